@@ -0,0 +1,183 @@
+// Connections per second the server gets through during a connection storm, and what that does to live matches' ticks.
+//
+//   TickThread - how the server used to do it: the tick thread waits on the listener too, accepts one connection per wakeup and,
+//                since the match is full, sends LOBBY Full and disconnects before it gets back to ticking
+//   Acceptor   - the Acceptor drains the backlog on its own thread and hands connections to 1 or 16 match threads through their
+//                MatchInbox. Each match keeps its first two players, after that everyone gets LOBBY Full from the acceptor.
+//
+// Every iteration opens 16 connections to localhost and waits until the server side has dealt with all of them, so
+// items_per_second is connections handled per second. Every match ticks every 30 ms doing 0.5 ms of work;
+// tick_late_p99_us / tick_late_max_us are how long after its deadline a tick started, late_ticks the ones over 5 ms late.
+
+#include <benchmark/benchmark.h>
+#include <SFML/Network.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../GameServer/Acceptor.h"
+#include "../Shared/GameConfig.h"
+
+using namespace std;
+using namespace sf;
+
+namespace {
+
+	constexpr size_t CONNECTIONS_PER_ITERATION = 16;
+	constexpr int64_t TICK_WORK_US = 500;
+	constexpr int64_t LATE_TICK_US = 5000;
+
+	using SteadyClock = chrono::steady_clock;
+
+	// Stand-in for a tick's simulation work
+	void spin(int64_t micros) {
+		SteadyClock::time_point until = SteadyClock::now() + chrono::microseconds(micros);
+		while (SteadyClock::now() < until) {}
+	}
+
+	// How late each tick started, from every match
+	struct TickLog {
+		void add(const vector<int64_t>& lateness) {
+			lock_guard<mutex> guard(lock);
+			samples.insert(samples.end(), lateness.begin(), lateness.end());
+		}
+
+		void report(benchmark::State& state) {
+			if (samples.empty()) return;
+			sort(samples.begin(), samples.end());
+			state.counters["tick_late_p99_us"] = static_cast<double>(samples[samples.size() * 99 / 100]);
+			state.counters["tick_late_max_us"] = static_cast<double>(samples.back());
+			state.counters["late_ticks"] = static_cast<double>(count_if(samples.begin(), samples.end(), [](int64_t late) { return late > LATE_TICK_US; }));
+			state.counters["ticks"] = static_cast<double>(samples.size());
+		}
+
+		mutex lock;
+		vector<int64_t> samples;
+	};
+
+	// The client side of the storm: open a batch of connections, wait until the server has handled them all, close them
+	void connectBatch(unsigned short port, atomic<uint64_t>& handled, uint64_t& expected) {
+		TcpSocket sockets[CONNECTIONS_PER_ITERATION];
+		for (TcpSocket& socket : sockets) socket.connect(IpAddress::LocalHost, port);
+		expected += CONNECTIONS_PER_ITERATION;
+		while (handled.load(memory_order_acquire) < expected) this_thread::sleep_for(chrono::microseconds(50)); // Not yield: leave the CPU to the server threads
+	}
+}
+
+static void BM_Accept_TickThread(benchmark::State& state) {
+	TcpListener listener;
+	if (listener.listen(Socket::AnyPort) != Socket::Done) {
+		state.SkipWithError("Could not listen");
+		return;
+	}
+	unsigned short port = listener.getLocalPort();
+
+	atomic<bool> running{ true };
+	atomic<uint64_t> handled{ 0 };
+	TickLog ticks;
+
+	thread tickThread([&] {
+		SocketSelector selector;
+		selector.add(listener);
+		vector<int64_t> lateness;
+
+		SteadyClock::time_point deadline = SteadyClock::now() + chrono::milliseconds(SNAPSHOT_INTERVAL_MS);
+		while (running.load(memory_order_relaxed)) {
+			auto left = chrono::duration_cast<chrono::microseconds>(deadline - SteadyClock::now()).count();
+			if (left > 0 && selector.wait(microseconds(left)) && selector.isReady(listener)) {
+				TcpSocket extraPlayer;
+				if (listener.accept(extraPlayer) == Socket::Done) {
+					Packet packet = lobbyPacket(LobbyStatus::Full);
+					extraPlayer.send(packet);
+					extraPlayer.disconnect();
+					handled.fetch_add(1, memory_order_release);
+				}
+				continue;
+			}
+
+			SteadyClock::time_point now = SteadyClock::now();
+			if (now >= deadline) {
+				lateness.push_back(chrono::duration_cast<chrono::microseconds>(now - deadline).count());
+				spin(TICK_WORK_US);
+				deadline += chrono::milliseconds(SNAPSHOT_INTERVAL_MS);
+			}
+		}
+		ticks.add(lateness);
+	});
+
+	uint64_t expected = 0;
+	for (auto _ : state) connectBatch(port, handled, expected);
+
+	running = false;
+	tickThread.join();
+	ticks.report(state);
+	state.SetItemsProcessed(static_cast<int64_t>(expected));
+}
+BENCHMARK(BM_Accept_TickThread)->Iterations(1000)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+static void BM_Accept_Acceptor(benchmark::State& state) {
+	size_t matchCount = static_cast<size_t>(state.range(0));
+
+	// Every connection comes from 127.0.0.1 here, so the per-IP limit is out of the way
+	AdmissionPolicy policy;
+	policy.connectionsPerSecondPerIp = 1e9f;
+	policy.burstPerIp = 1e9f;
+
+	Acceptor acceptor(Socket::AnyPort, policy);
+	if (!acceptor.isListening()) {
+		state.SkipWithError("Could not listen");
+		return;
+	}
+
+	vector<unique_ptr<MatchInbox>> inboxes;
+	for (size_t i = 0; i < matchCount; ++i) {
+		inboxes.push_back(make_unique<MatchInbox>(2));
+		acceptor.addWorker(*inboxes.back());
+	}
+
+	atomic<bool> running{ true };
+	atomic<uint64_t> handled{ 0 };
+	TickLog ticks;
+
+	thread acceptThread([&] {
+		while (running.load(memory_order_relaxed)) handled.fetch_add(acceptor.acceptBatch(milliseconds(10)), memory_order_release);
+	});
+
+	vector<thread> matches;
+	for (size_t i = 0; i < matchCount; ++i) {
+		matches.emplace_back([&, i] {
+			vector<unique_ptr<ClientSocket>> players, arrived;
+			vector<int64_t> lateness;
+
+			// Matches start at different times, so their ticks don't all land at once
+			SteadyClock::time_point deadline = SteadyClock::now() + chrono::milliseconds(SNAPSHOT_INTERVAL_MS) + chrono::microseconds(SNAPSHOT_INTERVAL_MS * 1000 * i / matchCount);
+			while (running.load(memory_order_relaxed)) {
+				this_thread::sleep_until(deadline);
+				lateness.push_back(chrono::duration_cast<chrono::microseconds>(SteadyClock::now() - deadline).count());
+
+				arrived.clear();
+				inboxes[i]->take(arrived, players.size());
+				for (auto& player : arrived) players.push_back(move(player));
+
+				spin(TICK_WORK_US);
+				deadline += chrono::milliseconds(SNAPSHOT_INTERVAL_MS);
+			}
+			ticks.add(lateness);
+		});
+	}
+
+	uint64_t expected = 0;
+	for (auto _ : state) connectBatch(acceptor.getLocalPort(), handled, expected);
+
+	running = false;
+	acceptThread.join();
+	for (thread& match : matches) match.join();
+	ticks.report(state);
+	state.SetItemsProcessed(static_cast<int64_t>(expected));
+}
+BENCHMARK(BM_Accept_Acceptor)->Arg(1)->Arg(16)->Iterations(1000)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,134 @@
+// Cost of sending one message to every client, at 2, 64 and 1,024 recipients (Linux, over local socket pairs).
+//
+//   CopyPerRecipient - what sf::TcpSocket::send(Packet&) does for each client: build a new length-prefixed buffer and send it
+//   SharedBuffer     - encode once into a MessagePool buffer, queue a reference per client, flush with sendmsg
+//
+// The payload is a PLAYER_POSITIONS message for the same number of players (command + timestamp, ID, x, y each).
+
+#include <benchmark/benchmark.h>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "../GameServer/MessagePool.h"
+
+namespace {
+
+	struct Recipients {
+		explicit Recipients(size_t count) {
+			// 1,024 pairs needs more descriptors than the usual soft limit
+			rlimit limit;
+			if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+				limit.rlim_cur = limit.rlim_max;
+				setrlimit(RLIMIT_NOFILE, &limit);
+			}
+
+			for (size_t i = 0; i < count; ++i) {
+				int pair[2];
+				if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) break;
+				senders.push_back(pair[0]);
+				receivers.push_back(pair[1]);
+			}
+		}
+
+		~Recipients() {
+			for (int fd : senders) close(fd);
+			for (int fd : receivers) close(fd);
+		}
+
+		// Read everything the benchmark sent, outside the timed part
+		void drain() {
+			char sink[65536];
+			for (int fd : receivers) {
+				while (recv(fd, sink, sizeof(sink), MSG_DONTWAIT) > 0) {}
+			}
+		}
+
+		std::vector<int> senders;
+		std::vector<int> receivers;
+	};
+
+	std::vector<char> positionsPayload(size_t players) {
+		const char command[] = "PLAYER_POSITIONS";
+		std::vector<char> payload(4 + sizeof(command) - 1 + players * (8 + 4 + 4 + 4), 'x');
+		return payload;
+	}
+
+	// Drain before any socket has this much unread, so no send ever fails with EAGAIN and both versions do the same work.
+	// (Unix sockets charge ~1KB of buffer space per send however small, hence the message limit too.)
+	constexpr size_t DRAIN_AFTER_BYTES = 64 * 1024;
+	constexpr size_t DRAIN_AFTER_MESSAGES = 64;
+}
+
+static void BM_Broadcast_CopyPerRecipient(benchmark::State& state) {
+	size_t count = static_cast<size_t>(state.range(0));
+	Recipients recipients(count);
+	std::vector<char> payload = positionsPayload(count);
+
+	size_t unread = 0;
+	size_t unreadMessages = 0;
+	for (auto _ : state) {
+		for (int fd : recipients.senders) {
+			// New buffer with the size prefix for every client, like TcpSocket::send(Packet&)
+			uint32_t size = static_cast<uint32_t>(payload.size());
+			std::unique_ptr<char[]> block(new char[4 + size]);
+			block[0] = static_cast<char>(size >> 24);
+			block[1] = static_cast<char>(size >> 16);
+			block[2] = static_cast<char>(size >> 8);
+			block[3] = static_cast<char>(size);
+			std::memcpy(block.get() + 4, payload.data(), size);
+			benchmark::DoNotOptimize(send(fd, block.get(), 4 + size, MSG_DONTWAIT | MSG_NOSIGNAL));
+		}
+
+		unread += payload.size() + 4;
+		if (unread >= DRAIN_AFTER_BYTES || ++unreadMessages == DRAIN_AFTER_MESSAGES) {
+			state.PauseTiming();
+			recipients.drain();
+			unread = 0;
+			unreadMessages = 0;
+			state.ResumeTiming();
+		}
+	}
+
+	state.SetItemsProcessed(state.iterations() * count);
+	state.SetBytesProcessed(state.iterations() * count * (payload.size() + 4));
+}
+BENCHMARK(BM_Broadcast_CopyPerRecipient)->Arg(2)->Arg(64)->Arg(1024);
+
+static void BM_Broadcast_SharedBuffer(benchmark::State& state) {
+	size_t count = static_cast<size_t>(state.range(0));
+	Recipients recipients(count);
+	std::vector<char> payload = positionsPayload(count);
+	MessagePool pool(payload.size() + 4);
+	std::vector<OutboundQueue> queues(count);
+
+	size_t unread = 0;
+	size_t unreadMessages = 0;
+	for (auto _ : state) {
+		// Encoded once per tick
+		MessageRef message = pool.encode(payload.data(), payload.size());
+
+		for (size_t i = 0; i < count; ++i) {
+			queues[i].push(message);
+			benchmark::DoNotOptimize(queues[i].flush(recipients.senders[i]));
+		}
+
+		unread += payload.size() + 4;
+		if (unread >= DRAIN_AFTER_BYTES || ++unreadMessages == DRAIN_AFTER_MESSAGES) {
+			state.PauseTiming();
+			recipients.drain();
+			unread = 0;
+			unreadMessages = 0;
+			state.ResumeTiming();
+		}
+	}
+
+	state.counters["pool_buffers"] = static_cast<double>(pool.totalCount());
+	state.SetItemsProcessed(state.iterations() * count);
+	state.SetBytesProcessed(state.iterations() * count * (payload.size() + 4));
+}
+BENCHMARK(BM_Broadcast_SharedBuffer)->Arg(2)->Arg(64)->Arg(1024);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,266 @@
+// Checks that the client's per-frame work makes no heap allocations once it has warmed up, without a server or a window.
+// Not a Google Benchmark: it exits with 1 if any frame after the warm-up allocated, so a build can fail on it.
+//
+// Each frame goes the way Client::gameLoop does: FramePacer hands out the input ticks, and every tick steps the player
+// towards a moving target, sends UPDATE_POSITION (with the InputEcho) through a PacketStream when shouldSendInput says so,
+// then reads everything the server sent. The server end is a loopback connection in this process, sending what a match
+// sends: PLAYER_POSITIONS for 4 players, or 64 (big enough to go out PACKED), ROSTER score changes and a SPAWN / DESPAWN now
+// and then. Everything it receives is decoded with the client's decoders into reused buffers and applied to a Leaderboard
+// and the players' positions, then each frame interpolates every player for drawing. The server end's own work is left
+// out of the count (FrameAllocationCheck::exclude).
+//
+// What it can't cover is the drawing itself and SFML's window: the headless client does those (see README,
+// CORPLIFE_COUNT_ALLOCATIONS).
+//
+// Needs -DCORPLIFE_COUNT_ALLOCATIONS=ON. `cmake --build <build> --target alloc-check` builds and runs it.
+
+#include <SFML/Network.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../Shared/AllocationCounter.h"
+#include "../Shared/Compression.h"
+#include "../Shared/Decoders.h"
+#include "../Shared/PacketStream.h"
+#include "../Shared/Protocol.h"
+#include "../Shared/Schema.h"
+#include "../Shared/Simulation.h"
+#include "../Client1/FramePacer.h"
+#include "../Client1/Leaderboard.h"
+
+using namespace std;
+using namespace sf;
+
+namespace {
+
+	constexpr unsigned FRAMES = 2000;
+	constexpr unsigned WARMUP_FRAMES = 120; // The same as Client::ALLOCATION_WARMUP_FRAMES
+	constexpr float FRAME_SECONDS = 1.f / 60.f;
+	constexpr int OUR_ID = 0;
+	constexpr int SMALL_MATCH = 4;
+	constexpr int BIG_MATCH = 64;
+
+	// The parts of Client's Player the game loop touches
+	struct Player {
+		Vector2f position;
+		Vector2f previousPosition;
+		long long lastReceivedTimestamp = -1;
+		Clock lastReceivedUpdate;
+	};
+
+	// The server end: plain SFML, like the real server's wire format, and allowed to allocate
+	class FakeServer {
+	public:
+		bool connect(TcpSocket& client) {
+			if (listener.listen(Socket::AnyPort, IpAddress::LocalHost) != Socket::Done) return false;
+			if (client.connect(IpAddress::LocalHost, listener.getLocalPort()) != Socket::Done) return false;
+			return listener.accept(socket) == Socket::Done;
+		}
+
+		// One input tick's worth of messages
+		void sendTick(unsigned tick) {
+			Packet ignored;
+			socket.setBlocking(false);
+			while (socket.receive(ignored) == Socket::Done) {} // UPDATE_POSITIONs
+			socket.setBlocking(true);
+
+			// Snapshots every other tick (SNAPSHOT_INTERVAL_MS is two input ticks), alternating between a small and a big match.
+			// The first of everything comes during the warm-up (about 130 ticks), when the client's buffers are still growing.
+			if (tick % 2 == 0) {
+				Packet snapshot = positions((tick / 50) % 2 == 0 ? SMALL_MATCH : BIG_MATCH, tick);
+				send(snapshot);
+			}
+			if (tick % 7 == 0) {
+				Packet roster;
+				roster << opcodeName(Opcode::Roster) << ++rosterVersion << static_cast<Uint16>(1)
+					<< static_cast<Uint8>(RosterEvent::Score) << static_cast<Int32>(tick % SMALL_MATCH) << static_cast<Int32>(1);
+				send(roster);
+			}
+			if (tick % 150 == 20) {
+				Packet spawn;
+				spawn << opcodeName(Opcode::Spawn);
+				Schema::append(spawn, SpawnMessage{ 400.f, 300.f, 255, 128, 0, tick / 60.f });
+				send(spawn);
+			}
+			else if (tick % 150 == 95) {
+				Packet despawn;
+				despawn << opcodeName(Opcode::Despawn);
+				send(despawn);
+			}
+		}
+
+		Uint32 rosterVersion = 0;
+
+	private:
+		Packet positions(int players, unsigned tick) {
+			Packet packet;
+			packet << opcodeName(Opcode::PlayerPositions);
+			for (int id = 0; id < players; ++id) {
+				float angle = tick * 0.02f + id;
+				Schema::append(packet, PlayerPositionEntry{ 1700000000000LL + tick * 15, id, 800.f + 300.f * cos(angle), 400.f + 200.f * sin(angle) });
+			}
+			return packet;
+		}
+
+		// PACKED when that makes it smaller, like Server::encodeMessage
+		void send(Packet& packet) {
+			if (packet.getDataSize() >= COMPRESSION_THRESHOLD) {
+				compressor.compress(packet.getData(), packet.getDataSize(), compressed);
+				if (PACKED_HEADER_SIZE + compressed.size() < packet.getDataSize()) {
+					Packet packed;
+					packed << opcodeName(Opcode::Packed) << COMPRESSION_DICTIONARY_VERSION << static_cast<Uint32>(packet.getDataSize());
+					packed.append(compressed.data(), compressed.size());
+					socket.send(packed);
+					return;
+				}
+			}
+			socket.send(packet);
+		}
+
+		TcpListener listener;
+		TcpSocket socket;
+		Compressor compressor;
+		vector<char> compressed;
+	};
+
+	// Client::unpack
+	bool unpack(Packet& packet, string& command, Compressor& decompressor, vector<char>& unpacked) {
+		uint8_t version = 0;
+		uint32_t rawSize = 0;
+		if (!decodePackedHeader(packet, version, rawSize) || version != COMPRESSION_DICTIONARY_VERSION) return false;
+
+		const char* data = static_cast<const char*>(packet.getData()) + PACKED_HEADER_SIZE;
+		if (!decompressor.decompress(data, packet.getDataSize() - PACKED_HEADER_SIZE, rawSize, unpacked)) return false;
+		packet.clear();
+		packet.append(unpacked.data(), unpacked.size());
+		packet >> command;
+		return static_cast<bool>(packet) && command != "PACKED";
+	}
+}
+
+int main() {
+	if (!AllocationCounter::isActive()) {
+		cerr << "Built without CORPLIFE_COUNT_ALLOCATIONS, so there's nothing to count. Configure with -DCORPLIFE_COUNT_ALLOCATIONS=ON.\n";
+		return 1;
+	}
+
+	TcpSocket socket;
+	FakeServer server;
+	if (!server.connect(socket)) {
+		cerr << "Could not open a loopback connection.\n";
+		return 1;
+	}
+	socket.setBlocking(false);
+
+	// The client's state, as in Client
+	PacketStream packetStream(socket);
+	Packet incoming, outgoing;
+	string command;
+	vector<PlayerPositionEntry> positionEntries;
+	vector<RosterEntry> rosterEntries;
+	vector<char> unpacked;
+	Compressor decompressor;
+	unordered_map<int, Player> playerData;
+	Leaderboard leaderboard;
+	for (int id = 0; id < SMALL_MATCH; ++id) leaderboard.set(id, "Player " + to_string(id), 0);
+	vector<Vector2f> rainbowPositions;
+
+	Vector2f position(PLAYER_SPAWN_X, PLAYER_SPAWN_Y), previousPosition = position;
+	Vector2f lastSentPosition, lastSentMovement;
+	Clock sinceInputSent;
+
+	FramePacer pacer(INPUT_TICK_MS / 1000.f, FRAME_SECONDS);
+	FrameAllocationCheck allocationCheck(WARMUP_FRAMES);
+	unsigned tickCount = 0;
+	uint32_t firstVersion = 0;
+	uint64_t checkedFrames = 0, allocatingFrames = 0;
+
+	for (unsigned frame = 0; frame < FRAMES; ++frame) {
+		allocationCheck.beginFrame();
+
+		unsigned ticks = pacer.beginFrame(FRAME_SECONDS);
+		for (unsigned i = 0; i < ticks; ++i) {
+			tickCount++;
+			float seconds = tickCount * INPUT_TICK_MS / 1000.f;
+
+			// Client::inputTick: move, then send if that's worth it
+			Vector2f target(800.f + 400.f * cos(seconds), 450.f + 250.f * sin(seconds * 1.3f));
+			previousPosition = position;
+			MoveStep move = step(position, target, INPUT_TICK_MS / 1000.f);
+			position = move.position;
+
+			if (shouldSendInput(position, move.movement, lastSentPosition, lastSentMovement, sinceInputSent.getElapsedTime().asSeconds() * 1000.f)) {
+				outgoing.clear();
+				outgoing << "UPDATE_POSITION";
+				Schema::append(outgoing, UpdatePositionMessage{ position.x, position.y, move.movement.x, move.movement.y });
+				auto self = playerData.find(OUR_ID);
+				if (self != playerData.end()) {
+					Int32 heldMs = self->second.lastReceivedUpdate.getElapsedTime().asMilliseconds();
+					Schema::append(outgoing, InputEcho{ self->second.lastReceivedTimestamp, static_cast<uint16_t>(min<Int32>(heldMs, 65535)) });
+				}
+				if (packetStream.send(outgoing) == Socket::Done) {
+					lastSentPosition = position;
+					lastSentMovement = move.movement;
+					sinceInputSent.restart();
+				}
+			}
+
+			allocationCheck.exclude();
+			server.sendTick(tickCount);
+			allocationCheck.include();
+
+			// Client::receiveMessages
+			while (packetStream.receive(incoming) == Socket::Done) {
+				incoming >> command;
+				if (command == "PACKED" && !unpack(incoming, command, decompressor, unpacked)) command.clear();
+
+				if (command == "PLAYER_POSITIONS" && decodePlayerPositions(incoming, positionEntries)) {
+					for (const PlayerPositionEntry& entry : positionEntries) {
+						Player& player = playerData[entry.ID];
+						player.lastReceivedTimestamp = entry.timestamp;
+						player.lastReceivedUpdate.restart();
+						player.previousPosition = player.position;
+						player.position = player.position + 0.2f * (Vector2f(entry.x, entry.y) - player.position);
+					}
+				}
+				else if (command == "ROSTER" && decodeRoster(incoming, firstVersion, rosterEntries)) {
+					for (const RosterEntry& event : rosterEntries) {
+						if (event.type == RosterEvent::Score) leaderboard.addScore(event.ID, event.value);
+					}
+				}
+				else if (command == "SPAWN") {
+					SpawnMessage spawn;
+					if (decodeSpawn(incoming, spawn)) rainbowPositions.push_back(Vector2f(spawn.x, spawn.y));
+				}
+				else if (command == "DESPAWN") rainbowPositions.clear();
+			}
+		}
+
+		// What the frame draws: everyone part way between their last two positions, and the top of the scoreboard
+		float alpha = pacer.alpha();
+		Vector2f drawn = previousPosition + alpha * (position - previousPosition);
+		for (const auto& entry : playerData) {
+			const Player& player = entry.second;
+			drawn += player.previousPosition + alpha * (player.position - player.previousPosition);
+		}
+		int topScores = 0;
+		for (size_t rank = 0; rank < leaderboard.size() && rank < 5; ++rank) topScores += leaderboard.at(rank).score;
+		if (drawn.x != drawn.x || topScores < 0) cerr << "Unexpected state\n"; // Keeps the work from being optimised away
+
+		uint64_t frameAllocations = allocationCheck.endFrame();
+		if (allocationCheck.warmedUp()) {
+			checkedFrames++;
+			if (frameAllocations > 0) {
+				allocatingFrames++;
+				if (allocatingFrames <= 10) cerr << "Frame " << frame << " made " << frameAllocations << " allocations\n";
+			}
+		}
+	}
+
+	cout << "Allocation check: " << allocatingFrames << " of " << checkedFrames << " frames after warm-up allocated ("
+		<< playerData.size() << " players, " << server.rosterVersion << " roster events).\n";
+	return allocatingFrames > 0 || playerData.size() < BIG_MATCH ? 1 : 0;
+}
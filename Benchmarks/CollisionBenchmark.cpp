@@ -0,0 +1,122 @@
+// Collision tests (Shared/Collision.h), in pairs tested per second (pairs_per_second).
+//
+//   OnePairAtATime  - overlaps() on each player and collectible in turn, the way the server tested one player at a time
+//   FirstOverlaps   - findFirstOverlaps, N players against M collectibles, with the scalar and the AVX2 kernel
+//   FirstOverlap    - findFirstOverlap, N players against one rainbow ball (what Server::updateBots does for its bots)
+//
+// Players and collectibles are spread at random over the play area, so few pairs overlap, as in a match. Before timing
+// anything the AVX2 kernel's answers are checked against the scalar one's.
+
+#include <benchmark/benchmark.h>
+#include <random>
+#include <vector>
+#include "../Shared/Collision.h"
+
+using namespace std;
+
+namespace {
+
+	struct Circles {
+		vector<float> x, y;
+		float radius;
+
+		CircleBatch batch() const { return { x.data(), y.data(), x.size(), radius }; }
+	};
+
+	Circles scatter(size_t count, float radius, unsigned seed) {
+		mt19937 random(seed);
+		uniform_real_distribution<float> x(radius, WINDOW_WIDTH - radius), y(radius, WINDOW_HEIGHT - radius);
+		Circles circles;
+		circles.radius = radius;
+		for (size_t i = 0; i < count; ++i) {
+			circles.x.push_back(x(random));
+			circles.y.push_back(y(random));
+		}
+		return circles;
+	}
+
+	void countPairs(benchmark::State& state, size_t pairs) {
+		state.counters["pairs_per_second"] = benchmark::Counter(static_cast<double>(state.iterations() * pairs), benchmark::Counter::kIsRate);
+	}
+
+	// Both kernels have to give the same answers before either is worth timing
+	bool kernelsAgree(const Circles& players, const Circles& collectibles) {
+		if (!setCollisionKernel(CollisionKernel::Avx2)) return true;
+		vector<int32_t> scalar(players.x.size()), avx2(players.x.size());
+		findFirstOverlaps(players.batch(), collectibles.batch(), avx2.data());
+		setCollisionKernel(CollisionKernel::Scalar);
+		findFirstOverlaps(players.batch(), collectibles.batch(), scalar.data());
+		return scalar == avx2;
+	}
+
+	bool useKernel(benchmark::State& state, CollisionKernel kernel) {
+		if (setCollisionKernel(kernel)) return true;
+		state.SkipWithError("This CPU doesn't have AVX2");
+		return false;
+	}
+}
+
+static void BM_OnePairAtATime(benchmark::State& state) {
+	size_t count = static_cast<size_t>(state.range(0)), collectibleCount = static_cast<size_t>(state.range(1));
+	vector<Circle> players, collectibles;
+	Circles playerCentres = scatter(count, PLAYER_RADIUS, 1), collectibleCentres = scatter(collectibleCount, RAINBOW_RADIUS, 2);
+	for (size_t i = 0; i < count; ++i) players.push_back({ playerCentres.x[i], playerCentres.y[i], PLAYER_RADIUS });
+	for (size_t j = 0; j < collectibleCount; ++j) collectibles.push_back({ collectibleCentres.x[j], collectibleCentres.y[j], RAINBOW_RADIUS });
+
+	for (auto _ : state) {
+		int touching = 0;
+		for (const Circle& player : players) {
+			for (const Circle& collectible : collectibles) {
+				if (overlaps(player, collectible)) {
+					touching++;
+					break;
+				}
+			}
+		}
+		benchmark::DoNotOptimize(touching);
+	}
+	countPairs(state, count * collectibleCount);
+}
+BENCHMARK(BM_OnePairAtATime)->Args({ 1024, 1 })->Args({ 1024, 16 })->Args({ 16384, 64 });
+
+static void firstOverlaps(benchmark::State& state, CollisionKernel kernel) {
+	size_t count = static_cast<size_t>(state.range(0)), collectibleCount = static_cast<size_t>(state.range(1));
+	Circles players = scatter(count, PLAYER_RADIUS, 1), collectibles = scatter(collectibleCount, RAINBOW_RADIUS, 2);
+	if (!kernelsAgree(players, collectibles)) {
+		state.SkipWithError("The AVX2 and scalar kernels disagree");
+		return;
+	}
+	if (!useKernel(state, kernel)) return;
+
+	vector<int32_t> firstHit(count);
+	for (auto _ : state) {
+		findFirstOverlaps(players.batch(), collectibles.batch(), firstHit.data());
+		benchmark::DoNotOptimize(firstHit.data());
+		benchmark::ClobberMemory();
+	}
+	countPairs(state, count * collectibleCount);
+}
+
+static void BM_FirstOverlaps_Scalar(benchmark::State& state) { firstOverlaps(state, CollisionKernel::Scalar); }
+static void BM_FirstOverlaps_Avx2(benchmark::State& state) { firstOverlaps(state, CollisionKernel::Avx2); }
+BENCHMARK(BM_FirstOverlaps_Scalar)->Args({ 64, 1 })->Args({ 1024, 1 })->Args({ 1024, 16 })->Args({ 16384, 64 });
+BENCHMARK(BM_FirstOverlaps_Avx2)->Args({ 64, 1 })->Args({ 1024, 1 })->Args({ 1024, 16 })->Args({ 16384, 64 });
+
+static void firstOverlap(benchmark::State& state, CollisionKernel kernel) {
+	size_t count = static_cast<size_t>(state.range(0));
+	Circles players = scatter(count, PLAYER_RADIUS, 1);
+	Circle ball = { -100.f, -100.f, RAINBOW_RADIUS }; // Off the map, so every player is tested
+	if (!useKernel(state, kernel)) return;
+
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(findFirstOverlap(players.batch(), ball));
+	}
+	countPairs(state, count);
+}
+
+static void BM_FirstOverlap_Scalar(benchmark::State& state) { firstOverlap(state, CollisionKernel::Scalar); }
+static void BM_FirstOverlap_Avx2(benchmark::State& state) { firstOverlap(state, CollisionKernel::Avx2); }
+BENCHMARK(BM_FirstOverlap_Scalar)->Arg(64)->Arg(2048)->Arg(16384);
+BENCHMARK(BM_FirstOverlap_Avx2)->Arg(64)->Arg(2048)->Arg(16384);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,100 @@
+// CPU time against bytes saved for the messages big enough to be compressed (Shared/Compression.h), with and without the
+// preset dictionary. Messages are built with sf::Packet exactly as the server builds them.
+//
+//   PlayerPositions/32   - a prioritised snapshot in a big match (SNAPSHOT_PLAYER_BUDGET entries)
+//   PlayerPositions/1024 - every player's position at 1,024 players
+//   ScoresWithNames/100  - UPDATE_SCORES as it used to be, every player's name and score whenever anyone scored
+//   RosterFull/100       - the scoreboard a client gets when it joins a 100 player match (ROSTER_FULL)
+//
+// raw_bytes / packed_bytes are the message before and after (packed_bytes includes the PACKED header), bytes_per_second is
+// how much raw message gets through per second.
+
+#include <benchmark/benchmark.h>
+#include <SFML/Network.hpp>
+#include <string>
+#include <vector>
+#include "../Shared/Compression.h"
+#include "../Shared/Protocol.h"
+
+using namespace std;
+using namespace sf;
+
+namespace {
+
+	enum class Message { PlayerPositions32, PlayerPositions1024, ScoresWithNames, RosterFull };
+
+	const char* const NAMES[] = { "Headless", "Player", "xX_Sniper_Xx", "Alex", "rainbow_hunter", "Sam", "Jo", "CorpLifer" };
+
+	string nameFor(int id) {
+		return NAMES[id % 8] + to_string(id);
+	}
+
+	void positions(Packet& packet, int players) {
+		packet << "PLAYER_POSITIONS";
+		Int64 timestamp = 1760000000000LL;
+		for (int id = 0; id < players; ++id) {
+			packet << timestamp << id << 100.f + (id * 137) % 1500 + 0.37f * id << 100.f + (id * 89) % 700 + 0.11f * id;
+		}
+	}
+
+	Packet build(Message message) {
+		Packet packet;
+		switch (message) {
+		case Message::PlayerPositions32: positions(packet, 32); break;
+		case Message::PlayerPositions1024: positions(packet, 1024); break;
+		case Message::ScoresWithNames:
+			packet << "UPDATE_SCORES";
+			for (int id = 0; id < 100; ++id) packet << id << nameFor(id) << id % 13;
+			break;
+		case Message::RosterFull:
+			packet << "ROSTER_FULL" << static_cast<Uint32>(412) << static_cast<Uint32>(100);
+			for (int id = 0; id < 100; ++id) packet << id << nameFor(id) << id % 13;
+			break;
+		}
+		return packet;
+	}
+
+	void label(benchmark::State& state) {
+		static const char* const LABELS[] = { "PlayerPositions/32", "PlayerPositions/1024", "ScoresWithNames/100", "RosterFull/100" };
+		state.SetLabel(string(LABELS[state.range(0)]) + (state.range(1) ? " dictionary" : " no dictionary"));
+	}
+}
+
+static void BM_Compress(benchmark::State& state) {
+	Packet packet = build(static_cast<Message>(state.range(0)));
+	Compressor compressor(state.range(1) != 0);
+	vector<char> out;
+
+	for (auto _ : state) {
+		compressor.compress(packet.getData(), packet.getDataSize(), out);
+		benchmark::DoNotOptimize(out.data());
+	}
+
+	label(state);
+	state.counters["raw_bytes"] = static_cast<double>(packet.getDataSize());
+	state.counters["packed_bytes"] = static_cast<double>(PACKED_HEADER_SIZE + out.size());
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * packet.getDataSize()));
+}
+
+static void BM_Decompress(benchmark::State& state) {
+	Packet packet = build(static_cast<Message>(state.range(0)));
+	Compressor compressor(state.range(1) != 0);
+	vector<char> compressed, out;
+	compressor.compress(packet.getData(), packet.getDataSize(), compressed);
+
+	for (auto _ : state) {
+		if (!compressor.decompress(compressed.data(), compressed.size(), packet.getDataSize(), out)) {
+			state.SkipWithError("Did not decompress");
+			return;
+		}
+		benchmark::DoNotOptimize(out.data());
+	}
+
+	label(state);
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * packet.getDataSize()));
+}
+
+BENCHMARK(BM_Compress)->ArgsProduct({ { 0, 1, 2, 3 }, { 0, 1 } });
+BENCHMARK(BM_Decompress)->ArgsProduct({ { 0, 1, 2, 3 }, { 0, 1 } });
+
+BENCHMARK_MAIN();
@@ -0,0 +1,266 @@
+// Decode throughput of every message the server and client receive, in messages per second on one core (items_per_second).
+//
+//   Checked   - the decoder in Shared/Decoders.h, which checks everything (finite positions, IDs, counts against the bytes
+//               left, name lengths) and what the server, client and spectator use
+//   Unchecked - the same fields read straight off the packet with no checks, the way the receivers used to. The checked
+//               decoder shouldn't be noticeably slower than this.
+//
+// Each iteration copies the message into a reused packet first, the way PacketStream::receive hands it over.
+
+#include <benchmark/benchmark.h>
+#include <SFML/Network.hpp>
+#include <string>
+#include <vector>
+#include "../Shared/Decoders.h"
+
+using namespace std;
+using namespace sf;
+
+namespace {
+
+	Packet updatePosition() {
+		Packet packet;
+		packet << opcodeName(Opcode::UpdatePosition);
+		Schema::append(packet, UpdatePositionMessage{ 512.f, 384.f, 1.5f, -0.5f });
+		Schema::append(packet, InputEcho{ 1700000000000LL, 16 });
+		return packet;
+	}
+
+	Packet playerPositions(int players) {
+		Packet packet;
+		packet << opcodeName(Opcode::PlayerPositions);
+		for (int id = 0; id < players; ++id) Schema::append(packet, PlayerPositionEntry{ 1700000000000LL, id, 100.f + id, 200.f + id });
+		return packet;
+	}
+
+	// A tick's worth of events: a couple of joins and the rest pickups
+	Packet roster(int events) {
+		Packet packet;
+		packet << opcodeName(Opcode::Roster) << static_cast<Uint32>(100) << static_cast<Uint16>(events);
+		for (int i = 0; i < events; ++i) {
+			if (i < 2) packet << static_cast<Uint8>(RosterEvent::Join) << static_cast<Int32>(i) << ("Player" + to_string(i)) << static_cast<Int32>(0);
+			else packet << static_cast<Uint8>(RosterEvent::Score) << static_cast<Int32>(i) << static_cast<Int32>(1);
+		}
+		return packet;
+	}
+
+	Packet fullRoster(int players) {
+		Packet packet;
+		packet << opcodeName(Opcode::RosterFull) << static_cast<Uint32>(100) << static_cast<Uint32>(players);
+		for (int id = 0; id < players; ++id) packet << static_cast<Int32>(id) << ("Player" + to_string(id)) << static_cast<Int32>(id % 13);
+		return packet;
+	}
+
+	Packet watch(int players) {
+		Packet packet;
+		packet << opcodeName(Opcode::Watch) << static_cast<Uint32>(42) << static_cast<Uint8>(WATCH_MATCH_IN_PROGRESS | WATCH_RAINBOW_BALL)
+			<< 800.f << 450.f << static_cast<Uint8>(255) << static_cast<Uint8>(128) << static_cast<Uint8>(0) << static_cast<Uint16>(players);
+		for (int id = 0; id < players; ++id) {
+			packet << static_cast<Int32>(id) << 100.f + id << 200.f + id << static_cast<Int32>(id % 13) << ("Player" + to_string(id));
+		}
+		return packet;
+	}
+
+	// Refill `packet` with `encoded` and read the command, then time `decode` on what's left
+	template <typename Decode>
+	void run(benchmark::State& state, const Packet& encoded, Decode decode) {
+		Packet packet;
+		string command;
+		for (auto _ : state) {
+			packet.clear();
+			packet.append(encoded.getData(), encoded.getDataSize());
+			packet >> command;
+			benchmark::DoNotOptimize(decode(packet));
+		}
+		state.SetItemsProcessed(state.iterations());
+		state.counters["message_bytes"] = static_cast<double>(encoded.getDataSize());
+	}
+}
+
+/* ------------------------ UPDATE_POSITION (every client, every input change) ------------------------ */
+
+static void BM_UpdatePosition_Unchecked(benchmark::State& state) {
+	run(state, updatePosition(), [](Packet& packet) {
+		float x, y, moveX, moveY;
+		Int64 timestamp = 0;
+		Uint16 heldMs = 0;
+		packet >> x >> y >> moveX >> moveY;
+		if (!packet.endOfPacket()) packet >> timestamp >> heldMs;
+		return x + y + moveX + moveY + timestamp + heldMs;
+	});
+}
+BENCHMARK(BM_UpdatePosition_Unchecked);
+
+static void BM_UpdatePosition_Checked(benchmark::State& state) {
+	run(state, updatePosition(), [](Packet& packet) {
+		UpdatePositionMessage update;
+		InputEcho echo;
+		bool valid = decodeUpdatePosition(packet, update, echo);
+		return valid ? update.x + update.y + update.moveX + update.moveY + echo.timestamp + echo.heldMs : 0.f;
+	});
+}
+BENCHMARK(BM_UpdatePosition_Checked);
+
+/* ------------------------ PLAYER_POSITIONS ------------------------ */
+
+static void BM_PlayerPositions_Unchecked(benchmark::State& state) {
+	run(state, playerPositions(static_cast<int>(state.range(0))), [](Packet& packet) {
+		float sum = 0.f;
+		while (!packet.endOfPacket()) {
+			Int64 timestamp;
+			Int32 id;
+			float x, y;
+			packet >> timestamp >> id >> x >> y;
+			if (!packet) break;
+			sum += x + y;
+		}
+		return sum;
+	});
+}
+BENCHMARK(BM_PlayerPositions_Unchecked)->Arg(2)->Arg(32);
+
+static void BM_PlayerPositions_Checked(benchmark::State& state) {
+	vector<PlayerPositionEntry> entries;
+	run(state, playerPositions(static_cast<int>(state.range(0))), [&](Packet& packet) {
+		float sum = 0.f;
+		if (decodePlayerPositions(packet, entries)) {
+			for (const PlayerPositionEntry& entry : entries) sum += entry.x + entry.y;
+		}
+		return sum;
+	});
+}
+BENCHMARK(BM_PlayerPositions_Checked)->Arg(2)->Arg(32);
+
+/* ------------------------ ROSTER and ROSTER_FULL ------------------------ */
+
+static void BM_Roster_Unchecked(benchmark::State& state) {
+	string name;
+	run(state, roster(static_cast<int>(state.range(0))), [&](Packet& packet) {
+		Uint32 firstVersion = 0;
+		Uint16 count = 0;
+		packet >> firstVersion >> count;
+		Int32 sum = 0;
+		for (Uint16 i = 0; i < count; ++i) {
+			Uint8 type = 0;
+			Int32 id = 0, value = 0;
+			packet >> type >> id;
+			if (type == static_cast<Uint8>(RosterEvent::Join)) packet >> name >> value;
+			else if (type == static_cast<Uint8>(RosterEvent::Score)) packet >> value;
+			if (!packet) break;
+			sum += id + value;
+		}
+		return sum;
+	});
+}
+BENCHMARK(BM_Roster_Unchecked)->Arg(1)->Arg(8);
+
+static void BM_Roster_Checked(benchmark::State& state) {
+	vector<RosterEntry> events;
+	run(state, roster(static_cast<int>(state.range(0))), [&](Packet& packet) {
+		uint32_t firstVersion = 0;
+		Int32 sum = 0;
+		if (decodeRoster(packet, firstVersion, events)) {
+			for (const RosterEntry& event : events) sum += event.ID + event.value;
+		}
+		return sum;
+	});
+}
+BENCHMARK(BM_Roster_Checked)->Arg(1)->Arg(8);
+
+static void BM_RosterFull_Unchecked(benchmark::State& state) {
+	string name;
+	run(state, fullRoster(static_cast<int>(state.range(0))), [&](Packet& packet) {
+		Uint32 version = 0, count = 0;
+		packet >> version >> count;
+		Int32 sum = 0;
+		for (Uint32 i = 0; i < count; ++i) {
+			Int32 id = 0, score = 0;
+			packet >> id >> name >> score;
+			if (!packet) break;
+			sum += id + score;
+		}
+		return sum;
+	});
+}
+BENCHMARK(BM_RosterFull_Unchecked)->Arg(2)->Arg(64);
+
+static void BM_RosterFull_Checked(benchmark::State& state) {
+	vector<RosterEntry> players;
+	run(state, fullRoster(static_cast<int>(state.range(0))), [&](Packet& packet) {
+		uint32_t version = 0;
+		Int32 sum = 0;
+		if (decodeFullRoster(packet, version, players)) {
+			for (const RosterEntry& player : players) sum += player.ID + player.value;
+		}
+		return sum;
+	});
+}
+BENCHMARK(BM_RosterFull_Checked)->Arg(2)->Arg(64);
+
+/* ------------------------ WATCH (every spectator, every frame) ------------------------ */
+
+static void BM_Watch_Unchecked(benchmark::State& state) {
+	string name;
+	run(state, watch(static_cast<int>(state.range(0))), [&](Packet& packet) {
+		Uint32 frame = 0;
+		Uint8 flags = 0, r, g, b;
+		Uint16 count = 0;
+		float rainbowX, rainbowY;
+		packet >> frame >> flags;
+		if (flags & WATCH_RAINBOW_BALL) packet >> rainbowX >> rainbowY >> r >> g >> b;
+		packet >> count;
+		float sum = 0.f;
+		for (Uint16 i = 0; i < count; ++i) {
+			Int32 id = 0, score = 0;
+			float x, y;
+			packet >> id >> x >> y >> score >> name;
+			sum += x + y;
+		}
+		return sum;
+	});
+}
+BENCHMARK(BM_Watch_Unchecked)->Arg(2)->Arg(64);
+
+static void BM_Watch_Checked(benchmark::State& state) {
+	WatchFrame frame;
+	run(state, watch(static_cast<int>(state.range(0))), [&](Packet& packet) {
+		float sum = 0.f;
+		if (decodeWatch(packet, frame)) {
+			for (const RosterEntry& player : frame.players) sum += player.x + player.y;
+		}
+		return sum;
+	});
+}
+BENCHMARK(BM_Watch_Checked)->Arg(2)->Arg(64);
+
+/* ------------------------ The rest (rare, checked only) ------------------------ */
+
+static void BM_PlayerName_Checked(benchmark::State& state) {
+	Packet encoded;
+	encoded << opcodeName(Opcode::PlayerName) << "Alice";
+	string name;
+	run(state, encoded, [&](Packet& packet) { return decodePlayerName(packet, name); });
+}
+BENCHMARK(BM_PlayerName_Checked);
+
+static void BM_Spawn_Checked(benchmark::State& state) {
+	Packet encoded;
+	encoded << opcodeName(Opcode::Spawn);
+	Schema::append(encoded, SpawnMessage{ 800.f, 450.f, 255, 128, 0, 5663.5f });
+	SpawnMessage spawn;
+	run(state, encoded, [&](Packet& packet) { return decodeSpawn(packet, spawn); });
+}
+BENCHMARK(BM_Spawn_Checked);
+
+static void BM_Resync_Checked(benchmark::State& state) {
+	Packet encoded;
+	encoded << opcodeName(Opcode::Resync);
+	Schema::append(encoded, ResyncMessage{ 3, 200.f, 300.f, 12, 2 });
+	Schema::append(encoded, SpawnMessage{ 800.f, 450.f, 255, 128, 0, 5663.5f });
+	ResyncMessage resync;
+	SpawnMessage spawn;
+	run(state, encoded, [&](Packet& packet) { return decodeResync(packet, resync, spawn); });
+}
+BENCHMARK(BM_Resync_Checked);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,120 @@
+// Frame-time cost of logging from the game loop.
+//
+// Each iteration is the per-frame work of Client::gameLoop's movement step plus the per-frame "Actual: ..." line
+// that sendPlayerPosition used to write with cout << endl. Compare:
+//   NoLogging            - the line compiled out (what CORPLIFE_LOG_LEVEL does)
+//   SyncStreamEndl       - the old cout << ... << endl, one flush per frame
+//   AsyncLevelOff        - LOG_DEBUG with the level switched off at runtime
+//   AsyncRateLimited     - LOG_DEBUG as used in the client (default per call site rate limit)
+//   AsyncEveryFrame      - every line formatted into the ring buffer (no rate limit)
+
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <fstream>
+#include <cstdio>
+#include "../Shared/Logger.h"
+
+#ifdef _WIN32
+static const char* NULL_DEVICE = "NUL";
+#else
+static const char* NULL_DEVICE = "/dev/null";
+#endif
+
+namespace {
+
+	struct FrameState {
+		float x = 100.f, y = 100.f;
+		float targetX = 900.f, targetY = 500.f;
+		float moveX = 0.f, moveY = 0.f;
+	};
+
+	// Same maths as the movement step in Client::gameLoop
+	inline void simulateFrame(FrameState& state, float deltaTime) {
+		float dx = state.targetX - state.x, dy = state.targetY - state.y;
+		float distance = std::sqrt(dx * dx + dy * dy);
+		if (distance > 5.f) {
+			state.moveX = dx / distance * 400.f * deltaTime;
+			state.moveY = dy / distance * 400.f * deltaTime;
+			state.x += state.moveX;
+			state.y += state.moveY;
+		}
+		else {
+			state.targetX = 1700.f - state.targetX;
+			state.targetY = 900.f - state.targetY;
+		}
+	}
+
+	struct NullOutput {
+		NullOutput() {
+			file = std::fopen(NULL_DEVICE, "w");
+			Logger::setOutput(file, file);
+		}
+		~NullOutput() {
+			Logger::setOutput(stdout, stderr);
+			std::fclose(file);
+		}
+		FILE* file;
+	};
+}
+
+static void BM_Frame_NoLogging(benchmark::State& state) {
+	FrameState frame;
+	for (auto _ : state) {
+		simulateFrame(frame, 1.f / 60.f);
+		benchmark::DoNotOptimize(frame);
+	}
+}
+BENCHMARK(BM_Frame_NoLogging);
+
+static void BM_Frame_SyncStreamEndl(benchmark::State& state) {
+	std::ofstream out(NULL_DEVICE);
+	FrameState frame;
+	for (auto _ : state) {
+		simulateFrame(frame, 1.f / 60.f);
+		out << "Actual: " << frame.x << ", " << frame.y << " || " << frame.moveX << ", " << frame.moveY << std::endl;
+	}
+}
+BENCHMARK(BM_Frame_SyncStreamEndl);
+
+static void BM_Frame_AsyncLevelOff(benchmark::State& state) {
+	NullOutput output;
+	Logger::setLevel(LogLevel::Off);
+	FrameState frame;
+	for (auto _ : state) {
+		simulateFrame(frame, 1.f / 60.f);
+		LOG_AT(LogLevel::Debug, "Actual: %.2f, %.2f || %.3f, %.3f", frame.x, frame.y, frame.moveX, frame.moveY);
+		benchmark::DoNotOptimize(frame);
+	}
+	Logger::setLevel(LogLevel::Debug);
+}
+BENCHMARK(BM_Frame_AsyncLevelOff);
+
+static void BM_Frame_AsyncRateLimited(benchmark::State& state) {
+	NullOutput output;
+	Logger::setLevel(LogLevel::Debug);
+	FrameState frame;
+	for (auto _ : state) {
+		simulateFrame(frame, 1.f / 60.f);
+		LOG_AT(LogLevel::Debug, "Actual: %.2f, %.2f || %.3f, %.3f", frame.x, frame.y, frame.moveX, frame.moveY);
+		benchmark::DoNotOptimize(frame);
+	}
+	Logger::flush();
+}
+BENCHMARK(BM_Frame_AsyncRateLimited);
+
+static void BM_Frame_AsyncEveryFrame(benchmark::State& state) {
+	NullOutput output;
+	Logger::setLevel(LogLevel::Debug);
+	FrameState frame;
+	uint64_t droppedBefore = Logger::droppedCount();
+	for (auto _ : state) {
+		simulateFrame(frame, 1.f / 60.f);
+		LOG_LIMITED(LogLevel::Debug, UINT32_MAX, "Actual: %.2f, %.2f || %.3f, %.3f", frame.x, frame.y, frame.moveX, frame.moveY);
+		benchmark::DoNotOptimize(frame);
+	}
+	Logger::flush();
+	state.counters["dropped"] = static_cast<double>(Logger::droppedCount() - droppedBefore);
+}
+BENCHMARK(BM_Frame_AsyncEveryFrame);
+
+BENCHMARK_MAIN();
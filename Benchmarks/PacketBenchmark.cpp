@@ -0,0 +1,213 @@
+// Encode / decode cost of the two messages sent every tick, with sf::Packet exactly as the server and client use it.
+//
+//   PlayerPositions - server -> clients, command + (timestamp, ID, x, y) per player, at 2, 64 and 1,024 players
+//   UpdatePosition  - client -> server, command + x, y, moveX, moveY + echoed timestamp and how long it was held
+//
+// The Fresh variants build a new Packet per message (what the server does), Reused clears one packet and refills it
+// (what the client does since the per-frame allocation work). The Schema variants write and read the same bytes through
+// the generated serializers in Shared/Schema.h, which is what the server and client use now.
+
+#include <benchmark/benchmark.h>
+#include <SFML/Network.hpp>
+#include <string>
+#include "../Shared/Protocol.h"
+
+using namespace sf;
+
+namespace {
+
+	void encodePositions(Packet& packet, int players) {
+		packet << "PLAYER_POSITIONS";
+		for (int id = 0; id < players; ++id) {
+			packet << static_cast<Int64>(1700000000000LL + id) << id << 100.f + id << 200.f + id;
+		}
+	}
+
+	void encodeUpdate(Packet& packet) {
+		packet << "UPDATE_POSITION" << 512.f << 384.f << 1.5f << -0.5f << static_cast<Int64>(1700000000000LL) << static_cast<Uint16>(16);
+	}
+
+	void encodePositionsSchema(Packet& packet, int players) {
+		packet << "PLAYER_POSITIONS";
+		for (int id = 0; id < players; ++id) {
+			Schema::append(packet, PlayerPositionEntry{ 1700000000000LL + id, id, 100.f + id, 200.f + id });
+		}
+	}
+
+	void encodeUpdateSchema(Packet& packet) {
+		packet << "UPDATE_POSITION";
+		Schema::append(packet, UpdatePositionMessage{ 512.f, 384.f, 1.5f, -0.5f });
+		Schema::append(packet, InputEcho{ 1700000000000LL, 16 });
+	}
+}
+
+static void BM_Encode_PlayerPositions_Fresh(benchmark::State& state) {
+	int players = static_cast<int>(state.range(0));
+	for (auto _ : state) {
+		Packet packet;
+		encodePositions(packet, players);
+		benchmark::DoNotOptimize(packet.getData());
+	}
+	state.SetItemsProcessed(state.iterations() * players);
+}
+BENCHMARK(BM_Encode_PlayerPositions_Fresh)->Arg(2)->Arg(64)->Arg(1024);
+
+static void BM_Encode_PlayerPositions_Reused(benchmark::State& state) {
+	int players = static_cast<int>(state.range(0));
+	Packet packet;
+	for (auto _ : state) {
+		packet.clear();
+		encodePositions(packet, players);
+		benchmark::DoNotOptimize(packet.getData());
+	}
+	state.SetItemsProcessed(state.iterations() * players);
+}
+BENCHMARK(BM_Encode_PlayerPositions_Reused)->Arg(2)->Arg(64)->Arg(1024);
+
+// Same loop as Client::receivePlayerPositions, minus the map update
+static void BM_Decode_PlayerPositions(benchmark::State& state) {
+	int players = static_cast<int>(state.range(0));
+	Packet encoded;
+	encodePositions(encoded, players);
+
+	Packet packet;
+	std::string command;
+	for (auto _ : state) {
+		packet.clear();
+		packet.append(encoded.getData(), encoded.getDataSize());
+
+		packet >> command;
+		float sum = 0.f;
+		while (!packet.endOfPacket()) {
+			Int64 timestamp;
+			int id;
+			float x, y;
+			packet >> timestamp >> id >> x >> y;
+			sum += x + y;
+		}
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * players);
+}
+BENCHMARK(BM_Decode_PlayerPositions)->Arg(2)->Arg(64)->Arg(1024);
+
+static void BM_Encode_PlayerPositions_Schema_Fresh(benchmark::State& state) {
+	int players = static_cast<int>(state.range(0));
+	for (auto _ : state) {
+		Packet packet;
+		encodePositionsSchema(packet, players);
+		benchmark::DoNotOptimize(packet.getData());
+	}
+	state.SetItemsProcessed(state.iterations() * players);
+}
+BENCHMARK(BM_Encode_PlayerPositions_Schema_Fresh)->Arg(2)->Arg(64)->Arg(1024);
+
+static void BM_Encode_PlayerPositions_Schema_Reused(benchmark::State& state) {
+	int players = static_cast<int>(state.range(0));
+	Packet packet;
+	for (auto _ : state) {
+		packet.clear();
+		encodePositionsSchema(packet, players);
+		benchmark::DoNotOptimize(packet.getData());
+	}
+	state.SetItemsProcessed(state.iterations() * players);
+}
+BENCHMARK(BM_Encode_PlayerPositions_Schema_Reused)->Arg(2)->Arg(64)->Arg(1024);
+
+// The loop Client::receivePlayerPositions has now
+static void BM_Decode_PlayerPositions_Schema(benchmark::State& state) {
+	int players = static_cast<int>(state.range(0));
+	Packet encoded;
+	encodePositions(encoded, players);
+
+	Packet packet;
+	std::string command;
+	for (auto _ : state) {
+		packet.clear();
+		packet.append(encoded.getData(), encoded.getDataSize());
+
+		packet >> command;
+		Schema::MessageReader reader = Schema::reader(packet);
+		PlayerPositionEntry entry;
+		float sum = 0.f;
+		while (!reader.atEnd() && reader.read(entry)) sum += entry.x + entry.y;
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * players);
+}
+BENCHMARK(BM_Decode_PlayerPositions_Schema)->Arg(2)->Arg(64)->Arg(1024);
+
+static void BM_Encode_UpdatePosition_Fresh(benchmark::State& state) {
+	for (auto _ : state) {
+		Packet packet;
+		encodeUpdate(packet);
+		benchmark::DoNotOptimize(packet.getData());
+	}
+}
+BENCHMARK(BM_Encode_UpdatePosition_Fresh);
+
+static void BM_Encode_UpdatePosition_Reused(benchmark::State& state) {
+	Packet packet;
+	for (auto _ : state) {
+		packet.clear();
+		encodeUpdate(packet);
+		benchmark::DoNotOptimize(packet.getData());
+	}
+}
+BENCHMARK(BM_Encode_UpdatePosition_Reused);
+
+// Same reads as Server::processClientData for UPDATE_POSITION
+static void BM_Decode_UpdatePosition(benchmark::State& state) {
+	Packet encoded;
+	encodeUpdate(encoded);
+
+	Packet packet;
+	std::string command;
+	for (auto _ : state) {
+		packet.clear();
+		packet.append(encoded.getData(), encoded.getDataSize());
+
+		float x, y, moveX, moveY;
+		Int64 echoedTimestamp = 0;
+		Uint16 heldMs = 0;
+		packet >> command >> x >> y >> moveX >> moveY;
+		if (!packet.endOfPacket()) packet >> echoedTimestamp >> heldMs;
+		benchmark::DoNotOptimize(x + y + moveX + moveY);
+		benchmark::DoNotOptimize(echoedTimestamp - heldMs);
+	}
+}
+BENCHMARK(BM_Decode_UpdatePosition);
+
+static void BM_Encode_UpdatePosition_Schema(benchmark::State& state) {
+	Packet packet;
+	for (auto _ : state) {
+		packet.clear();
+		encodeUpdateSchema(packet);
+		benchmark::DoNotOptimize(packet.getData());
+	}
+}
+BENCHMARK(BM_Encode_UpdatePosition_Schema);
+
+static void BM_Decode_UpdatePosition_Schema(benchmark::State& state) {
+	Packet encoded;
+	encodeUpdate(encoded);
+
+	Packet packet;
+	std::string command;
+	for (auto _ : state) {
+		packet.clear();
+		packet.append(encoded.getData(), encoded.getDataSize());
+
+		packet >> command;
+		Schema::MessageReader reader = Schema::reader(packet);
+		UpdatePositionMessage update = {};
+		InputEcho echo = {};
+		reader.read(update);
+		if (!reader.atEnd()) reader.read(echo);
+		benchmark::DoNotOptimize(update.x + update.y + update.moveX + update.moveY);
+		benchmark::DoNotOptimize(echo.timestamp - echo.heldMs);
+	}
+}
+BENCHMARK(BM_Decode_UpdatePosition_Schema);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,133 @@
+// The player store (GameServer/PlayerStore.h) at 1 and 4 million players.
+//
+//   Open         - starting the server with a store that was shut down cleanly (headers only, however big it is)
+//   RebuildIndex - starting it after the index was lost: every profile is read again
+//   Find         - one player by name, with their rank on the lifetime leaderboard
+//   TopPlayers   - the top 10 of the lifetime leaderboard
+//   AddScore     - a pickup, as the store's writer thread applies it
+//
+// The stores are built once, in the working directory (PlayerStoreBenchmark_<players>.*), and left there so the next run
+// doesn't have to build them again. About 300 MB for the 4 million player one.
+
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "../GameServer/PlayerStore.h"
+#include "../Shared/Logger.h"
+
+using namespace std;
+
+namespace {
+
+	string nameFor(uint32_t id) {
+		return "Player" + to_string(id);
+	}
+
+	// Path of a closed store with `players` profiles and random lifetime scores
+	string storeWith(uint32_t players) {
+		Logger::setLevel(LogLevel::Warning); // Every open() logs a line
+		string path = "PlayerStoreBenchmark_" + to_string(players);
+		PlayerStore store;
+		if (!store.open(path)) return string();
+		if (store.playerCount() == players) return path;
+
+		mt19937 random(players);
+		for (uint32_t id = static_cast<uint32_t>(store.playerCount()); id < players; ++id) {
+			uint32_t profileID = store.addPlayer(nameFor(id), 0);
+			store.addScore(profileID, random() % 5000);
+		}
+		return path;
+	}
+}
+
+static void BM_Open(benchmark::State& state) {
+	string path = storeWith(static_cast<uint32_t>(state.range(0)));
+	if (path.empty()) {
+		state.SkipWithError("Could not build the store");
+		return;
+	}
+
+	for (auto _ : state) {
+		PlayerStore store;
+		benchmark::DoNotOptimize(store.open(path));
+		state.PauseTiming();
+		store.close();
+		state.ResumeTiming();
+	}
+}
+BENCHMARK(BM_Open)->Arg(1 << 20)->Arg(1 << 22)->Unit(benchmark::kMicrosecond);
+
+static void BM_RebuildIndex(benchmark::State& state) {
+	string path = storeWith(static_cast<uint32_t>(state.range(0)));
+	if (path.empty()) {
+		state.SkipWithError("Could not build the store");
+		return;
+	}
+
+	for (auto _ : state) {
+		state.PauseTiming();
+		remove((path + ".index").c_str());
+		state.ResumeTiming();
+
+		PlayerStore store;
+		benchmark::DoNotOptimize(store.open(path));
+		state.PauseTiming();
+		store.close();
+		state.ResumeTiming();
+	}
+}
+BENCHMARK(BM_RebuildIndex)->Arg(1 << 20)->Arg(1 << 22)->Iterations(3)->Unit(benchmark::kMillisecond);
+
+static void BM_Find(benchmark::State& state) {
+	uint32_t players = static_cast<uint32_t>(state.range(0));
+	PlayerStore store;
+	if (!store.open(storeWith(players))) {
+		state.SkipWithError("Could not open the store");
+		return;
+	}
+
+	// Names made up front, so the benchmark doesn't time to_string
+	mt19937 random(1);
+	vector<string> names(4096);
+	for (auto& name : names) name = nameFor(random() % players);
+
+	PlayerSummary summary;
+	size_t next = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(store.find(names[next++ % names.size()], summary));
+	}
+}
+BENCHMARK(BM_Find)->Arg(1 << 20)->Arg(1 << 22);
+
+static void BM_TopPlayers(benchmark::State& state) {
+	PlayerStore store;
+	if (!store.open(storeWith(static_cast<uint32_t>(state.range(0))))) {
+		state.SkipWithError("Could not open the store");
+		return;
+	}
+
+	vector<PlayerSummary> top;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(store.topPlayers(10, top));
+	}
+}
+BENCHMARK(BM_TopPlayers)->Arg(1 << 20)->Arg(1 << 22);
+
+static void BM_AddScore(benchmark::State& state) {
+	uint32_t players = static_cast<uint32_t>(state.range(0));
+	PlayerStore store;
+	if (!store.open(storeWith(players))) {
+		state.SkipWithError("Could not open the store");
+		return;
+	}
+
+	mt19937 random(2);
+	for (auto _ : state) {
+		store.addScore(random() % players, 1);
+	}
+}
+BENCHMARK(BM_AddScore)->Arg(1 << 20)->Arg(1 << 22);
+
+BENCHMARK_MAIN();
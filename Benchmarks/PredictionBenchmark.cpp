@@ -0,0 +1,261 @@
+// How good the server's predicted positions are, and what they cost.
+//
+// A player follows a mouse path the way Client::inputTick moves them (step() every INPUT_TICK_MS, UPDATE_POSITION whenever
+// shouldSendInput says so). Their updates reach the server `latency` ms later, and every `tick` ms the server predicts where
+// they'll be, like Server::predictedPosition (prediction time twice the snapshot interval). The prediction takes `latency` ms
+// more to reach the player, so it's compared with where the player actually is by then, which is what they see on screen.
+//
+// Each benchmark is one predictor on one path at one tick interval and latency:
+//   time             - one predictor call
+//   rms_px           - root mean square distance between the prediction and where the player really is
+//   overshoot_px     - on average, how far the prediction runs past the player in the direction they were last seen moving
+//                      (what makes the green circle fly past a player who stopped or turned)
+//   max_overshoot_px - the worst of those
+//
+// Paths:
+//   Orbit  - the headless client's scripted input: a smooth loop round the play area
+//   Chase  - a new target every 1.5 s, like chasing rainbow balls: straight runs and sudden stops
+//   Zigzag - sharp turns every 250 ms
+//   Recorded - with CORPLIFE_TRAJECTORY=<file> set, a path recorded with `Client1 --record <file>` (one "ms x y" line per input tick)
+//
+// Predictors: Server (predictPosition, what the game uses), LastKnown (no prediction, the baseline to beat) and a couple of
+// alternatives. Add one to PREDICTORS to compare it.
+
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "../Shared/Simulation.h"
+
+namespace {
+
+	using Predictor = Vector2f(*)(const deque<PositionSnapshot>& history, Vector2f position, float predictionTime);
+
+	constexpr float FRAME_MS = static_cast<float>(INPUT_TICK_MS); // One of the client's input ticks
+	constexpr float PATH_MS = 20000.f;
+	const Vector2f SPAWN = { 100.f, 100.f };
+
+	float dot(Vector2f a, Vector2f b) {
+		return a.x * b.x + a.y * b.y;
+	}
+
+	/* ------------------------ Predictors ------------------------ */
+
+	// predictPosition with the server's default prediction-smoothing
+	Vector2f server(const deque<PositionSnapshot>& history, Vector2f position, float predictionTime) {
+		return predictPosition(history, position, predictionTime, PREDICTION_SMOOTHING);
+	}
+
+	// Where the server last heard the player was
+	Vector2f lastKnown(const deque<PositionSnapshot>&, Vector2f position, float) {
+		return position;
+	}
+
+	// Straight on from the last two snapshots at the speed between them. No 2.5x, smoothing or drift limit.
+	Vector2f linear(const deque<PositionSnapshot>& history, Vector2f position, float predictionTime) {
+		if (history.size() < 2) return position;
+		const PositionSnapshot& last = history.back();
+		const PositionSnapshot& before = history[history.size() - 2];
+		float seconds = (last.timestamp - before.timestamp) / 1000.f;
+		if (seconds <= 0.f) return position;
+		return clampToWorld(last.position + (last.position - before.position) / seconds * predictionTime);
+	}
+
+	// Velocity over the whole history, so one update arriving early or late doesn't swing it, and never faster than a player
+	// can move. Only half the prediction time: a player's next move is as likely to be a turn as more of the same.
+	Vector2f averaged(const deque<PositionSnapshot>& history, Vector2f position, float predictionTime) {
+		if (history.size() < 2) return position;
+		float seconds = (history.back().timestamp - history.front().timestamp) / 1000.f;
+		if (seconds <= 0.f) return position;
+
+		Vector2f velocity = (history.back().position - history.front().position) / seconds;
+		float speed = sqrt(dot(velocity, velocity));
+		if (speed > MOVE_SPEED) velocity *= MOVE_SPEED / speed;
+		return clampToWorld(position + velocity * (predictionTime * 0.5f));
+	}
+
+	struct NamedPredictor {
+		const char* name;
+		Predictor predict;
+	};
+
+	const NamedPredictor PREDICTORS[] = {
+		{ "Server", server },
+		{ "LastKnown", lastKnown },
+		{ "Linear", linear },
+		{ "Averaged", averaged },
+	};
+
+	/* ------------------------ Paths ------------------------ */
+
+	// Where the mouse is at each moment
+	struct Path {
+		string name;
+		function<Vector2f(float ms)> target;
+	};
+
+	// Same as Client::headlessTarget when there's no rainbow ball
+	Vector2f orbit(float ms) {
+		float seconds = ms / 1000.f;
+		return { WINDOW_WIDTH / 2 + 400.f * cos(seconds), WINDOW_HEIGHT / 2 + 250.f * sin(seconds * 0.7f) };
+	}
+
+	Path chase() {
+		mt19937 random(7);
+		auto targets = make_shared<vector<Vector2f>>();
+		for (float ms = 0.f; ms <= PATH_MS; ms += 1500.f) {
+			targets->push_back({ static_cast<float>(random() % static_cast<unsigned>(WINDOW_WIDTH)), static_cast<float>(random() % static_cast<unsigned>(WINDOW_HEIGHT)) });
+		}
+		return { "Chase", [targets](float ms) { return (*targets)[static_cast<size_t>(ms / 1500.f)]; } };
+	}
+
+	Vector2f zigzag(float ms) {
+		int leg = static_cast<int>(ms / 250.f);
+		float across = (leg % 2 == 0) ? 200.f : 700.f;
+		return { 100.f + fmod(ms / 20000.f * 1500.f, 1500.f), across };
+	}
+
+	// A path from `Client1 --record`. The mouse stays where it was last seen between ticks.
+	bool recorded(const string& filePath, Path& path) {
+		ifstream file(filePath);
+		auto samples = make_shared<vector<pair<float, Vector2f>>>();
+		float ms, x, y;
+		while (file >> ms >> x >> y) samples->push_back({ ms, { x, y } });
+		if (samples->empty()) return false;
+
+		path.name = "Recorded";
+		path.target = [samples](float ms) {
+			auto after = upper_bound(samples->begin(), samples->end(), ms, [](float t, const pair<float, Vector2f>& sample) { return t < sample.first; });
+			return after == samples->begin() ? after->second : (after - 1)->second;
+		};
+		return true;
+	}
+
+	/* ------------------------ Replay ------------------------ */
+
+	// One prediction the server makes, and the truth to judge it by
+	struct Query {
+		deque<PositionSnapshot> history;
+		Vector2f position; // Last known
+		Vector2f actual;   // Where the player is when the prediction reaches them
+		Vector2f heading;  // Unit vector the player was last seen moving in (zero if they weren't)
+	};
+
+	vector<Query> replay(const Path& path, float tickMs, float latencyMs) {
+		struct Update {
+			float arrivesMs;
+			Vector2f position;
+		};
+
+		// The client
+		vector<Vector2f> actual;
+		vector<Update> updates;
+		Vector2f position = SPAWN, lastSent = SPAWN, lastMovement;
+		float lastSentMs = 0.f;
+		for (float ms = 0.f; ms < PATH_MS; ms += FRAME_MS) {
+			MoveStep move = step(position, path.target(ms), FRAME_MS / 1000.f);
+			position = move.position;
+			actual.push_back(position);
+
+			if (shouldSendInput(position, move.movement, lastSent, lastMovement, ms - lastSentMs)) {
+				updates.push_back({ ms + latencyMs, position });
+				lastSent = position;
+				lastMovement = move.movement;
+				lastSentMs = ms;
+			}
+		}
+
+		// The server, which applies each update as it arrives and predicts every tick
+		vector<Query> queries;
+		deque<PositionSnapshot> history;
+		Vector2f known = SPAWN;
+		size_t next = 0;
+		for (float ms = tickMs; ms + latencyMs < PATH_MS; ms += tickMs) {
+			for (; next < updates.size() && updates[next].arrivesMs <= ms; ++next) {
+				known = updates[next].position;
+				history.push_back({ known, updates[next].arrivesMs });
+				if (history.size() > POSITION_HISTORY_SIZE) history.pop_front();
+			}
+			if (history.size() < 2) continue;
+
+			Vector2f moved = history.back().position - history[history.size() - 2].position;
+			float length = sqrt(dot(moved, moved));
+			Vector2f heading = length > 0.f ? moved / length : Vector2f();
+
+			size_t frame = min(static_cast<size_t>((ms + latencyMs) / FRAME_MS), actual.size() - 1);
+			queries.push_back({ history, known, actual[frame], heading });
+		}
+		return queries;
+	}
+
+	void predictAlong(benchmark::State& state, Predictor predict, const Path& path, float tickMs, float latencyMs) {
+		vector<Query> queries = replay(path, tickMs, latencyMs);
+		float predictionTime = 2.f * tickMs / 1000.f;
+
+		// Accuracy, over every prediction once
+		double squared = 0.0, overshoot = 0.0, maxOvershoot = 0.0;
+		for (const Query& query : queries) {
+			Vector2f error = predict(query.history, query.position, predictionTime) - query.actual;
+			squared += dot(error, error);
+			double ahead = dot(error, query.heading);
+			if (ahead > 0.0) {
+				overshoot += ahead;
+				maxOvershoot = max(maxOvershoot, ahead);
+			}
+		}
+
+		// Cost, one call per iteration
+		size_t index = 0;
+		for (auto _ : state) {
+			const Query& query = queries[index];
+			benchmark::DoNotOptimize(predict(query.history, query.position, predictionTime));
+			if (++index == queries.size()) index = 0;
+		}
+
+		double count = static_cast<double>(queries.size());
+		state.counters["rms_px"] = sqrt(squared / count);
+		state.counters["overshoot_px"] = overshoot / count;
+		state.counters["max_overshoot_px"] = maxOvershoot;
+	}
+}
+
+int main(int argc, char** argv) {
+	vector<Path> paths = { { "Orbit", orbit }, chase(), { "Zigzag", zigzag } };
+	const char* recording = getenv("CORPLIFE_TRAJECTORY");
+	if (recording) {
+		Path path;
+		if (recorded(recording, path)) paths.push_back(path);
+		else fprintf(stderr, "Could not read a path from %s\n", recording);
+	}
+
+	// Snapshot intervals: 60 Hz, the normal 30 ms, and the slowest a client's rate backs off to. Latencies are one way.
+	const int ticks[] = { 16, SNAPSHOT_INTERVAL_MS, MAX_SNAPSHOT_INTERVAL_MS };
+	const int latencies[] = { 0, 25, 50, 100 };
+
+	for (const NamedPredictor& predictor : PREDICTORS) {
+		for (const Path& path : paths) {
+			for (int tick : ticks) {
+				for (int latency : latencies) {
+					string name = string("Predict/") + predictor.name + "/" + path.name + "/tick:" + to_string(tick) + "/latency:" + to_string(latency);
+					Predictor predict = predictor.predict;
+					benchmark::RegisterBenchmark(name.c_str(), [=](benchmark::State& state) {
+						predictAlong(state, predict, path, static_cast<float>(tick), static_cast<float>(latency));
+					})->MinTime(0.05);
+				}
+			}
+		}
+	}
+
+	benchmark::Initialize(&argc, argv);
+	if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return 0;
+}
@@ -0,0 +1,78 @@
+// Cost of drawing one game frame offscreen, at 2, 64 and 1,024 players.
+//
+// Each iteration draws what Client::gameLoop draws (the score texts if res/comic.ttf is there, one circle per player and the
+// rainbow ball) into a 1700x900 sf::RenderTexture and calls display(). Needs an OpenGL context: on a machine without a
+// display run it under `xvfb-run -a` with LIBGL_ALWAYS_SOFTWARE=1 (Mesa's software renderer). Without one it is skipped.
+
+#include <benchmark/benchmark.h>
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include "../Shared/GameConfig.h"
+
+using namespace std;
+using namespace sf;
+
+namespace {
+
+	struct Scene {
+		Scene() : playerShape(PLAYER_RADIUS), rainbowShape(RAINBOW_RADIUS) {
+			playerShape.setFillColor(Color::Red);
+			playerShape.setOutlineThickness(2.f);
+			playerShape.setOutlineColor(Color(250, 150, 100));
+			rainbowShape.setFillColor(Color(200, 100, 255));
+
+			if (font.loadFromFile("res/comic.ttf")) {
+				for (int i = 0; i < 2; i++) {
+					scoreTexts[i].setFont(font);
+					scoreTexts[i].setCharacterSize(24);
+					scoreTexts[i].setString("Player's Score: 0");
+					scoreTexts[i].setPosition(10, 10 + (i * 30));
+				}
+				hasFont = true;
+			}
+		}
+
+		CircleShape playerShape;
+		CircleShape rainbowShape;
+		Font font;
+		Text scoreTexts[2];
+		bool hasFont = false;
+	};
+}
+
+static void BM_Render_Frame(benchmark::State& state) {
+	size_t count = static_cast<size_t>(state.range(0));
+
+	RenderTexture target;
+	if (!target.create(static_cast<unsigned>(WINDOW_WIDTH), static_cast<unsigned>(WINDOW_HEIGHT))) {
+		state.SkipWithError("Could not create a RenderTexture (no OpenGL context)");
+		return;
+	}
+
+	Scene scene;
+	vector<Vector2f> positions(count);
+	for (size_t i = 0; i < count; ++i) positions[i] = { static_cast<float>((i * 37) % 1670), static_cast<float>((i * 53) % 870) };
+
+	size_t drawCalls = 0;
+	for (auto _ : state) {
+		target.clear();
+		if (scene.hasFont) {
+			for (int i = 0; i < 2; i++) target.draw(scene.scoreTexts[i]);
+			drawCalls += 2;
+		}
+		for (const Vector2f& position : positions) {
+			scene.playerShape.setPosition(position);
+			target.draw(scene.playerShape);
+		}
+		scene.rainbowShape.setPosition(850.f, 450.f);
+		target.draw(scene.rainbowShape);
+		target.display();
+		drawCalls += count + 1;
+	}
+
+	state.counters["draw_calls_per_frame"] = static_cast<double>(drawCalls) / static_cast<double>(state.iterations());
+	state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_Render_Frame)->Arg(2)->Arg(64)->Arg(1024)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
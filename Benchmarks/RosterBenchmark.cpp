@@ -0,0 +1,98 @@
+// What one pickup costs, in bytes on the wire and client CPU, at 2, 100 and 1,000 players.
+//
+//   FullList - how it used to be: UPDATE_SCORES with every player's ID, name and score, which the client parsed into a map and
+//              sorted to draw the scoreboard
+//   Roster   - a ROSTER message with one Score event, applied to the Leaderboard (Client1/Leaderboard.h), then the top 5 read
+//              off it
+//
+//   message_bytes - size of the message the server sends every client for the pickup
+
+#include <benchmark/benchmark.h>
+#include <SFML/Network.hpp>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../Shared/Protocol.h"
+#include "../Client1/Leaderboard.h"
+
+using namespace std;
+using namespace sf;
+
+namespace {
+
+	constexpr size_t TOP = 5;
+
+	string nameFor(int id) {
+		return "Player" + to_string(id);
+	}
+}
+
+static void BM_Pickup_FullList(benchmark::State& state) {
+	int players = static_cast<int>(state.range(0));
+	Packet packet;
+	packet << "UPDATE_SCORES";
+	for (int id = 0; id < players; ++id) packet << id << nameFor(id) << id % 13;
+
+	struct Score { string name; int score; };
+	unordered_map<int, Score> scores;
+	vector<pair<int, int>> sorted;
+	string command, name;
+
+	for (auto _ : state) {
+		// Packets are read once, so every iteration reads a copy like the client got a fresh one
+		Packet received = packet;
+		received >> command;
+		int id, score;
+		while (received >> id >> name >> score) {
+			Score& entry = scores[id];
+			entry.name = name;
+			entry.score = score;
+		}
+
+		sorted.clear();
+		for (auto& entry : scores) sorted.emplace_back(entry.second.score, entry.first);
+		size_t shown = min(TOP, sorted.size());
+		partial_sort(sorted.begin(), sorted.begin() + shown, sorted.end(), [](const pair<int, int>& a, const pair<int, int>& b) { return a.first > b.first; });
+		benchmark::DoNotOptimize(sorted.data());
+	}
+
+	state.counters["message_bytes"] = static_cast<double>(packet.getDataSize());
+}
+BENCHMARK(BM_Pickup_FullList)->Arg(2)->Arg(100)->Arg(1000);
+
+static void BM_Pickup_Roster(benchmark::State& state) {
+	int players = static_cast<int>(state.range(0));
+	Leaderboard leaderboard;
+	for (int id = 0; id < players; ++id) leaderboard.set(id, nameFor(id), id % 13);
+
+	// Pickups by players all over the table, so it isn't always the leader moving
+	vector<Packet> packets(64);
+	for (size_t i = 0; i < packets.size(); ++i) {
+		packets[i] << "ROSTER" << static_cast<Uint32>(i + 1) << static_cast<Uint16>(1)
+			<< static_cast<Uint8>(RosterEvent::Score) << static_cast<int>((i * 7919) % players) << static_cast<Int32>(1);
+	}
+
+	string command;
+	int total = 0;
+	size_t next = 0;
+	for (auto _ : state) {
+		Packet received = packets[next++ % packets.size()];
+		Uint32 version;
+		Uint16 count;
+		Uint8 type;
+		int id;
+		Int32 change;
+		received >> command >> version >> count >> type >> id >> change;
+		leaderboard.addScore(id, change);
+
+		size_t shown = min(TOP, leaderboard.size());
+		for (size_t rank = 0; rank < shown; ++rank) total += leaderboard.at(rank).score;
+		benchmark::DoNotOptimize(total);
+	}
+
+	state.counters["message_bytes"] = static_cast<double>(packets[0].getDataSize());
+}
+BENCHMARK(BM_Pickup_Roster)->Arg(2)->Arg(100)->Arg(1000);
+
+BENCHMARK_MAIN();
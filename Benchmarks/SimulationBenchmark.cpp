@@ -0,0 +1,133 @@
+// The shared game rules (Shared/Simulation) and one whole server tick, at 2, 64 and 1,024 players.
+//
+//   Step              - one frame of client movement
+//   PredictPosition   - predictPosition for one player with a full position history
+//   RainbowCollision  - isTouchingRainbowBall for every player against one ball
+//   ServerTick        - what Server::run does for one tick with no socket waits: decode one UPDATE_POSITION per player
+//                       (velocity, collision, history), then predict everyone, encode PLAYER_POSITIONS once into the
+//                       MessagePool and queue it for every player. The queues are emptied as if the sends all went through.
+
+#include <benchmark/benchmark.h>
+#include <SFML/Network.hpp>
+#include <string>
+#include <vector>
+#include "../Shared/Simulation.h"
+#include "../GameServer/MessagePool.h"
+
+namespace {
+
+	constexpr float SMOOTHING = PREDICTION_SMOOTHING;
+
+	// The parts of ClientData the tick touches
+	struct SimPlayer {
+		int ID = 0;
+		int score = 0;
+		Vector2f position;
+		Vector2f velocity;
+		Vector2f predictedPosition;
+		deque<PositionSnapshot> positionHistory;
+		OutboundQueue outbound;
+	};
+
+	deque<PositionSnapshot> fullHistory(float x, float y) {
+		deque<PositionSnapshot> history;
+		for (int i = 0; i < 4; ++i) history.push_back({ { x + i * 3.f, y + i * 2.f }, 30.f * i });
+		return history;
+	}
+}
+
+static void BM_Step(benchmark::State& state) {
+	Vector2f position = { 100.f, 100.f };
+	Vector2f target = { 900.f, 500.f };
+	for (auto _ : state) {
+		MoveStep move = step(position, target, 1.f / 60.f);
+		position = move.position == position ? Vector2f(100.f, 100.f) : move.position; // Start over once it reaches the mouse
+		benchmark::DoNotOptimize(position);
+	}
+}
+BENCHMARK(BM_Step);
+
+static void BM_PredictPosition(benchmark::State& state) {
+	deque<PositionSnapshot> history = fullHistory(400.f, 300.f);
+	Vector2f position = history.back().position;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(predictPosition(history, position, 0.06f, SMOOTHING));
+	}
+}
+BENCHMARK(BM_PredictPosition);
+
+static void BM_RainbowCollision(benchmark::State& state) {
+	size_t count = static_cast<size_t>(state.range(0));
+	vector<Vector2f> players(count);
+	for (size_t i = 0; i < count; ++i) players[i] = { static_cast<float>((i * 37) % 1700), static_cast<float>((i * 53) % 900) };
+	Vector2f ball = { 850.f, 450.f };
+
+	for (auto _ : state) {
+		int touching = 0;
+		for (const Vector2f& player : players) touching += isTouchingRainbowBall(player, ball);
+		benchmark::DoNotOptimize(touching);
+	}
+	state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_RainbowCollision)->Arg(2)->Arg(64)->Arg(1024);
+
+static void BM_ServerTick(benchmark::State& state) {
+	size_t count = static_cast<size_t>(state.range(0));
+	vector<SimPlayer> players(count);
+	vector<Packet> updates(count);
+	for (size_t i = 0; i < count; ++i) {
+		players[i].ID = static_cast<int>(i);
+		players[i].position = { static_cast<float>((i * 37) % 1700), static_cast<float>((i * 53) % 900) };
+		updates[i] << "UPDATE_POSITION" << players[i].position.x + 2.f << players[i].position.y + 1.f << 2.f << 1.f << static_cast<Int64>(1700000000000LL);
+	}
+
+	MessagePool pool;
+	Vector2f ball = { 850.f, 450.f };
+	Packet packet;
+	string command;
+	float now = 0.f;
+
+	for (auto _ : state) {
+		now += 30.f;
+
+		// processClientData for every player
+		for (size_t i = 0; i < count; ++i) {
+			SimPlayer& player = players[i];
+			packet.clear();
+			packet.append(updates[i].getData(), updates[i].getDataSize());
+
+			float x, y, moveX, moveY;
+			Int64 echoedTimestamp = 0;
+			packet >> command >> x >> y >> moveX >> moveY;
+			if (!packet.endOfPacket()) packet >> echoedTimestamp;
+
+			Vector2f newVelocity = Vector2f(moveX, moveY) / 0.03f;
+			player.velocity = SMOOTHING * player.velocity + (1.0f - SMOOTHING) * newVelocity;
+
+			if (isTouchingRainbowBall(player.position, ball)) player.score++;
+
+			player.positionHistory.push_back({ { x, y }, now });
+			if (player.positionHistory.size() > POSITION_HISTORY_SIZE) player.positionHistory.pop_front();
+			player.position = clampToWorld({ x, y });
+		}
+
+		// sendPlayerPositions
+		Packet positions;
+		positions << "PLAYER_POSITIONS";
+		for (SimPlayer& player : players) {
+			player.predictedPosition = predictPosition(player.positionHistory, player.position, 0.06f, SMOOTHING);
+			positions << static_cast<Int64>(1700000000000LL) << player.ID << player.predictedPosition.x << player.predictedPosition.y;
+		}
+
+		MessageRef message = pool.encode(positions.getData(), positions.getDataSize());
+		for (SimPlayer& player : players) player.outbound.push(message);
+
+		// flushAllOutbound, with every send going through in full
+		for (SimPlayer& player : players) player.outbound.consume(message.size());
+	}
+
+	state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_ServerTick)->Arg(2)->Arg(64)->Arg(1024);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,234 @@
+// Bandwidth of PLAYER_POSITIONS and UPDATE_POSITION at 2, 64 and 1,024 players, over 2 seconds of simulated game time.
+//
+//   Fixed    - how it used to be: every client gets every player's position every 30 ms, and every client sends
+//              UPDATE_POSITION every frame (60 fps) whether it moved or not
+//   Adaptive - each client's rate comes from its SnapshotRate, past SNAPSHOT_PLAYER_BUDGET players each snapshot only carries the
+//              ones SnapshotPriority picks for that client, and input only goes out on change or as a heartbeat (shouldSendInput)
+//
+// No sockets: every client has a simulated link that drains its outbound queue at a fixed rate. Every 8th client is on a slow
+// (10 KB/s) link, the rest get 200 KB/s, everyone has 20 ms of base RTT plus however long their queue takes to drain.
+// Players alternate between a second of chasing a moving target and a second of standing still, starting at different times.
+//
+//   server_egress_Bps  - PLAYER_POSITIONS bytes queued per second, all clients together
+//   client_input_Bps   - UPDATE_POSITION bytes per second, all clients together
+//   dropped_snapshots  - snapshots that didn't fit in a full outbound queue (OutboundQueue::CAPACITY messages)
+//   slow_link_delay_ms - average time a snapshot spent in a slow client's queue (ones still queued at the end count up to then)
+//   near_age_ms        - how old the position a client has for its 8 nearest players is, on average (sampled every 100 ms,
+//                        counting from when the server sent it, so a snapshot stuck in a queue doesn't count as seen yet)
+//   all_age_ms         - the same for every other player
+
+#include <benchmark/benchmark.h>
+#include <SFML/Network.hpp>
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <vector>
+#include "../Shared/Simulation.h"
+#include "../GameServer/MessagePool.h"
+#include "../GameServer/Snapshots.h"
+
+namespace {
+
+	constexpr int SIMULATED_MS = 2000;
+	constexpr int FRAME_MS = 16; // Roughly 60 fps on the clients
+	constexpr float BASE_RTT_MS = 20.f;
+	constexpr float FAST_LINK_BYTES_PER_MS = 200.f;
+	constexpr float SLOW_LINK_BYTES_PER_MS = 10.f;
+	constexpr size_t NEAREST = 8;
+
+	// The real encoded sizes, measured from sf::Packet once
+	struct WireSizes {
+		size_t positionsHeader, positionEntry, input;
+
+		WireSizes() {
+			Packet header;
+			header << "PLAYER_POSITIONS";
+			Packet entry = header;
+			entry << Int64(0) << 0 << 0.f << 0.f;
+			Packet update;
+			update << "UPDATE_POSITION" << 0.f << 0.f << 0.f << 0.f << Int64(0) << Uint16(0);
+
+			positionsHeader = header.getDataSize() + sizeof(Uint32); // Plus SFML's length prefix
+			positionEntry = entry.getDataSize() - header.getDataSize();
+			input = update.getDataSize() + sizeof(Uint32);
+		}
+
+		size_t positions(size_t entries) const { return positionsHeader + entries * positionEntry; }
+	};
+
+	struct SimClient {
+		int ID = 0;
+		float linkBytesPerMs = FAST_LINK_BYTES_PER_MS;
+		Vector2f position;
+		Vector2f lastSentPosition, lastSentMovement;
+		float lastInputMs = -1e9f;
+
+		struct Queued {
+			size_t bytes; // Left to send
+			float queuedAt;
+			vector<int> IDs; // Players in it, empty for everyone
+		};
+		deque<Queued> queue;
+		size_t queuedBytes = 0;
+		unsigned dropped = 0;
+
+		SnapshotRate rate;
+		SnapshotPriority priority;
+		vector<float> seenAt; // When this client last got each player's position (indexed by ID)
+	};
+
+	// Where player `i` is heading at `ms`. Half the time the target circles the middle of the map, half the time it's where they already are.
+	Vector2f targetFor(const SimClient& client, int ms) {
+		int phase = (ms + client.ID * 397) % 2000;
+		if (phase >= 1000) return client.position;
+
+		float angle = ms * 0.002f + client.ID;
+		return { WINDOW_WIDTH / 2 + cos(angle) * (200.f + client.ID % 7 * 80.f), WINDOW_HEIGHT / 2 + sin(angle) * (150.f + client.ID % 5 * 50.f) };
+	}
+
+	void simulate(benchmark::State& state, bool adaptive) {
+		size_t playerCount = static_cast<size_t>(state.range(0));
+		WireSizes wire;
+
+		double egressBytes = 0, inputBytes = 0, dropped = 0;
+		double slowDelay = 0, slowDelivered = 0, nearAge = 0, nearSamples = 0, allAge = 0, allSamples = 0;
+
+		vector<SnapshotCandidate> candidates;
+		vector<size_t> chosen;
+		vector<pair<float, int>> byDistance;
+
+		for (auto _ : state) {
+			vector<SimClient> clients(playerCount);
+			for (size_t i = 0; i < playerCount; ++i) {
+				clients[i].ID = static_cast<int>(i);
+				clients[i].position = { 100.f + (i * 137) % 1500, 100.f + (i * 89) % 700 };
+				clients[i].linkBytesPerMs = i % 8 == 7 ? SLOW_LINK_BYTES_PER_MS : FAST_LINK_BYTES_PER_MS;
+				clients[i].seenAt.assign(playerCount, 0.f);
+			}
+
+			for (int ms = 0; ms < SIMULATED_MS; ++ms) {
+				float now = static_cast<float>(ms);
+
+				// Clients: move and send input once a frame
+				if (ms % FRAME_MS == 0) {
+					for (SimClient& client : clients) {
+						MoveStep move = step(client.position, targetFor(client, ms), FRAME_MS / 1000.f);
+						client.position = move.position;
+
+						bool send = !adaptive || shouldSendInput(move.position, move.movement, client.lastSentPosition, client.lastSentMovement, now - client.lastInputMs);
+						if (send) {
+							inputBytes += wire.input;
+							client.lastSentPosition = move.position;
+							client.lastSentMovement = move.movement;
+							client.lastInputMs = now;
+						}
+					}
+				}
+
+				// Server: snapshots
+				for (SimClient& client : clients) {
+					SimClient::Queued snapshot = { wire.positions(playerCount), now, {} };
+					if (adaptive) {
+						if (!client.rate.isDue(now)) continue;
+						if (playerCount > SNAPSHOT_PLAYER_BUDGET) {
+							if (candidates.size() != playerCount) {
+								candidates.clear();
+								for (const SimClient& other : clients) candidates.push_back({ other.ID, other.position });
+							}
+							client.priority.select({ client.ID, client.position }, candidates, nullptr, SNAPSHOT_PLAYER_BUDGET - 1, chosen);
+							snapshot.bytes = wire.positions(chosen.size() + 1);
+							for (size_t index : chosen) snapshot.IDs.push_back(candidates[index].ID);
+						}
+					}
+					else if (ms % SNAPSHOT_INTERVAL_MS != 0) continue;
+
+					if (client.queue.size() >= OutboundQueue::CAPACITY) {
+						client.dropped++;
+						dropped++;
+					}
+					else {
+						client.queuedBytes += snapshot.bytes;
+						egressBytes += snapshot.bytes;
+						client.queue.push_back(move(snapshot));
+					}
+
+					if (adaptive) {
+						float rtt = BASE_RTT_MS + client.queuedBytes / client.linkBytesPerMs;
+						client.rate.markSent(now);
+						client.rate.update(rtt, client.queue.size(), client.dropped);
+						client.dropped = 0;
+					}
+				}
+				candidates.clear(); // Positions move on by the next millisecond
+
+				// The links drain
+				for (SimClient& client : clients) {
+					float budget = client.linkBytesPerMs;
+					while (budget > 0 && !client.queue.empty()) {
+						auto& front = client.queue.front();
+						size_t sent = min(front.bytes, static_cast<size_t>(ceil(budget)));
+						front.bytes -= sent;
+						client.queuedBytes -= sent;
+						budget -= sent;
+						if (front.bytes == 0) {
+							if (client.linkBytesPerMs == SLOW_LINK_BYTES_PER_MS) {
+								slowDelay += now - front.queuedAt;
+								slowDelivered++;
+							}
+							if (front.IDs.empty()) fill(client.seenAt.begin(), client.seenAt.end(), front.queuedAt);
+							else for (int ID : front.IDs) client.seenAt[ID] = front.queuedAt;
+							client.queue.pop_front();
+						}
+					}
+				}
+
+				// How fresh each client's view of its nearest players is
+				if (ms % 100 == 0) {
+					for (const SimClient& client : clients) {
+						byDistance.clear();
+						for (const SimClient& other : clients) {
+							if (other.ID != client.ID) byDistance.push_back({ hypot(other.position.x - client.position.x, other.position.y - client.position.y), other.ID });
+						}
+						size_t nearest = min(NEAREST, byDistance.size());
+						partial_sort(byDistance.begin(), byDistance.begin() + nearest, byDistance.end());
+						for (size_t i = 0; i < nearest; ++i) {
+							nearAge += now - client.seenAt[byDistance[i].second];
+							nearSamples++;
+						}
+						for (const auto& other : byDistance) allAge += now - client.seenAt[other.second];
+						allSamples += byDistance.size();
+					}
+				}
+			}
+
+			// Whatever is still stuck in a slow client's queue has waited at least this long
+			for (const SimClient& client : clients) {
+				if (client.linkBytesPerMs != SLOW_LINK_BYTES_PER_MS) continue;
+				for (const auto& queued : client.queue) {
+					slowDelay += SIMULATED_MS - queued.queuedAt;
+					slowDelivered++;
+				}
+			}
+		}
+
+		double seconds = state.iterations() * SIMULATED_MS / 1000.0;
+		state.counters["server_egress_Bps"] = egressBytes / seconds;
+		state.counters["client_input_Bps"] = inputBytes / seconds;
+		state.counters["dropped_snapshots"] = dropped / state.iterations();
+		state.counters["slow_link_delay_ms"] = slowDelivered > 0 ? slowDelay / slowDelivered : 0;
+		state.counters["near_age_ms"] = nearSamples > 0 ? nearAge / nearSamples : 0;
+		state.counters["all_age_ms"] = allSamples > 0 ? allAge / allSamples : 0;
+	}
+}
+
+static void BM_Snapshots_Fixed(benchmark::State& state) {
+	simulate(state, false);
+}
+BENCHMARK(BM_Snapshots_Fixed)->Arg(2)->Arg(64)->Arg(1024)->Iterations(1)->Unit(benchmark::kMillisecond);
+
+static void BM_Snapshots_Adaptive(benchmark::State& state) {
+	simulate(state, true);
+}
+BENCHMARK(BM_Snapshots_Adaptive)->Arg(2)->Arg(64)->Arg(1024)->Iterations(1)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
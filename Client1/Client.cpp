@@ -1,36 +1,107 @@
 #include "Client.h"
 
 // Constructor
-Client::Client() :
+Client::Client(const HeadlessOptions& headless) :
 	window(nullptr),
+	headless(headless),
+	packetStream(socket),
+	lobby(socket, packetStream),
+	resume(socket, packetStream),
 	playerID(-1),
+	sessionToken(0),
 	currentState(GameState::MainMenu),
 	hasRainbowBall(false),
-	actualPlayerShape(CIRCLE_RADIUS),
-	predictedPlayerShape(CIRCLE_RADIUS),
-	otherPlayerShape(CIRCLE_RADIUS)
-{}
+	actualPlayerShape(PLAYER_RADIUS),
+	predictedPlayerShape(PLAYER_RADIUS),
+	otherPlayerShape(PLAYER_RADIUS),
+	actualRenderShape(PLAYER_RADIUS),
+	predictedRenderShape(PLAYER_RADIUS),
+	rainbowShape(RAINBOW_RADIUS)
+{
+	// Styles for the shapes drawn every frame are set once here, the render functions only move them
+
+	// Local player (grey shape)
+	actualRenderShape.setFillColor(Color(128, 128, 128, 150));
+	actualRenderShape.setOutlineThickness(CIRCLE_BORDER);
+	actualRenderShape.setOutlineColor(Color(200, 200, 200, 150));
+
+	// Own predicted position from the server (green shape)
+	predictedRenderShape.setFillColor(Color::Green);
+	predictedRenderShape.setOutlineThickness(CIRCLE_BORDER);
+	predictedRenderShape.setOutlineColor(Color(250, 150, 100));
+
+	// Opponent (red shape)
+	otherPlayerShape.setFillColor(Color::Red);
+	otherPlayerShape.setOutlineThickness(CIRCLE_BORDER);
+	otherPlayerShape.setOutlineColor(Color(250, 150, 100));
+}
 
 // Destructor
 Client::~Client() {
 	if (window) {
 		delete window;
 	}
+	delete offscreen;
 }
 
 // Run the client
 void Client::run() {
+	if (headless.enabled) {
+		if (joinHeadless()) startGame();
+		return;
+	}
 	createMainMenu();
 }
 
-// Connect to the server
-bool Client::connectToServer() {
-	// Try to connect to the server
-	if (socket.connect(SERVER, PORT) != Socket::Done) {
-		cerr << "Error: Could not connect to server.\n";
-		return false;
+// Headless: join with the name and server from the command line instead of the main menu, then wait for the match to start.
+// Goes through the same LobbyConnection as the menu, polling it every 10 ms.
+bool Client::joinHeadless() {
+	playerName = headless.playerName;
+	SERVER = headless.server;
+
+	// With --netem we connect to the emulator, which passes everything on to the server after holding it back
+	if (!headless.netProfile.empty()) {
+		NetProfile profile;
+		string error;
+		if (!NetProfile::load(headless.netProfile, profile, error)) {
+			cerr << error << "\n";
+			return false;
+		}
+		netEmulator.reset(new NetEmulator());
+		if (!netEmulator->start(profile, IpAddress(SERVER), PORT)) return false;
+		cout << "Playing through the network emulator (" << profile.name << ").\n";
+		SERVER = "127.0.0.1";
+		serverPort = netEmulator->getLocalPort();
 	}
-	return true;
+	sinceJoin.restart();
+	lobby.start(SERVER, serverPort, playerName);
+
+	bool announced = false;
+	while (true) {
+		switch (lobby.update()) {
+		case LobbyConnection::State::Waiting:
+			if (!announced) cout << "Joined " << SERVER << " as " << playerName << ". Waiting for the match to start...\n";
+			announced = true;
+			break;
+		case LobbyConnection::State::Starting:
+			return true;
+		case LobbyConnection::State::Full:
+			cerr << "The lobby is full. Try again later." << endl;
+			return false;
+		case LobbyConnection::State::Failed:
+			cerr << lobby.getError() << endl;
+			return false;
+		default:
+			break;
+		}
+		sleep(milliseconds(10));
+	}
+}
+
+// Headless input: chase the rainbow ball when there is one, otherwise wander around the middle of the play area
+Vector2f Client::headlessTarget(float seconds) const {
+	if (!rainbowPositions.empty()) return rainbowPositions.front();
+	return { WINDOW_WIDTH / 2 + 400.f * cos(seconds), WINDOW_HEIGHT / 2 + 250.f * sin(seconds * 0.7f) };
 }
 
 /* Game UI */
@@ -42,14 +113,21 @@ void Client::createMainMenu() {
 	bool isEditingIPv4 = false;
 
 	// Loading the font
-	Font font;
+	Font& font = menuFont;
 	if (!font.loadFromFile("res/comic.ttf")) {
 		cerr << "Failed to load font!" << endl;
 		return;
 	}
 
-	// Main Menu Loop
+	// Main Menu Loop. Every state draws a frame each time round, nothing in here waits on the network.
 	while (true) {
+		// Closed from the waiting screens
+		if (window && !window->isOpen()) {
+			delete window;
+			window = nullptr;
+			return;
+		}
+
 		if (currentState == GameState::MainMenu) {
 			// Check if the window is already created or create a new one
 			if (!window) {
@@ -82,6 +160,7 @@ void Client::createMainMenu() {
 			Text IPv4Input = createText(SERVER.empty() ? "Click to enter IPv4" : SERVER, font, 24, isEditingIPv4 ? Color::White : Color::Cyan, centerX, centerY + 150);
 
 			Text errorText = createText("Name and IPv4 cannot be empty! >:(", font, 20, Color::Red, centerX - 200, centerY + 200);
+			Text connectionErrorText = createText(lobby.getError(), font, 20, Color::Red, centerX - 200, centerY + 200);
 
 			// Update button colors for hover effects
 			Vector2i mousePos = Mouse::getPosition(*window);
@@ -108,37 +187,10 @@ void Client::createMainMenu() {
 						else {
 							showError = false;
 
-							if (socket.getRemoteAddress() == IpAddress::None && !connectToServer()) {
-								cerr << "Failed to connect to server!" << endl;
-								continue;
-							}
-							else {
-								// Send player name to server
-								Packet packet;
-								packet << "PLAYER_NAME" << playerName;
-
-								if (socket.send(packet) != Socket::Done) {
-									cerr << "Failed to send player name to server!" << endl;
-									continue;
-								}
-							}
-						}
-
-						// Once connected, receive a message from the server
-						Packet packet;
-						if (socket.receive(packet) == Socket::Done) {
-							string message;
-							packet >> message;
-
-							if (message == "Waiting for another player to connect...") {
-								currentState = GameState::WaitingForPlayer;
-							}
-							else if (message == "The lobby is full. Try again later.") {
-								currentState = GameState::LobbyFull;
-							}
-							else {
-								currentState = GameState::Playing;
-							}
+							// Connects and sends the name in the background, handleWaitingState moves us on from here
+							sinceJoin.restart();
+							lobby.start(SERVER, serverPort, playerName);
+							currentState = GameState::Connecting;
 							break;
 						}
 					}
@@ -175,7 +227,7 @@ void Client::createMainMenu() {
 						else if (event.text.unicode == '\r') { // Handle Enter key
 							isEditingName = false; // Finish editing
 						}
-						else if (event.text.unicode < 128) { // Append valid ASCII characters
+						else if (event.text.unicode < 128 && playerName.size() < MAX_NAME_LENGTH) { // Append valid ASCII characters
 							playerName += static_cast<char>(event.text.unicode);
 						}
 					}
@@ -189,7 +241,7 @@ void Client::createMainMenu() {
 						else if (event.text.unicode == '\r') { // Handle Enter key
 							isEditingIPv4 = false; // Finish editing
 						}
-						else if (event.text.unicode < 128) { // Append valid ASCII characters
+						else if (event.text.unicode < 128 && SERVER.size() < MAX_SERVER_ADDRESS_LENGTH) { // Append valid ASCII characters
 							SERVER += static_cast<char>(event.text.unicode);
 						}
 					}
@@ -211,16 +263,13 @@ void Client::createMainMenu() {
 			if (showError) {
 				window->draw(errorText);
 			}
+			else if (lobby.getState() == LobbyConnection::State::Failed) {
+				window->draw(connectionErrorText);
+			}
 			window->display();
 		}
 		else if (currentState == GameState::LobbyFull) {
 
-			Font font;
-			if (!font.loadFromFile("res/comic.ttf")) {
-				cerr << "Failed to load font!" << endl;
-				return;
-			}
-
 			Text fullMessage("The lobby is full. Try again later.", font, 30);
 			fullMessage.setFillColor(Color::White);
 			fullMessage.setPosition(window->getSize().x / 2 - fullMessage.getGlobalBounds().width / 2, window->getSize().y / 3);
@@ -264,8 +313,12 @@ void Client::createMainMenu() {
 			window->draw(backText);
 			window->display();
 		}
+		else if (currentState == GameState::Connecting) {
+			displayWaitingMessage("Connecting to " + SERVER + "...");
+			handleWaitingState();
+		}
 		else if (currentState == GameState::WaitingForPlayer) {
-			displayWaitingMessage();
+			displayWaitingMessage("Waiting for player 2...");
 			handleWaitingState();
 		}
 		else if (currentState == GameState::Playing) {
@@ -296,52 +349,59 @@ RectangleShape Client::createButton(float width, float height, const Color& colo
 }
 
 
-void Client::displayWaitingMessage() {
-	// Create font
-	Font font;
-	if (!font.loadFromFile("res/comic.ttf")) { // Specify the correct font path
-		cerr << "Error loading font!" << endl;
-		return;
-	}
-
+void Client::displayWaitingMessage(const string& message) {
 	// Create text to display
 	Text waitingText;
-	waitingText.setFont(font);
-	waitingText.setString("Waiting for player 2...");
+	waitingText.setFont(menuFont);
+	waitingText.setString(message);
 	waitingText.setFillColor(Color::White); // Text color
 	waitingText.setPosition(window->getSize().x / 2 - waitingText.getGlobalBounds().width / 2,
 		window->getSize().y / 2 - waitingText.getGlobalBounds().height / 2); // Center the text
 
+	Text cancelText("Press Esc to cancel", menuFont, 18);
+	cancelText.setFillColor(Color(180, 180, 180));
+	cancelText.setPosition(window->getSize().x / 2 - cancelText.getGlobalBounds().width / 2, window->getSize().y * 2 / 3);
+
 	// Draw text on window
 	window->clear();
 	window->draw(waitingText);
+	window->draw(cancelText);
 	window->display();
 }
 
+// Connecting and waiting for player 2: handle the window's events and move the lobby connection along by one step. Never blocks.
 void Client::handleWaitingState() {
 	Event event{};
 	while (window->pollEvent(event)) {
 		if (event.type == Event::Closed) {
 			window->close(); // Close the window when the user requests it
-			socket.disconnect(); // Disconnect from the server
+			lobby.cancel(); // Disconnect from the server
 			return;
 		}
-	}
-
-	// Make socket non-blocking to prevent it from blocking the window
-	socket.setBlocking(false);
-
-	// Try receiving a packet in a non-blocking manner
-	Packet packet;
-	if (socket.receive(packet) == Socket::Done) {
-		string message;
-		packet >> message;
-		if (message == "Both players connected. Starting the game!") {
-			currentState = GameState::Playing;
+		if (event.type == Event::KeyPressed && event.key.code == Keyboard::Escape) {
+			lobby.cancel();
+			currentState = GameState::MainMenu;
+			return;
 		}
 	}
 
-	socket.setBlocking(true);  // Reset the socket to blocking mode when done
+	switch (lobby.update()) {
+	case LobbyConnection::State::Waiting:
+		currentState = GameState::WaitingForPlayer;
+		break;
+	case LobbyConnection::State::Starting:
+		currentState = GameState::Playing;
+		break;
+	case LobbyConnection::State::Full:
+		currentState = GameState::LobbyFull;
+		break;
+	case LobbyConnection::State::Failed:
+		cerr << lobby.getError() << endl;
+		currentState = GameState::MainMenu; // The menu shows the error
+		break;
+	default:
+		break;
+	}
 }
 
 void Client::startGame() {
@@ -349,12 +409,37 @@ void Client::startGame() {
 	// Get the spawn position
 	receiveInitialPosition();
 
+	// Loaded once here rather than every frame. A headless run without rendering doesn't need it, and one rendering offscreen carries on without text.
+	bool drawing = !headless.enabled || headless.renderMode != RenderMode::None;
+	if (drawing && !gameFont.loadFromFile("res/comic.ttf")) {
+		cerr << "Failed to load font!" << endl;
+		if (!headless.enabled) return;
+	}
+	for (size_t i = 0; i < SCOREBOARD_LINES; i++) {
+		scoreTexts[i].setFont(gameFont);
+		scoreTexts[i].setCharacterSize(24);
+		scoreTexts[i].setFillColor(Color::White);
+		scoreTexts[i].setPosition(10, 10 + (i * 30));
+	}
+
 	// Setup window
-	window = new RenderWindow(VideoMode(WINDOW_WIDTH, WINDOW_HEIGHT), "Eat The Dots", Style::Default);
-	window->setVerticalSyncEnabled(true);
-	if (!window) {
-		cerr << "Failed to create window for the game!" << endl;
-		return;
+	if (!headless.enabled) {
+		window = new RenderWindow(VideoMode(WINDOW_WIDTH, WINDOW_HEIGHT), "Eat The Dots", Style::Default);
+		window->setVerticalSyncEnabled(true); // Paces the frames on its own: a 144 Hz display gets 144. No frame cap on top (SFML says not to use both).
+		if (!window) {
+			cerr << "Failed to create window for the game!" << endl;
+			return;
+		}
+		renderTarget = window;
+	}
+	else if (headless.renderMode == RenderMode::Offscreen) {
+		offscreen = new RenderTexture();
+		if (offscreen->create(WINDOW_WIDTH, WINDOW_HEIGHT)) renderTarget = offscreen;
+		else {
+			cerr << "Could not create the offscreen render texture (no OpenGL context?). Carrying on without rendering." << endl;
+			delete offscreen;
+			offscreen = nullptr;
+		}
 	}
 	gameLoop();
 }
@@ -362,133 +447,293 @@ void Client::startGame() {
 // Function to receive the initial position of the player from the server
 void Client::receiveInitialPosition() {
 
-	Packet positionPacket;
-	string command;
-	float x, y;
-	int spawnID;
+	Packet& positionPacket = incomingPacket;
 
-	// If the command is PLAYER_POSITIONS, then we get the spawn position first time
-	if (socket.receive(positionPacket) == Socket::Done) {
+	// The server sends PLAYER_ID just before our first PLAYER_POSITIONS, and our spawn position is the entry with our ID in it (the
+	// entries are in the server's order, not ours first). Through packetStream, which may already hold them from the lobby handshake.
+	// Anything else that comes in first is handled as usual.
+	while (packetStream.receive(positionPacket) == Socket::Done) {
 		positionPacket >> command;
-		if (command == "PLAYER_POSITIONS") {
-			positionPacket >> spawnID >> x >> y; // Now we extract the position after confirming the command
-			actualPlayerShape.setPosition(x, y);
+		if (command == "PACKED" && !unpack(positionPacket, command)) command.clear(); // A big match's first snapshot is compressed
+		if (command != "PLAYER_POSITIONS") {
+			handleMessage(positionPacket);
+			continue;
 		}
-		else {
-			cerr << "Received unexpected command: " << command << endl;
+		if (!decodePlayerPositions(positionPacket, positionEntries)) continue;
+
+		for (const auto& entry : positionEntries) {
+			if (entry.ID == playerID) {
+				actualPlayerShape.setPosition(entry.x, entry.y);
+
+				// A new player always starts at the spawn point, so anywhere else means we've been given someone else's position
+				awayFromSpawn = abs(entry.x - PLAYER_SPAWN_X) > 0.5f || abs(entry.y - PLAYER_SPAWN_Y) > 0.5f;
+				if (awayFromSpawn) cerr << "Started at " << entry.x << ", " << entry.y << " instead of our spawn at " << PLAYER_SPAWN_X << ", " << PLAYER_SPAWN_Y << "." << endl;
+				return;
+			}
 		}
+		cerr << "Our first snapshot didn't have our own position in it (player ID " << playerID << ")." << endl;
+		awayFromSpawn = true;
+		return;
 	}
-	else {
-		cout << "There was an error getting the initial spawn positions.";
+	cout << "There was an error getting the initial spawn positions.";
+}
+
+// Reconnect to the server and ask for our old session back using the token from PLAYER_ID, one step a frame (see SessionResume.h),
+// so the game keeps drawing meanwhile. False once it has given up and the game is over.
+bool Client::updateResume() {
+	unsigned attempt = resume.getAttempt();
+	switch (resume.update()) {
+	case SessionResume::State::Resumed:
+		applyResync(resume.getResync());
+		resume.reset();
+		return true;
+	case SessionResume::State::Failed:
+		cerr << resume.getError() << "\n";
+		resume.reset();
+		if (window) window->close();
+		return false;
+	default:
+		if (resume.getAttempt() != attempt) cout << "Reconnecting to the server (attempt " << resume.getAttempt() << " of " << SessionResume::MAX_ATTEMPTS << ")...\n";
+		return true;
+	}
+}
+
+// Restore our own state after resuming, plus whatever changed while we were disconnected
+void Client::applyResync(Packet& packet) {
+	ResyncMessage resync;
+	SpawnMessage spawn;
+	if (!decodeResync(packet, resync, spawn)) {
+		LOG_WARNING("Dropped a malformed RESYNC.");
 		return;
 	}
+
+	playerID = resync.ID;
+	playerData[playerID].id = playerID;
+	actualPlayerShape.setPosition(resync.x, resync.y);
+
+	// Everyone's scores come in the ROSTER_FULL the server sends next. Anything from before the disconnect is out of date.
+	rosterRequested = true;
+	sinceRosterRequest.restart();
+
+	// Rainbow ball: 0 = unchanged, 1 = gone, 2 = a new one
+	if (resync.rainbowBall != 0) deleteRainbowData();
+	if (resync.rainbowBall == 2) receiveRainbowData(spawn);
+
+	cout << "Session resumed as ID " << playerID << ".\n";
 }
 
 /* Main Game Loop */
 
-// Main game loop for rendering and handling player movement
+// Main game loop for rendering and handling player movement. Headless runs go through the same loop with scripted input and no window.
+//
+// Input, movement and the network run on a fixed INPUT_TICK_MS tick (inputTick) and drawing runs once a frame, at whatever rate
+// the display or the frame cap allows. FramePacer says how many ticks each frame owes, and frames in between ticks draw the
+// players part way between where they were before the last tick and where they are now.
 void Client::gameLoop() {
-	window->setFramerateLimit(60);  // Cap the framerate
+	// The first snapshot has been read, from here on nothing waits on the server
+	socket.setBlocking(false);
 
-	// Create a player shape and set its initial position
-	Vector2f targetPos; // Target position based on mouse
-	float moveSpeed = 400.f; // Speed of movement in pixels per second
-	const float deadZoneRadius = 5.f; // Dead zone radius to prevent jittering
+	float framePeriod = 0.f; // vsync
+	if (!window) framePeriod = headless.framerate > 0 ? 1.f / headless.framerate : FramePacer::UNPACED;
+	FramePacer pacer(INPUT_TICK_MS / 1000.f, framePeriod);
 
-	Clock clock; // For frame-based timing
+	Clock frameClock; // From the start of one frame to the start of the next
+	unsigned frameCount = 0;
+	unsigned tickCount = 0; // Drives the headless input, so a scripted run plays the same at any frame rate
 
-	while (window->isOpen()) {
-		float deltaTime = clock.restart().asSeconds(); // Time since last frame
+	previousOwnPosition = actualPlayerShape.getPosition();
 
-		Font font;
-		if (!font.loadFromFile("res/comic.ttf")) {
-			cerr << "Failed to load font!" << endl;
-			return;
-		}
+	// With CORPLIFE_COUNT_ALLOCATIONS, checks that frames stop allocating after the first couple of seconds
+	FrameAllocationCheck allocationCheck(ALLOCATION_WARMUP_FRAMES);
 
-		Event event;
-		while (window->pollEvent(event)) {
-			if (event.type == Event::Closed) {
-				window->close();
-				return;
+	// --record: one "ms x y" line per input tick, a path PredictionBenchmark can replay
+	ofstream trajectory;
+	if (!headless.recordPath.empty()) {
+		trajectory.open(headless.recordPath);
+		if (!trajectory) cerr << "Could not record the path to " << headless.recordPath << "\n";
+	}
+
+	while (window ? window->isOpen() : (headless.frames == 0 || frameCount < headless.frames)) {
+		TRACE_SCOPE("Client::frame");
+		METRIC_TIMER(Metrics::Histogram::FrameTimeUs);
+		allocationCheck.beginFrame();
+		frameCount++;
+		drawCalls = 0;
+
+		unsigned ticks = pacer.beginFrame(frameClock.restart().asSeconds());
+		if (pacer.missedDeadline()) METRIC_ADD(Metrics::Counter::MissedFrameDeadlines, 1);
+		if (pacer.skippedTicks() > 0) METRIC_ADD(Metrics::Counter::SkippedInputTicks, pacer.skippedTicks());
+
+		if (window) {
+			Event event;
+			allocationCheck.exclude(); // SFML's event queue
+			while (window->pollEvent(event)) {
+				if (event.type == Event::Closed) {
+					window->close();
+					return;
+				}
 			}
+			allocationCheck.include();
+		}
+
+		// Reconnecting after the connection dropped. The ticks carry on moving us locally, but nothing is sent or read until it's done.
+		if (resume.isActive() && !updateResume()) return;
+
+		tickCount += pacer.skippedTicks(); // Still time gone by for the scripted input
+		for (unsigned i = 0; i < ticks; i++) {
+			tickCount++;
+			if (!inputTick(tickCount * INPUT_TICK_MS / 1000.f, trajectory)) return;
 		}
 
-		// Update target position to the mouse location
-		targetPos = window->mapPixelToCoords(Mouse::getPosition(*window)); //convert the pixel coordinates from the mouse to world coordinates
+		// Clear the window and render everything
+		TRACE_SPAN_BEGIN(renderSpan, "Client::render");
+		float alpha = pacer.alpha();
+		Vector2f ownPosition = applyExtrapolation(previousOwnPosition, actualPlayerShape.getPosition(), alpha);
+		if (renderTarget) renderTarget->clear();
+		displayScores();
+		renderActualSelf(ownPosition.x, ownPosition.y);
+		renderReceivedShapes(alpha); // Draw all the players (self and opponent)
+		drawRainbowBalls(); // Draw the rainbow ball
+		METRIC_RECORD(Metrics::Histogram::DrawCalls, drawCalls);
+		TRACE_SPAN_END(renderSpan);
 
-		// Get the current position of the player
-		Vector2f currentPos = actualPlayerShape.getPosition();
-		Vector2f movementVector;
+		TRACE_SPAN_BEGIN(displaySpan, "Client::display"); // Includes the wait for vsync / the framerate limit
+		allocationCheck.exclude(); // SFML's own buffers
+		if (window) window->display();
+		else {
+			if (offscreen) offscreen->display();
 
-		// Compute direction vector and normalize it
-		Vector2f direction = targetPos - currentPos;
-		float distance = sqrt(direction.x * direction.x + direction.y * direction.y);
+			// Stand-in for vsync
+			Time frameTime = frameClock.getElapsedTime();
+			if (framePeriod > 0.f && seconds(framePeriod) > frameTime) sleep(seconds(framePeriod) - frameTime);
+		}
+		allocationCheck.include();
+		TRACE_SPAN_END(displaySpan);
 
-		// Only move if outside the dead zone
-		if (distance > deadZoneRadius) {
-			Vector2f normalizedDirection = direction / distance; // Normalize the direction vector
-			movementVector = normalizedDirection * moveSpeed * deltaTime;
-			actualPlayerShape.move(movementVector);
+		if (frameCount == 1) {
+			Int32 firstFrameMs = sinceJoin.getElapsedTime().asMilliseconds();
+			METRIC_RECORD(Metrics::Histogram::TimeToFirstFrameMs, static_cast<uint64_t>(firstFrameMs));
+			LOG_INFO("First game frame %d ms after joining", static_cast<int>(firstFrameMs));
 		}
 
-		// Clamp the player's position within the window bounds
-		Vector2f position = actualPlayerShape.getPosition();
-		float radius = actualPlayerShape.getRadius();
-
-		position.x = max(0.f, min(position.x, window->getSize().x - 2 * radius));
-		position.y = max(0.f, min(position.y, window->getSize().y - 2 * radius));
-		actualPlayerShape.setPosition(position);
-
-		sendPlayerPosition(movementVector); // Send the updated position of the player to the server.
-
-		// Receive packet from server. Check what command it is and then call that function.
-		Packet receivedPacket;
-		auto status = socket.receive(receivedPacket);
-		if (status == Socket::Done) {
-			string command;
-			receivedPacket >> command;
-
-			if (command == "PLAYER_POSITIONS") receivePlayerPositions(receivedPacket);
-			else if (command == "PLAYER_ID") receivedPacket >> playerID;
-			else if (command == "SPAWN") receiveRainbowData(receivedPacket);
-			else if (command == "DESPAWN") deleteRainbowData();
-			else if (command == "UPDATE_SCORES") updateScores(receivedPacket);
-			else cerr << "Error receiving data from socket: " << status << endl;
+		uint64_t frameAllocations = allocationCheck.endFrame();
+		if (AllocationCounter::isActive() && allocationCheck.warmedUp()) {
+			checkedFrames++;
+			if (frameAllocations > 0) {
+				allocatingFrames++;
+				LOG_ERROR("%llu heap allocations in one frame after warm-up", static_cast<unsigned long long>(frameAllocations));
+			}
 		}
-		else handleErrors(status);
+	}
+}
+
+// One input tick: read the mouse (or the script), move, send our position and handle everything the server has sent.
+// `gameSeconds` is the game time at this tick. False when the game is over (the connection dropped with no session to resume).
+bool Client::inputTick(float gameSeconds, ofstream& trajectory) {
+	TRACE_SCOPE("Client::inputTick");
+
+	// Where everyone was, for the frames drawn until the next tick
+	previousOwnPosition = actualPlayerShape.getPosition();
+	for (auto& player : playerData) player.second.previousPosition = player.second.position;
 
-		// If no update received for 90 ms, then set position to actual player shape.
-		if (playerData[playerID].lastReceivedUpdate.getElapsedTime().asMilliseconds() > 90) {
-			cout << "Setting to actual position.\n";
+	TRACE_SPAN_BEGIN(inputSpan, "Client::input");
+	uint64_t inputTime = Metrics::isEnabled() ? Metrics::nowMicros() : 0;
 
-			Vector2f currentPosition = predictedPlayerShape.getPosition();
-			Vector2f targetPosition = actualPlayerShape.getPosition();
-			float extrapolationSpeed = 0.2f;
+	// Update target position to the mouse location
+	Vector2f targetPos;
+	if (window) targetPos = window->mapPixelToCoords(Mouse::getPosition(*window)); //convert the pixel coordinates from the mouse to world coordinates
+	else targetPos = headlessTarget(gameSeconds);
+	if (trajectory.is_open()) trajectory << static_cast<int>(gameSeconds * 1000.f) << ' ' << targetPos.x << ' ' << targetPos.y << '\n';
 
-			Vector2f extrapolatedPosition = applyExtrapolation(currentPosition, targetPosition, extrapolationSpeed);
+	// Move towards the mouse and stay inside the play area. Same rules as the server uses (Shared/Simulation).
+	MoveStep move = step(actualPlayerShape.getPosition(), targetPos, INPUT_TICK_MS / 1000.f);
+	Vector2f movementVector = move.movement;
+	actualPlayerShape.setPosition(move.position);
 
-			// Update the predicted position with the extrapolated value
-			predictedPlayerShape.setPosition(extrapolatedPosition);
+	TRACE_SPAN_END(inputSpan);
 
-			// playerData[playerID].lastReceivedUpdate.restart();
+	TRACE_SPAN_BEGIN(networkSpan, "Client::network");
+	if (!resume.isActive()) {
+		bool sent = sendPlayerPosition(movementVector); // Send the updated position of the player to the server, if it changed.
+		if (sent && inputTime != 0) METRIC_RECORD(Metrics::Histogram::InputToSendUs, Metrics::nowMicros() - inputTime);
+
+		if (!receiveMessages()) return false;
+	}
+
+	// If no update received for a while (longer than the slowest rate the server backs off to), then set position to actual player shape.
+	if (playerData[playerID].lastReceivedUpdate.getElapsedTime().asMilliseconds() > MAX_SNAPSHOT_INTERVAL_MS + SNAPSHOT_INTERVAL_MS) {
+		LOG_DEBUG("Setting to actual position.");
+		if (!usingOwnPosition) METRIC_ADD(Metrics::Counter::PredictionFallbacks, 1);
+		usingOwnPosition = true;
+
+		Vector2f currentPosition = predictedPlayerShape.getPosition();
+		Vector2f targetPosition = actualPlayerShape.getPosition();
+		float extrapolationSpeed = 0.2f;
+
+		Vector2f extrapolatedPosition = applyExtrapolation(currentPosition, targetPosition, extrapolationSpeed);
+
+		// Update the predicted position with the extrapolated value
+		predictedPlayerShape.setPosition(extrapolatedPosition);
+
+		// playerData[playerID].lastReceivedUpdate.restart();
+	}
+
+	TRACE_SPAN_END(networkSpan);
+	return true;
+}
+
+// Handle every message the server has sent since the last tick. Check what command each one is and then call that function.
+// False when the game is over.
+bool Client::receiveMessages() {
+	Packet& receivedPacket = incomingPacket;
+	Socket::Status status;
+	while ((status = packetStream.receive(receivedPacket)) == Socket::Done) {
+		size_t wireBytes = receivedPacket.getDataSize();
+		receivedPacket >> command;
+
+		// A compressed message: swap in the original and handle that instead
+		if (command == "PACKED" && !unpack(receivedPacket, command)) {
+			LOG_WARNING("Dropped a compressed message that could not be unpacked.");
+			command.clear();
 		}
+		METRIC_PACKET_IN(opcodeFromCommand(command), wireBytes);
 
-		/*for (int i = 0; i < 2; i++) {
-			cout << " || ID: " << playerData[i].id << endl;
-			cout << " || Name: " << playerData[i].name << endl;
-			cout << " || score: " << playerData[i].score << endl;
-			cout << " || position: " << playerData[i].position.x << ", " << playerData[i].position.y << endl;
-		}*/
+		handleMessage(receivedPacket);
+	}
 
-		// Clear the window and render everything
-		window->clear();
-		displayScores(font);
-		renderActualSelf(actualPlayerShape.getPosition().x, actualPlayerShape.getPosition().y);
-		renderReceivedShapes(); // Draw all the players (self and opponent)
-		drawRainbowBalls(); // Draw the rainbow ball
-		window->display();
+	if (status == Socket::Disconnected || status == Socket::Error) {
+		// Lost the connection (or the server sent something PacketStream can't read past, which leaves it no better).
+		// Try to get back into the same session (a frame at a time, see updateResume) before giving up.
+		if (sessionToken == 0) {
+			cerr << "Lost connection to the server.\n";
+			if (window) window->close();
+			return false;
+		}
+		cout << "Lost the connection. Reconnecting to the server (attempt 1 of " << SessionResume::MAX_ATTEMPTS << ")...\n";
+		resume.start(SERVER, serverPort, sessionToken);
+	}
+	else if (status != Socket::NotReady) handleErrors(status); // NotReady: nothing more has come yet
+	return true;
+}
+
+// One message from the server, whose command has already been read into `command`
+void Client::handleMessage(Packet& packet) {
+	if (command == "PLAYER_POSITIONS") receivePlayerPositions(packet);
+	else if (command == "PLAYER_ID") {
+		PlayerIdMessage id;
+		if (decodePlayerId(packet, id)) {
+			playerID = id.ID;
+			sessionToken = id.sessionToken;
+		}
 	}
+	else if (command == "SPAWN") {
+		SpawnMessage spawn;
+		if (decodeSpawn(packet, spawn)) receiveRainbowData(spawn);
+	}
+	else if (command == "DESPAWN") deleteRainbowData();
+	else if (command == "ROSTER") receiveRoster(packet);
+	else if (command == "ROSTER_FULL") receiveFullRoster(packet);
+	else if (!command.empty()) LOG_WARNING("Unknown command from server: %s", command.c_str());
 }
 
 // Extrapolation code
@@ -497,22 +742,69 @@ Vector2f Client::applyExtrapolation(Vector2f start, Vector2f end, float speed) {
 	return extrapolatedPosition;
 }
 
-// Send actual player position to the server
-void Client::sendPlayerPosition(Vector2f movementVector) {
-	Packet packet;
-	packet << "UPDATE_POSITION" << actualPlayerShape.getPosition().x << actualPlayerShape.getPosition().y << movementVector.x << movementVector.y;
+// Send actual player position to the server. Only when we moved or stopped, otherwise just a heartbeat every INPUT_HEARTBEAT_MS.
+// Returns whether anything was sent.
+bool Client::sendPlayerPosition(Vector2f movementVector) {
+	Vector2f position = actualPlayerShape.getPosition();
+	if (!shouldSendInput(position, movementVector, lastSentPosition, lastSentMovement, sinceInputSent.getElapsedTime().asSeconds() * 1000.f)) return false;
+
+	Packet& packet = outgoingPacket; // Reused, clear() keeps its buffer
+	packet.clear();
+	packet << "UPDATE_POSITION";
+	Schema::append(packet, UpdatePositionMessage{ position.x, position.y, movementVector.x, movementVector.y });
+
+	// Echo the timestamp of the last positions we got so the server can measure the round trip time, and how long ago we got it
+	// (we may not have sent anything since), so the server can take that off
+	auto self = playerData.find(playerID);
+	if (self != playerData.end()) {
+		Int32 heldMs = self->second.lastReceivedUpdate.getElapsedTime().asMilliseconds();
+		Schema::append(packet, InputEcho{ self->second.lastReceivedTimestamp, static_cast<uint16_t>(min<Int32>(heldMs, 65535)) });
+	}
 
-	cout << "Actual: " << actualPlayerShape.getPosition().x << ", " << actualPlayerShape.getPosition().y << " || " << movementVector.x << ", " << movementVector.y << endl;
-	if (socket.send(packet) != Socket::Done) cerr << "Failed to send player position to the server.\n";
+	LOG_DEBUG("Actual: %.2f, %.2f || %.3f, %.3f", actualPlayerShape.getPosition().x, actualPlayerShape.getPosition().y, movementVector.x, movementVector.y);
+	size_t bytes = packet.getDataSize();
+	Socket::Status status = packetStream.send(packet);
+	if (status != Socket::Done) {
+		METRIC_SEND_FAILURE(status);
+		LOG_WARNING("Failed to send player position to the server.");
+		return false;
+	}
+
+	METRIC_PACKET_OUT(Opcode::UpdatePosition, bytes);
+	lastSentPosition = position;
+	lastSentMovement = movementVector;
+	sinceInputSent.restart();
+	return true;
 }
 
-// Receive the predicted positions from the server
-void Client::receivePlayerPositions(Packet packet) {
-	for (size_t i = 0; i < playerData.size(); ++i) {
-		long long timestamp;
-		float x, y;
-		int id;
-		packet >> timestamp >> id >> x >> y;
+// Replace a PACKED message with the message it holds, and read that message's command into `unpackedCommand`.
+// False if it's from a different dictionary or doesn't decompress.
+bool Client::unpack(Packet& packet, string& unpackedCommand) {
+	uint8_t version = 0;
+	uint32_t rawSize = 0;
+	if (!decodePackedHeader(packet, version, rawSize) || version != COMPRESSION_DICTIONARY_VERSION) return false;
+
+	const char* compressed = static_cast<const char*>(packet.getData()) + PACKED_HEADER_SIZE;
+	if (!decompressor.decompress(compressed, packet.getDataSize() - PACKED_HEADER_SIZE, rawSize, unpacked)) return false;
+
+	packet.clear(); // Keeps its buffer, so this doesn't allocate once it's grown
+	packet.append(unpacked.data(), unpacked.size());
+	packet >> unpackedCommand;
+	return static_cast<bool>(packet) && unpackedCommand != "PACKED";
+}
+
+// Receive the predicted positions from the server. In a big match the server only sends the players nearest to us, so read
+// however many entries there are rather than one per player we know about.
+void Client::receivePlayerPositions(Packet& packet) {
+	if (!decodePlayerPositions(packet, positionEntries)) {
+		LOG_WARNING("Dropped a malformed PLAYER_POSITIONS.");
+		return;
+	}
+
+	for (const PlayerPositionEntry& entry : positionEntries) {
+		int id = entry.ID;
+		float x = entry.x, y = entry.y;
+		long long timestamp = entry.timestamp;
 
 		// Update the last received timestamp
 		playerData[id].lastReceivedTimestamp = timestamp;
@@ -521,126 +813,182 @@ void Client::receivePlayerPositions(Packet packet) {
 		playerData[id].position = applyExtrapolation(playerData[id].position, Vector2f(x, y), 0.2); // Apply extrapolation from previous prection position to the newly received predicted position
 
 		if (id == playerID) {
-			cout << "Predicted: " << x << ", " << y << " || " << playerData[playerID].lastReceivedUpdate.getElapsedTime().asMilliseconds() << endl;
+			Vector2f error = Vector2f(x, y) - actualPlayerShape.getPosition();
+			METRIC_RECORD(Metrics::Histogram::OwnPredictionErrorPx, static_cast<uint64_t>(sqrt(error.x * error.x + error.y * error.y)));
+			usingOwnPosition = false;
+			LOG_DEBUG("Predicted: %.2f, %.2f || %d", x, y, playerData[playerID].lastReceivedUpdate.getElapsedTime().asMilliseconds());
 		}
 	}
 }
 
 // Receive dots position and colour
-void Client::receiveRainbowData(Packet packet) {
-	float x, y, spawnTime;
-	Uint8 r, g, b;
-	packet >> x >> y >> r >> g >> b >> spawnTime;
-	rainbowPositions.push_back(Vector2f(x, y));
-	rainbowColors.push_back(Color(r, g, b));
-	cout << "Rainbow received: " << x << ", " << y << " with spawn time: " << spawnTime << " seconds.\n";
+void Client::receiveRainbowData(const SpawnMessage& spawn) {
+	rainbowPositions.push_back(Vector2f(spawn.x, spawn.y));
+	rainbowColors.push_back(Color(spawn.r, spawn.g, spawn.b));
+	LOG_INFO("Rainbow received: %.1f, %.1f with spawn time: %.3f seconds.", spawn.x, spawn.y, spawn.spawnTime);
 }
 
 // Clears all rainbows since currently we are only spawning 1
 void Client::deleteRainbowData() {
 	rainbowPositions.clear();
 	rainbowColors.clear();
-	cout << "Cleared rainbows\n";
+	LOG_INFO("Cleared rainbows");
 }
 
 // Function to update the scores received from the server
-void Client::updateScores(Packet& packet) {
-	int playerID, score;
-	string nameReceived;
+/* ------------------------ Scoreboard ------------------------ */
+
+// Players joining, leaving and scoring. Only applied if it carries on from the version we have, otherwise we've missed
+// something and ask for the whole roster again.
+void Client::receiveRoster(Packet& packet) {
+	uint32_t firstVersion = 0;
+	if (!decodeRoster(packet, firstVersion, rosterEntries)) {
+		// A bad event means we can't trust the rest, or the version
+		if (!rosterRequested) requestFullRoster();
+		return;
+	}
+	Uint32 count = static_cast<Uint32>(rosterEntries.size());
+
+	// The ROSTER_FULL on its way already includes these. Ask again if it's taking far too long.
+	if (rosterRequested) {
+		if (sinceRosterRequest.getElapsedTime() > seconds(2)) requestFullRoster();
+		return;
+	}
+	if (firstVersion + count - 1 <= rosterVersion) return; // Already have them
+	if (firstVersion != rosterVersion + 1) {
+		LOG_WARNING("Roster gap: have version %u, got %u. Asking for the full roster.", rosterVersion, firstVersion);
+		requestFullRoster();
+		return;
+	}
 
-	// Decode the scores from the packet
-	while (!packet.endOfPacket()) {
-		packet >> playerID >> nameReceived >> score;
+	for (const RosterEntry& event : rosterEntries) {
+		if (event.type == RosterEvent::Join) {
+			leaderboard.set(event.ID, event.name, event.value);
+		}
+		else if (event.type == RosterEvent::Leave) {
+			leaderboard.remove(event.ID);
+		}
+		else if (event.type == RosterEvent::Score) {
+			leaderboard.addScore(event.ID, event.value);
 
-		if (playerID >= 0 && playerID < 2) { // Assuming two players, adjust if needed
-			playerData[playerID].score = score;
-			playerData[playerID].name = nameReceived;
+			const Leaderboard::Entry* entry = leaderboard.find(event.ID);
+			if (entry) LOG_INFO("%s (ID: %d): %d", entry->name.c_str(), event.ID, entry->score);
 		}
 	}
 
-	cout << playerData[playerID].name << " (ID: " << playerID << "): " << playerData[playerID].score << ", ";
+	rosterVersion = firstVersion + count - 1;
+	scoresChanged = true;
+}
+
+// The whole roster, when we join the match, after resuming or after asking for it. A broken one is dropped whole: the
+// next gap asks for it again.
+void Client::receiveFullRoster(Packet& packet) {
+	uint32_t version = 0;
+	if (!decodeFullRoster(packet, version, rosterEntries)) {
+		LOG_WARNING("Dropped a malformed ROSTER_FULL.");
+		return;
+	}
+
+	leaderboard.clear();
+	for (const RosterEntry& player : rosterEntries) leaderboard.set(player.ID, player.name, player.value);
+
+	rosterVersion = version;
+	rosterRequested = false;
+	scoresChanged = true;
 }
 
-// Function to display scores at the top left of the window
-void Client::displayScores(Font& font) {
-	int yOffset = 10;
+void Client::requestFullRoster() {
+	Packet& packet = outgoingPacket;
+	packet.clear();
+	packet << opcodeName(Opcode::RosterRequest) << rosterVersion;
 
-	for (int i = 0; i < 2; i++) {
-		string scoreText = playerData[i].name + "'s Score: " + to_string(playerData[i].score);
-		Text scoreDisplay = createText(scoreText, font, 24, Color::White, 10, yOffset + (i * 30));
-		window->draw(scoreDisplay);
+	size_t bytes = packet.getDataSize();
+	Socket::Status status = packetStream.send(packet);
+	if (status != Socket::Done) {
+		METRIC_SEND_FAILURE(status);
+		return; // Try again on the next gap
 	}
+	METRIC_PACKET_OUT(Opcode::RosterRequest, bytes);
+	rosterRequested = true;
+	sinceRosterRequest.restart();
 }
 
-// Local player (grey shape)
-void Client::renderActualSelf(float x, float y) {
-	CircleShape actualPlayerShape(CIRCLE_RADIUS);
-	actualPlayerShape.setRadius(CIRCLE_RADIUS);
-	actualPlayerShape.setFillColor(Color(128, 128, 128, 150));
-	actualPlayerShape.setOutlineThickness(CIRCLE_BORDER);
-	actualPlayerShape.setOutlineColor(Color(200, 200, 200, 150));
-	actualPlayerShape.setPosition(x, y);
-	window->draw(actualPlayerShape);
-}
-
-// Draw positions received from server for own and other players
-void Client::renderReceivedShapes() {
-	CircleShape otherPlayerShape(CIRCLE_RADIUS);
-	otherPlayerShape.setFillColor(Color::Red);
-	otherPlayerShape.setOutlineThickness(CIRCLE_BORDER);
-	otherPlayerShape.setOutlineColor(Color(250, 150, 100));
+void Client::displayScores() {
+	// Only the top few lines, and only rebuilt when the leaderboard changed
+	if (scoresChanged) {
+		char scoreText[64];
+		scoreLines = min(SCOREBOARD_LINES, leaderboard.size());
+		for (size_t i = 0; i < scoreLines; i++) {
+			const Leaderboard::Entry& entry = leaderboard.at(i);
+			snprintf(scoreText, sizeof(scoreText), "%s's Score: %d", entry.name.c_str(), entry.score);
+			scoreTexts[i].setString(scoreText);
+		}
+		scoresChanged = false;
+	}
 
-	// Iterate through all positions and render only if playerID matches
-	for (size_t i = 0; i < playerData.size(); ++i) {
-		if (static_cast<int>(i) != playerID) {
-			otherPlayerShape.setPosition(playerData[i].position.x, playerData[i].position.y);
+	for (size_t i = 0; i < scoreLines; i++) {
+		draw(scoreTexts[i]);
+	}
+}
 
-			//cout << "New position set: " << otherPlayerShape.getPosition().x << ", " << otherPlayerShape.getPosition().y << endl;
+// Local player (grey shape)
+void Client::renderActualSelf(float x, float y) {
+	actualRenderShape.setPosition(x, y);
+	draw(actualRenderShape);
+}
 
-			window->draw(otherPlayerShape);
-		}
-		else {
-			renderPredictedSelf(playerData[i].position.x, playerData[i].position.y); // Draw self
+// Draw positions received from server for own and other players, `alpha` of the way from before the last input tick to now
+void Client::renderReceivedShapes(float alpha) {
+	// Iterate through everyone we've had a position for. IDs keep counting up across matches and resumed sessions, so
+	// they're not 0..N-1, and indexing the map with operator[] would add (and draw) players that aren't there.
+	for (const auto& entry : playerData) {
+		const Player& player = entry.second;
+		Vector2f position = applyExtrapolation(player.previousPosition, player.position, alpha);
+		if (entry.first != playerID) {
+			otherPlayerShape.setPosition(position);
+			draw(otherPlayerShape);
 		}
+		else renderPredictedSelf(position.x, position.y); // Draw self
 	}
 }
 
 // Render self predicted shape
 void Client::renderPredictedSelf(float x, float y) {
-	CircleShape predictedPlayerShape(CIRCLE_RADIUS);
-	predictedPlayerShape.setRadius(CIRCLE_RADIUS);
-	predictedPlayerShape.setFillColor(Color::Green);
-	predictedPlayerShape.setOutlineThickness(CIRCLE_BORDER);
-	predictedPlayerShape.setOutlineColor(Color(250, 150, 100));
-	predictedPlayerShape.setPosition(x, y);
-	window->draw(predictedPlayerShape);
+	predictedRenderShape.setPosition(x, y);
+	draw(predictedRenderShape);
 }
 
 // Draw the rainbow dots
 void Client::drawRainbowBalls() {
 	for (size_t i = 0; i < rainbowPositions.size(); ++i) {
-		CircleShape rainbow(RAINBOW_RADIUS);
-		rainbow.setPosition(rainbowPositions[i]);
-		rainbow.setFillColor(rainbowColors[i]);
-		window->draw(rainbow);
+		rainbowShape.setPosition(rainbowPositions[i]);
+		rainbowShape.setFillColor(rainbowColors[i]);
+		draw(rainbowShape);
 	}
 }
 
+// Every draw in the game loop goes through here so the draw calls can be counted (and skipped when there's nothing to draw into)
+void Client::draw(const Drawable& drawable) {
+	drawCalls++;
+	if (renderTarget) renderTarget->draw(drawable);
+}
+
 /* Handle any errors */
+// Called from the game loop, so these go through the rate limited logger instead of straight to cerr
 void Client::handleErrors(Socket::Status status) {
 	switch (status) {
 	case Socket::NotReady:
-		cerr << "Socket not ready to send/receive data.\n";
+		LOG_WARNING("Socket not ready to send/receive data.");
 		break;
 	case Socket::Partial:
-		cerr << "Partial data sent/received.\n";
+		LOG_WARNING("Partial data sent/received.");
 		break;
 	case Socket::Disconnected:
-		cerr << "Socket disconnected.\n";
+		LOG_WARNING("Socket disconnected.");
 		break;
 	case Socket::Error:
 	default:
-		cerr << "An unexpected socket error occurred.\n";
+		LOG_ERROR("An unexpected socket error occurred.");
 		break;
 	}
 }
\ No newline at end of file
@@ -11,6 +11,22 @@
 #include <random>
 #include <thread>
 #include <fstream>
+#include <cassert>
+#include <cmath>
+#include "../Shared/Protocol.h"
+#include "../Shared/Decoders.h"
+#include "../Shared/GameConfig.h"
+#include "../Shared/Simulation.h"
+#include "../Shared/Metrics.h"
+#include "../Shared/Logger.h"
+#include "../Shared/Compression.h"
+#include "../Shared/PacketStream.h"
+#include "../Shared/AllocationCounter.h"
+#include "../Shared/NetEmulator.h"
+#include "LobbyConnection.h"
+#include "Leaderboard.h"
+#include "FramePacer.h"
+#include "SessionResume.h"
 
 using namespace sf;
 using namespace std;
@@ -18,17 +34,37 @@ using namespace std;
 // Enums for game state
 enum class GameState {
 	MainMenu,
+	Connecting,
 	Playing,
 	WaitingForPlayer,
 	LobbyFull
 };
 
+// Where the game loop draws each frame
+enum class RenderMode {
+	Window,    // Normal play
+	Offscreen, // Into an sf::RenderTexture (needs an OpenGL context, e.g. Mesa's software renderer under xvfb-run)
+	None       // Everything up to the draw calls, which are counted but skipped
+};
+
+// Running the client without a player or a display, for profiling in CI (see main.cpp for the command line)
+struct HeadlessOptions {
+	bool enabled = false;
+	RenderMode renderMode = RenderMode::None;
+	string playerName = "Headless";
+	string server = "127.0.0.1";
+	unsigned frames = 0;     // Stop after this many frames (0 = until the server goes away)
+	unsigned framerate = 60; // Frame cap standing in for vsync (0 = as fast as possible). Input runs at INPUT_TICK_MS either way.
+	string statsPath;        // Where to write the JSON stats when the run ends
+	string netProfile;       // Play through the network emulator with this profile (see Shared/NetEmulator.h)
+	string recordPath;       // Write the mouse (or scripted) target of every input tick here, for Benchmarks/PredictionBenchmark
+};
+
 struct Player {
 	int id;
 	CircleShape shape;
 	Vector2f position;
-	string name;
-	int score;
+	Vector2f previousPosition; // Before the last input tick, so frames in between can draw them part way
 	long long lastReceivedTimestamp = -1;
 	Clock lastReceivedUpdate;
 };
@@ -36,73 +72,131 @@ struct Player {
 class Client {
 private:
 
-	// Constants
+	// Constants (the ones shared with the server are in Shared/GameConfig.h)
 	string SERVER;
-	const unsigned short PORT = 5555;
-
-	const float WINDOW_WIDTH = 1700.f;
-	const float WINDOW_HEIGHT = 900.f;
+	unsigned short serverPort = PORT; // The network emulator's when there is one
 
-	const float CIRCLE_RADIUS = 15.f;
 	const float CIRCLE_BORDER = 2.f;
-	const float RAINBOW_RADIUS = 7.f;
+	static constexpr size_t SCOREBOARD_LINES = 5; // Top players shown
+	static constexpr size_t MAX_SERVER_ADDRESS_LENGTH = 15; // An IPv4 dotted quad, "255.255.255.255"
+	static constexpr uint64_t ALLOCATION_WARMUP_FRAMES = 120; // Frames that may still allocate while buffers grow (about 2 s)
 
 	// SFML objects
 	RenderWindow* window;
+	RenderTexture* offscreen = nullptr;   // Headless runs with RenderMode::Offscreen
+	RenderTarget* renderTarget = nullptr; // What the game loop draws into: the window, the offscreen texture or nothing
+	unsigned drawCalls = 0;               // This frame's
+	uint64_t checkedFrames = 0;           // With CORPLIFE_COUNT_ALLOCATIONS: frames after the warm-up...
+	uint64_t allocatingFrames = 0;        // ...and how many of them allocated
+	bool awayFromSpawn = false;           // Our first snapshot didn't start us at PLAYER_SPAWN (see main.cpp)
+	HeadlessOptions headless;
 	TcpSocket socket;
+	PacketStream packetStream; // Used by the game loop instead of socket.send/receive so packets don't allocate every frame
+	LobbyConnection lobby;     // Connect + lobby handshake without blocking the menu
+	SessionResume resume;      // Getting our session back after the connection drops, without blocking the game loop
+	unique_ptr<NetEmulator> netEmulator; // Headless runs with --netem
+	Clock sinceJoin;           // Restarted when joining, for the time to the first game frame
 
 	// Game state
 	Clock ticker;
-	int playerID;
+	int playerID = -1; // From PLAYER_ID, which comes just before our first PLAYER_POSITIONS
+	Uint64 sessionToken; // Given by the server with our ID, used to resume the session after a disconnect
+	bool usingOwnPosition = false; // The server's prediction of us went stale, so we're pulling towards our own position
+	Vector2f previousOwnPosition;  // actualPlayerShape's position before the last input tick
 	unordered_map<int, Player> playerData;
 	GameState currentState;
 
+	// Scoreboard, kept up to date by ROSTER events (see RosterEvent in Shared/Protocol.h)
+	Leaderboard leaderboard;
+	Uint32 rosterVersion = 0;
+	bool rosterRequested = false; // Asked for ROSTER_FULL after a gap, ignore ROSTER until it arrives
+	Clock sinceRosterRequest;     // In case that ROSTER_FULL never comes (the server drops messages to a client that falls behind)
+	vector<RosterEntry> rosterEntries; // Reused when reading ROSTER and ROSTER_FULL
+
 	vector<Vector2f> rainbowPositions;
 	vector<Color> rainbowColors;
 	bool hasRainbowBall;
 
 	// UI-related
 	string playerName;
+	Font menuFont; // Loaded once for the menu, waiting and lobby full screens
 
 	// Circle shapes
 	CircleShape actualPlayerShape;
 	CircleShape predictedPlayerShape;
 	CircleShape otherPlayerShape;
 
-	bool connectToServer();
+	// Reused every frame so the game loop doesn't allocate once it's warmed up
+	Packet outgoingPacket;
+	Packet incomingPacket;
+	Compressor decompressor;   // For PACKED messages
+	vector<char> unpacked;
+	vector<PlayerPositionEntry> positionEntries;
+
+	// What the last UPDATE_POSITION said, so an unchanged one is only sent as a heartbeat (see shouldSendInput in Shared/Simulation.h)
+	Vector2f lastSentPosition;
+	Vector2f lastSentMovement;
+	Clock sinceInputSent;
+	string command;
+	Font gameFont;
+	Text scoreTexts[SCOREBOARD_LINES];
+	size_t scoreLines = 0;
+	bool scoresChanged = true; // Only rebuild the score strings when they change
+	CircleShape actualRenderShape;
+	CircleShape predictedRenderShape;
+	CircleShape rainbowShape;
 
 	// Private helper methods
 	void createMainMenu();
 	RectangleShape createButton(float width, float height, const Color& color, float x, float y);
 	Text createText(const string& content, const Font& font, unsigned int size, const Color& color, float x, float y);
-	void displayWaitingMessage();
+	void displayWaitingMessage(const string& message);
 	void handleWaitingState();
 
+	bool joinHeadless();
+	Vector2f headlessTarget(float seconds) const;
+
 	void startGame();
 	void receiveInitialPosition();
+	bool updateResume();
+	void applyResync(Packet& packet);
 
 	void gameLoop();
+	bool inputTick(float seconds, ofstream& trajectory);
+	bool receiveMessages();
+	void handleMessage(Packet& packet);
 	Vector2f applyExtrapolation(Vector2f start, Vector2f end, float speed);
-	void sendPlayerPosition(Vector2f movementVector);
-	void receivePlayerPositions(Packet packet);
-	void receiveRainbowData(Packet packet);
+	bool sendPlayerPosition(Vector2f movementVector);
+	bool unpack(Packet& packet, string& unpackedCommand);
+	void receivePlayerPositions(Packet& packet);
+	void receiveRoster(Packet& packet);
+	void receiveFullRoster(Packet& packet);
+	void requestFullRoster();
+	void receiveRainbowData(const SpawnMessage& spawn);
 	void deleteRainbowData();
-	void updateScores(Packet& packet);
-	void displayScores(Font& font);
+	void displayScores();
 	void renderActualSelf(float x, float y);
-	void renderReceivedShapes();
+	void renderReceivedShapes(float alpha);
 	void drawRainbowBalls();
 	void renderPredictedSelf(float x, float y);
+	void draw(const Drawable& drawable);
 
 	void handleErrors(Socket::Status status);
 
 public:
 	// Constructor and Destructor
-	Client();
+	explicit Client(const HeadlessOptions& headless = HeadlessOptions());
 	~Client();
 
 	// Main entry point for the client
 	void run();
+
+	// The no-allocations-per-frame check, when built with CORPLIFE_COUNT_ALLOCATIONS (see main.cpp)
+	uint64_t getCheckedFrames() const { return checkedFrames; }
+	uint64_t getAllocatingFrames() const { return allocatingFrames; }
+
+	// True if the first snapshot put us somewhere other than our own spawn, e.g. on another player (see main.cpp)
+	bool startedAwayFromSpawn() const { return awayFromSpawn; }
 };
 
 #endif
\ No newline at end of file
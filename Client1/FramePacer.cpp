@@ -0,0 +1,39 @@
+#include "FramePacer.h"
+#include <algorithm>
+
+// Starts with a tick due, so the first frame already has input in it
+FramePacer::FramePacer(float tickSeconds, float framePeriodSeconds) : tickSeconds(tickSeconds), fixedPeriod(framePeriodSeconds), accumulator(tickSeconds) {}
+
+unsigned FramePacer::beginFrame(float frameSeconds) {
+	// The first frame's time is from before the loop started, not from one frame to the next
+	if (fixedPeriod == 0.f && started) {
+		shortestFrame = min(shortestFrame, frameSeconds);
+		if (++framesInBlock == PERIOD_WINDOW_FRAMES) {
+			// Start a new block, so a display that changes refresh rate (or a window moved to another one) is picked up
+			shortestPreviousFrame = shortestFrame;
+			shortestFrame = numeric_limits<float>::infinity();
+			framesInBlock = 0;
+		}
+	}
+	started = true;
+	float period = framePeriod();
+	missed = period > 0.f && frameSeconds > period * 1.5f;
+
+	accumulator += frameSeconds;
+	unsigned ticks = static_cast<unsigned>(accumulator / tickSeconds);
+	skipped = 0;
+	if (ticks > MAX_TICKS_PER_FRAME) {
+		// A long stall (a reconnect, the window being dragged): running every tick we missed would only make the next frame late too
+		skipped = ticks - MAX_TICKS_PER_FRAME;
+		ticks = MAX_TICKS_PER_FRAME;
+	}
+	accumulator -= (ticks + skipped) * tickSeconds;
+	accumulator = max(0.f, accumulator); // Float rounding
+	return ticks;
+}
+
+float FramePacer::framePeriod() const {
+	if (fixedPeriod != 0.f) return max(0.f, fixedPeriod);
+	float shortest = min(shortestFrame, shortestPreviousFrame);
+	return shortest == numeric_limits<float>::infinity() ? 0.f : shortest;
+}
@@ -0,0 +1,56 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <limits>
+
+using namespace std;
+
+// Keeps the game's input ticks at a fixed rate whatever rate the frames come at, and keeps track of how well the frames
+// themselves are keeping time.
+//
+// Every frame adds the time since the last one to an accumulator and runs one input tick (read the mouse, step(), send,
+// receive) per whole tick in it, so a 144 Hz display runs a tick every other frame or so and a 20 fps machine runs three a
+// frame, and both move the player and talk to the server exactly the same way. What's left over is alpha(): how far the
+// frame is between the last tick and the next, for drawing the player part way between the two.
+//
+// A frame is late (missed its deadline) when it comes more than half a frame period after it should have. The period is
+// the frame cap when there is one. With vsync it's the display's refresh interval, which SFML can't tell us, so it's
+// worked out from the frames: vsync never lets them come faster than the display, so the shortest recent frame is one
+// refresh. Frames that aren't paced at all have no deadline.
+class FramePacer {
+public:
+	static constexpr float UNPACED = -1.f;                     // For framePeriodSeconds: as fast as they can go
+	static constexpr unsigned MAX_TICKS_PER_FRAME = 8;         // Catch up by at most this many ticks, the rest are skipped
+	static constexpr unsigned PERIOD_WINDOW_FRAMES = 120;      // The display's refresh interval is the shortest frame in the last 120-240
+
+	// framePeriodSeconds: how often frames are meant to come (a frame cap), 0 for vsync or UNPACED
+	FramePacer(float tickSeconds, float framePeriodSeconds);
+
+	// Start of a frame, with the time since the last one started. Returns how many input ticks to run this frame.
+	unsigned beginFrame(float frameSeconds);
+
+	// 0 = a tick has just run .. 1 = the next one is due
+	float alpha() const { return accumulator / tickSeconds; }
+
+	// About the last beginFrame
+	bool missedDeadline() const { return missed; }
+	unsigned skippedTicks() const { return skipped; } // Ticks dropped because the frame was too late to catch up on them
+
+	// When frames are meant to come, in seconds. 0 if they're unpaced or there hasn't been a frame to work it out from.
+	float framePeriod() const;
+
+private:
+	float tickSeconds;
+	float fixedPeriod;      // > 0 for a frame cap
+	float accumulator;
+	bool started = false;
+	bool missed = false;
+	unsigned skipped = 0;
+
+	// Shortest frame in the current block of PERIOD_WINDOW_FRAMES and in the one before it, for vsync
+	float shortestFrame = numeric_limits<float>::infinity();
+	float shortestPreviousFrame = numeric_limits<float>::infinity();
+	unsigned framesInBlock = 0;
+};
+
+#endif
@@ -0,0 +1,92 @@
+#include "Leaderboard.h"
+#include <algorithm>
+#include <utility>
+
+void Leaderboard::set(int ID, const string& name, int score) {
+	auto it = rankOf.find(ID);
+	if (it == rankOf.end()) {
+		rankOf[ID] = ranking.size();
+		ranking.push_back({ ID, score, name });
+		moveUp(ranking.size() - 1);
+		return;
+	}
+
+	size_t rank = it->second;
+	int oldScore = ranking[rank].score;
+	ranking[rank].name = name;
+	ranking[rank].score = score;
+	if (score > oldScore) moveUp(rank);
+	else if (score < oldScore) moveDown(rank);
+}
+
+void Leaderboard::remove(int ID) {
+	auto it = rankOf.find(ID);
+	if (it == rankOf.end()) return;
+
+	// Shift everyone below them up one place
+	for (size_t rank = it->second; rank + 1 < ranking.size(); ++rank) {
+		swapRanks(rank, rank + 1);
+	}
+	ranking.pop_back();
+	rankOf.erase(ID);
+}
+
+void Leaderboard::addScore(int ID, int change) {
+	auto it = rankOf.find(ID);
+	if (it == rankOf.end()) return;
+
+	// One point at a time: swap with the first player on the same score, which keeps the order, then take the point.
+	// Points are picked up one at a time in this game, so this loop normally runs once.
+	size_t rank = it->second;
+	for (; change > 0; --change) {
+		int score = ranking[rank].score;
+		auto first = lower_bound(ranking.begin(), ranking.begin() + rank, score, [](const Entry& entry, int value) { return entry.score > value; });
+		size_t target = first - ranking.begin();
+		swapRanks(rank, target);
+		rank = target;
+		ranking[rank].score++;
+	}
+
+	// Same the other way round: swap with the last player on the same score
+	for (; change < 0; ++change) {
+		int score = ranking[rank].score;
+		auto last = upper_bound(ranking.begin() + rank, ranking.end(), score, [](int value, const Entry& entry) { return value > entry.score; });
+		size_t target = (last - ranking.begin()) - 1;
+		swapRanks(rank, target);
+		rank = target;
+		ranking[rank].score--;
+	}
+}
+
+void Leaderboard::clear() {
+	ranking.clear();
+	rankOf.clear();
+}
+
+const Leaderboard::Entry* Leaderboard::find(int ID) const {
+	auto it = rankOf.find(ID);
+	return it == rankOf.end() ? nullptr : &ranking[it->second];
+}
+
+void Leaderboard::swapRanks(size_t a, size_t b) {
+	if (a == b) return;
+	swap(ranking[a], ranking[b]);
+	rankOf[ranking[a].ID] = a;
+	rankOf[ranking[b].ID] = b;
+}
+
+// After a player's score went up: past everyone with a lower score
+void Leaderboard::moveUp(size_t rank) {
+	while (rank > 0 && ranking[rank - 1].score < ranking[rank].score) {
+		swapRanks(rank - 1, rank);
+		rank--;
+	}
+}
+
+// After a player's score went down: below everyone with a score at least as high
+void Leaderboard::moveDown(size_t rank) {
+	while (rank + 1 < ranking.size() && ranking[rank + 1].score >= ranking[rank].score) {
+		swapRanks(rank, rank + 1);
+		rank++;
+	}
+}
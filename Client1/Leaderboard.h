@@ -0,0 +1,47 @@
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// The scoreboard, kept sorted as ROSTER events come in instead of being rebuilt from the whole list every time someone scores.
+//
+// Players are kept in a vector, highest score first. A score going up or down by one only has to swap the player with the
+// first (or last) player on their old score, which a binary search finds, so a pickup is O(log n) and never allocates.
+// Joins, leaves and bigger jumps move entries along the vector, but those are rare.
+// Players on the same score stay in the order they got there.
+class Leaderboard {
+public:
+	struct Entry {
+		int ID;
+		int score;
+		string name;
+	};
+
+	// Add a player, or update their name and score if they're already on it (ROSTER Join and ROSTER_FULL)
+	void set(int ID, const string& name, int score);
+	void remove(int ID);
+	void addScore(int ID, int change);
+	void clear();
+
+	size_t size() const { return ranking.size(); }
+
+	// 0 is the leader
+	const Entry& at(size_t rank) const { return ranking[rank]; }
+
+	// Null if they aren't on the leaderboard
+	const Entry* find(int ID) const;
+
+private:
+	void swapRanks(size_t a, size_t b);
+	void moveUp(size_t rank);
+	void moveDown(size_t rank);
+
+	vector<Entry> ranking;
+	unordered_map<int, size_t> rankOf; // ID -> index in ranking
+};
+
+#endif
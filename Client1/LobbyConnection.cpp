@@ -0,0 +1,116 @@
+#include "LobbyConnection.h"
+
+LobbyConnection::LobbyConnection(TcpSocket& socket, PacketStream& packetStream) : socket(socket), packetStream(packetStream) {}
+
+void LobbyConnection::start(const string& server, unsigned short port, const string& name) {
+	playerName = name;
+	error.clear();
+	sinceStart.restart();
+	inState.restart();
+
+	IpAddress address(server);
+	if (address == IpAddress::None) {
+		fail("Invalid IPv4 address: " + server);
+		return;
+	}
+
+	socket.disconnect();
+	packetStream.reset();
+	socket.setBlocking(false);
+
+	// Non-blocking connect returns NotReady while the connection is being made. Done is possible straight away on localhost.
+	Socket::Status status = socket.connect(address, port);
+	if (status == Socket::Error) {
+		fail("Could not connect to " + server);
+		return;
+	}
+	connectSelector.clear();
+	connectSelector.add(socket);
+	state = State::Connecting;
+}
+
+LobbyConnection::State LobbyConnection::update() {
+	switch (state) {
+	case State::Connecting:
+		// SFML has no "connect finished" call: the socket has a remote address once the connection is made
+		if (socket.getRemoteAddress() != IpAddress::None) {
+			packet.clear();
+			packet << "PLAYER_NAME" << playerName;
+			if (packetStream.send(packet) != Socket::Done) {
+				fail("Failed to send player name to server!");
+				break;
+			}
+			connectSelector.clear();
+			state = State::Handshaking;
+			inState.restart();
+		}
+		// A refused connect makes the socket readable without it ever getting a peer (not on Windows, where we wait for the timeout instead).
+		// wait(Time::Zero) would block forever, hence the microsecond.
+		else if (connectSelector.wait(microseconds(1)) && connectSelector.isReady(socket)) {
+			fail("Could not connect to server (connection refused).");
+		}
+		else if (inState.getElapsedTime().asSeconds() > CONNECT_TIMEOUT_SECONDS) {
+			fail("Could not connect to server (timed out).");
+		}
+		break;
+
+	case State::Handshaking:
+		receiveStatus();
+		if (state == State::Handshaking && inState.getElapsedTime().asSeconds() > HANDSHAKE_TIMEOUT_SECONDS) {
+			fail("The server didn't answer (timed out).");
+		}
+		break;
+
+	case State::Waiting:
+		receiveStatus();
+		break;
+
+	default:
+		break;
+	}
+	return state;
+}
+
+// Read any LOBBY status the server has sent. Anything else this early is ignored.
+void LobbyConnection::receiveStatus() {
+	Socket::Status status;
+	while ((status = packetStream.receive(packet)) == Socket::Done) {
+		string command;
+		packet >> command;
+		if (command != opcodeName(Opcode::Lobby)) continue;
+
+		LobbyStatus lobbyStatus;
+		if (!decodeLobby(packet, lobbyStatus)) continue;
+		switch (lobbyStatus) {
+		case LobbyStatus::Waiting:
+			state = State::Waiting;
+			break;
+		case LobbyStatus::Starting:
+			state = State::Starting;
+			socket.setBlocking(true); // Client::receiveInitialPosition waits for the first snapshot, then the game loop goes back to non-blocking
+			return;
+		case LobbyStatus::Full:
+			state = State::Full;
+			socket.disconnect();
+			return;
+		}
+		inState.restart();
+	}
+
+	if (status == Socket::Disconnected || status == Socket::Error) fail("Lost the connection to the server.");
+}
+
+void LobbyConnection::cancel() {
+	connectSelector.clear();
+	socket.disconnect();
+	packetStream.reset();
+	state = State::Idle;
+}
+
+void LobbyConnection::fail(const string& reason) {
+	connectSelector.clear();
+	socket.disconnect();
+	packetStream.reset();
+	error = reason;
+	state = State::Failed;
+}
@@ -0,0 +1,68 @@
+#ifndef LOBBY_CONNECTION_H
+#define LOBBY_CONNECTION_H
+
+#include <SFML/Network.hpp>
+#include <string>
+#include "../Shared/PacketStream.h"
+#include "../Shared/Protocol.h"
+#include "../Shared/Decoders.h"
+
+using namespace std;
+using namespace sf;
+
+// Connecting to the server and getting into a match, one non-blocking step per frame so the menu keeps drawing.
+//
+//   Connecting  -> non-blocking connect, done once the socket has a peer (CONNECT_TIMEOUT)
+//   Handshaking -> PLAYER_NAME sent, waiting for the first LOBBY status (HANDSHAKE_TIMEOUT)
+//   Waiting     -> LOBBY Waiting, for as long as it takes another player to join
+//   Starting    -> LOBBY Starting, the match begins (the socket is put back in blocking mode to wait for the first snapshot)
+//   Full        -> LOBBY Full, the server disconnects us
+//   Failed      -> timed out, disconnected or bad address (see getError)
+class LobbyConnection {
+public:
+	enum class State {
+		Idle,
+		Connecting,
+		Handshaking,
+		Waiting,
+		Starting,
+		Full,
+		Failed
+	};
+
+	static constexpr float CONNECT_TIMEOUT_SECONDS = 5.f;
+	static constexpr float HANDSHAKE_TIMEOUT_SECONDS = 5.f;
+
+	LobbyConnection(TcpSocket& socket, PacketStream& packetStream);
+
+	// Starts connecting. Returns straight away, call update() every frame after this.
+	void start(const string& server, unsigned short port, const string& playerName);
+
+	// Moves the state machine along without ever blocking and returns the new state
+	State update();
+
+	// Gives up and closes the socket
+	void cancel();
+
+	State getState() const { return state; }
+	const string& getError() const { return error; }
+
+	// Since start() was called
+	Time getElapsed() const { return sinceStart.getElapsedTime(); }
+
+private:
+	void fail(const string& reason);
+	void receiveStatus();
+
+	TcpSocket& socket;
+	PacketStream& packetStream;
+	Packet packet;
+	SocketSelector connectSelector; // Only to notice a refused connect early
+	string playerName;
+	string error;
+	State state = State::Idle;
+	Clock sinceStart;
+	Clock inState; // Time spent in the current state, for the timeouts
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include "SessionResume.h"
+
+SessionResume::SessionResume(TcpSocket& socket, PacketStream& packetStream) : socket(socket), packetStream(packetStream) {}
+
+void SessionResume::start(const string& server, unsigned short serverPort, Uint64 token) {
+	address = IpAddress(server);
+	port = serverPort;
+	sessionToken = token;
+	attempt = 0;
+	error.clear();
+
+	if (sessionToken == 0) {
+		fail("No session to resume.");
+		return;
+	}
+	connect();
+}
+
+void SessionResume::connect() {
+	attempt++;
+	inState.restart();
+
+	socket.disconnect();
+	packetStream.reset(); // Anything half-received belongs to the old connection
+	socket.setBlocking(false);
+
+	// Non-blocking connect returns NotReady while the connection is being made. Done is possible straight away on localhost.
+	if (socket.connect(address, port) == Socket::Error) {
+		retry();
+		return;
+	}
+	connectSelector.clear();
+	connectSelector.add(socket);
+	state = State::Connecting;
+}
+
+SessionResume::State SessionResume::update() {
+	switch (state) {
+	case State::Connecting:
+		// SFML has no "connect finished" call: the socket has a remote address once the connection is made
+		if (socket.getRemoteAddress() != IpAddress::None) {
+			packet.clear();
+			packet << opcodeName(Opcode::Resume);
+			Schema::append(packet, ResumeMessage{ sessionToken });
+			connectSelector.clear();
+			if (packetStream.send(packet) != Socket::Done) {
+				retry();
+				break;
+			}
+			state = State::Waiting;
+			inState.restart();
+		}
+		// A refused connect makes the socket readable without it ever getting a peer (see LobbyConnection::update)
+		else if (connectSelector.wait(microseconds(1)) && connectSelector.isReady(socket)) retry();
+		else if (inState.getElapsedTime().asSeconds() > CONNECT_TIMEOUT_SECONDS) retry();
+		break;
+
+	case State::Waiting:
+		receiveAnswer();
+		if (state == State::Waiting && inState.getElapsedTime().asSeconds() > REPLY_TIMEOUT_SECONDS) retry();
+		break;
+
+	case State::RetryWait:
+		if (inState.getElapsedTime().asSeconds() > RETRY_DELAY_SECONDS) connect();
+		break;
+
+	default:
+		break;
+	}
+	return state;
+}
+
+// The first thing that matters after RESUME: RESYNC, RESUME_FAILED or LOBBY Full. A LOBBY Waiting sent to every new
+// connection before the server has read our RESUME is skipped. Anything after RESYNC is left in the stream for the game loop.
+void SessionResume::receiveAnswer() {
+	Socket::Status status;
+	while ((status = packetStream.receive(packet)) == Socket::Done) {
+		string command;
+		packet >> command;
+
+		if (command == opcodeName(Opcode::Resync)) {
+			state = State::Resumed;
+			return;
+		}
+		if (command == opcodeName(Opcode::ResumeFailed)) {
+			fail("The server could not resume our session.");
+			return;
+		}
+
+		LobbyStatus lobbyStatus;
+		if (command == opcodeName(Opcode::Lobby) && decodeLobby(packet, lobbyStatus) && lobbyStatus == LobbyStatus::Full) {
+			fail("The server is full, so our session can't be resumed.");
+			return;
+		}
+	}
+
+	if (status == Socket::Disconnected || status == Socket::Error) retry();
+}
+
+void SessionResume::retry() {
+	connectSelector.clear();
+	socket.disconnect();
+	packetStream.reset();
+	if (attempt >= MAX_ATTEMPTS) {
+		fail("Lost connection to the server.");
+		return;
+	}
+	state = State::RetryWait;
+	inState.restart();
+}
+
+void SessionResume::fail(const string& reason) {
+	connectSelector.clear();
+	socket.disconnect();
+	packetStream.reset();
+	error = reason;
+	state = State::Failed;
+}
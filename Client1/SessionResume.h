@@ -0,0 +1,75 @@
+#ifndef SESSION_RESUME_H
+#define SESSION_RESUME_H
+
+#include <SFML/Network.hpp>
+#include <string>
+#include "../Shared/PacketStream.h"
+#include "../Shared/Protocol.h"
+#include "../Shared/Decoders.h"
+
+using namespace std;
+using namespace sf;
+
+// Getting back into our session after the connection drops, one non-blocking step per frame like LobbyConnection, so the
+// game keeps drawing (and the window keeps answering) while it happens.
+//
+//   Connecting -> non-blocking connect, done once the socket has a peer (CONNECT_TIMEOUT)
+//   Waiting    -> RESUME sent with our session token, waiting for the server's answer (REPLY_TIMEOUT)
+//   RetryWait  -> that attempt didn't get through, trying again after RETRY_DELAY (up to MAX_ATTEMPTS)
+//   Resumed    -> RESYNC came back (see getResync), the socket is left non-blocking for the game loop
+//   Failed     -> RESUME_FAILED, LOBBY Full or out of attempts (see getError). Nothing is retried after the server has said no.
+class SessionResume {
+public:
+	enum class State {
+		Idle,
+		Connecting,
+		Waiting,
+		RetryWait,
+		Resumed,
+		Failed
+	};
+
+	static constexpr unsigned MAX_ATTEMPTS = 5;
+	static constexpr float CONNECT_TIMEOUT_SECONDS = 2.f;
+	static constexpr float REPLY_TIMEOUT_SECONDS = 5.f;
+	static constexpr float RETRY_DELAY_SECONDS = 1.f;
+
+	SessionResume(TcpSocket& socket, PacketStream& packetStream);
+
+	// Starts the first attempt. Returns straight away, call update() every frame after this.
+	void start(const string& server, unsigned short port, Uint64 sessionToken);
+
+	// Moves the state machine along without ever blocking and returns the new state
+	State update();
+
+	// Back to Idle once the game has dealt with Resumed or Failed
+	void reset() { state = State::Idle; }
+
+	bool isActive() const { return state == State::Connecting || state == State::Waiting || state == State::RetryWait; }
+	State getState() const { return state; }
+	unsigned getAttempt() const { return attempt; } // 1..MAX_ATTEMPTS
+	const string& getError() const { return error; }
+
+	// The RESYNC, once Resumed, for Client::applyResync. Its command has already been read.
+	Packet& getResync() { return packet; }
+
+private:
+	void connect();
+	void receiveAnswer();
+	void retry(); // This attempt failed, but the server hasn't refused us: try again if there are attempts left
+	void fail(const string& reason);
+
+	TcpSocket& socket;
+	PacketStream& packetStream;
+	Packet packet;
+	SocketSelector connectSelector; // Only to notice a refused connect early
+	IpAddress address;
+	unsigned short port = 0;
+	Uint64 sessionToken = 0;
+	unsigned attempt = 0;
+	string error;
+	State state = State::Idle;
+	Clock inState; // Time spent in the current state, for the timeouts
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include "Spectator.h"
+#include "../Shared/Logger.h"
+#include <iostream>
+
+// Players are told apart by colour, picked by player ID
+static const Color PLAYER_COLORS[] = { Color::Red, Color(100, 149, 237), Color::Green, Color::Yellow, Color::Magenta, Color::Cyan };
+
+Spectator::Spectator(const string& server, unsigned short port, bool headless, unsigned frames)
+	: server(server), port(port), headless(headless), framesToWatch(frames) {}
+
+void Spectator::run() {
+	if (socket.connect(IpAddress(server), port, seconds(5)) != Socket::Done) {
+		cerr << "Could not reach " << server << ":" << port << ".\n";
+		return;
+	}
+	cout << "Watching " << server << ":" << port << "\n";
+
+	// Headless there's nothing else to do, so just wait for each frame
+	if (headless) {
+		while (receiveFrames() && (framesToWatch == 0 || framesReceived < framesToWatch)) {}
+	}
+	else {
+		hasFont = font.loadFromFile("res/comic.ttf");
+		if (!hasFont) cerr << "Failed to load font!" << endl;
+
+		RenderWindow window(VideoMode(WINDOW_WIDTH, WINDOW_HEIGHT), "Eat The Dots - Spectating", Style::Default);
+		window.setFramerateLimit(60);
+		socket.setBlocking(false);
+
+		bool connected = true;
+		while (window.isOpen()) {
+			Event event;
+			while (window.pollEvent(event)) {
+				if (event.type == Event::Closed || (event.type == Event::KeyPressed && event.key.code == Keyboard::Escape)) window.close();
+			}
+
+			// Whatever's come in since the last frame. The last one of them is the one drawn.
+			if (connected) connected = receiveFrames();
+			if (!connected) latest.flags = 0;
+			draw(window);
+			window.display();
+		}
+	}
+
+	if (full) cout << "The server has no room for another spectator. Try again later.\n";
+	cout << "Watched " << framesReceived << " frames (" << framesMissed << " missed).\n";
+}
+
+bool Spectator::receiveFrames() {
+	Socket::Status status;
+	while ((status = packetStream.receive(packet)) == Socket::Done) {
+		if (!(packet >> command)) continue;
+		if (command == opcodeName(Opcode::Watch)) readFrame();
+		else if (command == opcodeName(Opcode::Lobby)) full = true;
+
+		// Headless, one frame at a time so --frames stops on the right one
+		if (headless) return true;
+	}
+	return status == Socket::NotReady;
+}
+
+void Spectator::readFrame() {
+	// Into the spare frame, so a broken one leaves the last good frame on screen
+	if (!decodeWatch(packet, incoming)) {
+		LOG_WARNING("Dropped a malformed WATCH frame");
+		return;
+	}
+	swap(latest, incoming);
+	Uint32 frame = latest.frame;
+
+	if (anyFrame && frame > lastFrame + 1) framesMissed += frame - lastFrame - 1;
+	anyFrame = true;
+	lastFrame = frame;
+	framesReceived++;
+}
+
+void Spectator::draw(RenderWindow& window) {
+	window.clear();
+
+	bool matchInProgress = (latest.flags & WATCH_MATCH_IN_PROGRESS) != 0;
+	if ((latest.flags & WATCH_RAINBOW_BALL) && matchInProgress) {
+		rainbowShape.setPosition(latest.rainbow.x, latest.rainbow.y);
+		rainbowShape.setFillColor(Color(latest.rainbow.r, latest.rainbow.g, latest.rainbow.b));
+		window.draw(rainbowShape);
+	}
+
+	for (size_t i = 0; i < latest.players.size() && matchInProgress; ++i) {
+		const RosterEntry& player = latest.players[i];
+		playerShape.setPosition(player.x, player.y);
+		playerShape.setFillColor(PLAYER_COLORS[player.ID % (sizeof(PLAYER_COLORS) / sizeof(PLAYER_COLORS[0]))]);
+		window.draw(playerShape);
+
+		if (hasFont) {
+			Text name(player.name, font, 16);
+			name.setPosition(player.x, player.y - 22.f);
+			window.draw(name);
+
+			Text score(player.name + "'s Score: " + to_string(player.value), font, 20);
+			score.setPosition(10.f, 10.f + 25.f * i);
+			window.draw(score);
+		}
+	}
+
+	if (!matchInProgress && hasFont) {
+		Text waiting(full ? "The server has no room for another spectator." : "Waiting for a match...", font, 30);
+		waiting.setPosition(WINDOW_WIDTH / 2 - 250.f, WINDOW_HEIGHT / 2 - 20.f);
+		window.draw(waiting);
+	}
+}
@@ -0,0 +1,58 @@
+#ifndef SPECTATOR_H
+#define SPECTATOR_H
+
+#include <SFML/Graphics.hpp>
+#include <SFML/Network.hpp>
+#include <string>
+#include <vector>
+#include "../Shared/Protocol.h"
+#include "../Shared/Decoders.h"
+#include "../Shared/GameConfig.h"
+#include "../Shared/PacketStream.h"
+
+using namespace sf;
+using namespace std;
+
+// `Client1 --spectate`: watches a match from a server's (or a relay's) spectator port instead of playing in it. Each WATCH
+// frame has the whole match in it, so there's nothing to predict or keep in sync: the latest frame is what's drawn. Nothing is
+// ever sent to the server. The match shows up SPECTATOR_DELAY_MS after the players see it.
+class Spectator {
+public:
+	// headless: no window, just count the frames (stops after `frames` of them, or when the server goes, with frames = 0)
+	Spectator(const string& server, unsigned short port, bool headless, unsigned frames);
+
+	void run();
+
+private:
+	bool receiveFrames(); // False once the server has gone
+	void readFrame();
+	void draw(RenderWindow& window);
+
+	string server;
+	unsigned short port;
+	bool headless;
+	unsigned framesToWatch;
+
+	TcpSocket socket;
+	PacketStream packetStream{ socket };
+	Packet packet;
+	string command;
+	bool full = false; // The server had no room for another spectator
+
+	// The latest good frame, and the one the next is read into
+	WatchFrame latest;
+	WatchFrame incoming;
+
+	// Frames are numbered, so a gap means some were dropped on the way (a relay, or the server, fell behind)
+	bool anyFrame = false;
+	Uint32 lastFrame = 0;
+	unsigned framesReceived = 0;
+	unsigned framesMissed = 0;
+
+	Font font;
+	bool hasFont = false;
+	CircleShape playerShape{ PLAYER_RADIUS };
+	CircleShape rainbowShape{ RAINBOW_RADIUS };
+};
+
+#endif
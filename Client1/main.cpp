@@ -1,7 +1,90 @@
 #include "Client.h"
+#include "Spectator.h"
+#include <cstring>
 
-int main() {
-	Client client;
-	client.run();
-	return 0;
-}
\ No newline at end of file
+// Usage:
+//   Client1 [--record FILE.txt]  Normal game with the main menu
+//   Client1 --headless [--render none|offscreen] [--name NAME] [--server IP] [--frames N] [--fps N] [--stats FILE.json] [--netem PROFILE] [--record FILE.txt]
+//   Client1 --spectate [--server IP] [--port N] [--headless [--frames N]]
+//
+// --headless joins the server straight away and plays the match with scripted input and no window. --render offscreen draws
+// every frame into a texture instead (needs OpenGL, e.g. `xvfb-run -a` with LIBGL_ALWAYS_SOFTWARE=1 in a container).
+// Frame time, missed frame deadlines, input-to-send latency and draw calls are written to the --stats file when the run ends.
+// --fps only changes how often frames are drawn: input and the network run every INPUT_TICK_MS regardless (see FramePacer.h).
+// --record writes where the mouse (or the scripted input) was every input tick, for Benchmarks/PredictionBenchmark to replay.
+// --netem plays through the network emulator (Shared/NetEmulator.h) with a profile from NetProfiles/, e.g. NetProfiles/dsl.netem.
+// Built with -DCORPLIFE_COUNT_ALLOCATIONS=ON, a headless run checks that the game loop makes no heap allocations once it has
+// warmed up, and exits with 1 if any frame after the first couple of seconds did (or the run was too short to tell).
+// A headless run also exits with 1 if the server didn't start it at its own spawn point (PLAYER_SPAWN in Shared/GameConfig.h),
+// e.g. on top of a bot, so `GameServer --bots N` plus a couple of headless clients checks that late and second joiners spawn right.
+// --spectate watches the match from the server's spectator port (or a relay's, with --port) instead of playing (see Spectator.h).
+// Headless it only counts the frames it gets.
+
+static void printUsage() {
+	cerr << "Usage: Client1 [--record FILE.txt] [--headless [--render none|offscreen] [--name NAME] [--server IP] [--frames N] [--fps N] [--stats FILE.json] [--netem PROFILE]]\n"
+		<< "       Client1 --spectate [--server IP] [--port N] [--headless [--frames N]]\n";
+}
+
+int main(int argc, char* argv[]) {
+	HeadlessOptions headless;
+	bool spectate = false;
+	bool checkFailed = false;
+	unsigned short spectatorPort = SPECTATOR_PORT;
+	for (int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--headless") headless.enabled = true;
+		else if (arg == "--render" && hasValue) {
+			string mode = argv[++i];
+			if (mode == "none") headless.renderMode = RenderMode::None;
+			else if (mode == "offscreen") headless.renderMode = RenderMode::Offscreen;
+			else {
+				printUsage();
+				return 1;
+			}
+		}
+		else if (arg == "--name" && hasValue) headless.playerName = argv[++i];
+		else if (arg == "--server" && hasValue) headless.server = argv[++i];
+		else if (arg == "--frames" && hasValue) headless.frames = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+		else if (arg == "--fps" && hasValue) headless.framerate = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+		else if (arg == "--stats" && hasValue) headless.statsPath = argv[++i];
+		else if (arg == "--netem" && hasValue) headless.netProfile = argv[++i];
+		else if (arg == "--record" && hasValue) headless.recordPath = argv[++i];
+		else if (arg == "--spectate") spectate = true;
+		else if (arg == "--port" && hasValue) spectatorPort = static_cast<unsigned short>(strtoul(argv[++i], nullptr, 10));
+		else {
+			printUsage();
+			return 1;
+		}
+	}
+
+	// Set CORPLIFE_TRACE=<file.json> to record metrics and a Chrome trace of this run
+	const char* tracePath = getenv("CORPLIFE_TRACE");
+	Metrics::setEnabled(tracePath != nullptr || !headless.statsPath.empty());
+
+	if (spectate) {
+		Spectator spectator(headless.server, spectatorPort, headless.enabled, headless.frames);
+		spectator.run();
+	}
+	else {
+		Client client(headless);
+		client.run();
+
+		if (headless.enabled && AllocationCounter::isActive()) {
+			cout << "Allocation check: " << client.getAllocatingFrames() << " of " << client.getCheckedFrames() << " frames after warm-up allocated.\n";
+			if (client.getCheckedFrames() == 0) cerr << "The run ended during the warm-up, so nothing was checked. Give it more --frames.\n";
+			checkFailed = client.getCheckedFrames() == 0 || client.getAllocatingFrames() > 0;
+		}
+		if (headless.enabled && client.startedAwayFromSpawn()) checkFailed = true;
+	}
+
+	if (tracePath || !headless.statsPath.empty()) Metrics::writeSummary(cout);
+	if (tracePath && !Metrics::writeChromeTrace(tracePath)) cerr << "Could not write the trace to " << tracePath << "\n";
+	if (!headless.statsPath.empty()) {
+		ofstream stats(headless.statsPath);
+		Metrics::writeJson(stats);
+		if (!stats) cerr << "Could not write the stats to " << headless.statsPath << "\n";
+	}
+	return checkFailed ? 1 : 0;
+}
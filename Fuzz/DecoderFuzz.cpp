@@ -0,0 +1,457 @@
+// Fuzz target for the message decoders (Shared/Decoders.h), and for the decompressor behind PACKED.
+//
+// Built once per message, with CORPLIFE_FUZZ_MESSAGE set to its Opcode (e.g. FuzzUpdatePosition): the input is what follows
+// the command. FuzzAnyMessage is built without it and takes whole packets, command included, the way the receivers do.
+// FuzzPacketStream (CORPLIFE_FUZZ_STREAM) is a step earlier: the input is the bytes off the socket, length prefixes and all,
+// sent over a loopback connection to a PacketStream.
+//
+// Besides not crashing (run it with -DCORPLIFE_SANITIZE=address,undefined), a message a decoder accepts has to make sense:
+// finite positions, IDs that index arrays, names no longer than MAX_NAME_LENGTH, and the fixed-size ones have to encode
+// back to the bytes they came from.
+//
+// With Clang it's a libFuzzer target. Anywhere else it's built with its own main(), which replays the files given
+// (a corpus, or a crash from libFuzzer) or, with none, mutates valid messages for a while:
+//
+//   FuzzUpdatePosition [--runs N] [--seed N]   Mutate (200,000 runs by default)
+//   FuzzUpdatePosition FILE|DIR...             Replay
+//   FuzzUpdatePosition --write-seeds DIR       Write the valid messages out, as a starting corpus for libFuzzer
+
+#include "../Shared/Decoders.h"
+#include "../Shared/Compression.h"
+#include "../Shared/GameConfig.h"
+#include "../Shared/PacketStream.h"
+#include <SFML/Network.hpp>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace sf;
+
+namespace {
+
+	// Reused between runs, like the client and server reuse theirs
+	struct Scratch {
+		Packet packet;
+		string command;
+		string name;
+		vector<PlayerPositionEntry> positions;
+		vector<RosterEntry> roster;
+		WatchFrame watch;
+		Compressor decompressor;
+		vector<char> unpacked;
+		vector<char> encoded;
+	};
+
+	void check(bool condition, const char* what) {
+		if (!condition) {
+			fprintf(stderr, "Decoder accepted a bad message: %s\n", what);
+			abort();
+		}
+	}
+
+	bool isPosition(float x, float y) {
+		return std::isfinite(x) && std::isfinite(y);
+	}
+
+	// A fixed-size message encodes back to exactly the bytes it was decoded from
+	template <typename Message>
+	void checkRoundTrip(Scratch& scratch, const Message& message, size_t position) {
+		const char* received = static_cast<const char*>(scratch.packet.getData()) + position;
+		check(position + Schema::size<Message>() <= scratch.packet.getDataSize(), "decoded past the end of the packet");
+		scratch.encoded.resize(Schema::size<Message>());
+		Schema::encode(message, scratch.encoded.data());
+		check(memcmp(scratch.encoded.data(), received, scratch.encoded.size()) == 0, "doesn't encode back to the same bytes");
+	}
+
+	void checkNames(const vector<RosterEntry>& entries) {
+		for (const RosterEntry& entry : entries) {
+			check(entry.ID >= 0, "negative ID");
+			check(entry.name.size() <= MAX_NAME_LENGTH, "name too long");
+		}
+	}
+
+	void decode(Scratch& scratch, Opcode opcode) {
+		Packet& packet = scratch.packet;
+		size_t start = packet.getReadPosition();
+
+		switch (opcode) {
+		case Opcode::PlayerName:
+			if (decodePlayerName(packet, scratch.name)) check(scratch.name.size() <= MAX_NAME_LENGTH, "name too long");
+			break;
+
+		case Opcode::UpdatePosition: {
+			UpdatePositionMessage update;
+			InputEcho echo;
+			if (decodeUpdatePosition(packet, update, echo)) {
+				check(isPosition(update.x, update.y) && isPosition(update.moveX, update.moveY), "position isn't finite");
+				checkRoundTrip(scratch, update, start);
+			}
+			break;
+		}
+
+		case Opcode::Resume: {
+			ResumeMessage resume;
+			if (decodeResume(packet, resume)) checkRoundTrip(scratch, resume, start);
+			break;
+		}
+
+		case Opcode::RosterRequest: {
+			uint32_t version;
+			decodeRosterRequest(packet, version);
+			break;
+		}
+
+		case Opcode::PlayerPositions:
+			if (decodePlayerPositions(packet, scratch.positions)) {
+				check(scratch.positions.size() * Schema::size<PlayerPositionEntry>() == packet.getDataSize() - start, "entries don't fill the packet");
+				for (size_t i = 0; i < scratch.positions.size(); ++i) {
+					const PlayerPositionEntry& entry = scratch.positions[i];
+					check(entry.ID >= 0 && isPosition(entry.x, entry.y), "bad position entry");
+					checkRoundTrip(scratch, entry, start + i * Schema::size<PlayerPositionEntry>());
+				}
+			}
+			break;
+
+		case Opcode::PlayerId: {
+			PlayerIdMessage id;
+			if (decodePlayerId(packet, id)) {
+				check(id.ID >= 0, "negative ID");
+				checkRoundTrip(scratch, id, start);
+			}
+			break;
+		}
+
+		case Opcode::Spawn: {
+			SpawnMessage spawn;
+			if (decodeSpawn(packet, spawn)) {
+				check(isPosition(spawn.x, spawn.y), "position isn't finite");
+				checkRoundTrip(scratch, spawn, start);
+			}
+			break;
+		}
+
+		case Opcode::Resync: {
+			ResyncMessage resync;
+			SpawnMessage spawn;
+			if (decodeResync(packet, resync, spawn)) {
+				check(resync.ID >= 0 && resync.rainbowBall <= 2 && isPosition(resync.x, resync.y), "bad resync");
+				checkRoundTrip(scratch, resync, start);
+				if (resync.rainbowBall == 2) checkRoundTrip(scratch, spawn, start + Schema::size<ResyncMessage>());
+			}
+			break;
+		}
+
+		case Opcode::Lobby: {
+			LobbyStatus status;
+			if (decodeLobby(packet, status)) check(status <= LobbyStatus::Full, "unknown lobby status");
+			break;
+		}
+
+		case Opcode::Roster: {
+			uint32_t firstVersion;
+			if (decodeRoster(packet, firstVersion, scratch.roster)) {
+				check(!scratch.roster.empty(), "empty roster");
+				check(scratch.roster.size() - 1 <= 0xFFFFFFFFu - firstVersion, "roster version wraps");
+				checkNames(scratch.roster);
+			}
+			break;
+		}
+
+		case Opcode::RosterFull: {
+			uint32_t version;
+			if (decodeFullRoster(packet, version, scratch.roster)) checkNames(scratch.roster);
+			break;
+		}
+
+		case Opcode::Packed: {
+			uint8_t version;
+			uint32_t rawSize;
+			if (decodePackedHeader(packet, version, rawSize)) {
+				check(rawSize <= MAX_DECOMPRESSED_SIZE, "raw size over the limit");
+				const char* compressed = static_cast<const char*>(packet.getData()) + PACKED_HEADER_SIZE;
+				if (scratch.decompressor.decompress(compressed, packet.getDataSize() - PACKED_HEADER_SIZE, rawSize, scratch.unpacked)) {
+					check(scratch.unpacked.size() == rawSize, "decompressed to the wrong size");
+				}
+			}
+			break;
+		}
+
+		case Opcode::Watch:
+			if (decodeWatch(packet, scratch.watch)) {
+				checkNames(scratch.watch.players);
+				for (const RosterEntry& player : scratch.watch.players) check(isPosition(player.x, player.y), "position isn't finite");
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	// One of each message, as the real senders write them
+	vector<Packet> validMessages() {
+		vector<Packet> messages(OPCODE_COUNT);
+		auto start = [&](Opcode opcode) -> Packet& {
+			Packet& packet = messages[static_cast<size_t>(opcode)];
+			packet << opcodeName(opcode);
+			return packet;
+		};
+
+		start(Opcode::PlayerName) << "Alice";
+		Packet& update = start(Opcode::UpdatePosition);
+		Schema::append(update, UpdatePositionMessage{ 512.f, 384.f, 1.5f, -0.5f });
+		Schema::append(update, InputEcho{ 1700000000000LL, 16 });
+		Schema::append(start(Opcode::Resume), ResumeMessage{ 0x0123456789ABCDEFULL });
+		start(Opcode::RosterRequest) << static_cast<Uint32>(7);
+
+		Packet& positions = start(Opcode::PlayerPositions);
+		for (int id = 0; id < 4; ++id) Schema::append(positions, PlayerPositionEntry{ 1700000000000LL, id, 100.f * id, 50.f * id });
+		Schema::append(start(Opcode::PlayerId), PlayerIdMessage{ 3, 0x0123456789ABCDEFULL });
+		Schema::append(start(Opcode::Spawn), SpawnMessage{ 800.f, 450.f, 255, 128, 0, 5663.5f });
+		Packet& resync = start(Opcode::Resync);
+		Schema::append(resync, ResyncMessage{ 3, 200.f, 300.f, 12, 2 });
+		Schema::append(resync, SpawnMessage{ 800.f, 450.f, 255, 128, 0, 5663.5f });
+		start(Opcode::Lobby) << static_cast<Uint8>(LobbyStatus::Starting);
+
+		start(Opcode::Roster) << static_cast<Uint32>(5) << static_cast<Uint16>(3)
+			<< static_cast<Uint8>(RosterEvent::Join) << static_cast<Int32>(4) << "Bob" << static_cast<Int32>(0)
+			<< static_cast<Uint8>(RosterEvent::Score) << static_cast<Int32>(3) << static_cast<Int32>(1)
+			<< static_cast<Uint8>(RosterEvent::Leave) << static_cast<Int32>(2);
+		start(Opcode::RosterFull) << static_cast<Uint32>(7) << static_cast<Uint32>(2)
+			<< static_cast<Int32>(3) << "Alice" << static_cast<Int32>(12) << static_cast<Int32>(4) << "Bob" << static_cast<Int32>(0);
+
+		// A real compressed scoreboard
+		Packet scores;
+		scores << opcodeName(Opcode::RosterFull) << static_cast<Uint32>(7) << static_cast<Uint32>(20);
+		for (int id = 0; id < 20; ++id) scores << static_cast<Int32>(id) << ("Player" + to_string(id)) << static_cast<Int32>(id % 3);
+		Compressor compressor;
+		vector<char> compressed;
+		compressor.compress(scores.getData(), scores.getDataSize(), compressed);
+		start(Opcode::Packed) << COMPRESSION_DICTIONARY_VERSION << static_cast<Uint32>(scores.getDataSize());
+		messages[static_cast<size_t>(Opcode::Packed)].append(compressed.data(), compressed.size());
+
+		Packet& watch = start(Opcode::Watch);
+		watch << static_cast<Uint32>(42) << static_cast<Uint8>(WATCH_MATCH_IN_PROGRESS | WATCH_RAINBOW_BALL)
+			<< 800.f << 450.f << static_cast<Uint8>(255) << static_cast<Uint8>(128) << static_cast<Uint8>(0) << static_cast<Uint16>(2)
+			<< static_cast<Int32>(3) << 200.f << 300.f << static_cast<Int32>(12) << "Alice"
+			<< static_cast<Int32>(4) << 600.f << 100.f << static_cast<Int32>(0) << "Bob";
+		return messages;
+	}
+
+#ifdef CORPLIFE_FUZZ_STREAM
+	// Sends `data` down a new loopback connection and reads it back with a PacketStream. It has to hand back exactly the packets
+	// the length prefixes describe, in order, and stop with Error at a length over MAX_PACKET_SIZE instead of allocating it.
+	// Each packet then goes through the decoders like FuzzAnyMessage's.
+	void receiveStream(Scratch& scratch, const uint8_t* data, size_t size) {
+		static TcpListener listener;
+		static bool listening = listener.listen(Socket::AnyPort, IpAddress::LocalHost) == Socket::Done;
+		check(listening, "no loopback listener");
+
+		// Fuzz inputs are a few KB at most, well under the socket buffers, so the whole input is sent before anything is read.
+		// The writer closes first so the reader sees the end of the stream.
+		TcpSocket writer, reader;
+		if (writer.connect(IpAddress::LocalHost, listener.getLocalPort()) != Socket::Done || listener.accept(reader) != Socket::Done) return;
+		size_t sent = 0;
+		if (size > 0 && writer.send(data, size, sent) != Socket::Done) return;
+		writer.disconnect();
+
+		PacketStream stream(reader);
+		size_t at = 0;
+		Socket::Status status;
+		while ((status = stream.receive(scratch.packet)) == Socket::Done) {
+			check(size - at >= 4, "a packet from nothing");
+			size_t length = (static_cast<size_t>(data[at]) << 24) | (static_cast<size_t>(data[at + 1]) << 16) | (static_cast<size_t>(data[at + 2]) << 8) | data[at + 3];
+			check(length <= MAX_PACKET_SIZE, "accepted a packet over MAX_PACKET_SIZE");
+			check(length <= size - at - 4 && scratch.packet.getDataSize() == length, "packet isn't the size its prefix says");
+			check(length == 0 || memcmp(scratch.packet.getData(), data + at + 4, length) == 0, "packet isn't the bytes that were sent");
+			at += 4 + length;
+
+			// On to the decoders, as the receivers do
+			if (scratch.packet >> scratch.command) decode(scratch, opcodeFromCommand(scratch.command));
+		}
+
+		// What's left: nothing or part of a packet (the connection just ends), or a length that's too big
+		bool tooBig = size - at >= 4 && ((static_cast<size_t>(data[at]) << 24) | (static_cast<size_t>(data[at + 1]) << 16) | (static_cast<size_t>(data[at + 2]) << 8) | data[at + 3]) > MAX_PACKET_SIZE;
+		check(status == (tooBig ? Socket::Error : Socket::Disconnected), "stream ended the wrong way");
+	}
+#endif
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+	static Scratch scratch;
+	Packet& packet = scratch.packet;
+	packet.clear();
+
+#if defined(CORPLIFE_FUZZ_STREAM)
+	receiveStream(scratch, data, size);
+#elif defined(CORPLIFE_FUZZ_MESSAGE)
+	packet << opcodeName(Opcode::CORPLIFE_FUZZ_MESSAGE);
+	packet.append(data, size);
+	packet >> scratch.command;
+	decode(scratch, Opcode::CORPLIFE_FUZZ_MESSAGE);
+#else
+	packet.append(data, size);
+	if (packet >> scratch.command) decode(scratch, opcodeFromCommand(scratch.command));
+#endif
+	return 0;
+}
+
+#ifndef CORPLIFE_LIBFUZZER
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+
+namespace {
+
+	// The inputs this target takes: whole packets for FuzzAnyMessage, the stream of all of them (and a bad length) for
+	// FuzzPacketStream, otherwise its message without the command
+	vector<string> seeds() {
+		vector<string> result;
+		vector<Packet> messages = validMessages();
+#ifdef CORPLIFE_FUZZ_STREAM
+		string stream;
+		for (const Packet& message : messages) {
+			uint32_t length = static_cast<uint32_t>(message.getDataSize());
+			for (int i = 0; i < 4; ++i) stream += static_cast<char>(length >> (8 * (3 - i)));
+			stream.append(static_cast<const char*>(message.getData()), message.getDataSize());
+		}
+		result.push_back(stream);
+		result.push_back(stream.substr(0, stream.size() / 2));
+		result.push_back(string("\xFF\xFF\xFF\xFF", 4) + stream);
+#else
+		for (size_t i = 0; i < static_cast<size_t>(Opcode::Unknown); ++i) {
+			const Packet& message = messages[i];
+			const char* bytes = static_cast<const char*>(message.getData());
+#ifdef CORPLIFE_FUZZ_MESSAGE
+			if (static_cast<Opcode>(i) != Opcode::CORPLIFE_FUZZ_MESSAGE) continue;
+			size_t commandSize = 4 + strlen(opcodeName(static_cast<Opcode>(i)));
+			result.emplace_back(bytes + commandSize, message.getDataSize() - commandSize);
+#else
+			result.emplace_back(bytes, message.getDataSize());
+#endif
+		}
+#endif
+		return result;
+	}
+
+	void run(const string& input) {
+		LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t*>(input.data()), input.size());
+	}
+
+	// The kinds of damage that find decoder bugs: flipped bits, lengths and counts set to something huge, NaNs, cut short,
+	// stretched, or spliced with another message
+	void mutate(string& input, const vector<string>& corpus, mt19937& random) {
+		auto pick = [&](size_t n) { return n == 0 ? 0 : static_cast<size_t>(random() % n); };
+		static const uint32_t interesting[] = { 0, 1, 0x7F, 0x80, 0xFF, 0x7FFF, 0xFFFF, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFF, 0x7FC00000 /* NaN */, 0x7F800000 /* Infinity */ };
+
+		int mutations = 1 + static_cast<int>(pick(4));
+		for (int m = 0; m < mutations; ++m) {
+			switch (pick(7)) {
+			case 0:
+				if (!input.empty()) input[pick(input.size())] ^= static_cast<char>(1 << pick(8));
+				break;
+			case 1:
+				if (!input.empty()) input[pick(input.size())] = static_cast<char>(random());
+				break;
+			case 2:
+				input.resize(pick(input.size() + 1));
+				break;
+			case 3:
+				input.insert(pick(input.size() + 1), pick(16) + 1, static_cast<char>(random()));
+				break;
+			case 4:
+				if (input.size() >= 4) {
+					uint32_t value = interesting[pick(sizeof(interesting) / sizeof(interesting[0]))];
+					size_t at = pick(input.size() - 3);
+					for (int i = 0; i < 4; ++i) input[at + i] = static_cast<char>(value >> (8 * (3 - i)));
+				}
+				break;
+			case 5: {
+				const string& other = corpus[pick(corpus.size())];
+				size_t from = pick(other.size() + 1);
+				input = input.substr(0, pick(input.size() + 1)) + other.substr(from);
+				break;
+			}
+			default:
+				if (!input.empty()) {
+					size_t from = pick(input.size());
+					input.insert(pick(input.size() + 1), input.substr(from, pick(32) + 1));
+				}
+				break;
+			}
+		}
+	}
+
+	bool readFile(const filesystem::path& path, string& contents) {
+		ifstream file(path, ios::binary);
+		if (!file) return false;
+		contents.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+		return true;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	unsigned long runs = 200000;
+	unsigned long seed = 1;
+	vector<string> paths;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) runs = strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = strtoul(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "--write-seeds") == 0 && i + 1 < argc) {
+			filesystem::path directory = argv[++i];
+			filesystem::create_directories(directory);
+			vector<string> inputs = seeds();
+			for (size_t n = 0; n < inputs.size(); ++n) {
+				ofstream(directory / ("seed" + to_string(n)), ios::binary).write(inputs[n].data(), inputs[n].size());
+			}
+			printf("Wrote %zu seeds to %s\n", inputs.size(), directory.string().c_str());
+			return 0;
+		}
+		else if (argv[i][0] == '-') {
+			fprintf(stderr, "Usage: %s [--runs N] [--seed N] [--write-seeds DIR] [FILE|DIR...]\n", argv[0]);
+			return 1;
+		}
+		else paths.push_back(argv[i]);
+	}
+
+	// Replay
+	if (!paths.empty()) {
+		size_t replayed = 0;
+		string input;
+		for (const string& path : paths) {
+			if (filesystem::is_directory(path)) {
+				for (const auto& entry : filesystem::directory_iterator(path)) {
+					if (entry.is_regular_file() && readFile(entry.path(), input)) { run(input); replayed++; }
+				}
+			}
+			else if (readFile(path, input)) { run(input); replayed++; }
+			else fprintf(stderr, "Could not read %s\n", path.c_str());
+		}
+		printf("Replayed %zu inputs\n", replayed);
+		return 0;
+	}
+
+	// Mutate. Every input that's kept is a valid message with some damage, which gets much deeper into the decoders than
+	// random bytes would.
+	vector<string> corpus = seeds();
+	for (const string& input : corpus) run(input);
+
+	mt19937 random(static_cast<uint32_t>(seed));
+	string input;
+	for (unsigned long i = 0; i < runs; ++i) {
+		input = corpus[random() % corpus.size()];
+		mutate(input, corpus, random);
+		run(input);
+		if (i % 64 == 0 && corpus.size() < 256) corpus.push_back(input); // Damage builds up on some of them
+	}
+	printf("%lu runs, no crashes\n", runs);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,153 @@
+#include "Acceptor.h"
+#include <iostream>
+#include <algorithm>
+
+Packet lobbyPacket(LobbyStatus status) {
+	Packet packet;
+	packet << opcodeName(Opcode::Lobby) << static_cast<Uint8>(status);
+	return packet;
+}
+
+/* ------------------------ MatchInbox ------------------------ */
+
+MatchInbox::MatchInbox(size_t capacity) : capacity(capacity), free(capacity) {}
+
+bool MatchInbox::offer(unique_ptr<ClientSocket>& socket) {
+	lock_guard<mutex> guard(lock);
+	if (free == 0) return false;
+	free--;
+	pending.push_back(move(socket));
+	return true;
+}
+
+void MatchInbox::take(vector<unique_ptr<ClientSocket>>& out, size_t playersInMatch) {
+	lock_guard<mutex> guard(lock);
+	for (auto& socket : pending) out.push_back(move(socket));
+	pending.clear();
+
+	// Done under the same lock as offer(), so a connection can't slip in between taking the queue and recounting
+	size_t taken = playersInMatch + out.size();
+	free = taken < capacity ? capacity - taken : 0;
+}
+
+size_t MatchInbox::freeSlots() const {
+	lock_guard<mutex> guard(lock);
+	return free;
+}
+
+/* ------------------------ Acceptor ------------------------ */
+
+Acceptor::Acceptor(unsigned short port, const AdmissionPolicy& policy) : policy(policy), lastPrune(SteadyClock::now()) {
+	if (listener.listen(port) != Socket::Done) {
+		cerr << "Could not listen on port " << port << ".\n";
+		return;
+	}
+
+	// Non-blocking so a batch stops as soon as the backlog is empty
+	listener.setBlocking(false);
+	selector.add(listener);
+	listening = true;
+	cout << "Listening successful on port " << listener.getLocalPort() << ". Waiting for incoming connections.. \n";
+}
+
+Acceptor::Acceptor(AdoptedListener adopted, const AdmissionPolicy& policy) : policy(policy), lastPrune(SteadyClock::now()) {
+	listener.adopt(adopted.handle);
+	listener.setBlocking(false);
+	selector.add(listener);
+	listening = true;
+	cout << "Took over the listening socket on port " << listener.getLocalPort() << ".\n";
+}
+
+Acceptor::~Acceptor() {
+	stop();
+	listener.close();
+}
+
+void Acceptor::addWorker(MatchInbox& inbox) {
+	workers.push_back(&inbox);
+}
+
+void Acceptor::start() {
+	if (!listening || worker.joinable()) return;
+	stopping = false;
+	worker = thread([this] {
+		// Short waits so stop() doesn't hang around: a hot restart waits for both acceptors to stop while the match is paused.
+		// A connection still wakes it straight away, so this only costs a few idle wakeups a second.
+		while (!stopping.load(memory_order_relaxed)) acceptBatch(milliseconds(20));
+	});
+}
+
+void Acceptor::stop() {
+	stopping = true;
+	if (worker.joinable()) worker.join();
+}
+
+size_t Acceptor::acceptBatch(Time timeout) {
+	if (!selector.wait(timeout) || !selector.isReady(listener)) return 0;
+
+	TRACE_SCOPE("Acceptor::batch");
+	size_t accepted = 0;
+	while (accepted < policy.acceptBatch) {
+		auto socket = make_unique<ClientSocket>();
+		if (listener.accept(*socket) != Socket::Done) break; // NotReady: the backlog is empty
+		accepted++;
+		admit(move(socket));
+	}
+
+	METRIC_RECORD(Metrics::Histogram::AcceptBatchSize, accepted);
+	return accepted;
+}
+
+void Acceptor::admit(unique_ptr<ClientSocket> socket) {
+	SteadyClock::time_point now = SteadyClock::now();
+	if (now - lastPrune > chrono::seconds(10)) pruneBuckets(now);
+
+	// Over the rate limit: close straight away. No reply, answering a flood only helps it.
+	if (!allowedByRate(socket->getRemoteAddress().toInteger(), now)) {
+		METRIC_ADD(Metrics::Counter::ConnectionsThrottled, 1);
+		return;
+	}
+
+	for (MatchInbox* inbox : workers) {
+		if (inbox->offer(socket)) {
+			METRIC_ADD(Metrics::Counter::ConnectionsAccepted, 1);
+			return;
+		}
+	}
+
+	// Every match is full. The socket's send buffer is empty, so this small packet goes out without waiting.
+	socket->setBlocking(false);
+	Packet packet = lobbyPacket(LobbyStatus::Full);
+	size_t bytes = packet.getDataSize(); // Read before sending, SFML may modify the packet while sending
+	Socket::Status status = socket->send(packet);
+	if (status == Socket::Done) METRIC_PACKET_OUT(Opcode::Lobby, bytes);
+	else METRIC_SEND_FAILURE(status);
+	socket->disconnect();
+	METRIC_ADD(Metrics::Counter::ConnectionsRejected, 1);
+}
+
+// Token bucket per IP: refills at connectionsPerSecondPerIp up to burstPerIp, each connection takes one token
+bool Acceptor::allowedByRate(Uint32 address, SteadyClock::time_point now) {
+	auto inserted = buckets.emplace(address, RateBucket{ policy.burstPerIp, now });
+	RateBucket& bucket = inserted.first->second;
+
+	if (!inserted.second) {
+		float elapsed = chrono::duration<float>(now - bucket.refilled).count();
+		bucket.tokens = min(policy.burstPerIp, bucket.tokens + elapsed * policy.connectionsPerSecondPerIp);
+		bucket.refilled = now;
+	}
+
+	if (bucket.tokens < 1.f) return false;
+	bucket.tokens -= 1.f;
+	return true;
+}
+
+// Forget IPs whose bucket has refilled completely, they'd start from a full bucket anyway
+void Acceptor::pruneBuckets(SteadyClock::time_point now) {
+	lastPrune = now;
+	float refillSeconds = policy.burstPerIp / policy.connectionsPerSecondPerIp;
+	for (auto it = buckets.begin(); it != buckets.end();) {
+		if (chrono::duration<float>(now - it->second.refilled).count() >= refillSeconds) it = buckets.erase(it);
+		else ++it;
+	}
+}
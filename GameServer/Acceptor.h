@@ -0,0 +1,122 @@
+#ifndef ACCEPTOR_H
+#define ACCEPTOR_H
+
+#include <SFML/Network.hpp>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "../Shared/Protocol.h"
+#include "../Shared/Metrics.h"
+
+using namespace std;
+using namespace sf;
+
+// A TcpSocket with its OS handle exposed, for the scatter-gather sends in Server::flushOutbound, and a way to wrap a
+// connection another server process handed over (see Handoff.h)
+class ClientSocket : public TcpSocket {
+public:
+	using TcpSocket::getHandle;
+	void adopt(SocketHandle handle) { create(handle); }
+};
+
+// The same for the listening socket
+class ListenSocket : public TcpListener {
+public:
+	using TcpListener::getHandle;
+	void adopt(SocketHandle handle) { create(handle); }
+};
+
+// LOBBY followed by the status byte, so the client can switch on it instead of comparing strings
+Packet lobbyPacket(LobbyStatus status);
+
+// Where the acceptor leaves admitted connections for one match. The match's own thread collects them once per tick.
+//
+// Slots are reserved when a connection is offered, so the acceptor never hands a match more players than it has room for,
+// and take() recounts them from the players the match actually has (people leave between ticks).
+class MatchInbox {
+public:
+	explicit MatchInbox(size_t capacity);
+
+	// Acceptor thread: queue the socket if there's a free slot. Only moves from `socket` when it returns true.
+	bool offer(unique_ptr<ClientSocket>& socket);
+
+	// Match thread: move everything queued into `out` and recount the free slots given the players already in the match
+	void take(vector<unique_ptr<ClientSocket>>& out, size_t playersInMatch);
+
+	size_t freeSlots() const;
+
+private:
+	mutable mutex lock;
+	vector<unique_ptr<ClientSocket>> pending;
+	size_t capacity;
+	size_t free;
+};
+
+// Limits applied before a connection gets anywhere near a match
+struct AdmissionPolicy {
+	size_t acceptBatch = 64;                // Most connections taken off the backlog per wakeup
+	float connectionsPerSecondPerIp = 5.f;  // Sustained rate per IP...
+	float burstPerIp = 10.f;                // ...with this many allowed back to back (a LAN party behind one router still gets in)
+};
+
+// A listening socket handed over by the server process this one replaced (its own type so it can't be mistaken for a port)
+struct AdoptedListener {
+	SocketHandle handle;
+};
+
+// Owns the listening socket and runs on its own thread, so a connection storm is dealt with here instead of on the tick thread.
+// Each wakeup drains the listen backlog in a batch, drops IPs over the rate limit, answers LOBBY Full when every match is full
+// and hands the rest to the first match with a free slot.
+class Acceptor {
+public:
+	explicit Acceptor(unsigned short port, const AdmissionPolicy& policy = AdmissionPolicy());
+
+	// Carries on with a listening socket the previous server process handed over
+	explicit Acceptor(AdoptedListener adopted, const AdmissionPolicy& policy = AdmissionPolicy());
+	~Acceptor();
+
+	Acceptor(const Acceptor&) = delete;
+	Acceptor& operator=(const Acceptor&) = delete;
+
+	bool isListening() const { return listening; }
+	unsigned short getLocalPort() const { return listener.getLocalPort(); }
+	SocketHandle getListenerHandle() const { return listener.getHandle(); }
+
+	// Matches to hand connections to, in order of preference. Add them before start().
+	void addWorker(MatchInbox& inbox);
+
+	void start();
+	void stop();
+
+	// One wakeup of the acceptor thread: wait up to `timeout` for the listener, then accept a batch. Returns how many were accepted.
+	size_t acceptBatch(Time timeout);
+
+private:
+	using SteadyClock = chrono::steady_clock;
+
+	struct RateBucket {
+		float tokens;
+		SteadyClock::time_point refilled;
+	};
+
+	void admit(unique_ptr<ClientSocket> socket);
+	bool allowedByRate(Uint32 address, SteadyClock::time_point now);
+	void pruneBuckets(SteadyClock::time_point now);
+
+	ListenSocket listener;
+	SocketSelector selector;
+	AdmissionPolicy policy;
+	vector<MatchInbox*> workers;
+	unordered_map<Uint32, RateBucket> buckets; // Keyed by IPv4 address, only touched by the acceptor thread
+	SteadyClock::time_point lastPrune;
+	bool listening = false;
+
+	atomic<bool> stopping{ false };
+	thread worker;
+};
+
+#endif
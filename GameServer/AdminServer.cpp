@@ -0,0 +1,280 @@
+#include "AdminServer.h"
+#include "../Shared/Metrics.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+
+namespace {
+	constexpr size_t MAX_CONNECTIONS = 16;       // More than any one Prometheus and a few operators with curl need
+	constexpr size_t MAX_REQUEST_BYTES = 8192;   // The request line and headers. Nothing we serve takes a body.
+	constexpr auto REQUEST_TIMEOUT = chrono::seconds(5);
+	constexpr auto LISTEN_RETRY = chrono::seconds(1);
+
+	const char* statusText(int status) {
+		switch (status) {
+		case 200: return "OK";
+		case 400: return "Bad Request";
+		case 404: return "Not Found";
+		case 405: return "Method Not Allowed";
+		case 431: return "Request Header Fields Too Large";
+		default: return "Internal Server Error";
+		}
+	}
+
+	// Names come from the players. Anything outside printable ASCII is escaped, so one that isn't UTF-8 can't break the JSON.
+	void writeJsonString(ostream& out, const string& text) {
+		out << '"';
+		for (char c : text) {
+			unsigned char byte = static_cast<unsigned char>(c);
+			if (c == '"' || c == '\\') out << '\\' << c;
+			else if (byte < 0x20 || byte >= 0x7F) {
+				char escaped[7];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", byte);
+				out << escaped;
+			}
+			else out << c;
+		}
+		out << '"';
+	}
+}
+
+AdminServer::AdminServer(const IpAddress& address, unsigned short port, StatusBoard& board) : address(address), port(port), board(board) {
+	if (!tryListen()) cerr << "Could not listen for admin requests on " << address.toString() << ":" << port << " yet, will keep trying.\n";
+}
+
+AdminServer::~AdminServer() {
+	stop();
+	listener.close();
+}
+
+bool AdminServer::tryListen() {
+	lastListenAttempt = SteadyClock::now();
+	if (listener.listen(port, address) != Socket::Done) return false;
+
+	listener.setBlocking(false);
+	selector.add(listener);
+	listening = true;
+	cout << "Admin endpoint on http://" << address.toString() << ":" << listener.getLocalPort() << "/metrics\n";
+	return true;
+}
+
+void AdminServer::start() {
+	if (worker.joinable()) return;
+	stopping = false;
+	worker = thread([this] {
+		// Short waits, like the Acceptor's, so stop() doesn't keep a hot restart waiting
+		while (!stopping.load(memory_order_relaxed)) serve(milliseconds(50));
+	});
+}
+
+void AdminServer::stop() {
+	stopping = true;
+	if (worker.joinable()) worker.join();
+}
+
+/* ------------------------ Connections ------------------------ */
+
+void AdminServer::serve(Time timeout) {
+	// After a hot restart the old server process holds the port until it exits, so keep trying until it's ours
+	if (!listening) {
+		if (SteadyClock::now() - lastListenAttempt < LISTEN_RETRY || !tryListen()) {
+			sleep(timeout);
+			return;
+		}
+	}
+
+	// The selector only says when a socket can be read, so don't wait while a response is still going out
+	bool sending = any_of(connections.begin(), connections.end(), [](const Connection& c) { return c.sent < c.response.size(); });
+	bool ready = selector.wait(sending ? milliseconds(1) : timeout);
+
+	if (ready && selector.isReady(listener)) acceptConnections();
+
+	SteadyClock::time_point now = SteadyClock::now();
+	for (size_t i = 0; i < connections.size();) {
+		Connection& connection = connections[i];
+		if (ready && connection.response.empty() && selector.isReady(*connection.socket)) readRequest(connection);
+
+		bool keep = !connection.closed && (connection.response.empty() ? now - connection.opened < REQUEST_TIMEOUT : sendResponse(connection));
+		if (keep) {
+			++i;
+			continue;
+		}
+
+		// Done with it (or it never finished asking): close it
+		selector.remove(*connection.socket);
+		connections[i] = move(connections.back());
+		connections.pop_back();
+	}
+}
+
+void AdminServer::acceptConnections() {
+	for (;;) {
+		unique_ptr<TcpSocket> socket = make_unique<TcpSocket>();
+		if (listener.accept(*socket) != Socket::Done) return;
+		if (connections.size() >= MAX_CONNECTIONS) continue; // Closed as it goes out of scope
+
+		socket->setBlocking(false);
+		selector.add(*socket);
+		Connection connection;
+		connection.socket = move(socket);
+		connection.opened = SteadyClock::now();
+		connections.push_back(move(connection));
+	}
+}
+
+void AdminServer::readRequest(Connection& connection) {
+	char buffer[2048];
+	size_t received = 0;
+	Socket::Status status;
+	while ((status = connection.socket->receive(buffer, sizeof(buffer), received)) == Socket::Done) {
+		connection.request.append(buffer, received);
+		if (connection.request.size() > MAX_REQUEST_BYTES) {
+			respond(connection, 431, "text/plain", "Request too large\n");
+			return;
+		}
+	}
+
+	size_t headersEnd = connection.request.find("\r\n\r\n");
+	if (headersEnd == string::npos) {
+		if (status == Socket::Disconnected || status == Socket::Error) connection.closed = true; // Went away before finishing it
+		return;
+	}
+
+	// "GET /metrics HTTP/1.1". The query string is ignored.
+	size_t methodEnd = connection.request.find(' ');
+	size_t pathEnd = methodEnd == string::npos ? string::npos : connection.request.find(' ', methodEnd + 1);
+	if (pathEnd == string::npos || pathEnd > headersEnd) {
+		respond(connection, 400, "text/plain", "Bad request\n");
+		return;
+	}
+	string method = connection.request.substr(0, methodEnd);
+	string path = connection.request.substr(methodEnd + 1, pathEnd - methodEnd - 1);
+	path = path.substr(0, path.find('?'));
+	route(connection, method, path);
+}
+
+bool AdminServer::sendResponse(Connection& connection) {
+	if (connection.sent >= connection.response.size()) return false;
+
+	size_t sent = 0;
+	Socket::Status status = connection.socket->send(connection.response.data() + connection.sent, connection.response.size() - connection.sent, sent);
+	connection.sent += sent;
+	if (status == Socket::Done) return connection.sent < connection.response.size();
+	return status == Socket::Partial || status == Socket::NotReady;
+}
+
+void AdminServer::respond(Connection& connection, int status, const char* contentType, const string& body) {
+	ostringstream response;
+	response << "HTTP/1.1 " << status << " " << statusText(status) << "\r\n"
+		<< "Content-Type: " << contentType << "\r\n"
+		<< "Content-Length: " << body.size() << "\r\n";
+	if (status == 405) response << "Allow: GET\r\n";
+	response << "Connection: close\r\n\r\n" << body;
+
+	connection.response = response.str();
+	connection.sent = 0;
+}
+
+/* ------------------------ Pages ------------------------ */
+
+void AdminServer::route(Connection& connection, const string& method, const string& path) {
+	if (method != "GET") {
+		respond(connection, 405, "text/plain", "Only GET\n");
+		return;
+	}
+
+	ostringstream body;
+	if (path == "/metrics") {
+		writeMatchMetrics(body, board.latest());
+		Metrics::writePrometheus(body);
+		respond(connection, 200, "text/plain; version=0.0.4; charset=utf-8", body.str());
+	}
+	else if (path == "/metrics.json") {
+		Metrics::writeJson(body);
+		respond(connection, 200, "application/json", body.str());
+	}
+	else if (path == "/match") {
+		writeMatchJson(body, board.latest());
+		respond(connection, 200, "application/json", body.str());
+	}
+	else if (path == "/config") {
+		writeConfig(body, board.latest().config);
+		respond(connection, 200, "text/plain", body.str());
+	}
+	else if (path == "/") {
+		respond(connection, 200, "text/plain", "/metrics       Prometheus metrics\n/metrics.json  The same metrics as JSON\n/match         The match and its players as JSON\n/config        The settings in use\n");
+	}
+	else respond(connection, 404, "text/plain", "Not found\n");
+}
+
+void AdminServer::writeMatchMetrics(ostream& out, const MatchStatus& status) {
+	size_t bots = 0, queued = 0;
+	float slowestRtt = 0.f;
+	for (const PlayerStatus& player : status.players) {
+		if (player.bot) bots++;
+		else slowestRtt = max(slowestRtt, player.rttMs);
+		queued += player.queuedMessages;
+	}
+
+	// Keeps growing if the tick has stopped (or is stuck), which nothing else here would show
+	if (status.publishedAtUs != 0) {
+		out << "# TYPE corplife_status_age_seconds gauge\n";
+		out << "corplife_status_age_seconds " << (Metrics::nowMicros() - status.publishedAtUs) / 1e6 << "\n";
+	}
+	out << "# TYPE corplife_ticks_total counter\n";
+	out << "corplife_ticks_total " << status.ticks << "\n";
+	out << "# TYPE corplife_tick_work_us gauge\n";
+	out << "corplife_tick_work_us " << status.tickWorkUs << "\n";
+	out << "# TYPE corplife_tick_work_slowest_us gauge\n";
+	out << "corplife_tick_work_slowest_us " << status.slowestTickWorkUs << "\n";
+	out << "# TYPE corplife_match_in_progress gauge\n";
+	out << "corplife_match_in_progress " << (status.matchInProgress ? 1 : 0) << "\n";
+	out << "# TYPE corplife_match_seconds gauge\n";
+	out << "corplife_match_seconds " << status.matchSeconds << "\n";
+	out << "# TYPE corplife_rainbow_ball gauge\n";
+	out << "corplife_rainbow_ball " << (status.hasRainbowBall ? 1 : 0) << "\n";
+	out << "# TYPE corplife_players gauge\n";
+	out << "corplife_players{kind=\"human\"} " << status.players.size() - bots << "\n";
+	out << "corplife_players{kind=\"bot\"} " << bots << "\n";
+	out << "# TYPE corplife_spectators gauge\n";
+	out << "corplife_spectators " << status.spectators << "\n";
+	out << "# TYPE corplife_parked_sessions gauge\n";
+	out << "corplife_parked_sessions " << status.parkedSessions << "\n";
+	out << "# TYPE corplife_queued_messages gauge\n";
+	out << "corplife_queued_messages " << queued << "\n";
+	out << "# TYPE corplife_player_rtt_ms_max gauge\n";
+	out << "corplife_player_rtt_ms_max " << slowestRtt << "\n";
+}
+
+void AdminServer::writeMatchJson(ostream& out, const MatchStatus& status) {
+	uint64_t ageUs = status.publishedAtUs != 0 ? Metrics::nowMicros() - status.publishedAtUs : 0;
+
+	out << "{\n\"status_age_ms\": " << ageUs / 1000.0
+		<< ",\n\"ticks\": " << status.ticks
+		<< ",\n\"tick_work_us\": " << status.tickWorkUs
+		<< ",\n\"slowest_tick_work_us\": " << status.slowestTickWorkUs
+		<< ",\n\"match_in_progress\": " << (status.matchInProgress ? "true" : "false")
+		<< ",\n\"match_seconds\": " << status.matchSeconds
+		<< ",\n\"rainbow_ball\": ";
+	if (status.hasRainbowBall) out << "{\"x\": " << status.rainbowX << ", \"y\": " << status.rainbowY << "}";
+	else out << "null";
+	out << ",\n\"spectators\": " << status.spectators
+		<< ",\n\"parked_sessions\": " << status.parkedSessions
+		<< ",\n\"players\": [";
+
+	bool first = true;
+	for (const PlayerStatus& player : status.players) {
+		out << (first ? "" : ",") << "\n  {\"id\": " << player.ID << ", \"name\": ";
+		writeJsonString(out, player.name);
+		out << ", \"bot\": " << (player.bot ? "true" : "false")
+			<< ", \"in_match\": " << (player.inMatch ? "true" : "false")
+			<< ", \"score\": " << player.score
+			<< ", \"x\": " << player.x << ", \"y\": " << player.y
+			<< ", \"rtt_ms\": " << player.rttMs
+			<< ", \"snapshot_interval_ms\": " << player.snapshotIntervalMs
+			<< ", \"queued_messages\": " << player.queuedMessages << "}";
+		first = false;
+	}
+	out << "\n]\n}\n";
+}
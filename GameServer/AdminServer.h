@@ -0,0 +1,139 @@
+#ifndef ADMIN_SERVER_H
+#define ADMIN_SERVER_H
+
+#include <SFML/Network.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ServerConfig.h"
+
+using namespace std;
+using namespace sf;
+
+// How often the tick copies the match out for the admin endpoint. Scrapes see it at most this old.
+constexpr float ADMIN_PUBLISH_INTERVAL_MS = 100.f;
+
+// One player (or bot) as the admin endpoint shows them
+struct PlayerStatus {
+	int ID;
+	string name;
+	int score;
+	float x, y;
+	float rttMs;
+	float snapshotIntervalMs;
+	size_t queuedMessages; // Waiting in their outbound queue
+	bool bot;
+	bool inMatch;
+};
+
+// A copy of the match, made by the tick thread every ADMIN_PUBLISH_INTERVAL_MS
+struct MatchStatus {
+	uint64_t publishedAtUs = 0; // Metrics::nowMicros(), so a scrape can tell when the tick has stopped publishing
+	uint64_t ticks = 0;
+	uint64_t tickWorkUs = 0;        // How long the last tick took, not counting its wait for the sockets
+	uint64_t slowestTickWorkUs = 0; // The longest since the last copy
+	bool matchInProgress = false;
+	float matchSeconds = 0.f;
+	bool hasRainbowBall = false;
+	float rainbowX = 0.f, rainbowY = 0.f;
+	size_t spectators = 0;
+	size_t parkedSessions = 0;
+	ServerConfig config; // As it is now, after any reloads
+	vector<PlayerStatus> players;
+};
+
+// Hands the latest copy of something from one writer thread to one reader thread without either ever waiting on the other.
+//
+// Three slots: the writer fills its own and swaps it with the shared one, and the reader swaps the shared one for its own
+// whenever the writer has put a newer one there. Slots keep their storage, so once they've grown nothing is allocated.
+template <typename T>
+class TripleBuffer {
+public:
+	// Writer: fill this in (it holds whatever was in it two publishes ago), then publish()
+	T& back() { return slots[backIndex]; }
+
+	void publish() {
+		backIndex = shared.exchange(backIndex | FRESH, memory_order_acq_rel) & INDEX;
+	}
+
+	// Reader: the newest published value, or a default T if nothing has been published yet. Valid until the next call.
+	const T& latest() {
+		if (shared.load(memory_order_relaxed) & FRESH) frontIndex = shared.exchange(frontIndex, memory_order_acq_rel) & INDEX;
+		return slots[frontIndex];
+	}
+
+private:
+	static constexpr unsigned INDEX = 3;
+	static constexpr unsigned FRESH = 4; // The shared slot has been published since the reader last took it
+
+	T slots[3];
+	unsigned backIndex = 0;
+	atomic<unsigned> shared{ 1 };
+	unsigned frontIndex = 2;
+};
+
+using StatusBoard = TripleBuffer<MatchStatus>;
+
+// A small HTTP endpoint for operators, on its own port and thread, so looking at a running server never slows the tick:
+//
+//   GET /metrics       Prometheus text format: the match (players, spectators, ticks) and everything in Shared/Metrics.h
+//   GET /metrics.json  Metrics::writeJson
+//   GET /match         JSON: the match and every player in it (position, score, RTT, snapshot interval, queued messages)
+//   GET /config        The settings the server is running with, in the config file's format (see ServerConfig.h)
+//
+// It only reads the StatusBoard the tick publishes to and Metrics' shards, neither of which takes a lock. Sockets are
+// non-blocking and every connection gets one response and is closed.
+class AdminServer {
+public:
+	AdminServer(const IpAddress& address, unsigned short port, StatusBoard& board);
+	~AdminServer();
+
+	AdminServer(const AdminServer&) = delete;
+	AdminServer& operator=(const AdminServer&) = delete;
+
+	void start();
+	void stop();
+
+	// One wakeup of the admin thread: accept, read requests and send responses, waiting up to `timeout` for something to do
+	void serve(Time timeout);
+
+private:
+	using SteadyClock = chrono::steady_clock;
+
+	struct Connection {
+		unique_ptr<TcpSocket> socket;
+		string request;
+		string response;
+		size_t sent = 0;
+		SteadyClock::time_point opened;
+		bool closed = false; // By the client
+	};
+
+	bool tryListen();
+	void acceptConnections();
+	void readRequest(Connection& connection);
+	bool sendResponse(Connection& connection); // False once there's nothing left to send (or the client went away)
+	void respond(Connection& connection, int status, const char* contentType, const string& body);
+	void route(Connection& connection, const string& method, const string& path);
+	void writeMatchMetrics(ostream& out, const MatchStatus& status);
+	void writeMatchJson(ostream& out, const MatchStatus& status);
+
+	IpAddress address;
+	unsigned short port;
+	StatusBoard& board; // Only this thread reads it
+	TcpListener listener;
+	SocketSelector selector;
+	bool listening = false;
+	SteadyClock::time_point lastListenAttempt;
+	vector<Connection> connections;
+
+	atomic<bool> stopping{ false };
+	thread worker;
+};
+
+#endif
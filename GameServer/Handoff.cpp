@@ -0,0 +1,230 @@
+#include "Handoff.h"
+#include "../Shared/Logger.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+	constexpr uint32_t HANDOFF_MAGIC = 0x434c484f; // "CLHO"
+	constexpr size_t DESCRIPTORS_PER_MESSAGE = 64;
+	constexpr size_t STATE_CHUNK = 32 * 1024;
+
+	// First message: what follows. Then the descriptors, DESCRIPTORS_PER_MESSAGE at a time, then the state in STATE_CHUNK pieces.
+	// It's a SOCK_SEQPACKET socket, so every send() arrives as one message of the same size.
+	struct Header {
+		uint32_t magic;
+		uint32_t stateSize;
+		uint32_t descriptorCount;
+	};
+
+	bool socketAddress(const string& path, sockaddr_un& address) {
+		if (path.size() >= sizeof(address.sun_path)) {
+			LOG_ERROR("Handoff socket path too long: %s", path.c_str());
+			return false;
+		}
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		memcpy(address.sun_path, path.c_str(), path.size());
+		return true;
+	}
+
+	bool sendMessage(int fd, const void* data, size_t size) {
+		ssize_t sent;
+		do sent = ::send(fd, data, size, MSG_NOSIGNAL);
+		while (sent < 0 && errno == EINTR);
+		return sent == static_cast<ssize_t>(size);
+	}
+
+	bool receiveMessage(int fd, void* data, size_t size) {
+		ssize_t received;
+		do received = ::recv(fd, data, size, 0);
+		while (received < 0 && errno == EINTR);
+		return received == static_cast<ssize_t>(size);
+	}
+}
+
+HandoffChannel::~HandoffChannel() {
+	if (connection >= 0) ::close(connection);
+
+	// After a handoff the path belongs to the new server (connection is still open then), so only clean up on a normal exit
+	if (listener >= 0) {
+		::close(listener);
+		if (connection < 0) unlink(path.c_str());
+	}
+}
+
+bool HandoffChannel::listen(const string& socketPath) {
+	sockaddr_un address;
+	if (!socketAddress(socketPath, address)) return false;
+	path = socketPath;
+
+	listener = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (listener < 0) return false;
+
+	// Only one server can have the game port (the Acceptor got it first), so anything at the path is left over
+	unlink(path.c_str());
+	if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listener, 1) != 0) {
+		LOG_ERROR("Could not create the handoff socket %s: %s", path.c_str(), strerror(errno));
+		::close(listener);
+		listener = -1;
+		return false;
+	}
+	return true;
+}
+
+bool HandoffChannel::replacementWaiting() {
+	if (listener < 0) return false;
+	if (connection >= 0) return true;
+
+	// Blocking from here on: the handoff itself is the only thing happening. But not for ever: the match is frozen while we
+	// wait, so a new server that hangs or stops reading gets TIMEOUT_SECONDS per message, then we carry on without it.
+	connection = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+	if (connection < 0) return false;
+	timeval timeout = { TIMEOUT_SECONDS, 0 };
+	if (setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0 ||
+		setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) != 0) {
+		LOG_ERROR("Could not set the handoff timeout: %s", strerror(errno));
+		dropReplacement();
+		return false;
+	}
+	return true;
+}
+
+bool HandoffChannel::send(const Packet& state, const vector<int>& descriptors) {
+	Header header = { HANDOFF_MAGIC, static_cast<uint32_t>(state.getDataSize()), static_cast<uint32_t>(descriptors.size()) };
+	if (!sendMessage(connection, &header, sizeof(header))) return false;
+
+	for (size_t first = 0; first < descriptors.size(); first += DESCRIPTORS_PER_MESSAGE) {
+		size_t count = min(DESCRIPTORS_PER_MESSAGE, descriptors.size() - first);
+
+		char marker = 'F';
+		iovec payload = { &marker, 1 }; // Ancillary data has to come with at least one byte
+		alignas(cmsghdr) char control[CMSG_SPACE(DESCRIPTORS_PER_MESSAGE * sizeof(int))];
+		memset(control, 0, sizeof(control));
+
+		msghdr message = {};
+		message.msg_iov = &payload;
+		message.msg_iovlen = 1;
+		message.msg_control = control;
+		message.msg_controllen = CMSG_SPACE(count * sizeof(int));
+
+		cmsghdr* rights = CMSG_FIRSTHDR(&message);
+		rights->cmsg_level = SOL_SOCKET;
+		rights->cmsg_type = SCM_RIGHTS;
+		rights->cmsg_len = CMSG_LEN(count * sizeof(int));
+		memcpy(CMSG_DATA(rights), &descriptors[first], count * sizeof(int));
+
+		ssize_t sent;
+		do sent = sendmsg(connection, &message, MSG_NOSIGNAL);
+		while (sent < 0 && errno == EINTR);
+		if (sent != 1) return false;
+	}
+
+	const char* data = static_cast<const char*>(state.getData());
+	for (size_t offset = 0; offset < state.getDataSize(); offset += STATE_CHUNK) {
+		if (!sendMessage(connection, data + offset, min(STATE_CHUNK, state.getDataSize() - offset))) return false;
+	}
+	return true;
+}
+
+bool HandoffChannel::waitForAcknowledgement() {
+	char reply = 0;
+	if (receiveMessage(connection, &reply, 1)) return reply == 'K';
+	if (errno == EAGAIN || errno == EWOULDBLOCK) LOG_WARNING("The new server didn't take over within %d seconds", TIMEOUT_SECONDS);
+	return false;
+}
+
+void HandoffChannel::dropReplacement() {
+	if (connection >= 0) ::close(connection);
+	connection = -1;
+}
+
+bool HandoffChannel::connect(const string& socketPath) {
+	sockaddr_un address;
+	if (!socketAddress(socketPath, address)) return false;
+
+	connection = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (connection < 0 || ::connect(connection, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+		LOG_ERROR("Could not reach a running server at %s: %s", socketPath.c_str(), strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+bool HandoffChannel::receive(Packet& state, vector<int>& descriptors) {
+	Header header;
+	if (!receiveMessage(connection, &header, sizeof(header)) || header.magic != HANDOFF_MAGIC) return false;
+
+	descriptors.clear();
+	while (descriptors.size() < header.descriptorCount) {
+		char marker;
+		iovec payload = { &marker, 1 };
+		alignas(cmsghdr) char control[CMSG_SPACE(DESCRIPTORS_PER_MESSAGE * sizeof(int))];
+
+		msghdr message = {};
+		message.msg_iov = &payload;
+		message.msg_iovlen = 1;
+		message.msg_control = control;
+		message.msg_controllen = sizeof(control);
+
+		ssize_t received;
+		do received = recvmsg(connection, &message, MSG_CMSG_CLOEXEC);
+		while (received < 0 && errno == EINTR);
+		if (received != 1 || (message.msg_flags & MSG_CTRUNC)) return false;
+
+		size_t before = descriptors.size();
+		for (cmsghdr* rights = CMSG_FIRSTHDR(&message); rights; rights = CMSG_NXTHDR(&message, rights)) {
+			if (rights->cmsg_level != SOL_SOCKET || rights->cmsg_type != SCM_RIGHTS) continue;
+			size_t count = (rights->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+			descriptors.resize(descriptors.size() + count);
+			memcpy(&descriptors[descriptors.size() - count], CMSG_DATA(rights), count * sizeof(int));
+		}
+		if (descriptors.size() == before) return false;
+	}
+
+	vector<char> bytes(header.stateSize);
+	for (size_t offset = 0; offset < bytes.size(); offset += STATE_CHUNK) {
+		if (!receiveMessage(connection, bytes.data() + offset, min(STATE_CHUNK, bytes.size() - offset))) return false;
+	}
+	state.clear();
+	if (!bytes.empty()) state.append(bytes.data(), bytes.size());
+	return true;
+}
+
+bool HandoffChannel::acknowledge() {
+	char reply = 'K';
+	bool sent = sendMessage(connection, &reply, 1);
+
+	// Done with the old server. This channel can listen() for our own replacement now.
+	::close(connection);
+	connection = -1;
+	return sent;
+}
+
+#else
+
+HandoffChannel::~HandoffChannel() {}
+
+bool HandoffChannel::listen(const string&) { return false; }
+bool HandoffChannel::replacementWaiting() { return false; }
+bool HandoffChannel::send(const Packet&, const vector<int>&) { return false; }
+bool HandoffChannel::waitForAcknowledgement() { return false; }
+void HandoffChannel::dropReplacement() {}
+
+bool HandoffChannel::connect(const string&) {
+	LOG_ERROR("Hot restart needs Linux");
+	return false;
+}
+
+bool HandoffChannel::receive(Packet&, vector<int>&) { return false; }
+bool HandoffChannel::acknowledge() { return false; }
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+#include <SFML/Network.hpp>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace sf;
+
+// Hot restart: a new server process takes over from the running one without anyone being disconnected.
+//
+// The running server waits on a Unix domain socket (replacementWaiting() once a tick). A new server started with --takeover
+// connects to it, and the old one sends it the listening socket and every client's socket (as file descriptors, with
+// SCM_RIGHTS) along with the match state (Server::handOver). The TCP connections themselves never notice: the kernel keeps
+// them open as long as either process has them. Once the new server has set itself up it acknowledges, and the old one exits.
+// If the new one goes away before acknowledging, or hasn't within TIMEOUT_SECONDS, the old one carries on as if nothing
+// happened (the match is frozen meanwhile, so a hung replacement mustn't hold it forever). A new server whose acknowledgement
+// comes too late finds the channel closed and exits instead.
+//
+// Linux only. Elsewhere listen() and connect() just return false.
+class HandoffChannel {
+public:
+	static constexpr int TIMEOUT_SECONDS = 5; // Longest the running server waits on the new one, for each send and for the acknowledgement
+
+	HandoffChannel() = default;
+	~HandoffChannel();
+
+	HandoffChannel(const HandoffChannel&) = delete;
+	HandoffChannel& operator=(const HandoffChannel&) = delete;
+
+	// --- The running server ---
+
+	// Creates the socket at `path`, replacing one left behind by a server that's gone
+	bool listen(const string& path);
+
+	// True if a new server has connected. Never blocks.
+	bool replacementWaiting();
+
+	// The state and descriptors to the new server. The descriptors stay open here, in case it doesn't take them.
+	bool send(const Packet& state, const vector<int>& descriptors);
+
+	// Blocks until the new server says it has taken over (true), or it goes away or TIMEOUT_SECONDS pass (false)
+	bool waitForAcknowledgement();
+
+	// Forget the new server that didn't take over, and wait for the next one
+	void dropReplacement();
+
+	// --- The new server ---
+
+	bool connect(const string& path);
+	bool receive(Packet& state, vector<int>& descriptors);
+
+	// Tells the old server we've taken over (it exits then) and hangs up. False if it had stopped waiting for us.
+	bool acknowledge();
+
+private:
+	string path;
+	int listener = -1;
+	int connection = -1;
+};
+
+#endif
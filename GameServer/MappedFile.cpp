@@ -0,0 +1,167 @@
+#include "MappedFile.h"
+#include "../Shared/Logger.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const string& filePath, size_t minimumSize) {
+	close();
+	path = filePath;
+
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		LOG_ERROR("Could not open %s (error %lu)", path.c_str(), GetLastError());
+		return false;
+	}
+	file = handle;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(handle, &fileSize)) {
+		close();
+		return false;
+	}
+	length = static_cast<size_t>(fileSize.QuadPart);
+	if (length < minimumSize) return grow(minimumSize);
+	return map();
+}
+
+bool MappedFile::grow(size_t newSize) {
+	if (newSize <= length && base) return true;
+	unmap();
+
+	// A mapped file can't change size on Windows, hence the unmap first. The new part reads as zeros.
+	LARGE_INTEGER size;
+	size.QuadPart = static_cast<LONGLONG>(newSize);
+	if (!SetFilePointerEx(static_cast<HANDLE>(file), size, nullptr, FILE_BEGIN) || !SetEndOfFile(static_cast<HANDLE>(file))) {
+		LOG_ERROR("Could not grow %s to %zu bytes (error %lu)", path.c_str(), newSize, GetLastError());
+		return false;
+	}
+	length = newSize;
+	return map();
+}
+
+bool MappedFile::map() {
+	if (length == 0) return false;
+	mapping = CreateFileMappingA(static_cast<HANDLE>(file), nullptr, PAGE_READWRITE, 0, 0, nullptr);
+	if (!mapping) {
+		LOG_ERROR("Could not map %s (error %lu)", path.c_str(), GetLastError());
+		return false;
+	}
+	base = static_cast<char*>(MapViewOfFile(static_cast<HANDLE>(mapping), FILE_MAP_ALL_ACCESS, 0, 0, length));
+	if (!base) {
+		LOG_ERROR("Could not map %s (error %lu)", path.c_str(), GetLastError());
+		CloseHandle(static_cast<HANDLE>(mapping));
+		mapping = nullptr;
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::unmap() {
+	if (base) UnmapViewOfFile(base);
+	if (mapping) CloseHandle(static_cast<HANDLE>(mapping));
+	base = nullptr;
+	mapping = nullptr;
+}
+
+void MappedFile::sync(size_t offset, size_t bytes) {
+	if (!base || offset >= length) return;
+	if (bytes > length - offset) bytes = length - offset;
+
+	// FlushViewOfFile only hands the pages to the OS, FlushFileBuffers waits for the disk
+	FlushViewOfFile(base + offset, bytes);
+	FlushFileBuffers(static_cast<HANDLE>(file));
+}
+
+void MappedFile::close() {
+	unmap();
+	if (file) CloseHandle(static_cast<HANDLE>(file));
+	file = nullptr;
+	length = 0;
+}
+
+#else
+
+bool MappedFile::open(const string& filePath, size_t minimumSize) {
+	close();
+	path = filePath;
+
+	fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		LOG_ERROR("Could not open %s: %s", path.c_str(), strerror(errno));
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(fd, &status) != 0) {
+		close();
+		return false;
+	}
+	length = static_cast<size_t>(status.st_size);
+	if (length < minimumSize) return grow(minimumSize);
+	return map();
+}
+
+bool MappedFile::grow(size_t newSize) {
+	if (newSize <= length && base) return true;
+	unmap();
+
+	// ftruncate leaves a hole that reads as zeros, so growing doesn't write anything yet
+	if (ftruncate(fd, static_cast<off_t>(newSize)) != 0) {
+		LOG_ERROR("Could not grow %s to %zu bytes: %s", path.c_str(), newSize, strerror(errno));
+		return false;
+	}
+	length = newSize;
+	return map();
+}
+
+bool MappedFile::map() {
+	if (length == 0) return false;
+	void* address = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (address == MAP_FAILED) {
+		LOG_ERROR("Could not map %s: %s", path.c_str(), strerror(errno));
+		return false;
+	}
+	base = static_cast<char*>(address);
+	return true;
+}
+
+void MappedFile::unmap() {
+	if (base) munmap(base, length);
+	base = nullptr;
+}
+
+void MappedFile::sync(size_t offset, size_t bytes) {
+	if (!base || offset >= length) return;
+	if (bytes > length - offset) bytes = length - offset;
+
+	// msync wants a page aligned start
+	static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size_t start = offset / pageSize * pageSize;
+	msync(base + start, bytes + (offset - start), MS_SYNC);
+}
+
+void MappedFile::close() {
+	unmap();
+	if (fd >= 0) ::close(fd);
+	fd = -1;
+	length = 0;
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+using namespace std;
+
+// A file mapped into memory read/write, so PlayerStore can use what's on disk in place instead of reading it in.
+// mmap on Linux/macOS, a file mapping on Windows. Changes reach the file through the page cache, so they survive the
+// process crashing; sync() is only needed to get them onto the disk itself (power cut, OS crash).
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Opens the file, creating it if it doesn't exist, and maps all of it. Files smaller than `minimumSize` (e.g. just
+	// created) are grown to it first, with the new part zeroed.
+	bool open(const string& path, size_t minimumSize);
+	void close();
+
+	// Grows the file (zero filled) and maps it again. data() moves, so pointers into the old mapping are no longer valid.
+	bool grow(size_t newSize);
+
+	// Blocks until [offset, offset + length) is on the disk
+	void sync(size_t offset, size_t length);
+	void syncAll() { sync(0, length); }
+
+	bool isOpen() const { return base != nullptr; }
+	char* data() const { return base; }
+	size_t size() const { return length; }
+
+private:
+	bool map();
+	void unmap();
+
+	string path;
+	char* base = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	void* file = nullptr;    // HANDLE
+	void* mapping = nullptr; // HANDLE
+#else
+	int fd = -1;
+#endif
+};
+
+#endif
@@ -0,0 +1,196 @@
+#include "MessagePool.h"
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <cerrno>
+#endif
+
+using namespace std;
+
+/* ------------------------ MessageRef ------------------------ */
+
+MessageRef::MessageRef(MessageBuffer* buffer) : buffer(buffer) {
+	if (buffer) buffer->references.fetch_add(1, memory_order_relaxed);
+}
+
+MessageRef::MessageRef(const MessageRef& other) : buffer(other.buffer) {
+	if (buffer) buffer->references.fetch_add(1, memory_order_relaxed);
+}
+
+MessageRef::MessageRef(MessageRef&& other) noexcept : buffer(other.buffer) {
+	other.buffer = nullptr;
+}
+
+MessageRef& MessageRef::operator=(const MessageRef& other) {
+	if (this != &other) {
+		if (other.buffer) other.buffer->references.fetch_add(1, memory_order_relaxed);
+		release();
+		buffer = other.buffer;
+	}
+	return *this;
+}
+
+MessageRef& MessageRef::operator=(MessageRef&& other) noexcept {
+	if (this != &other) {
+		release();
+		buffer = other.buffer;
+		other.buffer = nullptr;
+	}
+	return *this;
+}
+
+MessageRef::~MessageRef() {
+	release();
+}
+
+void MessageRef::release() {
+	if (buffer && buffer->references.fetch_sub(1, memory_order_acq_rel) == 1) buffer->pool->recycle(buffer);
+	buffer = nullptr;
+}
+
+/* ------------------------ MessagePool ------------------------ */
+
+MessagePool::MessagePool(size_t bufferCapacity, size_t preallocate) : bufferCapacity(bufferCapacity) {
+	for (size_t i = 0; i < preallocate; ++i) {
+		buffers.push_back(make_unique<MessageBuffer>());
+		buffers.back()->pool = this;
+		buffers.back()->bytes.reserve(bufferCapacity);
+		freeBuffers.push_back(buffers.back().get());
+	}
+}
+
+MessageBuffer* MessagePool::acquire() {
+	MessageBuffer* buffer;
+	if (freeBuffers.empty()) {
+		// Only happens while the pool grows to the number of messages in flight
+		buffers.push_back(make_unique<MessageBuffer>());
+		buffer = buffers.back().get();
+		buffer->pool = this;
+		buffer->bytes.reserve(bufferCapacity);
+		freeBuffers.reserve(buffers.size());
+	}
+	else {
+		buffer = freeBuffers.back();
+		freeBuffers.pop_back();
+	}
+	return buffer;
+}
+
+MessageRef MessagePool::encode(const void* payload, size_t size) {
+	MessageBuffer* buffer = acquire();
+
+	// Same framing as sf::TcpSocket::send(Packet&): 4 byte big-endian size, then the data
+	uint32_t length = static_cast<uint32_t>(size);
+	buffer->bytes.resize(sizeof(length) + size);
+	buffer->bytes[0] = static_cast<char>(length >> 24);
+	buffer->bytes[1] = static_cast<char>(length >> 16);
+	buffer->bytes[2] = static_cast<char>(length >> 8);
+	buffer->bytes[3] = static_cast<char>(length);
+	if (size > 0) memcpy(&buffer->bytes[sizeof(length)], payload, size);
+
+	return MessageRef(buffer);
+}
+
+MessageRef MessagePool::copyFramed(const void* bytes, size_t size) {
+	MessageBuffer* buffer = acquire();
+	const char* begin = static_cast<const char*>(bytes);
+	buffer->bytes.assign(begin, begin + size);
+	return MessageRef(buffer);
+}
+
+void MessagePool::recycle(MessageBuffer* buffer) {
+	freeBuffers.push_back(buffer);
+}
+
+/* ------------------------ OutboundQueue ------------------------ */
+
+bool OutboundQueue::push(MessageRef message) {
+	if (count == CAPACITY) return false;
+	messages[(head + count) % CAPACITY] = move(message);
+	count++;
+	return true;
+}
+
+size_t OutboundQueue::gather(ConstBuffer* out, size_t max) const {
+	size_t filled = 0;
+	for (; filled < count && filled < max; ++filled) {
+		const MessageRef& message = messages[(head + filled) % CAPACITY];
+		size_t offset = filled == 0 ? headOffset : 0;
+		out[filled] = { message.data() + offset, message.size() - offset };
+	}
+	return filled;
+}
+
+void OutboundQueue::consume(size_t bytes) {
+	while (bytes > 0 && count > 0) {
+		MessageRef& message = messages[head];
+		size_t remaining = message.size() - headOffset;
+
+		if (bytes < remaining) {
+			headOffset += bytes;
+			return;
+		}
+
+		bytes -= remaining;
+		message = MessageRef(); // Give the buffer back once every recipient is done with it
+		head = (head + 1) % CAPACITY;
+		count--;
+		headOffset = 0;
+	}
+}
+
+void OutboundQueue::clear() {
+	while (count > 0) {
+		messages[head] = MessageRef();
+		head = (head + 1) % CAPACITY;
+		count--;
+	}
+	head = 0;
+	headOffset = 0;
+}
+
+#ifdef __linux__
+
+OutboundQueue::FlushResult OutboundQueue::flush(int fd) {
+	constexpr size_t MAX_IOVECS = 64;
+
+	while (count > 0) {
+		ConstBuffer pieces[MAX_IOVECS];
+		iovec vectors[MAX_IOVECS];
+		size_t pieceCount = gather(pieces, MAX_IOVECS);
+
+		size_t total = 0;
+		for (size_t i = 0; i < pieceCount; ++i) {
+			vectors[i].iov_base = const_cast<char*>(pieces[i].data);
+			vectors[i].iov_len = pieces[i].size;
+			total += pieces[i].size;
+		}
+
+		// MSG_DONTWAIT: never block the tick, whatever mode the socket is in. MSG_NOSIGNAL: no SIGPIPE on a dead client.
+		// The common case is a single message, where a plain send() is cheaper than building a msghdr.
+		ssize_t sent;
+		if (pieceCount == 1) {
+			sent = send(fd, pieces[0].data, pieces[0].size, MSG_DONTWAIT | MSG_NOSIGNAL);
+		}
+		else {
+			msghdr header = {};
+			header.msg_iov = vectors;
+			header.msg_iovlen = pieceCount;
+			sent = sendmsg(fd, &header, MSG_DONTWAIT | MSG_NOSIGNAL);
+		}
+		if (sent < 0) {
+			if (errno == EINTR) continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK) return FlushResult::WouldBlock;
+			if (errno == EPIPE || errno == ECONNRESET) return FlushResult::Disconnected;
+			return FlushResult::Error;
+		}
+
+		consume(static_cast<size_t>(sent));
+		if (static_cast<size_t>(sent) < total) return FlushResult::WouldBlock;
+	}
+	return FlushResult::Done;
+}
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef MESSAGE_POOL_H
+#define MESSAGE_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Outgoing messages for the server.
+//
+// A message is encoded once into a pooled buffer that already holds exactly what goes on the wire (the same 4 byte
+// big-endian size prefix sf::TcpSocket::send(Packet&) adds, then the packet data). Every recipient's OutboundQueue
+// holds a reference to that one buffer, so broadcasting to N clients is one copy rather than N. Once the last queue has
+// sent it, the buffer goes back to the pool.
+//
+// The pool itself is used from the tick thread only.
+
+class MessagePool;
+
+struct MessageBuffer {
+	std::vector<char> bytes;
+	std::atomic<uint32_t> references{ 0 };
+	MessagePool* pool = nullptr;
+};
+
+// Reference counted handle to a pooled message
+class MessageRef {
+public:
+	MessageRef() = default;
+	explicit MessageRef(MessageBuffer* buffer);
+	MessageRef(const MessageRef& other);
+	MessageRef(MessageRef&& other) noexcept;
+	MessageRef& operator=(const MessageRef& other);
+	MessageRef& operator=(MessageRef&& other) noexcept;
+	~MessageRef();
+
+	const char* data() const { return buffer->bytes.data(); }
+	size_t size() const { return buffer->bytes.size(); }
+	uint32_t useCount() const { return buffer ? buffer->references.load(std::memory_order_relaxed) : 0; }
+	explicit operator bool() const { return buffer != nullptr; }
+
+private:
+	void release();
+
+	MessageBuffer* buffer = nullptr;
+};
+
+class MessagePool {
+public:
+	// Buffers start with room for bufferCapacity bytes, and `preallocate` of them are created up front
+	explicit MessagePool(size_t bufferCapacity = 1024, size_t preallocate = 64);
+
+	MessagePool(const MessagePool&) = delete;
+	MessagePool& operator=(const MessagePool&) = delete;
+
+	// Copies the payload into a free buffer behind the length prefix
+	MessageRef encode(const void* payload, size_t size);
+
+	// Copies bytes that are already framed as they go on the wire (what's left of a previous server process's queue)
+	MessageRef copyFramed(const void* bytes, size_t size);
+
+	size_t freeCount() const { return freeBuffers.size(); }
+	size_t totalCount() const { return buffers.size(); }
+
+private:
+	friend class MessageRef;
+	void recycle(MessageBuffer* buffer);
+	MessageBuffer* acquire();
+
+	std::vector<std::unique_ptr<MessageBuffer>> buffers;
+	std::vector<MessageBuffer*> freeBuffers;
+	size_t bufferCapacity;
+};
+
+// One piece of a message still waiting to be sent
+struct ConstBuffer {
+	const char* data;
+	size_t size;
+};
+
+// Messages waiting to go out to one client, oldest first. Fixed size ring, so queueing never allocates.
+class OutboundQueue {
+public:
+	static constexpr size_t CAPACITY = 256;
+
+	OutboundQueue() : messages(CAPACITY) {}
+
+	// False if the queue is full (the client isn't reading)
+	bool push(MessageRef message);
+
+	bool empty() const { return count == 0; }
+	size_t depth() const { return count; }
+
+	// Fills `out` with the unsent parts of up to `max` queued messages (for writev / sendmsg). Returns how many were filled.
+	size_t gather(ConstBuffer* out, size_t max) const;
+
+	// Marks `bytes` as sent, releasing messages that are now fully sent
+	void consume(size_t bytes);
+
+	void clear();
+
+#ifdef __linux__
+	enum class FlushResult {
+		Done,         // Everything queued was sent
+		WouldBlock,   // The socket buffer is full, the rest stays queued
+		Disconnected,
+		Error
+	};
+
+	// Sends as much as the socket will take right now with scatter-gather sendmsg calls, never blocking
+	FlushResult flush(int fd);
+#endif
+
+private:
+	std::vector<MessageRef> messages;
+	size_t head = 0;
+	size_t count = 0;
+	size_t headOffset = 0; // Bytes of the first message already sent
+};
+
+#endif
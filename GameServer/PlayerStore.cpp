@@ -0,0 +1,644 @@
+#include "PlayerStore.h"
+#include "../Shared/Logger.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+	constexpr uint32_t STORE_VERSION = 1;
+	constexpr size_t HEADER_SIZE = 64;
+	constexpr size_t INITIAL_RECORDS = 1024;
+	constexpr uint64_t INITIAL_BUCKETS = 4096; // Hash table slots. Kept at least twice the number of profiles.
+
+	const char PROFILES_MAGIC[8] = { 'C', 'L', 'P', 'R', 'O', 'F', 'I', 'L' };
+	const char MATCHES_MAGIC[8] = { 'C', 'L', 'M', 'A', 'T', 'C', 'H', 'S' };
+	const char INDEX_MAGIC[8] = { 'C', 'L', 'I', 'N', 'D', 'E', 'X', '_' };
+
+	uint32_t fnv32(const void* data, size_t size) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		uint32_t hash = 2166136261u;
+		for (size_t i = 0; i < size; ++i) hash = (hash ^ bytes[i]) * 16777619u;
+		return hash;
+	}
+
+	uint64_t fnv64(const char* data, size_t size) {
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < size; ++i) hash = (hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ull;
+		return hash;
+	}
+
+	// Checksum of a record with its checksum field zeroed. A record that was never written (all zeros) doesn't pass.
+	template <typename Record>
+	uint32_t checksumOf(Record record) {
+		record.checksum = 0;
+		return fnv32(&record, sizeof(record));
+	}
+
+	template <typename Record>
+	void seal(Record& record) {
+		record.checksum = checksumOf(record);
+	}
+
+	template <typename Record>
+	bool isIntact(const Record& record) {
+		return record.checksum == checksumOf(record);
+	}
+
+	// Length of a name as it's stored: up to the first zero byte, and no longer than fits in a ProfileRecord
+	size_t storedLength(const string& name) {
+		return strnlen(name.c_str(), min(name.size(), STORE_NAME_LENGTH - 1));
+	}
+
+	int64_t rankedScore(int64_t score) {
+		return min(max(score, int64_t(0)), STORE_RANKED_SCORES - 1);
+	}
+}
+
+/* ------------------------ File layout ------------------------ */
+
+// First 64 bytes of the profiles and matches files. The records follow.
+struct PlayerStore::FileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t recordSize;
+	uint64_t count; // Records written. Set after the record itself, so a record is never counted before it's there.
+	uint32_t clean; // 1 once closed properly, 0 while open
+	uint8_t reserved[36];
+};
+
+// First 64 bytes of the index file, followed by the top players, the rank tree and the hash table
+struct PlayerStore::IndexHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t clean;
+	uint64_t profileCount; // Profiles indexed so far
+	uint64_t bucketCount;  // Hash table slots, a power of two
+	uint32_t topCount;     // Entries used in the top players list
+	uint8_t reserved[28];
+};
+
+struct PlayerStore::TopEntry {
+	uint32_t profileID;
+	uint32_t reserved;
+	int64_t score;
+};
+
+namespace {
+	constexpr size_t TOP_ENTRY_SIZE = 16;
+	constexpr size_t TOP_OFFSET = HEADER_SIZE;
+	constexpr size_t RANK_OFFSET = TOP_OFFSET + STORE_TOP_PLAYERS * TOP_ENTRY_SIZE;
+	constexpr size_t BUCKET_OFFSET = (RANK_OFFSET + (STORE_RANKED_SCORES + 1) * sizeof(uint32_t) + 63) / 64 * 64;
+
+	size_t indexSize(uint64_t bucketCount) {
+		return BUCKET_OFFSET + static_cast<size_t>(bucketCount) * sizeof(uint32_t);
+	}
+}
+
+PlayerStore::FileHeader* PlayerStore::profileHeader() const { return reinterpret_cast<FileHeader*>(profileFile.data()); }
+PlayerStore::FileHeader* PlayerStore::matchHeader() const { return reinterpret_cast<FileHeader*>(matchFile.data()); }
+PlayerStore::IndexHeader* PlayerStore::indexHeader() const { return reinterpret_cast<IndexHeader*>(indexFile.data()); }
+ProfileRecord* PlayerStore::profiles() const { return reinterpret_cast<ProfileRecord*>(profileFile.data() + HEADER_SIZE); }
+MatchRecord* PlayerStore::matches() const { return reinterpret_cast<MatchRecord*>(matchFile.data() + HEADER_SIZE); }
+PlayerStore::TopEntry* PlayerStore::topEntries() const { return reinterpret_cast<TopEntry*>(indexFile.data() + TOP_OFFSET); }
+uint32_t* PlayerStore::rankTree() const { return reinterpret_cast<uint32_t*>(indexFile.data() + RANK_OFFSET); }
+uint32_t* PlayerStore::buckets() const { return reinterpret_cast<uint32_t*>(indexFile.data() + BUCKET_OFFSET); }
+
+/* ------------------------ Opening and closing ------------------------ */
+
+PlayerStore::~PlayerStore() {
+	close();
+}
+
+bool PlayerStore::open(const string& basePath) {
+	static_assert(sizeof(FileHeader) == HEADER_SIZE && sizeof(IndexHeader) == HEADER_SIZE, "The headers are part of the file format");
+	static_assert(sizeof(TopEntry) == TOP_ENTRY_SIZE, "TopEntry is part of the file format");
+
+	lock_guard<mutex> guard(lock);
+	if (opened) return true;
+
+	bool profilesClean = false, matchesClean = false;
+	if (!openData(profileFile, basePath + ".profiles", PROFILES_MAGIC, sizeof(ProfileRecord), profilesClean) ||
+		!openData(matchFile, basePath + ".matches", MATCHES_MAGIC, sizeof(MatchRecord), matchesClean)) {
+		profileFile.close();
+		matchFile.close();
+		return false;
+	}
+
+	// The last run didn't get to close(): check every record before trusting the counts
+	if (!profilesClean || !matchesClean) {
+		LOG_WARNING("%s wasn't shut down cleanly, checking %llu profiles and %llu matches", basePath.c_str(),
+			static_cast<unsigned long long>(profileHeader()->count), static_cast<unsigned long long>(matchHeader()->count));
+		recoverProfiles();
+		recoverMatches();
+	}
+
+	opened = true; // rebuildIndex() may fail() it again
+	if (!openIndex(basePath + ".index", profilesClean)) {
+		fail("Could not open the index");
+		return false;
+	}
+
+	LOG_INFO("Opened %s: %llu players, %llu matches", basePath.c_str(), static_cast<unsigned long long>(profileHeader()->count),
+		static_cast<unsigned long long>(matchHeader()->count));
+	return true;
+}
+
+bool PlayerStore::openData(MappedFile& file, const string& path, const char* magic, size_t recordSize, bool& clean) {
+	if (!file.open(path, HEADER_SIZE + INITIAL_RECORDS * recordSize)) return false;
+	FileHeader* header = reinterpret_cast<FileHeader*>(file.data());
+
+	// A new (zero filled) file
+	if (header->magic[0] == 0) {
+		memcpy(header->magic, magic, sizeof(header->magic));
+		header->version = STORE_VERSION;
+		header->recordSize = static_cast<uint32_t>(recordSize);
+		header->count = 0;
+		header->clean = 1;
+	}
+	else if (memcmp(header->magic, magic, sizeof(header->magic)) != 0 || header->version != STORE_VERSION || header->recordSize != recordSize) {
+		// Not ours, or another version's. Leave it alone rather than overwrite someone's data.
+		LOG_ERROR("%s isn't a version %u store file", path.c_str(), STORE_VERSION);
+		file.close();
+		return false;
+	}
+
+	uint64_t capacity = (file.size() - HEADER_SIZE) / recordSize;
+	clean = header->clean == 1 && header->count <= capacity;
+
+	// Marked as open before anything else is written, so a crash from here on is noticed next time
+	header->clean = 0;
+	file.sync(0, HEADER_SIZE);
+	return true;
+}
+
+// The index is only trusted if it was closed cleanly along with the profiles it indexes. Otherwise it's built again.
+bool PlayerStore::openIndex(const string& path, bool dataWasClean) {
+	if (!indexFile.open(path, indexSize(INITIAL_BUCKETS))) return false;
+	IndexHeader* header = indexHeader();
+	uint64_t profileCount = profileHeader()->count;
+
+	bool usable = dataWasClean && memcmp(header->magic, INDEX_MAGIC, sizeof(header->magic)) == 0 && header->version == STORE_VERSION &&
+		header->clean == 1 && header->profileCount == profileCount && header->bucketCount >= INITIAL_BUCKETS &&
+		(header->bucketCount & (header->bucketCount - 1)) == 0 && indexFile.size() >= indexSize(header->bucketCount) &&
+		header->topCount <= STORE_TOP_PLAYERS;
+
+	if (!usable) {
+		uint64_t bucketCount = INITIAL_BUCKETS;
+		while (bucketCount < profileCount * 2) bucketCount *= 2;
+		if (header->magic[0] != 0) LOG_WARNING("Rebuilding %s from %llu profiles", path.c_str(), static_cast<unsigned long long>(profileCount));
+		if (!rebuildIndex(bucketCount)) return false;
+		header = indexHeader();
+	}
+
+	header->clean = 0;
+	indexFile.sync(0, HEADER_SIZE);
+	return true;
+}
+
+// Profiles damaged by the crash are cleared (the player starts again next time they join). Profiles appended after the
+// header's count was last written are picked up.
+void PlayerStore::recoverProfiles() {
+	FileHeader* header = profileHeader();
+	ProfileRecord* records = profiles();
+	uint64_t capacity = (profileFile.size() - HEADER_SIZE) / sizeof(ProfileRecord);
+	uint64_t count = min(header->count, capacity);
+
+	uint64_t damaged = 0;
+	for (uint64_t i = 0; i < count; ++i) {
+		if (isIntact(records[i])) continue;
+		memset(&records[i], 0, sizeof(ProfileRecord));
+		seal(records[i]);
+		damaged++;
+	}
+	while (count < capacity && isIntact(records[count])) count++;
+
+	if (damaged) LOG_WARNING("Cleared %llu damaged profiles", static_cast<unsigned long long>(damaged));
+	header->count = count;
+}
+
+// Same for matches. A damaged match is kept as one with no players, so the ones after it keep their positions.
+void PlayerStore::recoverMatches() {
+	FileHeader* header = matchHeader();
+	MatchRecord* records = matches();
+	uint64_t capacity = (matchFile.size() - HEADER_SIZE) / sizeof(MatchRecord);
+	uint64_t count = min(header->count, capacity);
+
+	uint64_t damaged = 0;
+	for (uint64_t i = 0; i < count; ++i) {
+		if (isIntact(records[i])) continue;
+		memset(&records[i], 0, sizeof(MatchRecord));
+		seal(records[i]);
+		damaged++;
+	}
+	while (count < capacity && isIntact(records[count])) count++;
+
+	if (damaged) LOG_WARNING("Cleared %llu damaged match results", static_cast<unsigned long long>(damaged));
+	header->count = count;
+}
+
+// Starts the index again from the profiles, with `bucketCount` hash table slots. Also how the hash table grows.
+bool PlayerStore::rebuildIndex(uint64_t bucketCount) {
+	size_t size = indexSize(bucketCount);
+	if (indexFile.size() < size && !indexFile.grow(size)) return false;
+	memset(indexFile.data(), 0, size);
+
+	IndexHeader* header = indexHeader();
+	memcpy(header->magic, INDEX_MAGIC, sizeof(header->magic));
+	header->version = STORE_VERSION;
+	header->bucketCount = bucketCount;
+
+	const ProfileRecord* records = profiles();
+	uint64_t profileCount = profileHeader()->count;
+	for (uint64_t i = 0; i < profileCount; ++i) {
+		if (records[i].name[0] == 0) continue;
+		uint32_t profileID = static_cast<uint32_t>(i);
+		insertIntoIndex(profileID);
+		addToRanks(records[i].lifetimeScore, 1);
+		insertTopPlayer(profileID, records[i].lifetimeScore);
+	}
+	header->profileCount = profileCount;
+	dirty = true;
+	return true;
+}
+
+void PlayerStore::close() {
+	lock_guard<mutex> guard(lock);
+	if (!opened) return;
+
+	// Everything else first, so the clean flags never reach the disk ahead of the data they vouch for
+	profileFile.syncAll();
+	matchFile.syncAll();
+	indexFile.syncAll();
+
+	profileHeader()->clean = 1;
+	matchHeader()->clean = 1;
+	indexHeader()->clean = 1;
+	profileFile.sync(0, HEADER_SIZE);
+	matchFile.sync(0, HEADER_SIZE);
+	indexFile.sync(0, HEADER_SIZE);
+
+	profileFile.close();
+	matchFile.close();
+	indexFile.close();
+	opened = false;
+	dirty = false;
+}
+
+// Something couldn't be written (usually a full disk). Stop using the files without marking them clean, so the next
+// open() checks them.
+void PlayerStore::fail(const char* what) {
+	LOG_ERROR("%s, the player store is switched off until the server restarts", what);
+	profileFile.close();
+	matchFile.close();
+	indexFile.close();
+	opened = false;
+}
+
+bool PlayerStore::isOpen() const {
+	lock_guard<mutex> guard(lock);
+	return opened;
+}
+
+void PlayerStore::sync() {
+	lock_guard<mutex> guard(lock);
+	if (!opened || !dirty) return;
+	profileFile.syncAll();
+	matchFile.syncAll();
+	indexFile.syncAll();
+	dirty = false;
+}
+
+/* ------------------------ Changes ------------------------ */
+
+// Makes room for one more record, doubling the file when it's full
+bool PlayerStore::reserveRecord(MappedFile& file, size_t recordSize) {
+	uint64_t count = reinterpret_cast<FileHeader*>(file.data())->count;
+	uint64_t capacity = (file.size() - HEADER_SIZE) / recordSize;
+	if (count < capacity) return true;
+	return file.grow(HEADER_SIZE + static_cast<size_t>(capacity * 2) * recordSize);
+}
+
+uint32_t PlayerStore::addPlayer(const string& name, int64_t nowUnixMs) {
+	lock_guard<mutex> guard(lock);
+	size_t length = storedLength(name);
+	if (!opened || length == 0) return NO_PROFILE;
+	dirty = true;
+
+	int64_t existing = findProfile(name.c_str(), length);
+	if (existing >= 0) {
+		ProfileRecord& record = profiles()[existing];
+		record.lastSeenUnixMs = nowUnixMs;
+		seal(record);
+		return static_cast<uint32_t>(existing);
+	}
+
+	if (!reserveRecord(profileFile, sizeof(ProfileRecord))) {
+		fail("Could not grow the profiles file");
+		return NO_PROFILE;
+	}
+
+	FileHeader* header = profileHeader();
+	uint32_t profileID = static_cast<uint32_t>(header->count);
+	ProfileRecord& record = profiles()[profileID];
+	memset(&record, 0, sizeof(record));
+	memcpy(record.name, name.c_str(), length);
+	record.lastSeenUnixMs = nowUnixMs;
+	seal(record);
+	header->count = profileID + 1;
+
+	// Keep the hash table at most half full
+	IndexHeader* index = indexHeader();
+	if ((uint64_t(profileID) + 1) * 2 > index->bucketCount) {
+		if (!rebuildIndex(index->bucketCount * 2)) {
+			fail("Could not grow the index");
+			return NO_PROFILE;
+		}
+	}
+	else {
+		insertIntoIndex(profileID);
+		addToRanks(0, 1);
+		insertTopPlayer(profileID, 0);
+		index->profileCount = profileID + 1;
+	}
+	return profileID;
+}
+
+void PlayerStore::addScore(uint32_t profileID, int64_t change) {
+	lock_guard<mutex> guard(lock);
+	if (!opened || change <= 0 || profileID >= profileHeader()->count) return;
+
+	ProfileRecord& record = profiles()[profileID];
+	if (record.name[0] == 0) return;
+	int64_t before = record.lifetimeScore;
+	record.lifetimeScore += change;
+	seal(record);
+
+	if (rankedScore(before) != rankedScore(record.lifetimeScore)) {
+		addToRanks(before, -1);
+		addToRanks(record.lifetimeScore, 1);
+	}
+	updateTopPlayers(profileID, record.lifetimeScore);
+	dirty = true;
+}
+
+void PlayerStore::addMatch(uint32_t durationMs, vector<pair<uint32_t, int32_t>> results, int64_t nowUnixMs) {
+	lock_guard<mutex> guard(lock);
+	if (!opened) return;
+	dirty = true;
+
+	results.erase(remove_if(results.begin(), results.end(), [this](const pair<uint32_t, int32_t>& result) {
+		return result.first >= profileHeader()->count;
+	}), results.end());
+	stable_sort(results.begin(), results.end(), [](const pair<uint32_t, int32_t>& a, const pair<uint32_t, int32_t>& b) { return a.second > b.second; });
+
+	// Everyone on the top score wins, unless nobody scored at all
+	int32_t winningScore = results.empty() ? 0 : results.front().second;
+	for (const auto& result : results) {
+		ProfileRecord& record = profiles()[result.first];
+		record.matchesPlayed++;
+		if (winningScore > 0 && result.second == winningScore) record.matchesWon++;
+		record.bestMatchScore = max(record.bestMatchScore, result.second);
+		seal(record);
+	}
+
+	if (!reserveRecord(matchFile, sizeof(MatchRecord))) {
+		fail("Could not grow the matches file");
+		return;
+	}
+
+	FileHeader* header = matchHeader();
+	MatchRecord& record = matches()[header->count];
+	memset(&record, 0, sizeof(record));
+	record.endedUnixMs = nowUnixMs;
+	record.durationMs = durationMs;
+	record.playerCount = static_cast<uint32_t>(min(results.size(), STORE_MATCH_PLAYERS));
+	for (uint32_t i = 0; i < record.playerCount; ++i) {
+		record.players[i].profileID = results[i].first;
+		record.players[i].score = results[i].second;
+	}
+	seal(record);
+	header->count++;
+}
+
+/* ------------------------ Index ------------------------ */
+
+// Open addressing with linear probing. Each slot holds a profile ID + 1, so 0 is an empty slot.
+int64_t PlayerStore::findProfile(const char* name, size_t length) const {
+	const uint32_t* slots = buckets();
+	const ProfileRecord* records = profiles();
+	uint64_t mask = indexHeader()->bucketCount - 1;
+
+	for (uint64_t slot = fnv64(name, length) & mask; slots[slot] != 0; slot = (slot + 1) & mask) {
+		const ProfileRecord& record = records[slots[slot] - 1];
+		if (record.name[length] == 0 && memcmp(record.name, name, length) == 0) return slots[slot] - 1;
+	}
+	return -1;
+}
+
+void PlayerStore::insertIntoIndex(uint32_t profileID) {
+	uint32_t* slots = buckets();
+	const ProfileRecord& record = profiles()[profileID];
+	uint64_t mask = indexHeader()->bucketCount - 1;
+
+	uint64_t slot = fnv64(record.name, strnlen(record.name, STORE_NAME_LENGTH)) & mask;
+	while (slots[slot] != 0) slot = (slot + 1) & mask;
+	slots[slot] = profileID + 1;
+}
+
+// Fenwick tree over lifetime scores: entry i covers a range of scores ending at i - 1, so adding up log(n) entries gives
+// how many players are on a score up to a given one
+void PlayerStore::addToRanks(int64_t score, int32_t change) {
+	uint32_t* tree = rankTree();
+	for (int64_t i = rankedScore(score) + 1; i <= STORE_RANKED_SCORES; i += i & -i) tree[i] += static_cast<uint32_t>(change);
+}
+
+uint64_t PlayerStore::playersAbove(int64_t score) const {
+	const uint32_t* tree = rankTree();
+	uint64_t upToScore = 0;
+	for (int64_t i = rankedScore(score) + 1; i > 0; i -= i & -i) upToScore += tree[i];
+	return tree[STORE_RANKED_SCORES] - upToScore; // The last entry covers every score
+}
+
+// Scores only go up, so a player already in the list moves up it, and one that isn't can only come in at the bottom
+void PlayerStore::updateTopPlayers(uint32_t profileID, int64_t score) {
+	IndexHeader* header = indexHeader();
+	TopEntry* top = topEntries();
+
+	uint32_t position = 0;
+	while (position < header->topCount && top[position].profileID != profileID) position++;
+	if (position == header->topCount) {
+		insertTopPlayer(profileID, score);
+		return;
+	}
+
+	top[position].score = score;
+	for (; position > 0 && top[position - 1].score < top[position].score; --position) swap(top[position - 1], top[position]);
+}
+
+// For a player who isn't in the list yet. Players on the same score stay in the order they got there.
+void PlayerStore::insertTopPlayer(uint32_t profileID, int64_t score) {
+	IndexHeader* header = indexHeader();
+	TopEntry* top = topEntries();
+
+	uint32_t position;
+	if (header->topCount < STORE_TOP_PLAYERS) position = header->topCount++;
+	else if (score > top[STORE_TOP_PLAYERS - 1].score) position = STORE_TOP_PLAYERS - 1;
+	else return;
+
+	top[position].profileID = profileID;
+	top[position].score = score;
+	for (; position > 0 && top[position - 1].score < top[position].score; --position) swap(top[position - 1], top[position]);
+}
+
+/* ------------------------ Queries ------------------------ */
+
+void PlayerStore::summarise(uint32_t profileID, PlayerSummary& out) const {
+	const ProfileRecord& record = profiles()[profileID];
+	out.profileID = profileID;
+	out.name.assign(record.name, strnlen(record.name, STORE_NAME_LENGTH));
+	out.lifetimeScore = record.lifetimeScore;
+	out.matchesPlayed = record.matchesPlayed;
+	out.matchesWon = record.matchesWon;
+	out.bestMatchScore = record.bestMatchScore;
+	out.rank = playersAbove(record.lifetimeScore) + 1;
+}
+
+bool PlayerStore::find(const string& name, PlayerSummary& out) const {
+	lock_guard<mutex> guard(lock);
+	size_t length = storedLength(name);
+	if (!opened || length == 0) return false;
+
+	int64_t profileID = findProfile(name.c_str(), length);
+	if (profileID < 0) return false;
+	summarise(static_cast<uint32_t>(profileID), out);
+	return true;
+}
+
+size_t PlayerStore::topPlayers(size_t count, vector<PlayerSummary>& out) const {
+	lock_guard<mutex> guard(lock);
+	if (!opened) {
+		out.clear();
+		return 0;
+	}
+
+	const TopEntry* top = topEntries();
+	size_t shown = min<size_t>(count, indexHeader()->topCount);
+	out.resize(shown);
+	for (size_t i = 0; i < shown; ++i) summarise(top[i].profileID, out[i]);
+	return shown;
+}
+
+bool PlayerStore::match(uint64_t index, MatchRecord& out) const {
+	lock_guard<mutex> guard(lock);
+	if (!opened || index >= matchHeader()->count) return false;
+	out = matches()[index];
+	return true;
+}
+
+uint64_t PlayerStore::playerCount() const {
+	lock_guard<mutex> guard(lock);
+	return opened ? profileHeader()->count : 0;
+}
+
+uint64_t PlayerStore::matchCount() const {
+	lock_guard<mutex> guard(lock);
+	return opened ? matchHeader()->count : 0;
+}
+
+/* ------------------------ StoreWriter ------------------------ */
+
+namespace {
+	int64_t unixMillis() {
+		return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+	}
+}
+
+StoreWriter::StoreWriter(PlayerStore& store) : store(store) {
+	worker = thread([this] { writeLoop(); });
+}
+
+StoreWriter::~StoreWriter() {
+	{
+		lock_guard<mutex> guard(queueLock);
+		stopping = true;
+	}
+	wake.notify_one();
+	worker.join();
+	store.close();
+}
+
+void StoreWriter::playerJoined(const string& name) {
+	push(Type::Join, name, 0);
+}
+
+void StoreWriter::scoreChanged(const string& name, int change) {
+	push(Type::Score, name, change);
+}
+
+void StoreWriter::matchEnded(uint32_t durationMs, const vector<pair<string, int>>& results) {
+	{
+		lock_guard<mutex> guard(queueLock);
+		for (const auto& result : results) queued.push_back(Command{ Type::MatchPlayer, result.first, result.second });
+		queued.push_back(Command{ Type::MatchEnd, string(), durationMs });
+	}
+	wake.notify_one();
+}
+
+void StoreWriter::push(Type type, const string& name, int64_t value) {
+	{
+		lock_guard<mutex> guard(queueLock);
+		queued.push_back(Command{ type, name, value });
+	}
+	wake.notify_one();
+}
+
+void StoreWriter::writeLoop() {
+	auto lastSync = chrono::steady_clock::now();
+	unique_lock<mutex> guard(queueLock);
+
+	for (;;) {
+		wake.wait_for(guard, STORE_SYNC_INTERVAL, [this] { return stopping || !queued.empty(); });
+		bool stop = stopping;
+		applying.swap(queued);
+		guard.unlock();
+
+		for (const auto& command : applying) apply(command);
+		applying.clear();
+
+		// The destructor's close() does the last one
+		auto now = chrono::steady_clock::now();
+		if (!stop && now - lastSync >= STORE_SYNC_INTERVAL) {
+			store.sync();
+			lastSync = now;
+		}
+
+		guard.lock();
+		if (stop && queued.empty()) return;
+	}
+}
+
+void StoreWriter::apply(const Command& command) {
+	switch (command.type) {
+	case Type::Join: {
+		store.addPlayer(command.name, unixMillis());
+		PlayerSummary summary;
+		if (store.find(command.name, summary)) {
+			LOG_INFO("%s: lifetime score %lld, rank %llu of %llu, %u matches played", summary.name.c_str(), static_cast<long long>(summary.lifetimeScore),
+				static_cast<unsigned long long>(summary.rank), static_cast<unsigned long long>(store.playerCount()), summary.matchesPlayed);
+		}
+		break;
+	}
+	case Type::Score:
+		store.addScore(store.addPlayer(command.name, unixMillis()), command.value);
+		break;
+	case Type::MatchPlayer: {
+		uint32_t profileID = store.addPlayer(command.name, unixMillis());
+		if (profileID != NO_PROFILE) matchResults.emplace_back(profileID, static_cast<int32_t>(command.value));
+		break;
+	}
+	case Type::MatchEnd:
+		store.addMatch(static_cast<uint32_t>(command.value), matchResults, unixMillis());
+		matchResults.clear();
+		break;
+	}
+}
@@ -0,0 +1,201 @@
+#ifndef PLAYER_STORE_H
+#define PLAYER_STORE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "MappedFile.h"
+
+using namespace std;
+
+// Player profiles, lifetime scores and match results, kept on disk so they outlive the server.
+//
+// Three memory-mapped files next to each other (<base>.profiles, <base>.matches, <base>.index):
+//
+//   profiles - one 64 byte ProfileRecord per player name, appended the first time the name is seen. A profile's ID is its
+//              position in the file, so it never changes.
+//   matches  - one MatchRecord per finished match, appended
+//   index    - everything that can be worked out again from the profiles: a hash table from name to profile ID, how many
+//              players are on each lifetime score (a Fenwick tree, so a rank is a handful of additions) and the top
+//              STORE_TOP_PLAYERS players by lifetime score
+//
+// Opening only checks the headers and maps the files, however many players there are. Every record carries a checksum and
+// each file a "shut down cleanly" flag: if the last run crashed, open() checks the records and rebuilds the index instead.
+// Records are written in place through the mapping, so anything written before a crash is still there, and sync() (which
+// StoreWriter calls once a second) is what gets it onto the disk in case the machine itself goes down.
+//
+// The numbers are stored in this machine's byte order, so copy the files between machines of the same kind only.
+
+constexpr size_t STORE_NAME_LENGTH = 32;    // Including the terminating zero, so names are cut to 31 bytes
+constexpr size_t STORE_TOP_PLAYERS = 100;   // How far down the lifetime leaderboard topPlayers() can go
+constexpr size_t STORE_MATCH_PLAYERS = 8;   // Players kept per match result (the highest scores)
+constexpr int64_t STORE_RANKED_SCORES = 1 << 16; // Players on this lifetime score or more all share one rank
+constexpr chrono::milliseconds STORE_SYNC_INTERVAL{ 1000 }; // Longest a change waits before StoreWriter gets it onto the disk
+
+constexpr uint32_t NO_PROFILE = 0xffffffff; // addPlayer couldn't make one (an empty name, or the disk is full)
+
+#pragma pack(push, 1)
+struct ProfileRecord {
+	char name[STORE_NAME_LENGTH]; // Zero padded. Empty for a record that was damaged in a crash and cleared.
+	int64_t lifetimeScore;
+	uint32_t matchesPlayed;
+	uint32_t matchesWon;
+	int32_t bestMatchScore;
+	uint32_t checksum;
+	int64_t lastSeenUnixMs;
+};
+
+struct MatchRecord {
+	int64_t endedUnixMs;
+	uint32_t durationMs;
+	uint32_t playerCount; // Entries used in `players`
+	struct {
+		uint32_t profileID;
+		int32_t score;
+	} players[STORE_MATCH_PLAYERS]; // Highest score first
+	uint32_t checksum;
+	uint32_t reserved;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(ProfileRecord) == 64, "ProfileRecord is part of the file format");
+static_assert(sizeof(MatchRecord) == 88, "MatchRecord is part of the file format");
+
+// A profile as the queries return it
+struct PlayerSummary {
+	uint32_t profileID = 0;
+	string name;
+	int64_t lifetimeScore = 0;
+	uint32_t matchesPlayed = 0;
+	uint32_t matchesWon = 0;
+	int32_t bestMatchScore = 0;
+	uint64_t rank = 0; // 1 is the top of the lifetime leaderboard
+};
+
+class PlayerStore {
+public:
+	PlayerStore() = default;
+	~PlayerStore();
+
+	PlayerStore(const PlayerStore&) = delete;
+	PlayerStore& operator=(const PlayerStore&) = delete;
+
+	// Opens the three files, creating them if they don't exist. False if they can't be opened or are from another version.
+	bool open(const string& basePath);
+
+	// Gets everything onto the disk and marks the files as shut down cleanly
+	void close();
+
+	bool isOpen() const;
+
+	// --- Changes. Any thread, but meant for StoreWriter's. ---
+
+	// The profile ID for `name`, creating the profile if it's new. Also sets when they were last seen.
+	uint32_t addPlayer(const string& name, int64_t nowUnixMs);
+
+	// Lifetime scores only go up (the top players list relies on it), so `change` must not be negative
+	void addScore(uint32_t profileID, int64_t change);
+
+	// Counts the match for every player in `results` (profile ID, score), a win for the highest score, and appends a MatchRecord
+	void addMatch(uint32_t durationMs, vector<pair<uint32_t, int32_t>> results, int64_t nowUnixMs);
+
+	// Blocks until everything changed so far is on the disk
+	void sync();
+
+	// --- Queries. Any thread. ---
+
+	bool find(const string& name, PlayerSummary& out) const;
+
+	// The `count` (up to STORE_TOP_PLAYERS) highest lifetime scores, best first. Returns how many there were.
+	size_t topPlayers(size_t count, vector<PlayerSummary>& out) const;
+
+	// The `index`th match (0 is the first one ever recorded)
+	bool match(uint64_t index, MatchRecord& out) const;
+
+	uint64_t playerCount() const;
+	uint64_t matchCount() const;
+
+private:
+	struct FileHeader;
+	struct IndexHeader;
+	struct TopEntry;
+
+	FileHeader* profileHeader() const;
+	FileHeader* matchHeader() const;
+	IndexHeader* indexHeader() const;
+	ProfileRecord* profiles() const;
+	MatchRecord* matches() const;
+	TopEntry* topEntries() const;
+	uint32_t* rankTree() const;
+	uint32_t* buckets() const;
+
+	bool openData(MappedFile& file, const string& path, const char* magic, size_t recordSize, bool& clean);
+	bool openIndex(const string& path, bool dataWasClean);
+	void recoverProfiles();
+	void recoverMatches();
+	bool rebuildIndex(uint64_t bucketCount);
+	bool reserveRecord(MappedFile& file, size_t recordSize);
+	void fail(const char* what);
+
+	int64_t findProfile(const char* name, size_t length) const;
+	void insertIntoIndex(uint32_t profileID);
+	void addToRanks(int64_t score, int32_t change);
+	uint64_t playersAbove(int64_t score) const;
+	void updateTopPlayers(uint32_t profileID, int64_t score);
+	void insertTopPlayer(uint32_t profileID, int64_t score);
+	void summarise(uint32_t profileID, PlayerSummary& out) const;
+
+	mutable mutex lock;
+	MappedFile profileFile, matchFile, indexFile;
+	bool opened = false;
+	bool dirty = false; // Changed since the last sync
+};
+
+// Applies changes to a PlayerStore on its own thread, so the tick never waits on the disk (or on a file being grown).
+// The tick thread queues them by name and carries on; the writer thread picks them up in batches, and syncs the store to
+// disk at most once a second.
+class StoreWriter {
+public:
+	explicit StoreWriter(PlayerStore& store);
+
+	// Applies everything still queued, then closes the store
+	~StoreWriter();
+
+	StoreWriter(const StoreWriter&) = delete;
+	StoreWriter& operator=(const StoreWriter&) = delete;
+
+	void playerJoined(const string& name);
+	void scoreChanged(const string& name, int change);
+
+	// One (name, score) per player who took part
+	void matchEnded(uint32_t durationMs, const vector<pair<string, int>>& results);
+
+private:
+	enum class Type { Join, Score, MatchPlayer, MatchEnd };
+
+	struct Command {
+		Type type;
+		string name;
+		int64_t value;
+	};
+
+	void push(Type type, const string& name, int64_t value);
+	void writeLoop();
+	void apply(const Command& command);
+
+	PlayerStore& store;
+	mutex queueLock;
+	condition_variable wake;
+	vector<Command> queued;  // Filled by the tick thread...
+	vector<Command> applying; // ...swapped with this one by the writer thread, so each side keeps its storage
+	vector<pair<uint32_t, int32_t>> matchResults; // MatchPlayer commands so far, until the MatchEnd
+	bool stopping = false;
+	thread worker;
+};
+
+#endif
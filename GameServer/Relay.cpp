@@ -0,0 +1,68 @@
+#include "Relay.h"
+#include "../Shared/GameConfig.h"
+#include "../Shared/Logger.h"
+#include "../Shared/Protocol.h"
+#include <atomic>
+#include <iostream>
+
+static atomic<bool> relayStopRequested{ false };
+
+static constexpr int RECONNECT_INTERVAL_MS = 1000;
+
+void Relay::requestStop() {
+	relayStopRequested = true;
+}
+
+Relay::Relay(const string& upstreamAddress, unsigned short upstreamPort) : upstreamAddress(upstreamAddress), upstreamPort(upstreamPort) {}
+
+bool Relay::connectUpstream() {
+	IpAddress address(upstreamAddress);
+	if (upstream.connect(address, upstreamPort, seconds(5)) != Socket::Done) return false;
+
+	// Never blocks the loop below: whatever's arrived is read when the selector says so
+	upstream.setBlocking(false);
+	upstreamStream.reset();
+	selector.add(upstream);
+	connected = true;
+	cout << "Relaying " << upstreamAddress << ":" << upstreamPort << ".\n";
+	return true;
+}
+
+void Relay::run() {
+	int nextAttemptMs = 0;
+	while (!relayStopRequested) {
+		int nowMs = clock.getElapsedTime().asMilliseconds();
+		feed.adoptNew();
+
+		if (!connected && nowMs >= nextAttemptMs && !connectUpstream()) {
+			LOG_WARNING("Could not reach %s:%u, trying again in a second", upstreamAddress.c_str(), upstreamPort);
+			nextAttemptMs = nowMs + RECONNECT_INTERVAL_MS;
+		}
+
+		// Frames arrive every snapshot interval, so this wakes up about that often (and to pick up new spectators meanwhile)
+		if (connected) {
+			if (selector.wait(milliseconds(SNAPSHOT_INTERVAL_MS))) receiveFrames(clock.getElapsedTime().asSeconds() * 1000.f);
+		}
+		else sleep(milliseconds(SNAPSHOT_INTERVAL_MS));
+
+		feed.update(clock.getElapsedTime().asSeconds() * 1000.f);
+	}
+	cout << "Shutting down the relay.\n";
+}
+
+void Relay::receiveFrames(float nowMs) {
+	Socket::Status status;
+	while ((status = upstreamStream.receive(frame)) == Socket::Done) {
+		// Passed on exactly as it came. Only the command is read, and that doesn't change what getData() returns.
+		if (!(frame >> command)) continue;
+		if (command == opcodeName(Opcode::Watch)) feed.publish(frame, nowMs);
+		else if (command == opcodeName(Opcode::Lobby)) LOG_WARNING("%s:%u has no room for another spectator", upstreamAddress.c_str(), upstreamPort);
+	}
+
+	if (status == Socket::Disconnected || status == Socket::Error) {
+		cout << "Lost " << upstreamAddress << ":" << upstreamPort << ", reconnecting.\n";
+		selector.remove(upstream);
+		upstream.disconnect();
+		connected = false;
+	}
+}
@@ -0,0 +1,48 @@
+#ifndef RELAY_H
+#define RELAY_H
+
+#include <SFML/Network.hpp>
+#include <string>
+#include "../Shared/PacketStream.h"
+#include "MessagePool.h"
+#include "Spectators.h"
+
+using namespace std;
+using namespace sf;
+
+// `GameServer --relay HOST[:PORT]`: runs no match, just watches one server's spectator port like any other spectator and
+// passes every WATCH frame straight on to up to RELAY_MAX_SPECTATORS of its own. The server only sends each frame once to the
+// relay, so a few relays (or relays of relays) let a big audience watch without the match's server doing any more work.
+// Frames are passed on as they arrive: the server has already held them back by SPECTATOR_DELAY_MS.
+class Relay {
+public:
+	Relay(const string& upstreamAddress, unsigned short upstreamPort);
+
+	// Where the relay's own spectator Acceptor leaves new spectators
+	MatchInbox& getInbox() { return feed.getInbox(); }
+
+	// Until requestStop(). Losing the server isn't the end: the relay tries again every second and its spectators stay connected meanwhile.
+	void run();
+
+	// Safe to call from a signal handler
+	static void requestStop();
+
+private:
+	bool connectUpstream();
+	void receiveFrames(float nowMs);
+
+	string upstreamAddress;
+	unsigned short upstreamPort;
+	TcpSocket upstream;
+	PacketStream upstreamStream{ upstream };
+	SocketSelector selector;
+	bool connected = false;
+	Packet frame;
+	string command;
+
+	MessagePool pool; // Declared before feed so the queues holding its buffers are destroyed first
+	SpectatorFeed feed{ pool, RELAY_MAX_SPECTATORS, 0.f };
+	Clock clock;
+};
+
+#endif
@@ -1,56 +1,126 @@
 #include "Server.h"
 
-// Constructor  -> Initialize
-Server::Server(unsigned short port) {
+static atomic<bool> stopRequested{ false };
+static atomic<bool> reloadRequested{ false };
 
-	// Attemp to bind the TCP listener to the specified port. If fail, then set the server's running flag to false and exit.
-	if (listener.listen(port) != Socket::Done) {
-		handleErrors("Server", listener.listen(port));
-		running = false;
+// Bump whenever writeState changes, so a new server never misreads an old one's state (the old one then just carries on)
+static constexpr Uint32 HANDOFF_STATE_VERSION = 3;
+
+// Constructor  -> Initialize. Listening and accepting is the Acceptor's job (see main.cpp), the server only gets the players it has room for.
+Server::Server(const ServerConfig& config, const ConfigSource& source) : config(config), configSource(source) {
+	newSockets.reserve(config.maxPlayers);
+	openPlayerStore();
+}
+
+// Set CORPLIFE_STORE to keep the player store somewhere else (it's three files: <path>.profiles, .matches and .index)
+void Server::openPlayerStore() {
+	const char* storePath = getenv("CORPLIFE_STORE");
+	if (playerStore.open(storePath ? storePath : "corplife")) storeWriter = make_unique<StoreWriter>(playerStore);
+	else cerr << "Could not open the player store, lifetime scores won't be kept.\n";
+}
+
+void Server::requestStop() {
+	stopRequested = true;
+}
+
+void Server::requestReload() {
+	reloadRequested = true;
+}
+
+// Read the config again (after a SIGHUP) and use the live settings from this tick on. Settings that only take effect at
+// startup stay as they are, and a config that doesn't load changes nothing.
+void Server::reloadConfig() {
+	ServerConfig loaded;
+	string error;
+	if (!configSource.load(loaded, error)) {
+		cerr << "Config not reloaded: " << error << "\n";
 		return;
 	}
 
-	// If successful, listen for any incoming connections.
-	cout << "Listening successful on port " << port << ". Waiting for incoming connections.. \n";
-	selector.add(listener);
+	for (const ConfigSetting& setting : configSettings()) {
+		double now = setting.get(config), then = setting.get(loaded);
+		if (now == then) continue;
+		if (setting.live) {
+			cout << "Config: " << setting.name << " " << now << " -> " << then << "\n";
+			setting.set(config, then);
+		}
+		else cout << "Config: " << setting.name << " only changes on a restart, keeping " << now << "\n";
+	}
 }
 
 // As long as the server is running...
 void Server::run() {
-	while (running) {
+	TRACE_SCOPE("Server::run");
+
+	while (running && !stopRequested && !handoffRequested) {
+		TRACE_SCOPE("Server::tick");
+		METRIC_TIMER(Metrics::Histogram::TickDurationUs);
+		tickCount++;
 
-		// Check for any incoming events with 20 ms timeout to ensure non-blocking I/O
-		if (selector.wait(milliseconds(30))) {
+		if (reloadRequested.exchange(false)) reloadConfig();
+
+		// First tick after a hot restart: how long the players went without a tick
+		if (tookOver) {
+			tookOver = false;
+			auto pause = chrono::duration_cast<chrono::microseconds>(ClockType::now() - pausedAt).count();
+			METRIC_RECORD(Metrics::Histogram::HandoffPauseUs, static_cast<uint64_t>(pause));
+			cout << "Took over " << clientData.size() << " players and " << spectators.size() << " spectators. The match was paused for " << pause / 1000.f << " ms.\n";
+		}
 
-			// If socket is ready, then process the new client connection
-			if (selector.isReady(listener)) {
-				processNewClient(); // Add to clientData
+		// Players the Acceptor has let in since the last tick, and spectators
+		adoptNewClients();
+		spectators.adoptNew();
+
+		// Check for any incoming events with a timeout (idle-wait-ms, 30 ms unless configured) to ensure non-blocking I/O, or less if someone's snapshot is due sooner.
+		// With nobody connected there's nothing to wait on (and select() with no sockets fails straight away on Windows), so just sleep.
+		// Bots have no sockets, so a match of only bots sleeps until the next snapshot is due.
+		bool ready = false;
+		Time wait = matchInProgress ? timeUntilNextSnapshot() : seconds(config.idleWaitMs / 1000.f);
+		if (clientData.size() == botCount) sleep(wait);
+		else ready = selector.wait(wait);
+		ClockType::time_point tickStart = ClockType::now(); // The rest of the tick is work, for the admin endpoint's tick time
+
+		if (ready) {
+
+			// How many clients have data waiting this wakeup
+			if (Metrics::isEnabled()) {
+				uint64_t ready = 0;
+				for (const auto& client : clientData) {
+					if (!client.bot && selector.isReady(*client.socket)) ready++;
+				}
+				METRIC_RECORD(Metrics::Histogram::QueueDepth, ready);
 			}
 
 			// Next, iterate through the clients that are connected
-			for (size_t i = 0; i < clientData.size(); ++i) {
-
-				// Only when a socket is ready, process the data from it to avoid blocking
-				if (selector.isReady(*clientData[i].socket)) {
+			for (size_t i = 0; i < clientData.size();) {
 
-					// Gets the player's name provided and latest actual positions
-					processClientData(*clientData[i].socket, i);
-				}
+				// Only when a socket is ready, process the data from it to avoid blocking (bots don't have one).
+				// Gets the player's name provided and latest actual positions. A client that was removed has had the next one
+				// moved into its place, so don't step over that one.
+				if (!clientData[i].bot && selector.isReady(*clientData[i].socket) && !processClientData(*clientData[i].socket, i)) continue;
+				++i;
 			}
 		}
 
-		// If both the clients are connected
-		if (bothPlayersConnected) {
+		// Drop any disconnected sessions whose grace period has run out
+		if (!parkedSessions.empty()) expireParkedSessions();
 
-			// Send the updated player positions every 30 ms. This includes the predicted positins. Restart the clock after sending the data.
-			if (ticker.getElapsedTime().asMilliseconds() > 30) {
-				sendPlayerPositions();
-				//cout << "Sent positions at " << ticker.getElapsedTime().asMilliseconds() << endl;
-				ticker.restart();
-			}
+		// If the match has started (both the clients connected at some point)
+		if (matchInProgress) {
 
-			// Send the Player ID only once, the first time
-			if (!sent) sendPlayerId();
+			// Bots move now, after this tick's UPDATE_POSITIONs, so everyone's snapshot has them where they are this tick
+			if (botCount > 0) updateBots();
+
+			// Send the Player ID (and session token) to any player who hasn't got one yet. Before the snapshots, so a new player
+			// knows which entry in their first PLAYER_POSITIONS is their spawn position.
+			sendPlayerId();
+
+			// Send the updated player positions (including the predicted positions) to whoever's due one. Every 30 ms for a
+			// client that keeps up, less often for one that doesn't.
+			sendSnapshots();
+
+			// Scoreboard changes from this tick, and the whole scoreboard to anyone who needs it
+			sendRosterUpdates();
 
 			// Although the rainbow ball may despawn if the player collides with it, only spawn it if 5 seconds have passed. It will spawn and despawn every 5 seconds. More info on this in the specific functions.
 			if (!hasRainbowBall) trySpawnRainbowBall();
@@ -58,101 +128,127 @@ void Server::run() {
 			// If the rainbow ball already exists, then check if 5 seconds have elapsed. If yes, then despawn it.
 			else checkRainbowBallTimeout();
 		}
-	}
 
-	// Server has stopped running
-	cout << "Shutting down the server.\n";
-}
+		// Spectators get the whole match as one frame every snapshot interval, built once however many are watching, and
+		// see it SPECTATOR_DELAY_MS after the players do. Between matches the frames just say there isn't one.
+		float nowMs = gameTime.getElapsedTime().asSeconds() * 1000.f;
+		if (spectators.size() > 0 && nowMs - lastWatchMs >= config.snapshotIntervalMs) publishWatchFrame(nowMs);
+		spectators.update(nowMs);
 
-/* ------------------------ Process New Client ------------------------ */
+		// Anything a client's socket couldn't take earlier
+		flushAllOutbound();
 
+		// A copy of the match for the admin endpoint, now and then
+		if (statusBoard) publishStatus(tickStart);
 
-void Server::processNewClient() {
+		// A new server process wants to take over. main() calls handOver once we've returned.
+		if (handoff && handoff->replacementWaiting()) {
+			handoffRequested = true;
+			pausedAt = ClockType::now();
+		}
+	}
 
-	// Static so that it doesn't reset on each function call (whenever new client connects)
-	static int nextPlayerID = 0;
+	// Server has stopped running
+	if (!handoffRequested) cout << "Shutting down the server.\n";
+}
 
-	// If more than 2 players attempt to connect, then show them an warning message that the server if full and exit.
-	if (clientData.size() >= 2) {
-		sendFullLobbyMessage(listener);
-		return;
-	}
+/* ------------------------ Process New Client ------------------------ */
 
-	// Else...
-	// Create a new socket instance for each client in order to handle separate communication - multiple clients are handled by the server, keeping their data separate!! 
 
-	auto newClient = make_unique<TcpSocket>();
+void Server::adoptNewClients() {
+	newSockets.clear();
+	inbox.take(newSockets, clientData.size() - botCount); // Bots don't take up a player's place
 
-	// Listen for any incoming client connections... When a client connects, create a newClient unique socket.
-	if (listener.accept(*newClient) == Socket::Done) {
+	for (auto& newClient : newSockets) {
 
 		// Selector handles multiple sockets to check for incoming data from any of the clients simultaneously
 		selector.add(*newClient);
 
+		// Non-blocking on every platform, so neither a slow reader (flushOutbound) nor half a packet (processClientData) can hold up the tick
+		newClient->setBlocking(false);
+
 		// Creating a new ClientData object to store and pass the data in an easier way.
 		// Could also do: clientData.push_back({move(newClient), nextPlayerID++, {0.0f, 0.0f});
 		ClientData newClientData;
 		newClientData.socket = move(newClient);
-		newClientData.ID = nextPlayerID++;
-		newClientData.position = { 100.0f, 100.0f }; // Starting position for both clients - (100, 100)
+		newClientData.snapshotRate = SnapshotRate(config.snapshotIntervalMs);
+		newClientData.position = { PLAYER_SPAWN_X, PLAYER_SPAWN_Y }; // Starting position for every new client - (100, 100)
+
+		// If someone dropped out and may come back, this could be them reconnecting. Wait for their first message (RESUME or PLAYER_NAME) before giving out an ID.
+		newClientData.awaitingHandshake = !parkedSessions.empty();
+		if (!newClientData.awaitingHandshake) newClientData.ID = nextPlayerID++;
+
 		clientData.push_back(move(newClientData)); // Push this client's data into clientData
 
-		cout << "New Client ID " << newClientData.ID << " connected: " << clientData.back().socket->getRemoteAddress() << "\n";
+		cout << "New Client connected: " << clientData.back().socket->getRemoteAddress() << "\n";
 
 		// Checks if both the players are connected
-		notifyClientsOnConnection();
-	}
-}
-
-// Function called if more than 2 players try to connect. IT gives a new window which says that the server is full. Player can then go back and exit.
-void Server::sendFullLobbyMessage(TcpListener& listener) {
-	auto extraPlayer = make_unique<TcpSocket>();
-	if (listener.accept(*extraPlayer) == Socket::Done) {
-		Packet packet;
-		packet << "The lobby is full. Sorry!";
-		extraPlayer->send(packet);
-		extraPlayer->disconnect();
+		if (!clientData.back().awaitingHandshake) notifyClientsOnConnection();
 	}
 }
 
 void Server::notifyClientsOnConnection() {
 	// If there is only 1 player, inform them they're waiting for another player
-	if (clientData.size() == 1) {
+	if (clientData.size() == 1 && !clientData[0].inMatch) {
 		// Notify the first player that they're waiting for the second player
-		Packet packet;
-		packet << "Waiting for another player to connect...";
-		clientData[0].socket->send(packet);
+		Packet packet = lobbyPacket(LobbyStatus::Waiting);
+		sendPacket(clientData[0], packet, Opcode::Lobby);
 	}
 
-	// If both players are connected, notify both to start the game
-	if (clientData.size() == 2) {
-		Packet startPacket;
-		startPacket << "Both players connected. Starting the game!";
+	// If both players are connected, notify both to start the game. Players already in the match (e.g. when a new player replaces one whose session expired) don't need the message again.
+	// Bots count as players here, so there can be more than max-players.
+	if (clientData.size() >= config.maxPlayers) {
+		Packet startPacket = lobbyPacket(LobbyStatus::Starting);
 
-		for (const auto& client : clientData) {
-			if (client.socket->send(startPacket) != Socket::Done) handleErrors("notifyClientsOnConnection", client.socket->send(startPacket));
+		for (auto& client : clientData) {
+			if (client.inMatch) continue;
+			Socket::Status status = sendPacket(client, startPacket, Opcode::Lobby);
+			if (status != Socket::Done) handleErrors("notifyClientsOnConnection", status);
+			client.inMatch = true;
 		}
 
 		// Set this boolean to true to perform further actions in run()
-		bothPlayersConnected = true;
+		if (!matchInProgress) {
+			matchStartedAt = ClockType::now();
+			matchResults.clear();
+		}
+		matchInProgress = true;
 	}
 }
 
 void Server::sendPlayerId() {
 
-	// Create unique packets for each client containing their unique ID and send it to the respective client
-	Packet client1, client2;
-	client1 << "PLAYER_ID" << clientData[0].ID;
-	client2 << "PLAYER_ID" << clientData[1].ID;
+	// Create unique packets for each client containing their unique ID and session token and send it to the respective client. The token is what lets them resume if they drop out.
+	for (auto& client : clientData) {
+		if (client.sessionToken != 0 || !client.inMatch || client.bot) continue;
 
-	if (clientData[0].socket->send(client1) != Socket::Done) handleErrors("sendPlayerId1", clientData[0].socket->send(client1));
-	if (clientData[1].socket->send(client2) != Socket::Done) handleErrors("sendPlayerId2", clientData[1].socket->send(client2));
-	sent = true;
+		do {
+			client.sessionToken = tokenGenerator();
+		} while (client.sessionToken == 0 || parkedSessions.count(client.sessionToken));
+
+		Packet packet;
+		packet << "PLAYER_ID";
+		Schema::append(packet, PlayerIdMessage{ client.ID, client.sessionToken });
+		Socket::Status status = sendPacket(client, packet, Opcode::PlayerId);
+		if (status != Socket::Done) handleErrors("sendPlayerId", status);
+	}
+}
+
+// A new player turned up while a dropped player's slot was being held for them, so there's no room.
+void Server::rejectPendingClient(size_t clientIndex) {
+	Packet packet = lobbyPacket(LobbyStatus::Full);
+	sendPacket(clientData[clientIndex], packet, Opcode::Lobby);
+	clientData[clientIndex].socket->disconnect();
+
+	selector.remove(*clientData[clientIndex].socket);
+	clientData.erase(clientData.begin() + clientIndex);
 }
 
 /* ------------------------ Process incoming packets------------------------ */
 
-void Server::processClientData(TcpSocket& client, size_t clientIndex) {
+bool Server::processClientData(TcpSocket& client, size_t clientIndex) {
+	TRACE_SCOPE("Server::processClientData");
+
 	Packet packet;
 	auto status = client.receive(packet);
 
@@ -160,152 +256,487 @@ void Server::processClientData(TcpSocket& client, size_t clientIndex) {
 	if (status == Socket::Done) {
 		string command;
 		packet >> command;
+		METRIC_PACKET_IN(opcodeFromCommand(command), packet.getDataSize());
+
+		// A player who dropped out is reconnecting with the token they were given in sendPlayerId. Only a new connection can be
+		// one: a player already in the match sending RESUME would have their own slot (score, roster entry, session) overwritten
+		// by the parked one, or be dropped for a bad token, so it's ignored.
+		if (command == "RESUME") {
+			if (clientData[clientIndex].inRoster) {
+				LOG_WARNING("Ignored RESUME from client %zu, who is already playing", clientIndex);
+				return true;
+			}
+			ResumeMessage resume = {};
+			decodeResume(packet, resume); // A short one has token 0, which is never issued
+
+			// Nobody's slot was being held when this connection came in (or it would be awaiting the handshake), so there's
+			// nothing for it to resume: token 0 gets it RESUME_FAILED straight away rather than leaving it to time out
+			return resumeSession(clientIndex, clientData[clientIndex].awaitingHandshake ? resume.sessionToken : 0);
+		}
 
 		// If name, then store it in the respective client's player name
 		if (command == "PLAYER_NAME") {
 			string receivedName;
-			packet >> receivedName;
+			if (!decodePlayerName(packet, receivedName)) {
+				LOG_WARNING("Malformed PLAYER_NAME from client %zu", clientIndex);
+				return true;
+			}
+
+			// A new player (not a resume). Only let them in if no dropped player's slot is being held.
+			if (clientData[clientIndex].awaitingHandshake) {
+				if (clientData.size() - botCount + parkedSessions.size() > config.maxPlayers) {
+					rejectPendingClient(clientIndex);
+					return false;
+				}
+				clientData[clientIndex].awaitingHandshake = false;
+				clientData[clientIndex].ID = nextPlayerID++;
+				notifyClientsOnConnection();
+			}
 
 			clientData[clientIndex].playerName = receivedName;
+			clientData[clientIndex].inRoster = true;
+			addRosterChange(RosterEvent::Join, clientData[clientIndex], clientData[clientIndex].score);
+			if (storeWriter) storeWriter->playerJoined(receivedName);
 			cout << "Player " << clientIndex << " is now known as " << receivedName << "\n";
 		}
 
+		// Nothing else is accepted until we know who this is
+		if (clientData[clientIndex].awaitingHandshake) return true;
+
+		// The client missed a ROSTER, so it gets the whole scoreboard again at the end of this tick
+		if (command == "ROSTER_REQUEST") {
+			uint32_t version = 0;
+			if (!decodeRosterRequest(packet, version)) return true;
+			clientData[clientIndex].rosterSynced = false;
+			METRIC_ADD(Metrics::Counter::RosterResyncs, 1);
+			return true;
+		}
+
 		// If currnet actual position, then synchronize the position incase of network delays. Client sends the current (x, y) position along with the 
 		if (command == "UPDATE_POSITION") {
-			float x, y, moveX, moveY;
-			packet >> x >> y >> moveX >> moveY;
+			UpdatePositionMessage update;
+			InputEcho echo;
+			if (!decodeUpdatePosition(packet, update, echo)) {
+				LOG_WARNING("Malformed UPDATE_POSITION from client %zu", clientIndex);
+				return true;
+			}
+			float x = update.x, y = update.y;
 
 			auto& clientRef = clientData[clientIndex];
 
-			clientRef.movementVector = { moveX, moveY };
+			// Clients echo the timestamp of the last PLAYER_POSITIONS they received, which gives us the round trip time. Since
+			// input is only sent when it changes, the client may have sat on that timestamp for a while: it says how long, so
+			// that isn't counted as network time.
+			if (echo.timestamp > 0) {
+				Int64 now = chrono::duration_cast<chrono::milliseconds>(chrono::high_resolution_clock::now().time_since_epoch()).count();
+				Int64 rtt = max<Int64>(0, now - echo.timestamp - echo.heldMs);
+				clientRef.rttMs = static_cast<float>(rtt);
+				METRIC_RECORD(Metrics::Histogram::ClientRttMs, static_cast<uint64_t>(rtt));
+			}
+
+			// How far off the last prediction we sent was from where the player actually is now
+			if (!clientRef.positionHistory.empty()) {
+				METRIC_RECORD(Metrics::Histogram::PredictionErrorPx, static_cast<uint64_t>(hypot(x - clientRef.predictedPosition.x, y - clientRef.predictedPosition.y)));
+			}
 
 			Time elapsed = clientRef.lastUpdateTime.getElapsedTime();
 			clientRef.lastUpdateTime.restart();
 
-			Vector2f newVelocity = clientRef.movementVector / elapsed.asSeconds();
-			clientRef.velocity = smoothingFactor * clientRef.velocity + (1.0f - smoothingFactor) * newVelocity;
-
 			//cout << "Received for Client " << clientIndex << ": " << x << ", " << y << " || " << gameTime.getElapsedTime().asSeconds() << " || V" << clientRef.velocity.x << ", " << clientRef.velocity.y << endl;
 
-			// Check for collision with the rainbow ball
-			if (hasRainbowBall && isPlayerTouchingRainbowBall(clientRef)) {
-				// Increment score and despawn rainbow ball
-				clientRef.score++;
-				despawnRainbowBall();  // Despawn the rainbow ball if touched
-				broadcastUpdatedScores();  // Send updated scores to both players
-			}
-
-			Vector2f newPosition = { x, y };
-
-			// Store the new position in the deque
-			PositionSnapshot snapshot = { newPosition, chrono::duration_cast<chrono::milliseconds>(chrono::high_resolution_clock::now().time_since_epoch()).count() };
-			auto& positionHistory = clientRef.positionHistory;
-			positionHistory.push_back(snapshot);
-
-			if (positionHistory.size() > 4) {
-				positionHistory.pop_front();
-			}
-
-			clientRef.position = newPosition;
+			movePlayer(clientRef, { x, y }, { update.moveX, update.moveY }, elapsed.asSeconds(), hasRainbowBall && isPlayerTouchingRainbowBall(clientRef));
 		}
 	}
 	else if (status == Socket::Disconnected) {
 		handleDisconnection(clientIndex);
+		return false;
+	}
+	else if (status == Socket::NotReady || status == Socket::Partial) {
+		// Only part of a packet so far. SFML keeps it until the rest comes in on a later tick.
 	}
 	else {
 		handleErrors("processClientData", status);
 	}
+	return true;
+}
+
+// A player's new position, from their UPDATE_POSITION or a bot's step: their velocity for the prediction, the rainbow ball
+// if they've reached it (tested by the caller, where they were before this move), and the position history
+void Server::movePlayer(ClientData& client, Vector2f position, Vector2f movement, float elapsedSeconds, bool touchingRainbowBall) {
+	client.movementVector = movement;
+
+	Vector2f newVelocity = client.movementVector / elapsedSeconds;
+	client.velocity = config.predictionSmoothing * client.velocity + (1.0f - config.predictionSmoothing) * newVelocity;
+
+	// Check for collision with the rainbow ball
+	if (hasRainbowBall && touchingRainbowBall) {
+		// Increment score and despawn rainbow ball
+		client.score++;
+		addRosterChange(RosterEvent::Score, client, 1); // Goes out to everyone at the end of the tick
+		if (storeWriter && !client.bot) storeWriter->scoreChanged(client.playerName, 1);
+		despawnRainbowBall();  // Despawn the rainbow ball if touched
+	}
+
+	// Same bounds the client's step() keeps the player in
+	Vector2f newPosition = clampToWorld(position);
+
+	// Store the new position in the deque. Milliseconds since the server started: epoch milliseconds are too big for a float to tell 30 ms apart.
+	PositionSnapshot snapshot = { newPosition, gameTime.getElapsedTime().asSeconds() * 1000.f };
+	auto& positionHistory = client.positionHistory;
+	positionHistory.push_back(snapshot);
+
+	if (positionHistory.size() > POSITION_HISTORY_SIZE) {
+		positionHistory.pop_front();
+	}
+
+	client.position = newPosition;
 }
 
 bool Server::isPlayerTouchingRainbowBall(ClientData& player) const {
 
-	// We take player.position (player's position and rainbowBall.first to access the Vecfor2f, which is in the first position of the pair.
-	// Then, we use the distance formula to get the distance between the player's shape and rainbow ball shape. Distance = sqrt[(x2 - x1)^2 + (y2 - y1)^2], where 2 represents player and 1 is rainbow ball
+	// rainbowBall.first is the Vector2f position, which is in the first position of the pair.
+	// Same check the client could make, from Shared/Simulation (player radius 15 + rainbow ball radius 7).
+	return isTouchingRainbowBall(player.position, rainbowBall.first);
+}
+
+/* ------------------------ Scoreboard ------------------------ */
 
-	float distance = sqrt(pow(player.position.x - rainbowBall.first.x, 2) + pow(player.position.y - rainbowBall.first.y, 2));
-	return distance < RAINBOW_RADIUS;  // Check if the player is within range of the rainbow ball's radius, which is set to 17 since player shape is 15. Added a little outer padding/ The rainbow ball's actual raidus is 7 on cleint's screen.
+// Record a change to the scoreboard. Each one gets the next roster version.
+void Server::addRosterChange(RosterEvent type, const ClientData& client, int value) {
+	pendingRoster.push_back({ type, client.ID, type == RosterEvent::Join ? client.playerName : string(), value });
+	rosterVersion++;
 }
 
-// This function is called if the player touches the present rainbow ball. It creates an "UPDATE_SCORES" command in the packet with the updated scores for both the clients.
-void Server::broadcastUpdatedScores() {
+// Send this tick's changes to everyone who has the scoreboard, then the whole scoreboard to anyone who doesn't (new in the match,
+// resumed, or asked because they missed something). In that order, so nobody gets changes already included in their ROSTER_FULL.
+void Server::sendRosterUpdates() {
+	if (!pendingRoster.empty()) {
+		Packet packet;
+		packet << opcodeName(Opcode::Roster) << static_cast<Uint32>(rosterVersion - pendingRoster.size() + 1) << static_cast<Uint16>(pendingRoster.size());
+		for (const RosterChange& change : pendingRoster) {
+			packet << static_cast<Uint8>(change.type) << change.ID;
+			if (change.type == RosterEvent::Join) packet << change.name << change.value;
+			else if (change.type == RosterEvent::Score) packet << static_cast<Int32>(change.value);
+		}
+		pendingRoster.clear();
+
+		// Encoded once and shared, like the other broadcasts
+		MessageRef message = encodeMessage(packet);
+		for (auto& client : clientData) {
+			if (!client.rosterSynced) continue;
+			Socket::Status status = queueMessage(client, message, Opcode::Roster);
+			if (status != Socket::Done) handleErrors("sendRosterUpdates", status);
+		}
+	}
+
+	for (auto& client : clientData) {
+		if (client.inMatch && !client.rosterSynced) sendFullRoster(client);
+	}
+}
+
+// Everyone with a name, connected or holding a parked session, with the version this is up to date with
+void Server::sendFullRoster(ClientData& client) {
+	Uint32 count = 0;
+	for (const auto& other : clientData) {
+		if (other.inRoster) count++;
+	}
+	for (const auto& parked : parkedSessions) {
+		if (parked.second.data.inRoster) count++;
+	}
+
 	Packet packet;
-	packet << "UPDATE_SCORES";
-	for (const auto& client : clientData) {
-		packet << client.ID << client.playerName << client.score;
-		//cout << "Client " << client.ID << " (" << client.playerName << ") score updated: " << client.score << "\n";
+	packet << opcodeName(Opcode::RosterFull) << rosterVersion << count;
+	for (const auto& other : clientData) {
+		if (other.inRoster) packet << other.ID << other.playerName << other.score;
 	}
-	broadcastToClients(packet);  // Send the updated scores to all clients
+	for (const auto& parked : parkedSessions) {
+		const ClientData& other = parked.second.data;
+		if (other.inRoster) packet << other.ID << other.playerName << other.score;
+	}
+
+	client.rosterSynced = true;
+	Socket::Status status = sendPacket(client, packet, Opcode::RosterFull);
+	if (status != Socket::Done) handleErrors("sendFullRoster", status);
 }
 
 // The packet is then sent to each client. Packet contains updated scores for both clients.
-void Server::broadcastToClients(Packet& packet) {
-	for (const auto& client : clientData) {
-		if (client.socket->send(packet) != Socket::Done) handleErrors("broadcastToClients", client.socket->send(packet));
+// It's encoded once, and every client's queue shares that one buffer.
+void Server::broadcastToClients(Packet& packet, Opcode opcode) {
+	MessageRef message = encodeMessage(packet);
+
+	for (auto& client : clientData) {
+		if (!client.inMatch) continue; // Still in the lobby
+		Socket::Status status = queueMessage(client, message, opcode);
+		if (status != Socket::Done) handleErrors("broadcastToClients", status);
 	}
 }
 
-// Incase a player disconnects,
-void Server::handleDisconnection(size_t index) {
-	cout << "Client disconnected: " << clientData[index].socket->getRemoteAddress() << "\n";
-	bothPlayersConnected = (clientData.size() == 2);
-	sent = false;
-	running = false;
-	clientData.clear();
-	selector.remove(listener);
-	listener.close();
-	cout << "Shutting down server since the player has disconnected. Please restart to play again.\n";
+// Encode a packet into a pooled buffer, as a PACKED message if it's big enough to be worth compressing and actually shrinks
+MessageRef Server::encodeMessage(const Packet& packet) {
+#ifndef CORPLIFE_NO_COMPRESSION
+	size_t size = packet.getDataSize();
+	if (size >= COMPRESSION_THRESHOLD) {
+		compressor.compress(packet.getData(), size, compressed);
+		if (PACKED_HEADER_SIZE + compressed.size() < size) {
+			Packet packed;
+			packed << opcodeName(Opcode::Packed) << COMPRESSION_DICTIONARY_VERSION << static_cast<Uint32>(size);
+			packed.append(compressed.data(), compressed.size());
+			METRIC_ADD(Metrics::Counter::CompressionSavedBytes, size - packed.getDataSize());
+			return messagePool.encode(packed.getData(), packed.getDataSize());
+		}
+	}
+#endif
+	return messagePool.encode(packet.getData(), packet.getDataSize());
 }
 
+// A packet for one client: encode it into a pooled buffer and queue it
+Socket::Status Server::sendPacket(ClientData& client, Packet& packet, Opcode opcode) {
+	MessageRef message = encodeMessage(packet);
+	return queueMessage(client, message, opcode);
+}
 
-//------- ------- ------- HANDLE PREDICTION LOGIC AND SEND CLIENTS THE PREDICTED POSITIONS ------ ------- -------//
+// Queue an already encoded message for a client and try to send it straight away. Whatever the socket can't take now stays queued for the next tick.
+Socket::Status Server::queueMessage(ClientData& client, const MessageRef& message, Opcode opcode) {
+	if (client.bot) return Socket::Done; // Bots play straight from the server's own state
+
+	if (!client.outbound.push(message)) {
+		// The client hasn't been reading for a while, drop this message rather than letting the queue grow. Their snapshot rate backs off because of it.
+		client.droppedMessages++;
+		METRIC_SEND_FAILURE(Socket::NotReady);
+		return Socket::NotReady;
+	}
 
-void Server::predictedPosition(const ClientData& client) {
-	// Player ID + positions
+	METRIC_PACKET_OUT(opcode, message.size());
+	return flushOutbound(client);
+}
+
+Socket::Status Server::flushOutbound(ClientData& client) {
+	METRIC_RECORD(Metrics::Histogram::OutboundQueueDepth, client.outbound.depth());
+
+#ifdef __linux__
+	// One sendmsg for everything queued, straight from the shared buffers
+	switch (client.outbound.flush(client.socket->getHandle())) {
+	case OutboundQueue::FlushResult::Done:
+	case OutboundQueue::FlushResult::WouldBlock: // The rest goes out on a later tick
+		return Socket::Done;
+	case OutboundQueue::FlushResult::Disconnected:
+		METRIC_SEND_FAILURE(Socket::Disconnected);
+		return Socket::Disconnected;
+	default:
+		METRIC_SEND_FAILURE(Socket::Error);
+		return Socket::Error;
+	}
+#else
+	// No scatter-gather here, so send the queued messages one at a time (still without copying them). The socket is non-blocking
+	// (adoptNewClients), so a client that isn't reading gets NotReady or Partial here rather than holding up the tick.
+	ConstBuffer piece;
+	while (client.outbound.gather(&piece, 1) == 1) {
+		size_t sent = 0;
+		Socket::Status status = client.socket->send(piece.data, piece.size, sent);
+		client.outbound.consume(sent);
+
+		if (status == Socket::NotReady || status == Socket::Partial) return Socket::Done;
+		if (status != Socket::Done) {
+			METRIC_SEND_FAILURE(status);
+			return status;
+		}
+	}
+	return Socket::Done;
+#endif
+}
+
+// Send whatever earlier ticks couldn't
+void Server::flushAllOutbound() {
 	for (auto& client : clientData) {
-		Vector2f predictedPosition = client.position; // Default to last known position
+		if (client.outbound.empty()) continue;
+		Socket::Status status = flushOutbound(client);
+		if (status != Socket::Done) handleErrors("flushAllOutbound", status);
+	}
+}
+
+// Incase a player disconnects, park their session so they can resume it, and keep the match going for everyone else.
+void Server::handleDisconnection(size_t index) {
+	ClientData& client = clientData[index];
+	cout << "Client disconnected: " << client.socket->getRemoteAddress() << "\n";
 
-		// Predict the next position if enough data is available
-		if (client.positionHistory.size() >= 2) {
-			const PositionSnapshot& lastPosition = client.positionHistory.back();
-			const PositionSnapshot& secondLastPosition = client.positionHistory[client.positionHistory.size() - 2];
+	selector.remove(*client.socket);
+	for (auto& other : clientData) other.snapshotPriority.forget(client.ID);
 
-			// Calculate velocity (last two positions)
-			float timeDelta = (lastPosition.timestamp - secondLastPosition.timestamp) / 1000.0f; // Convert ms to seconds
+	// Only players who were given a token can come back. Anyone else is off the scoreboard now.
+	if (client.sessionToken != 0) parkSession(client);
+	else if (client.inRoster) {
+		addRosterChange(RosterEvent::Leave, client, 0);
+		recordMatchResult(client);
+	}
 
-			if (timeDelta > 0.0f) {
-				Vector2f velocity = (lastPosition.position - secondLastPosition.position) / timeDelta;
+	clientData.erase(clientData.begin() + index);
 
-				// Predict based on velocity and elapsed time
-				float predictionTime = 2.f * ticker.getElapsedTime().asSeconds();
-				predictedPosition = lastPosition.position + (velocity * 2.5f) * predictionTime;
-			}
-			else {
-				// Not enough data, use last known position
-				client.predictedPosition = client.position;
+	if (clientData.size() == botCount && parkedSessions.empty()) resetMatch();
+}
+
+// Move the player's data out of clientData and keep it (without the socket) until they reconnect or the grace period ends
+void Server::parkSession(ClientData& client) {
+	ParkedSession session;
+	session.parkedAt = ClockType::now();
+	session.hadRainbowBall = hasRainbowBall;
+	session.rainbowAtPark = rainbowBall.first;
+
+	session.data = move(client);
+	session.data.socket.reset();
+	session.data.outbound.clear(); // Anything unsent is replaced by the resync
+
+	cout << "Holding " << session.data.playerName << "'s session (ID " << session.data.ID << ") for " << config.sessionGraceSeconds << " seconds.\n";
+	parkedSessions.emplace(session.data.sessionToken, move(session));
+}
+
+// Rebind the reconnected socket to the parked player's ID, score and position
+bool Server::resumeSession(size_t clientIndex, Uint64 token) {
+	auto it = parkedSessions.find(token);
+	if (it == parkedSessions.end()) {
+		Packet packet;
+		packet << "RESUME_FAILED";
+		sendPacket(clientData[clientIndex], packet, Opcode::ResumeFailed);
+		clientData[clientIndex].socket->disconnect();
+
+		selector.remove(*clientData[clientIndex].socket);
+		clientData.erase(clientData.begin() + clientIndex);
+		cout << "Rejected a resume with an unknown or expired session token.\n";
+		return false;
+	}
+
+	ParkedSession session = move(it->second);
+	parkedSessions.erase(it);
+
+	ClientData& client = clientData[clientIndex];
+	unique_ptr<ClientSocket> socket = move(client.socket);
+	client = move(session.data);
+	client.socket = move(socket);
+	client.awaitingHandshake = false;
+	client.inMatch = true;
+
+	// Old history is from before the disconnect, so it would throw off the prediction
+	client.positionHistory.clear();
+	client.velocity = { 0.f, 0.f };
+	client.lastUpdateTime.restart();
+	client.snapshotRate = SnapshotRate(config.snapshotIntervalMs); // New connection, start from the full rate again
+	client.droppedMessages = 0;
+	client.rosterSynced = false; // Missed the changes while away, so they get the whole scoreboard
+
+	cout << client.playerName << " resumed their session (ID " << client.ID << ").\n";
+	sendResync(client, session);
+
+	// A new player may have been waiting in the lobby for this slot to come back
+	notifyClientsOnConnection();
+	return true;
+}
+
+// Send the resumed player their own state, then the rainbow ball if it changed while they were away. The scoreboard follows in a ROSTER_FULL.
+void Server::sendResync(ClientData& client, const ParkedSession& session) {
+	ResyncMessage resync = { client.ID, client.position.x, client.position.y, client.score, 0 };
+
+	// Rainbow ball: 0 = unchanged, 1 = gone, 2 = a new one (followed by the same fields as SPAWN)
+	bool newBall = hasRainbowBall && (!session.hadRainbowBall || rainbowBall.first != session.rainbowAtPark);
+	if (newBall) resync.rainbowBall = 2;
+	else if (!hasRainbowBall && session.hadRainbowBall) resync.rainbowBall = 1;
+
+	Packet packet;
+	packet << "RESYNC";
+	Schema::append(packet, resync);
+	if (newBall) {
+		float spawnTimeSeconds = chrono::duration<float>(rainbowSpawnTime.time_since_epoch()).count();
+		Schema::append(packet, SpawnMessage{ rainbowBall.first.x, rainbowBall.first.y, rainbowBall.second.r, rainbowBall.second.g, rainbowBall.second.b, spawnTimeSeconds });
+	}
+
+	Socket::Status status = sendPacket(client, packet, Opcode::Resync);
+	if (status != Socket::Done) handleErrors("sendResync", status);
+}
+
+// Forget parked sessions once their grace period is up
+void Server::expireParkedSessions() {
+	for (auto it = parkedSessions.begin(); it != parkedSessions.end();) {
+		float parkedFor = chrono::duration<float>(ClockType::now() - it->second.parkedAt).count();
+		if (parkedFor >= config.sessionGraceSeconds) {
+			cout << it->second.data.playerName << "'s session expired.\n";
+			if (it->second.data.inRoster) {
+				addRosterChange(RosterEvent::Leave, it->second.data, 0);
+				recordMatchResult(it->second.data);
 			}
+			it = parkedSessions.erase(it);
 		}
-		else client.predictedPosition = client.position;
+		else ++it;
+	}
 
-		// Apply smoothing to avoid sudden jumps
-		predictedPosition = smoothingFactor * client.position + (1.0f - smoothingFactor) * predictedPosition;
+	if (clientData.size() == botCount && parkedSessions.empty()) resetMatch();
+}
 
-		// Limit drift
-		float maxDrift = 50.0f; // Maximum allowable drift
-		if (abs(predictedPosition.x - client.position.x) > maxDrift ||
-			abs(predictedPosition.y - client.position.y) > maxDrift) {
-			predictedPosition = client.position; // Revert to last known position
-		}
+// Everyone has left, so go back to waiting for two new players. Enough bots to play on their own just carry on.
+void Server::resetMatch() {
+	if (!matchInProgress || botCount >= config.maxPlayers) return;
+
+	matchInProgress = false;
+	hasRainbowBall = false;
+	pendingRoster.clear(); // Nobody left to tell
+	saveMatch();
 
+	// A bot waiting for someone to play against starts the next match from scratch
+	for (auto& client : clientData) {
+		client.inMatch = false;
+		client.score = 0;
+	}
+	cout << "All players have left. Waiting for a new match.\n";
+}
 
-		//cout << "Predicted for Client " << client.ID << ": " << predictedPosition.x << ", " << predictedPosition.y << " || " << gameTime.getElapsedTime().asSeconds() << " || V" << client.velocity.x << ", " << client.velocity.y << endl;
+// A player is gone for good, so their score for this match is final
+void Server::recordMatchResult(const ClientData& client) {
+	if (client.inMatch && !client.bot && !client.playerName.empty()) matchResults.emplace_back(client.playerName, client.score);
+}
 
-		client.predictedPosition.x = predictedPosition.x;
-		client.predictedPosition.y = predictedPosition.y;
+// Hand the finished match to the player store (it's written on the store's own thread)
+void Server::saveMatch() {
+	if (storeWriter && !matchResults.empty()) {
+		auto duration = chrono::duration_cast<chrono::milliseconds>(ClockType::now() - matchStartedAt);
+		storeWriter->matchEnded(static_cast<uint32_t>(duration.count()), matchResults);
 	}
+	matchResults.clear();
 }
 
-// Send PLAYER_POSITIONS command to the client along with the predicted positions and the current timestamp
-void Server::sendPlayerPositions() {
+
+//------- ------- ------- HANDLE PREDICTION LOGIC AND SEND CLIENTS THE PREDICTED POSITIONS ------ ------- -------//
+
+// Works out one player's predicted position (see predictPosition in Shared/Simulation.cpp)
+void Server::predictedPosition(ClientData& client) {
+	float predictionTime = 2.f * ticker.getElapsedTime().asSeconds();
+	client.predictedPosition = predictPosition(client.positionHistory, client.position, predictionTime, config.predictionSmoothing);
+}
+
+// Send PLAYER_POSITIONS to every client whose snapshot is due. Each client has its own rate (see Snapshots.h), so on a
+// given tick some clients get one and others don't.
+void Server::sendSnapshots() {
+	float nowMs = gameTime.getElapsedTime().asSeconds() * 1000.f;
+
+	bool anyDue = false;
+	size_t playersInMatch = 0;
+	for (const auto& client : clientData) {
+		if (!client.inMatch) continue;
+		playersInMatch++;
+		if (!client.bot && client.snapshotRate.isDue(nowMs)) anyDue = true;
+	}
+	if (!anyDue) return;
+
+	// Predict everyone once, however many clients this round goes to. Restart the clock after, it's the prediction's time step.
+	for (auto& client : clientData) {
+		if (client.inMatch) predictedPosition(client);
+	}
+	ticker.restart();
+
+	if (playersInMatch <= SNAPSHOT_PLAYER_BUDGET) sendPlayerPositions(nowMs);
+	else sendPrioritisedPositions(nowMs);
+}
+
+// Send PLAYER_POSITIONS command to the due clients along with the predicted positions of every player and the current timestamp
+void Server::sendPlayerPositions(float nowMs) {
+	TRACE_SCOPE("Server::sendPlayerPositions");
+
 	Packet packet;
 	packet << "PLAYER_POSITIONS";
 
@@ -314,24 +745,227 @@ void Server::sendPlayerPositions() {
 	auto timestamp = chrono::duration_cast<chrono::milliseconds>(now.time_since_epoch()).count();
 
 	// Timestamp + Player ID + positions
-	for (const auto& client : clientData) {
-		predictedPosition(client);
-		packet << timestamp << client.ID << client.predictedPosition.x << client.predictedPosition.y;
+	for (auto& client : clientData) {
+		if (!client.inMatch) continue;
+		Schema::append(packet, PlayerPositionEntry{ timestamp, client.ID, client.predictedPosition.x, client.predictedPosition.y });
 
 		//cout << timestamp << " Send for ID " << client.ID << " Predicted: " << predictedPosition.x << ", " << predictedPosition.y << endl;
 	}
 
+	// Encoded once and shared by every due client's queue
+	MessageRef message = encodeMessage(packet);
+
+	for (auto& client : clientData) {
+		if (!client.inMatch || client.bot || !client.snapshotRate.isDue(nowMs)) continue;
+		Socket::Status status = queueMessage(client, message, Opcode::PlayerPositions);
+		if (status != Socket::Done) handleErrors("sendPlayerPositions", status);
+		markSnapshotSent(client, nowMs);
+	}
+}
+
+// Too many players for everyone to get everyone: each due client gets their own position plus the ones that matter most to them.
+// Same PLAYER_POSITIONS layout, just fewer entries.
+void Server::sendPrioritisedPositions(float nowMs) {
+	TRACE_SCOPE("Server::sendPrioritisedPositions");
+
+	auto now = chrono::high_resolution_clock::now();
+	Int64 timestamp = chrono::duration_cast<chrono::milliseconds>(now.time_since_epoch()).count();
+
+	snapshotCandidates.clear();
+	for (const auto& client : clientData) {
+		if (client.inMatch) snapshotCandidates.push_back({ client.ID, client.predictedPosition });
+	}
+	const Vector2f* ball = hasRainbowBall ? &rainbowBall.first : nullptr;
+
+	for (auto& client : clientData) {
+		if (!client.inMatch || client.bot || !client.snapshotRate.isDue(nowMs)) continue;
+
+		SnapshotCandidate self = { client.ID, client.predictedPosition };
+		client.snapshotPriority.select(self, snapshotCandidates, ball, SNAPSHOT_PLAYER_BUDGET - 1, snapshotChosen);
+
+		Packet packet;
+		packet << "PLAYER_POSITIONS";
+		Schema::append(packet, PlayerPositionEntry{ timestamp, self.ID, self.position.x, self.position.y });
+		for (size_t index : snapshotChosen) {
+			const SnapshotCandidate& other = snapshotCandidates[index];
+			Schema::append(packet, PlayerPositionEntry{ timestamp, other.ID, other.position.x, other.position.y });
+		}
+
+		Socket::Status status = sendPacket(client, packet, Opcode::PlayerPositions);
+		if (status != Socket::Done) handleErrors("sendPrioritisedPositions", status);
+		markSnapshotSent(client, nowMs);
+	}
+}
+
+// Adjust the client's rate from how the connection looks after this snapshot went into its queue
+void Server::markSnapshotSent(ClientData& client, float nowMs) {
+	client.snapshotRate.markSent(nowMs);
+	client.snapshotRate.update(client.rttMs, client.outbound.depth(), client.droppedMessages, config.snapshotIntervalMs, config.maxSnapshotIntervalMs);
+	client.droppedMessages = 0;
+	METRIC_RECORD(Metrics::Histogram::SnapshotIntervalMs, static_cast<uint64_t>(client.snapshotRate.intervalMs()));
+}
+
+// How long the selector can wait before someone's next snapshot is due (between 1 ms and the snapshot interval)
+Time Server::timeUntilNextSnapshot() const {
+	float nowMs = gameTime.getElapsedTime().asSeconds() * 1000.f;
+	float wait = config.snapshotIntervalMs;
+	for (const auto& client : clientData) {
+		if (client.inMatch && !client.bot) wait = min(wait, client.snapshotRate.nextDueMs() - nowMs);
+	}
+	wait = min(wait, spectators.nextDueMs() - nowMs);
+	return milliseconds(max(1, static_cast<int>(ceil(wait))));
+}
+
+// One WATCH frame (see Shared/Protocol.h): everyone in the match, with their score and name, and the rainbow ball. Each frame
+// stands on its own, so a spectator can start watching (or miss a few) at any point.
+void Server::publishWatchFrame(float nowMs) {
+	lastWatchMs = nowMs;
+
+	Uint8 flags = matchInProgress ? WATCH_MATCH_IN_PROGRESS : 0;
+	if (hasRainbowBall) flags |= WATCH_RAINBOW_BALL;
+	watchPacket.clear();
+	watchPacket << opcodeName(Opcode::Watch) << watchFrame++ << flags;
+	if (hasRainbowBall) {
+		watchPacket << rainbowBall.first.x << rainbowBall.first.y << rainbowBall.second.r << rainbowBall.second.g << rainbowBall.second.b;
+	}
+
+	// Players still waiting to say who they are aren't in the match yet
+	Uint16 count = 0;
+	for (const auto& client : clientData) {
+		if (!client.awaitingHandshake) count++;
+	}
+	watchPacket << count;
+	for (const auto& client : clientData) {
+		if (client.awaitingHandshake) continue;
+		watchPacket << static_cast<Int32>(client.ID) << client.position.x << client.position.y << static_cast<Int32>(client.score) << client.playerName;
+	}
+
+	spectators.publish(watchPacket, nowMs);
+}
+
+// Copy the match into the admin endpoint's StatusBoard, at most every ADMIN_PUBLISH_INTERVAL_MS. The admin thread only ever
+// reads the copy, so however often it's scraped the tick never waits for it. Entries are overwritten in place, so the copy
+// stops allocating once it's seen the most players.
+void Server::publishStatus(ClockType::time_point tickStart) {
+	ClockType::time_point now = ClockType::now();
+	uint64_t workUs = static_cast<uint64_t>(chrono::duration_cast<chrono::microseconds>(now - tickStart).count());
+	slowestTickWorkUs = max(slowestTickWorkUs, workUs);
+	if (chrono::duration<float, milli>(now - lastStatusAt).count() < ADMIN_PUBLISH_INTERVAL_MS) return;
+	lastStatusAt = now;
+
+	MatchStatus& status = statusBoard->back();
+	status.publishedAtUs = Metrics::nowMicros();
+	status.ticks = tickCount;
+	status.tickWorkUs = workUs;
+	status.slowestTickWorkUs = slowestTickWorkUs;
+	status.matchInProgress = matchInProgress;
+	status.matchSeconds = matchInProgress ? chrono::duration<float>(now - matchStartedAt).count() : 0.f;
+	status.hasRainbowBall = hasRainbowBall;
+	status.rainbowX = rainbowBall.first.x;
+	status.rainbowY = rainbowBall.first.y;
+	status.spectators = spectators.size();
+	status.parkedSessions = parkedSessions.size();
+	status.config = config;
+
+	status.players.resize(clientData.size());
+	for (size_t i = 0; i < clientData.size(); ++i) {
+		const ClientData& client = clientData[i];
+		PlayerStatus& player = status.players[i];
+		player.ID = client.ID;
+		player.name = client.playerName;
+		player.score = client.score;
+		player.x = client.position.x;
+		player.y = client.position.y;
+		player.rttMs = client.rttMs;
+		player.snapshotIntervalMs = client.snapshotRate.intervalMs();
+		player.queuedMessages = client.outbound.depth();
+		player.bot = client.bot;
+		player.inMatch = client.inMatch;
+	}
+
+	statusBoard->publish();
+	slowestTickWorkUs = 0;
+}
+
+
+//------- ------- ------- ------- BOTS ------ ------  ------ ------- -------//
+
+// Bots join like players who have already told us their name: they're on the scoreboard straight away, and with enough of
+// them the match starts without anyone connecting
+void Server::addBots(size_t count) {
+	clientData.reserve(clientData.size() + count + config.maxPlayers);
+	for (size_t i = 0; i < count; ++i) {
+		ClientData bot;
+		bot.bot = true;
+		bot.ID = nextPlayerID++;
+		bot.playerName = "Bot " + to_string(bot.ID);
+		bot.position = randomBotTarget(); // Spread out, or thousands of them would all start on the same spot
+		bot.botTarget = randomBotTarget();
+		bot.inRoster = true;
+		bot.rosterSynced = true; // Nothing is sent to a bot, so there's no scoreboard of theirs to keep up to date
+		addRosterChange(RosterEvent::Join, bot, 0);
+		clientData.push_back(move(bot));
+	}
+	botCount += count;
+
+	if (count > 0) {
+		cout << "Added " << count << " bots.\n";
+		notifyClientsOnConnection();
+	}
+}
+
+// Every bot takes one step, the way Client::gameLoop moves a player towards the mouse: straight for the rainbow ball when there
+// is one, otherwise to a random spot and then another. It's all one pass over the players, with no packets either way, so
+// thousands of bots cost the tick about what their simulation and snapshots do.
+void Server::updateBots() {
+	TRACE_SCOPE("Server::updateBots");
+
+	// Ticks are usually 30 ms apart. A long gap (e.g. the match was waiting) is capped so nobody jumps across the map.
+	float deltaTime = min(botClock.restart().asSeconds(), 0.1f);
+	if (deltaTime <= 0.f) return;
+
+	// Which bot gets to the rainbow ball, with every bot tested in one go (Shared/Collision.h). Like players, each is tested
+	// where it was before this step, and the first in the list wins, so it's the one testing them one at a time would find.
+	size_t reachesBall = NO_CIRCLE;
+	if (hasRainbowBall) {
+		botCentresX.clear();
+		botCentresY.clear();
+		for (const auto& client : clientData) {
+			if (!client.bot || !client.inMatch) continue;
+			Circle circle = playerCircle(client.position.x, client.position.y);
+			botCentresX.push_back(circle.x);
+			botCentresY.push_back(circle.y);
+		}
+		CircleBatch bots = { botCentresX.data(), botCentresY.data(), botCentresX.size(), PLAYER_RADIUS };
+		reachesBall = findFirstOverlap(bots, rainbowCircle(rainbowBall.first.x, rainbowBall.first.y));
+	}
+
+	size_t botNumber = 0;
 	for (auto& client : clientData) {
-		if (client.socket->send(packet) != Socket::Done) handleErrors("sendPlayerPositions", client.socket->send(packet));
+		if (!client.bot || !client.inMatch) continue;
+		bool touchingRainbowBall = botNumber++ == reachesBall;
+
+		Vector2f target = hasRainbowBall ? rainbowBall.first : client.botTarget;
+		MoveStep move = step(client.position, target, deltaTime);
+
+		// Inside the dead zone, so it's got where it was going
+		if (!hasRainbowBall && move.movement == Vector2f()) client.botTarget = randomBotTarget();
+
+		movePlayer(client, move.position, move.movement, deltaTime, touchingRainbowBall);
 	}
 }
 
+Vector2f Server::randomBotTarget() {
+	uniform_real_distribution<float> x(0.f, WINDOW_WIDTH - 2 * PLAYER_RADIUS), y(0.f, WINDOW_HEIGHT - 2 * PLAYER_RADIUS);
+	return { x(botRandom), y(botRandom) };
+}
+
 
 //------- ------- ------- ------- RAINBOW BALL SPAWN & DESPAWN LOGIC ------  ------ ------- -------//
 
-// Check if it's been 5 seconds since the last rainbow ball spawn time. If yes, then spawn a new one
+// Check if it's been rainbow-lifetime-seconds (5 unless configured) since the last rainbow ball spawn time. If yes, then spawn a new one
 void Server::trySpawnRainbowBall() {
-	if (chrono::duration_cast<chrono::seconds>(ClockType::now() - rainbowSpawnTime).count() >= 5) {
+	if (chrono::duration<float>(ClockType::now() - rainbowSpawnTime).count() >= config.rainbowLifetimeSeconds) {
 		spawnRainbowBall();
 	}
 }
@@ -341,7 +975,7 @@ void Server::spawnRainbowBall() {
 
 	// Random width and height. We multiply radius by 2 and subtract it to make sure that the rainbow ball appears within the boundaries
 	Vector2f position(rand() % (int)(WINDOW_WIDTH - (RAINBOW_RADIUS * 2)), rand() % (int)(WINDOW_HEIGHT - (RAINBOW_RADIUS * 2)));
-	Color color(rand() % 256, rand() % 256, rand() % 256); // Random number generated from 0 - 255
+	BallColor color = { static_cast<Uint8>(rand() % 256), static_cast<Uint8>(rand() % 256), static_cast<Uint8>(rand() % 256) }; // Random number generated from 0 - 255
 
 	// Set up the rainbow ball pair
 	rainbowBall = { position, color };
@@ -351,16 +985,17 @@ void Server::spawnRainbowBall() {
 	float spawnTimeSeconds = chrono::duration<float>(rainbowSpawnTime.time_since_epoch()).count(); // Convert spawn time to float in seconds to timestamp it's spawn time
 
 	Packet packet;
-	packet << "SPAWN" << position.x << position.y << static_cast<Uint8>(color.r) << static_cast<Uint8>(color.g) << static_cast<Uint8>(color.b) << spawnTimeSeconds;
-	cout << "Spawn Rainbow at " << position.x << ", " << position.y << ". Time: " << spawnTimeSeconds << " seconds.\n";
+	packet << "SPAWN";
+	Schema::append(packet, SpawnMessage{ position.x, position.y, color.r, color.g, color.b, spawnTimeSeconds });
+	LOG_INFO("Spawn Rainbow at %.1f, %.1f. Time: %.3f seconds.", position.x, position.y, spawnTimeSeconds);
 
 	// Send rainbow ball packet to the clients
-	broadcastToClients(packet);
+	broadcastToClients(packet, Opcode::Spawn);
 }
 
-// Checks if 5 seconds have passed. If yes, then a despawn signail will be sent to the client
+// Checks if rainbow-lifetime-seconds have passed. If yes, then a despawn signail will be sent to the client
 void Server::checkRainbowBallTimeout() {
-	if (chrono::duration_cast<chrono::seconds>(ClockType::now() - rainbowSpawnTime).count() >= 5) {
+	if (chrono::duration<float>(ClockType::now() - rainbowSpawnTime).count() >= config.rainbowLifetimeSeconds) {
 		despawnRainbowBall();
 	}
 }
@@ -370,37 +1005,246 @@ void Server::despawnRainbowBall() {
 	hasRainbowBall = false;
 	Packet packet;
 	packet << "DESPAWN";
-	broadcastToClients(packet);
+	broadcastToClients(packet, Opcode::Despawn);
 }
 
 
 //------- ------- ------- ------- HANDLE ALL THE ERRORS ------  ------ ------- -------//
 
 // Handles all the errors. Format --> FunctionName: Error encountered
+// These can fire every tick (e.g. a client that stopped reading), so they go through the rate limited logger.
 void Server::handleErrors(string func, Socket::Status status) {
 	switch (status) {
 	case Socket::NotReady:
-		cerr << func << ": Socket not ready to send/receive data.\n";
+		LOG_WARNING("%s: Socket not ready to send/receive data.", func.c_str());
 		break;
 	case Socket::Partial:
-		cerr << func << ": Partial data sent/received.\n";
+		LOG_WARNING("%s: Partial data sent/received.", func.c_str());
 		break;
 	case Socket::Disconnected:
-		cerr << func << ": Socket disconnected.\n";
+		LOG_WARNING("%s: Socket disconnected.", func.c_str());
 		break;
 	case Socket::Error:
 	default:
-		cerr << func << ": An unexpected socket error occurred.\n";
+		LOG_ERROR("%s: An unexpected socket error occurred.", func.c_str());
 		break;
 	}
 }
 
 
+//------- ------- ------- ------- HOT RESTART ------  ------ ------- -------//
+
+// Steady clock times go over as nanoseconds. Both processes are on the same machine, so they read the same clock.
+static Int64 toNanos(ClockType::time_point time) {
+	return chrono::duration_cast<chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+static ClockType::time_point fromNanos(Int64 nanos) {
+	return ClockType::time_point(chrono::duration_cast<ClockType::duration>(chrono::nanoseconds(nanos)));
+}
+
+// Everything about a player except their socket, which goes as a file descriptor, and what's only kept for this
+// process's clock (their position history and snapshot rate, which the new server starts again).
+static void writeClient(Packet& state, const ClientData& client) {
+	state << client.ID << client.position.x << client.position.y << client.score << client.playerName
+		<< client.movementVector.x << client.movementVector.y << client.velocity.x << client.velocity.y
+		<< client.predictedPosition.x << client.predictedPosition.y << client.rttMs
+		<< client.inRoster << client.rosterSynced << client.sessionToken << client.awaitingHandshake << client.inMatch << client.bot;
+}
+
+static void readClient(Packet& state, ClientData& client) {
+	state >> client.ID >> client.position.x >> client.position.y >> client.score >> client.playerName
+		>> client.movementVector.x >> client.movementVector.y >> client.velocity.x >> client.velocity.y
+		>> client.predictedPosition.x >> client.predictedPosition.y >> client.rttMs
+		>> client.inRoster >> client.rosterSynced >> client.sessionToken >> client.awaitingHandshake >> client.inMatch >> client.bot;
+}
+
+// The match as handOver sends it. takeOver reads it back in the same order.
+void Server::writeState(Packet& state) const {
+	state << HANDOFF_STATE_VERSION << toNanos(pausedAt) << static_cast<Int32>(nextPlayerID)
+		<< matchInProgress << toNanos(matchStartedAt)
+		<< hasRainbowBall << rainbowBall.first.x << rainbowBall.first.y
+		<< rainbowBall.second.r << rainbowBall.second.g << rainbowBall.second.b << toNanos(rainbowSpawnTime)
+		<< rosterVersion;
+
+	state << static_cast<Uint32>(pendingRoster.size());
+	for (const auto& change : pendingRoster) {
+		state << static_cast<Uint8>(change.type) << change.ID << change.name << change.value;
+	}
+
+	state << static_cast<Uint32>(matchResults.size());
+	for (const auto& result : matchResults) state << result.first << result.second;
+
+	// Whatever a client's socket hadn't taken yet goes along too, exactly as it was framed, so nobody gets half a message
+	ConstBuffer pieces[OutboundQueue::CAPACITY];
+	state << static_cast<Uint32>(clientData.size());
+	for (const auto& client : clientData) {
+		writeClient(state, client);
+
+		string unsent;
+		size_t count = client.outbound.gather(pieces, OutboundQueue::CAPACITY);
+		for (size_t i = 0; i < count; ++i) unsent.append(pieces[i].data, pieces[i].size);
+		state << unsent;
+	}
+
+	state << static_cast<Uint32>(parkedSessions.size());
+	for (const auto& parked : parkedSessions) {
+		const ParkedSession& session = parked.second;
+		writeClient(state, session.data);
+		state << toNanos(session.parkedAt) << session.hadRainbowBall << session.rainbowAtPark.x << session.rainbowAtPark.y;
+	}
+
+	// Spectators' sockets follow the players'. Frames still being held back for them are let go: they miss a couple of
+	// seconds, but every frame stands on its own.
+	state << static_cast<Uint32>(spectators.size()) << watchFrame;
+}
+
+// Called once run() has returned because a new server connected. The acceptor has stopped, so nobody new turns up meanwhile.
+bool Server::handOver(SocketHandle listener, SocketHandle spectatorListener) {
+	// Anyone the acceptor let in before it stopped goes along too, and whatever can still be sent here is
+	adoptNewClients();
+	spectators.adoptNew();
+	flushAllOutbound();
+
+	Packet state;
+	writeState(state);
+
+	vector<int> sockets{ static_cast<int>(listener), static_cast<int>(spectatorListener) };
+	for (const auto& client : clientData) {
+		if (!client.bot) sockets.push_back(static_cast<int>(client.socket->getHandle()));
+	}
+	vector<int> watching = spectators.handles();
+	sockets.insert(sockets.end(), watching.begin(), watching.end());
+
+	// The new server opens the player store itself, so it has to be closed (cleanly) first. This waits for storeWriter's queue.
+	storeWriter.reset();
+
+	if (handoff->send(state, sockets) && handoff->waitForAcknowledgement()) {
+		handedOff = true;
+		cout << "Handed " << clientData.size() << " players and " << spectators.size() << " spectators over to the new server.\n";
+		return true;
+	}
+
+	// The new server went away before taking over (or couldn't read what we sent). Carry on as if it never came.
+	cerr << "The new server didn't take over, carrying on.\n";
+	handoff->dropReplacement();
+	handoffRequested = false;
+	openPlayerStore();
+	return false;
+}
+
+bool Server::takeOver(Packet& state, const vector<int>& sockets) {
+	// Whatever happens now, the match belongs to the server we're replacing until we acknowledge
+	handedOff = true;
+
+	Uint32 version = 0;
+	state >> version;
+	if (!state || version != HANDOFF_STATE_VERSION) {
+		cerr << "The running server is a different version (handoff state " << version << "), can't take over from it.\n";
+		return false;
+	}
+
+	Int64 paused = 0, matchStarted = 0, rainbowSpawned = 0;
+	Int32 nextID = 0;
+	state >> paused >> nextID >> matchInProgress >> matchStarted
+		>> hasRainbowBall >> rainbowBall.first.x >> rainbowBall.first.y
+		>> rainbowBall.second.r >> rainbowBall.second.g >> rainbowBall.second.b >> rainbowSpawned
+		>> rosterVersion;
+	nextPlayerID = nextID;
+	matchStartedAt = fromNanos(matchStarted);
+	rainbowSpawnTime = fromNanos(rainbowSpawned);
+
+	Uint32 count = 0;
+	state >> count;
+	for (Uint32 i = 0; i < count && state; ++i) {
+		RosterChange change;
+		Uint8 type = 0;
+		state >> type >> change.ID >> change.name >> change.value;
+		change.type = static_cast<RosterEvent>(type);
+		pendingRoster.push_back(change);
+	}
+
+	state >> count;
+	for (Uint32 i = 0; i < count && state; ++i) {
+		pair<string, int> result;
+		state >> result.first >> result.second;
+		matchResults.push_back(result);
+	}
+
+	// Each player has the next socket, apart from bots, which have none
+	state >> count;
+	size_t nextSocket = 0;
+	for (Uint32 i = 0; i < count && state; ++i) {
+		ClientData client;
+		readClient(state, client);
+		string unsent;
+		state >> unsent;
+
+		if (client.bot) {
+			client.botTarget = randomBotTarget();
+			botCount++;
+			clientData.push_back(move(client));
+			continue;
+		}
+		if (nextSocket == sockets.size() || clientData.size() - botCount == config.maxPlayers) {
+			cerr << "The running server sent " << sockets.size() << " sockets for more players than that, can't take over from it.\n";
+			return false;
+		}
+
+		client.socket = make_unique<ClientSocket>();
+		client.socket->adopt(sockets[nextSocket++]);
+		client.socket->setBlocking(false); // As in adoptNewClients
+		if (!unsent.empty()) client.outbound.push(messagePool.copyFramed(unsent.data(), unsent.size()));
+		selector.add(*client.socket);
+		clientData.push_back(move(client));
+	}
+
+	state >> count;
+	for (Uint32 i = 0; i < count && state; ++i) {
+		ParkedSession session;
+		Int64 parkedAt = 0;
+		readClient(state, session.data);
+		state >> parkedAt >> session.hadRainbowBall >> session.rainbowAtPark.x >> session.rainbowAtPark.y;
+		session.parkedAt = fromNanos(parkedAt);
+		Uint64 token = session.data.sessionToken;
+		parkedSessions.emplace(token, move(session));
+	}
+
+	Uint32 watching = 0;
+	state >> watching >> watchFrame;
+	if (!state) {
+		cerr << "The running server's state was cut short, can't take over from it.\n";
+		return false;
+	}
+	if (nextSocket + watching != sockets.size() || watching > MAX_SPECTATORS) {
+		cerr << "The running server sent " << sockets.size() << " sockets for " << nextSocket << " players and " << watching << " spectators, can't take over from it.\n";
+		return false;
+	}
+	for (size_t i = nextSocket; i < sockets.size(); ++i) {
+		auto socket = make_unique<ClientSocket>();
+		socket->adopt(sockets[i]);
+		spectators.add(move(socket));
+	}
+
+	handedOff = false;
+	tookOver = true;
+	pausedAt = fromNanos(paused);
+	return true;
+}
+
+
 //------- ------- ------- ------- DECONSTRUCTOR ------ ------  ------ ------- -------//
 
 // Destructor  -> Clean up the Server
 Server::~Server() {
 
+	// The match ends here for anyone still in it. storeWriter writes it out before it closes the store.
+	if (matchInProgress && !handedOff) {
+		for (const auto& client : clientData) recordMatchResult(client);
+		for (const auto& parked : parkedSessions) recordMatchResult(parked.second.data);
+		saveMatch();
+	}
+
 	// Disconnect all the clients present in clientData and then clear it
 	for (auto& client : clientData) {
 		if (client.socket) {
@@ -409,9 +1253,5 @@ Server::~Server() {
 	}
 	clientData.clear();
 
-	// Remove and close the listener from the selector
-	selector.remove(listener);
-	listener.close();
-
 	cout << "Humanity has been erased successfully ^_^ \n";
 }
\ No newline at end of file
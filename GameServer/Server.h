@@ -2,7 +2,6 @@
 #define SERVER_H
 
 #include <SFML/Network.hpp>
-#include <SFML/Graphics.hpp>
 #include <iostream>
 #include <vector>
 #include <chrono>
@@ -12,28 +11,49 @@
 #include <string>
 #include <cstdlib>
 #include <deque>
+#include <unordered_map>
+#include <atomic>
+#include "../Shared/Protocol.h"
+#include "../Shared/Decoders.h"
+#include "../Shared/Collision.h"
+#include "../Shared/GameConfig.h"
+#include "../Shared/Simulation.h"
+#include "../Shared/Metrics.h"
+#include "../Shared/Logger.h"
+#include "../Shared/Compression.h"
+#include "MessagePool.h"
+#include "Acceptor.h"
+#include "Snapshots.h"
+#include "PlayerStore.h"
+#include "Handoff.h"
+#include "Spectators.h"
+#include "AdminServer.h"
+#include "ServerConfig.h"
 
 using namespace std;
 using namespace sf;
 using ClockType = chrono::steady_clock;
 
-// Constants
-constexpr unsigned short PORT = 5555;
-constexpr float RAINBOW_RADIUS = 17.f;
-constexpr float WINDOW_WIDTH = 1700.f;
-constexpr float WINDOW_HEIGHT = 900.f;
-
 static Clock gameTime;
 static Clock ticker;
 
-struct PositionSnapshot {
-	Vector2f position;
-	float timestamp;
+// Colour of the rainbow ball. The server never draws anything, so it doesn't need sf::Color (or the graphics module).
+struct BallColor {
+	Uint8 r, g, b;
+};
+
+// A roster change not yet sent to the clients
+struct RosterChange {
+	RosterEvent type;
+	int ID;
+	string name; // Join only
+	int value;   // Join: score, Score: change in score
 };
 
 // Struct to store client data
 struct ClientData {
-	unique_ptr<TcpSocket> socket;
+	unique_ptr<ClientSocket> socket;
+	OutboundQueue outbound; // Encoded messages that haven't been fully sent to this client yet
 	Vector2f position;
 	int ID;
 	int score = 0;
@@ -46,50 +66,189 @@ struct ClientData {
 	Vector2f predictedPosition;
 
 	deque<PositionSnapshot> positionHistory; // Stores last 4 positions with timestamps
+	float rttMs = 0.f; // Round trip time measured from the timestamp the client echoes back in UPDATE_POSITION
+
+	// Per-client snapshot rate (see Snapshots.h)
+	SnapshotRate snapshotRate;
+	SnapshotPriority snapshotPriority;
+	unsigned droppedMessages = 0; // Messages the outbound queue had no room for since the last snapshot
+
+	// Scoreboard (see RosterEvent in Shared/Protocol.h)
+	bool inRoster = false;     // Has a name, so the other players have been told about them
+	bool rosterSynced = false; // Has been sent ROSTER_FULL, so from now on gets the ROSTER events
+
+	// For session resumption
+	Uint64 sessionToken = 0; // Issued with the player ID. 0 means the player hasn't received their ID yet.
+	bool awaitingHandshake = false; // Connected while a session was parked, so we wait to see if it's a RESUME or a new player
+	bool inMatch = false; // Already received the "starting the game" message
+
+	// Server-side bot (see Server::updateBots): no socket, moves itself every tick and is never sent anything
+	bool bot = false;
+	Vector2f botTarget; // Where it wanders to while there's no rainbow ball
+};
+
+// A disconnected player's data kept aside until they reconnect or the grace period runs out
+struct ParkedSession {
+	ClientData data;
+	ClockType::time_point parkedAt;
+
+	// What the player had last seen, so the resync only sends the rainbow ball if it changed while they were away.
+	// Scores come from the ROSTER_FULL they get on resuming.
+	bool hadRainbowBall = false;
+	Vector2f rainbowAtPark;
 };
 
 // Server class
 class Server {
 public:
-	// Constructor and Destructor
-	Server(unsigned short port = PORT);
+	// Constructor and Destructor. Connections come from an Acceptor through getInbox(). `source` is where `config` came from,
+	// for reloadConfig.
+	Server(const ServerConfig& config, const ConfigSource& source);
 	~Server();
 
 	void run();
 
+	// Where the Acceptor leaves this match's new players
+	MatchInbox& getInbox() { return inbox; }
+
+	// Bots that stay in the match for as long as the server runs. They count towards starting a match (one bot gives a lone
+	// player an opponent; max-players or more play on their own) but never take a human's place. Call before run().
+	void addBots(size_t count);
+
+	// Where the spectator port's Acceptor leaves people who only want to watch (see Spectators.h)
+	MatchInbox& getSpectatorInbox() { return spectators.getInbox(); }
+
+	// Safe to call from a signal handler. run() returns after the current tick.
+	static void requestStop();
+
+	// Safe to call from a signal handler (SIGHUP). The next tick reads the config again (see reloadConfig).
+	static void requestReload();
+
+	// Hot restart (see Handoff.h). With a channel set, run() also returns when a new server process wants to take over.
+	void enableHotRestart(HandoffChannel* channel) { handoff = channel; }
+	bool replacementWaiting() const { return handoffRequested; }
+
+	// Admin endpoint (see AdminServer.h). With a board set, the tick publishes a copy of the match to it every ADMIN_PUBLISH_INTERVAL_MS.
+	void enableAdmin(StatusBoard* board) { statusBoard = board; }
+
+	// Sends the match to the new server, with both listening sockets, and waits for it to take over. False if it didn't, in
+	// which case this server can carry on.
+	bool handOver(SocketHandle listener, SocketHandle spectatorListener);
+
+	// Carries on with the match the server process we're replacing handed over. `sockets` are the clients', then the
+	// spectators', in the order it sent them.
+	bool takeOver(Packet& state, const vector<int>& sockets);
+
+	// The old server stopped waiting for us to take over and carried on: the match is still its, so leave it alone on the way out
+	void abandonTakeOver() { handedOff = true; }
+
 private:
-	TcpListener listener;
+	ServerConfig config; // Declared first: the inbox's size comes from it
+	ConfigSource configSource;
+	MatchInbox inbox{ config.maxPlayers };
+	vector<unique_ptr<ClientSocket>> newSockets; // Taken from the inbox each tick (kept to reuse its storage)
 	SocketSelector selector;
+	MessagePool messagePool; // Declared before clientData and spectators so the queues holding its buffers are destroyed first
 	vector<ClientData> clientData;
+	SpectatorFeed spectators{ messagePool, MAX_SPECTATORS, SPECTATOR_DELAY_MS };
+	unordered_map<Uint64, ParkedSession> parkedSessions; // Keyed by session token
+	mt19937_64 tokenGenerator{ random_device{}() };
+	int nextPlayerID = 0;
+
+	// Bots (see addBots). They move with the same step() the client does, one step per tick.
+	size_t botCount = 0;
+	mt19937 botRandom{ random_device{}() };
+	Clock botClock;
+	vector<float> botCentresX, botCentresY; // Reused by updateBots for the batch collision test
 
 	bool running = true;
-	bool bothPlayersConnected = false;
-	bool sent = false;
+	bool matchInProgress = false;
 	bool hasRainbowBall = false;
-	pair<Vector2f, Color> rainbowBall;
+	pair<Vector2f, BallColor> rainbowBall;
 	ClockType::time_point rainbowSpawnTime;
-	float smoothingFactor = 0.6f; // Apply a smoothing factor when updating velocities to reduce sudden changes caused by small inaccuracies or lag.
-	float dampingFactor = 0.9f; // Apply a damping factor to slow down abrupt velocity changes.
+
+	// Scoreboard. Changes are collected during the tick and go out together in one ROSTER at the end of it.
+	Uint32 rosterVersion = 0;
+	vector<RosterChange> pendingRoster;
+
+	// Lifetime scores and match results (see PlayerStore.h). storeWriter is null if the store couldn't be opened, and the
+	// game goes on without it.
+	PlayerStore playerStore;
+	unique_ptr<StoreWriter> storeWriter;
+	ClockType::time_point matchStartedAt;
+	vector<pair<string, int>> matchResults; // Players who have left this match and their scores, until the match ends
+
+	// Hot restart
+	HandoffChannel* handoff = nullptr;
+	bool handoffRequested = false;
+	bool handedOff = false; // The match isn't ours to end: we handed it over (or failed to take it over)
+	bool tookOver = false;  // Until the first tick after taking over, when the pause gets measured
+	ClockType::time_point pausedAt; // When the old server stopped ticking (it sends this along with the match)
+
+	// Compresses messages over COMPRESSION_THRESHOLD before they're queued (see encodeMessage)
+	Compressor compressor;
+	vector<char> compressed;
+
+	// WATCH frames for the spectators, one every snapshot interval while anyone's watching
+	Uint32 watchFrame = 0;
+	float lastWatchMs = -1e9f;
+	Packet watchPacket;
+
+	// Admin endpoint
+	StatusBoard* statusBoard = nullptr;
+	Uint64 tickCount = 0;
+	uint64_t slowestTickWorkUs = 0; // Since the last publishStatus
+	ClockType::time_point lastStatusAt;
+
+	// Reused by sendSnapshots when the players don't all fit in one snapshot
+	vector<SnapshotCandidate> snapshotCandidates;
+	vector<size_t> snapshotChosen;
 
 	// Server methods
-	void processNewClient();
-	void sendFullLobbyMessage(TcpListener& listener);
+	void adoptNewClients();
 	void notifyClientsOnConnection();
 	void sendPlayerId();
+	void rejectPendingClient(size_t clientIndex);
 
-	void processClientData(TcpSocket& client, size_t clientIndex);
+	bool processClientData(TcpSocket& client, size_t clientIndex); // False if the client was removed from clientData
+	void movePlayer(ClientData& client, Vector2f position, Vector2f movement, float elapsedSeconds, bool touchingRainbowBall);
+	void updateBots();
+	Vector2f randomBotTarget();
 	bool isPlayerTouchingRainbowBall(ClientData& player) const;
 
 	void handleDisconnection(size_t index);
+	void parkSession(ClientData& client);
+	bool resumeSession(size_t clientIndex, Uint64 token); // False if the token was refused and the client removed
+	void sendResync(ClientData& client, const ParkedSession& session);
+	void expireParkedSessions();
+	void resetMatch();
+	void recordMatchResult(const ClientData& client);
+	void saveMatch();
+	void openPlayerStore();
+	void writeState(Packet& state) const;
 	void trySpawnRainbowBall();
 	void spawnRainbowBall();
 	void checkRainbowBallTimeout();
 	void despawnRainbowBall();
-	void broadcastUpdatedScores();
-	void broadcastToClients(Packet& packet);
-
-	void predictedPosition(const ClientData& client);
-	void sendPlayerPositions();
+	void addRosterChange(RosterEvent type, const ClientData& client, int value);
+	void sendRosterUpdates();
+	void sendFullRoster(ClientData& client);
+	void broadcastToClients(Packet& packet, Opcode opcode);
+	MessageRef encodeMessage(const Packet& packet);
+	Socket::Status sendPacket(ClientData& client, Packet& packet, Opcode opcode);
+	Socket::Status queueMessage(ClientData& client, const MessageRef& message, Opcode opcode);
+	Socket::Status flushOutbound(ClientData& client);
+	void flushAllOutbound();
+
+	void predictedPosition(ClientData& client);
+	void sendSnapshots();
+	void sendPlayerPositions(float nowMs);
+	void sendPrioritisedPositions(float nowMs);
+	void markSnapshotSent(ClientData& client, float nowMs);
+	Time timeUntilNextSnapshot() const;
+	void publishWatchFrame(float nowMs);
+	void publishStatus(ClockType::time_point tickStart);
+	void reloadConfig();
 	void handleErrors(string func, Socket::Status status);
 };
 
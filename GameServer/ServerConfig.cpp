@@ -0,0 +1,131 @@
+#include "ServerConfig.h"
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+// Reads and writes one member of ServerConfig as a double, whatever its type
+#define SETTING(member, name, min, max, whole, live, description) \
+	{ name, description, min, max, whole, live, \
+		[](const ServerConfig& config) { return static_cast<double>(config.member); }, \
+		[](ServerConfig& config, double value) { config.member = static_cast<decltype(config.member)>(value); } }
+
+const vector<ConfigSetting>& configSettings() {
+	static const vector<ConfigSetting> settings = {
+		SETTING(port, "port", 1, 65535, true, false, "Port players connect to"),
+		SETTING(spectatorPort, "spectator-port", 1, 65535, true, false, "Port spectators and relays connect to"),
+		SETTING(maxPlayers, "max-players", 1, 1024, true, false, "Players per match; it starts once this many (bots included) are in"),
+		SETTING(bots, "bots", 0, 100000, true, false, "Server-side bots in the match"),
+		SETTING(idleWaitMs, "idle-wait-ms", 1, 1000, false, true, "Longest a tick waits on the sockets when no snapshot is due sooner"),
+		// The client decides a player has stopped sending after MAX_SNAPSHOT_INTERVAL_MS + SNAPSHOT_INTERVAL_MS (Client::gameLoop),
+		// so snapshots can't be any further apart than that without rebuilding the client too
+		SETTING(snapshotIntervalMs, "snapshot-interval-ms", 5, MAX_SNAPSHOT_INTERVAL_MS, false, true, "PLAYER_POSITIONS (and WATCH) interval for a client that keeps up"),
+		SETTING(maxSnapshotIntervalMs, "max-snapshot-interval-ms", 5, MAX_SNAPSHOT_INTERVAL_MS, false, true, "Furthest a congested client's snapshots back off to"),
+		SETTING(rainbowLifetimeSeconds, "rainbow-lifetime-seconds", 0.5, 600, false, true, "How long a rainbow ball stays (and the wait for the next one)"),
+		SETTING(predictionSmoothing, "prediction-smoothing", 0, 0.99, false, true, "Weight of a player's last known position against the extrapolated one in their predicted position"),
+		SETTING(sessionGraceSeconds, "session-grace-seconds", 0, 3600, false, true, "How long a dropped player's slot is kept for them to resume"),
+	};
+	return settings;
+}
+
+#undef SETTING
+
+const ConfigSetting* findConfigSetting(const string& name) {
+	for (const ConfigSetting& setting : configSettings()) {
+		if (name == setting.name) return &setting;
+	}
+	return nullptr;
+}
+
+bool setConfigValue(ServerConfig& config, const string& name, const string& value, string& error) {
+	const ConfigSetting* setting = findConfigSetting(name);
+	if (!setting) {
+		error = "There's no setting called " + name;
+		return false;
+	}
+
+	// The whole value has to be a number, so "30ms" or "3O" isn't quietly read as 30 or 3
+	char* end = nullptr;
+	errno = 0;
+	double number = strtod(value.c_str(), &end);
+	bool parsed = !value.empty() && *end == '\0' && errno == 0 && std::isfinite(number);
+	if (!parsed || number < setting->min || number > setting->max || (setting->whole && number != std::floor(number))) {
+		ostringstream message;
+		message << name << " has to be " << (setting->whole ? "a whole number " : "") << "between " << setting->min << " and " << setting->max << " (got \"" << value << "\")";
+		error = message.str();
+		return false;
+	}
+
+	setting->set(config, number);
+	return true;
+}
+
+bool loadConfigFile(const string& path, ServerConfig& config, string& error) {
+	ifstream file(path);
+	if (!file) {
+		error = "Could not open " + path;
+		return false;
+	}
+
+	auto trim = [](const string& text) {
+		size_t first = text.find_first_not_of(" \t\r");
+		size_t last = text.find_last_not_of(" \t\r");
+		return first == string::npos ? string() : text.substr(first, last - first + 1);
+	};
+
+	ServerConfig loaded = config;
+	string line;
+	for (int number = 1; getline(file, line); ++number) {
+		line = trim(line.substr(0, line.find('#')));
+		if (line.empty()) continue;
+
+		size_t equals = line.find('=');
+		string settingError = "Expected name = value";
+		if (equals == string::npos || !setConfigValue(loaded, trim(line.substr(0, equals)), trim(line.substr(equals + 1)), settingError)) {
+			error = path + ":" + to_string(number) + ": " + settingError;
+			return false;
+		}
+	}
+
+	config = loaded;
+	return true;
+}
+
+bool validateConfig(const ServerConfig& config, string& error) {
+	if (config.maxSnapshotIntervalMs < config.snapshotIntervalMs) {
+		error = "max-snapshot-interval-ms can't be less than snapshot-interval-ms";
+		return false;
+	}
+	if (config.port == config.spectatorPort) {
+		error = "port and spectator-port have to be different";
+		return false;
+	}
+	return true;
+}
+
+bool ConfigSource::load(ServerConfig& config, string& error) const {
+	ServerConfig loaded;
+	if (!path.empty() && !loadConfigFile(path, loaded, error)) return false;
+	for (const auto& option : overrides) {
+		if (!setConfigValue(loaded, option.first, option.second, error)) return false;
+	}
+	if (!validateConfig(loaded, error)) return false;
+
+	config = loaded;
+	return true;
+}
+
+void writeConfig(ostream& out, const ServerConfig& config) {
+	for (const ConfigSetting& setting : configSettings()) {
+		out << "# " << setting.description << (setting.live ? " (live)" : "") << "\n";
+		out << setting.name << " = " << setting.get(config) << "\n";
+	}
+}
+
+void writeConfigUsage(ostream& out) {
+	for (const ConfigSetting& setting : configSettings()) {
+		out << "  --" << setting.name << " " << setting.min << ".." << setting.max << (setting.live ? " (live)" : "") << "\n"
+			<< "      " << setting.description << "\n";
+	}
+}
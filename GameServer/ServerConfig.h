@@ -0,0 +1,74 @@
+#ifndef SERVER_CONFIG_H
+#define SERVER_CONFIG_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../Shared/GameConfig.h"
+
+using namespace std;
+
+constexpr size_t MAX_PLAYERS = 2; // The default players per match
+
+// What can be tuned without rebuilding the server. The defaults are the game as it has always played.
+//
+// Settings come from a config file (`GameServer --config FILE`, one `name = value` per line, # for comments) and then the
+// command line (`--name value`), which wins. Every value is checked against its range before the server starts. Live settings
+// can also be changed while the server runs: edit the file and send it SIGHUP (see Server::reloadConfig).
+struct ServerConfig {
+	// Startup only
+	unsigned short port = PORT;
+	unsigned short spectatorPort = SPECTATOR_PORT;
+	size_t maxPlayers = MAX_PLAYERS; // Humans per match. The match starts once this many (bots included) are in.
+	size_t bots = 0;
+
+	// Live
+	float idleWaitMs = 30.f;                     // Longest a tick waits on the sockets when no snapshot is due sooner
+	float snapshotIntervalMs = SNAPSHOT_INTERVAL_MS;
+	float maxSnapshotIntervalMs = MAX_SNAPSHOT_INTERVAL_MS; // How far a congested client's rate backs off (see Snapshots.h)
+	float rainbowLifetimeSeconds = RAINBOW_LIFETIME_SECONDS;
+	float predictionSmoothing = PREDICTION_SMOOTHING; // Weight of the last known position against the extrapolated one (see predictPosition)
+	float sessionGraceSeconds = 30.f;            // How long a dropped player's slot is kept for them to resume
+};
+
+// One setting, for parsing, checking and listing them all the same way
+struct ConfigSetting {
+	const char* name;
+	const char* description;
+	double min, max;
+	bool whole; // Has to be a whole number
+	bool live;  // Can be changed by a reload
+	double (*get)(const ServerConfig& config);
+	void (*set)(ServerConfig& config, double value);
+};
+
+const vector<ConfigSetting>& configSettings();
+const ConfigSetting* findConfigSetting(const string& name);
+
+// Set one setting from its text. False (with `error` saying why) if there's no such setting or the value isn't allowed.
+bool setConfigValue(ServerConfig& config, const string& name, const string& value, string& error);
+
+// Settings from a file, on top of what `config` already has. Nothing is changed unless the whole file is valid.
+bool loadConfigFile(const string& path, ServerConfig& config, string& error);
+
+// Checks between settings (each one's own range is checked as it's set)
+bool validateConfig(const ServerConfig& config, string& error);
+
+// Where the server's settings come from, kept so they can be read again on a reload
+struct ConfigSource {
+	string path; // Empty for no file
+	vector<pair<string, string>> overrides; // --name value from the command line, in order
+
+	// The defaults, then the file, then the overrides, then validateConfig
+	bool load(ServerConfig& config, string& error) const;
+};
+
+// `name = value` for every setting, in the config file's format
+void writeConfig(ostream& out, const ServerConfig& config);
+
+// `--name value` for every setting, with its range, for the usage message
+void writeConfigUsage(ostream& out);
+
+#endif
@@ -0,0 +1,55 @@
+#include "Snapshots.h"
+#include <algorithm>
+#include <cmath>
+
+/* ------------------------ SnapshotRate ------------------------ */
+
+void SnapshotRate::update(float rttMs, size_t queueDepth, unsigned droppedSinceLast, float minIntervalMs, float maxIntervalMs) {
+	if (rttMs > 0.f) minRttMs = minRttMs < 0.f ? rttMs : min(rttMs, minRttMs + 0.5f);
+
+	// More than a couple of snapshots waiting means the client (or the path to it) isn't keeping up with the current rate
+	bool rttInflated = minRttMs > 0.f && rttMs > 2.f * minRttMs + 20.f;
+	bool congested = droppedSinceLast > 0 || queueDepth > 2 || rttInflated;
+
+	if (congested) interval = min(interval * 1.5f, maxIntervalMs);
+	else interval = max(interval - 2.f, minIntervalMs);
+	interval = min(interval, maxIntervalMs); // The limits can change while the server runs
+}
+
+/* ------------------------ SnapshotPriority ------------------------ */
+
+namespace {
+	// 1 when on top of each other, 0 at `range` and beyond
+	float nearness(Vector2f a, Vector2f b, float range) {
+		float distance = hypot(a.x - b.x, a.y - b.y);
+		return distance >= range ? 0.f : 1.f - distance / range;
+	}
+}
+
+void SnapshotPriority::select(const SnapshotCandidate& viewer, const vector<SnapshotCandidate>& candidates, const Vector2f* rainbowBall, size_t budget, vector<size_t>& chosen) {
+	chosen.clear();
+	ranked.clear();
+
+	for (size_t i = 0; i < candidates.size(); ++i) {
+		const SnapshotCandidate& candidate = candidates[i];
+		if (candidate.ID == viewer.ID) continue;
+
+		// Everyone counts for something, players near us count most (squared, so the closest few stand out in a crowd), and so
+		// does anyone about to grab the rainbow ball. A candidate gets sent about weight / (sum of weights) * budget of the time.
+		float near = nearness(viewer.position, candidate.position, 400.f);
+		float weight = 0.25f + 10.f * near * near;
+		if (rainbowBall) weight += 2.f * nearness(*rainbowBall, candidate.position, 200.f);
+
+		float& total = accumulated[candidate.ID];
+		total += weight;
+		ranked.push_back({ total, i });
+	}
+
+	size_t count = min(budget, ranked.size());
+	partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(), [](const pair<float, size_t>& a, const pair<float, size_t>& b) { return a.first > b.first; });
+
+	for (size_t i = 0; i < count; ++i) {
+		chosen.push_back(ranked[i].second);
+		accumulated[candidates[ranked[i].second].ID] = 0.f;
+	}
+}
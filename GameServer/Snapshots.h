@@ -0,0 +1,66 @@
+#ifndef SNAPSHOTS_H
+#define SNAPSHOTS_H
+
+#include <SFML/System/Vector2.hpp>
+#include <unordered_map>
+#include <vector>
+#include "../Shared/GameConfig.h"
+
+using namespace std;
+using namespace sf;
+
+constexpr size_t SNAPSHOT_PLAYER_BUDGET = 32; // Up to this many players everyone gets everyone, past it each snapshot carries the 32 that matter most to that client
+
+// How often one client gets PLAYER_POSITIONS. Starts at the snapshot interval and backs off (up to the max snapshot interval)
+// when the client looks congested, then creeps back down once it's keeping up again. Same idea as TCP's congestion window:
+// back off quickly (x1.5) and recover slowly (-2 ms per snapshot), so a bad connection doesn't flap between the two.
+//
+// TCP never loses a message outright, so "loss" here means a snapshot we had to drop because the client's outbound queue was full.
+// The queue depth and the RTT climbing above the lowest we've seen are the earlier warnings of the same thing.
+class SnapshotRate {
+public:
+	explicit SnapshotRate(float intervalMs = SNAPSHOT_INTERVAL_MS) : interval(intervalMs) {}
+
+	// Call after each snapshot sent to this client, with what we know about its connection right now. The interval stays
+	// between the two limits (the server's snapshot-interval-ms and max-snapshot-interval-ms, see ServerConfig.h).
+	void update(float rttMs, size_t queueDepth, unsigned droppedSinceLast,
+		float minIntervalMs = SNAPSHOT_INTERVAL_MS, float maxIntervalMs = MAX_SNAPSHOT_INTERVAL_MS);
+
+	bool isDue(float nowMs) const { return nowMs - lastSentMs >= interval; }
+	void markSent(float nowMs) { lastSentMs = nowMs; }
+
+	float intervalMs() const { return interval; }
+	float nextDueMs() const { return lastSentMs + interval; }
+
+private:
+	float interval;
+	float lastSentMs = -1e9f;  // Due straight away
+	float minRttMs = -1.f;     // Lowest RTT seen, slowly forgotten so a route change doesn't stick forever
+};
+
+// An entity that could go into a snapshot
+struct SnapshotCandidate {
+	int ID;
+	Vector2f position;
+};
+
+// Picks which other players go into a client's snapshot when there are too many to send them all every time.
+//
+// Every snapshot, each candidate's accumulator grows by how much the viewer cares about it (more when it's close to them or
+// to the rainbow ball), the `budget` highest get sent and theirs go back to zero. Nearby players end up in almost every snapshot
+// and far away ones still get one every few, instead of never.
+class SnapshotPriority {
+public:
+	// `chosen` is cleared and filled with the indexes of up to `budget` candidates (never the viewer themselves).
+	// `rainbowBall` is null when there isn't one.
+	void select(const SnapshotCandidate& viewer, const vector<SnapshotCandidate>& candidates, const Vector2f* rainbowBall, size_t budget, vector<size_t>& chosen);
+
+	// Drop the accumulators of players who have left
+	void forget(int ID) { accumulated.erase(ID); }
+
+private:
+	unordered_map<int, float> accumulated;
+	vector<pair<float, size_t>> ranked; // (accumulated, candidate index), reused between snapshots
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include "Spectators.h"
+#include "../Shared/Logger.h"
+#include "../Shared/Metrics.h"
+#include <algorithm>
+#include <limits>
+
+SpectatorFeed::SpectatorFeed(MessagePool& pool, size_t capacity, float delayMs) : pool(pool), inbox(capacity), delayMs(delayMs) {
+	spectators.reserve(capacity);
+	newSockets.reserve(capacity);
+}
+
+void SpectatorFeed::adoptNew() {
+	newSockets.clear();
+	inbox.take(newSockets, spectators.size());
+	for (auto& socket : newSockets) add(move(socket));
+}
+
+void SpectatorFeed::add(unique_ptr<ClientSocket> socket) {
+	// Nothing is ever read from a spectator, so there's no reason to wait on one
+	socket->setBlocking(false);
+	Spectator spectator;
+	spectator.socket = move(socket);
+	spectators.push_back(move(spectator));
+	LOG_INFO("Spectator joined, %zu watching", spectators.size());
+}
+
+void SpectatorFeed::publish(const Packet& frame, float nowMs) {
+	held.emplace_back(nowMs + delayMs, pool.encode(frame.getData(), frame.getDataSize()));
+}
+
+void SpectatorFeed::update(float nowMs) {
+	// Frames that have waited out the delay go to everyone. Nobody watching: they're just let go.
+	size_t due = 0;
+	while (due < held.size() && held[due].first <= nowMs) due++;
+
+	for (size_t i = 0; i < spectators.size();) {
+		Spectator& spectator = spectators[i];
+		bool keep = true;
+		for (size_t frame = 0; frame < due && keep; ++frame) {
+			METRIC_PACKET_OUT(Opcode::Watch, held[frame].second.size() - sizeof(Uint32));
+
+			// A full queue means they've stopped reading, CAPACITY frames (several seconds) ago
+			if (!spectator.outbound.push(held[frame].second)) {
+				LOG_WARNING("Dropping a spectator who fell %zu frames behind", spectator.outbound.depth());
+				keep = false;
+			}
+		}
+		if (keep && !spectator.outbound.empty()) keep = flush(spectator);
+
+		if (keep) ++i;
+		else {
+			spectator.socket->disconnect();
+			spectators.erase(spectators.begin() + i);
+			LOG_INFO("Spectator left, %zu watching", spectators.size());
+		}
+	}
+	held.erase(held.begin(), held.begin() + due);
+}
+
+float SpectatorFeed::nextDueMs() const {
+	return held.empty() ? numeric_limits<float>::max() : held.front().first;
+}
+
+vector<int> SpectatorFeed::handles() const {
+	vector<int> result;
+	for (const auto& spectator : spectators) result.push_back(static_cast<int>(spectator.socket->getHandle()));
+	return result;
+}
+
+// Same as Server::flushOutbound, without the per-client metrics. False once the spectator has gone.
+bool SpectatorFeed::flush(Spectator& spectator) {
+#ifdef __linux__
+	OutboundQueue::FlushResult result = spectator.outbound.flush(spectator.socket->getHandle());
+	return result == OutboundQueue::FlushResult::Done || result == OutboundQueue::FlushResult::WouldBlock;
+#else
+	ConstBuffer piece;
+	while (spectator.outbound.gather(&piece, 1) == 1) {
+		size_t sent = 0;
+		Socket::Status status = spectator.socket->send(piece.data, piece.size, sent);
+		spectator.outbound.consume(sent);
+
+		if (status == Socket::NotReady || status == Socket::Partial) return true;
+		if (status != Socket::Done) return false;
+	}
+	return true;
+#endif
+}
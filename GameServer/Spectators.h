@@ -0,0 +1,71 @@
+#ifndef SPECTATORS_H
+#define SPECTATORS_H
+
+#include <SFML/Network.hpp>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "MessagePool.h"
+#include "Acceptor.h"
+
+using namespace std;
+using namespace sf;
+
+// Spectators connect to SPECTATOR_PORT and only ever receive. A server takes MAX_SPECTATORS itself; a bigger audience
+// watches through relays (GameServer --relay), which each take RELAY_MAX_SPECTATORS and only count as one spectator here.
+constexpr size_t MAX_SPECTATORS = 256;
+constexpr size_t RELAY_MAX_SPECTATORS = 1024;
+
+// Spectators see the match this far behind the players, so watching can't be used to tell a player where the others are
+constexpr float SPECTATOR_DELAY_MS = 2000.f;
+
+// Everyone watching one match (or one relay).
+//
+// Each WATCH frame (see Shared/Protocol.h) is encoded once into the MessagePool and every spectator's queue holds a
+// reference to that one buffer, so a frame costs the same to build for one spectator as for a thousand. Frames are held
+// for the delay, then queued for everyone. Spectators are never read from (they aren't in the server's selector either):
+// one that goes away is noticed when sending to it fails, and one that stops reading is dropped once its queue is full.
+class SpectatorFeed {
+public:
+	SpectatorFeed(MessagePool& pool, size_t capacity, float delayMs);
+
+	// Where the spectator port's Acceptor leaves new spectators
+	MatchInbox& getInbox() { return inbox; }
+
+	// Spectators the acceptor has let in since the last call
+	void adoptNew();
+
+	// A spectator handed over by the server process this one replaced (see Server::takeOver)
+	void add(unique_ptr<ClientSocket> socket);
+
+	// Encodes `frame` once. It goes out to every spectator delayMs after `nowMs`.
+	void publish(const Packet& frame, float nowMs);
+
+	// Queues the frames that are due and sends whatever the sockets will take
+	void update(float nowMs);
+
+	// When the next held frame is due (a very large number if there isn't one)
+	float nextDueMs() const;
+
+	size_t size() const { return spectators.size(); }
+
+	// For the hot restart: the spectators' sockets, in order
+	vector<int> handles() const;
+
+private:
+	struct Spectator {
+		unique_ptr<ClientSocket> socket;
+		OutboundQueue outbound;
+	};
+
+	bool flush(Spectator& spectator);
+
+	MessagePool& pool;
+	MatchInbox inbox;
+	float delayMs;
+	deque<pair<float, MessageRef>> held; // Frames waiting out the delay, oldest first, with when they're due
+	vector<Spectator> spectators;
+	vector<unique_ptr<ClientSocket>> newSockets; // Taken from the inbox (kept to reuse its storage)
+};
+
+#endif
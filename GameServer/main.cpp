@@ -1,10 +1,191 @@
 #include "Server.h"
+#include "Handoff.h"
+#include "Relay.h"
+#include "AdminServer.h"
+#include "ServerConfig.h"
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
 
-int main() {
+static int usage() {
+	cerr << "Usage: GameServer [--takeover] [--config FILE] [--admin [HOST:]PORT] [--print-config] [--SETTING VALUE]...\n"
+		<< "       GameServer --relay HOST[:PORT] [--spectator-port N]\n"
+		<< "Settings (also in the config file, as SETTING = VALUE; live ones are read again on SIGHUP):\n";
+	writeConfigUsage(cerr);
+	return 1;
+}
+
+// A port number on the command line: all digits, 1-65535
+static bool parsePort(const string& text, unsigned short& port) {
+	if (text.empty() || text[0] < '0' || text[0] > '9') return false; // strtoul would take a sign or spaces
+	char* end = nullptr;
+	unsigned long value = strtoul(text.c_str(), &end, 10);
+	if (*end != '\0' || value < 1 || value > 65535) return false;
+	port = static_cast<unsigned short>(value);
+	return true;
+}
+
+// Spectators watch from behind relays and LAN parties more often than players play from them, so more get in per IP
+static AdmissionPolicy spectatorPolicy() {
+	AdmissionPolicy policy;
+	policy.connectionsPerSecondPerIp = 20.f;
+	policy.burstPerIp = 50.f;
+	return policy;
+}
+
+// GameServer --relay: pass another server's spectators' view on to our own spectators (see Relay.h)
+static int runRelay(const string& upstream, unsigned short spectatorPort) {
+	string host = upstream;
+	unsigned short upstreamPort = SPECTATOR_PORT;
+	size_t colon = upstream.rfind(':');
+	if (colon != string::npos) {
+		host = upstream.substr(0, colon);
+		if (!parsePort(upstream.substr(colon + 1), upstreamPort)) return usage();
+	}
+
+	Acceptor acceptor(spectatorPort, spectatorPolicy());
+	if (!acceptor.isListening()) return 1;
+
+	Relay relay(host, upstreamPort);
+	acceptor.addWorker(relay.getInbox());
+	acceptor.start();
+	relay.run();
+	acceptor.stop();
+	return 0;
+}
+
+int main(int argc, char* argv[]) {
 	srand(static_cast<unsigned int>(time(nullptr)));
 
-	Server server;
-	server.run();
+	bool takeover = false;
+	bool printConfig = false;
+	string relayFrom;
+	string admin;
+	ConfigSource configSource;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--takeover") == 0) takeover = true;
+		else if (strcmp(argv[i], "--relay") == 0 && i + 1 < argc) relayFrom = argv[++i];
+		else if (strcmp(argv[i], "--admin") == 0 && i + 1 < argc) admin = argv[++i];
+		else if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) configSource.path = argv[++i];
+		else if (strcmp(argv[i], "--print-config") == 0) printConfig = true;
+		else if (strncmp(argv[i], "--", 2) == 0 && findConfigSetting(argv[i] + 2) && i + 1 < argc) {
+			configSource.overrides.emplace_back(argv[i] + 2, argv[i + 1]);
+			++i;
+		}
+		else return usage();
+	}
+
+	// Everything is checked before anything starts
+	ServerConfig config;
+	string configError;
+	if (!configSource.load(config, configError)) {
+		cerr << configError << "\n";
+		return 1;
+	}
+	// What the server would run with, as a config file to start from
+	if (printConfig) {
+		writeConfig(cout, config);
+		return 0;
+	}
+	if (takeover && config.bots > 0) return usage();
+	if (!relayFrom.empty() && !admin.empty()) return usage(); // A relay has no match to show
+
+	// --admin [HOST:]PORT serves metrics and the match over HTTP (see AdminServer.h). Only on this machine unless a HOST is given.
+	string adminHost = "127.0.0.1";
+	unsigned short adminPort = 0;
+	if (!admin.empty()) {
+		size_t colon = admin.rfind(':');
+		if (colon != string::npos) adminHost = admin.substr(0, colon);
+		if (!parsePort(admin.substr(colon == string::npos ? 0 : colon + 1), adminPort)) return usage();
+	}
+
+	// Ctrl+C stops the server (or relay) cleanly so the metrics below still get written
+	signal(SIGINT, [](int) { Server::requestStop(); Relay::requestStop(); });
+#ifdef SIGHUP
+	signal(SIGHUP, [](int) { Server::requestReload(); });
+#endif
+
+	// Set CORPLIFE_TRACE=<file.json> to record metrics and a Chrome trace of this run
+	const char* tracePath = getenv("CORPLIFE_TRACE");
+	Metrics::setEnabled(tracePath != nullptr || !admin.empty()); // The admin endpoint serves them too
+
+	if (!relayFrom.empty()) {
+		int result = takeover || config.bots > 0 ? usage() : runRelay(relayFrom, config.spectatorPort);
+		if (tracePath) {
+			Metrics::writeSummary(cout);
+			if (!Metrics::writeChromeTrace(tracePath)) cerr << "Could not write the trace to " << tracePath << "\n";
+		}
+		return result;
+	}
+
+	// Hot restart: a server started with --takeover carries on from the one that's running, over the Unix socket at
+	// CORPLIFE_HANDOFF. It has to get everything before it opens the player store, which the old server closes to send it.
+	const char* handoffEnv = getenv("CORPLIFE_HANDOFF");
+	string handoffPath = handoffEnv ? handoffEnv : "corplife.handoff";
+	HandoffChannel handoff;
+	Packet handedState;
+	vector<int> handedSockets; // The two listening sockets, then the players', then the spectators'
+	if (takeover && (!handoff.connect(handoffPath) || !handoff.receive(handedState, handedSockets) || handedSockets.size() < 2)) {
+		cerr << "Could not take over from the running server.\n";
+		return 1;
+	}
+
+	// The acceptor takes connections on its own thread and hands the match the ones it has room for. Spectators have their
+	// own port and acceptor, so a crowd of them can never hold a player up.
+	unique_ptr<Acceptor> acceptor = takeover
+		? make_unique<Acceptor>(AdoptedListener{ handedSockets[0] })
+		: make_unique<Acceptor>(config.port);
+	unique_ptr<Acceptor> spectatorAcceptor = takeover
+		? make_unique<Acceptor>(AdoptedListener{ handedSockets[1] }, spectatorPolicy())
+		: make_unique<Acceptor>(config.spectatorPort, spectatorPolicy());
+	if (!acceptor->isListening() || !spectatorAcceptor->isListening()) return 1;
+
+	Server server(config, configSource);
+	if (takeover) {
+		// If this fails the old server never gets the acknowledgement and carries on. It also carries on if we took too long
+		// (HandoffChannel::TIMEOUT_SECONDS), and then the acknowledgement can't be sent.
+		if (!server.takeOver(handedState, vector<int>(handedSockets.begin() + 2, handedSockets.end()))) return 1;
+		if (!handoff.acknowledge()) {
+			cerr << "The running server stopped waiting for us to take over, leaving the match to it.\n";
+			server.abandonTakeOver();
+			return 1;
+		}
+	}
+	else server.addBots(config.bots); // A server taking over gets the old one's bots along with the match
+	if (handoff.listen(handoffPath)) server.enableHotRestart(&handoff);
+
+	StatusBoard statusBoard;
+	unique_ptr<AdminServer> adminServer;
+	if (!admin.empty()) {
+		adminServer = make_unique<AdminServer>(IpAddress(adminHost), adminPort, statusBoard);
+		server.enableAdmin(&statusBoard);
+		adminServer->start();
+	}
+
+	acceptor->addWorker(server.getInbox());
+	acceptor->start();
+	spectatorAcceptor->addWorker(server.getSpectatorInbox());
+	spectatorAcceptor->start();
+
+	// run() also returns when a new server wants to take over. If the handover doesn't work out, this one carries on.
+	for (;;) {
+		server.run();
+		if (!server.replacementWaiting()) break;
+
+		acceptor->stop();
+		spectatorAcceptor->stop();
+		if (server.handOver(acceptor->getListenerHandle(), spectatorAcceptor->getListenerHandle())) break;
+		acceptor->start();
+		spectatorAcceptor->start();
+	}
+	acceptor->stop();
+	spectatorAcceptor->stop();
+	if (adminServer) adminServer->stop();
+
+	if (tracePath) {
+		Metrics::writeSummary(cout);
+		if (!Metrics::writeChromeTrace(tracePath)) cerr << "Could not write the trace to " << tracePath << "\n";
+	}
 
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,36 @@
+#!/bin/sh
+# Plays a headless two player match under each network profile here and keeps what each run measured:
+#   <profile>-server.txt  the server's metrics (prediction_error_px, client_rtt_ms, snapshot_interval_ms, ...)
+#   <profile>-<name>.json each client's --stats (own_prediction_error_px, prediction_fallbacks, emulated_delay_ms, ...)
+#
+# Usage: NetProfiles/sweep.sh BUILD_DIR [OUT_DIR] [FRAMES]
+# BUILD_DIR has GameServer and Client1 in it. Port 5555 has to be free.
+# SERVER_ARGS is passed on to the server, to sweep its settings too, e.g.
+#   for ms in 15 30 60; do SERVER_ARGS="--snapshot-interval-ms $ms" NetProfiles/sweep.sh build results-$ms; done
+
+set -e
+build=${1:?Usage: sweep.sh BUILD_DIR [OUT_DIR] [FRAMES]}
+out=${2:-netem-results}
+frames=${3:-1800}
+profiles=$(cd "$(dirname "$0")" && pwd)
+
+mkdir -p "$out"
+for profile in "$profiles"/*.netem; do
+	name=$(basename "$profile" .netem)
+	echo "Profile $name..."
+
+	# The server's metrics summary is printed when it shuts down. Its own store and handoff socket, so it doesn't touch the real ones.
+	CORPLIFE_TRACE="$out/$name-trace.json" CORPLIFE_STORE="$out/store" CORPLIFE_HANDOFF="$out/handoff" \
+		"$build/GameServer" $SERVER_ARGS > "$out/$name-server.txt" 2>&1 &
+	server=$!
+	sleep 1
+
+	"$build/Client1" --headless --name Alice --frames "$frames" --netem "$profile" --stats "$out/$name-Alice.json" > "$out/$name-Alice.txt" 2>&1 &
+	alice=$!
+	"$build/Client1" --headless --name Bob --frames "$frames" --netem "$profile" --stats "$out/$name-Bob.json" > "$out/$name-Bob.txt" 2>&1
+	wait $alice
+
+	kill -INT $server
+	wait $server || true
+done
+echo "Results in $out"
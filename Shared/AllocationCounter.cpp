@@ -0,0 +1,111 @@
+#include "AllocationCounter.h"
+#include <cstdlib>
+#include <new>
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+namespace {
+	thread_local uint64_t allocations = 0;
+}
+
+namespace AllocationCounter {
+
+	bool isActive() {
+#ifdef CORPLIFE_COUNT_ALLOCATIONS
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	uint64_t count() {
+		return allocations;
+	}
+}
+
+#ifdef CORPLIFE_COUNT_ALLOCATIONS
+
+// Replacement global allocation functions. The nothrow forms of operator new / delete forward to these.
+void* operator new(std::size_t size) {
+	allocations++;
+	if (void* memory = std::malloc(size ? size : 1)) return memory;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+	allocations++;
+	if (void* memory = std::malloc(size ? size : 1)) return memory;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+	std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+	std::free(memory);
+}
+
+#ifdef __cpp_aligned_new
+
+// The over-aligned forms (alignas bigger than the default, e.g. a cache-line aligned buffer) don't go through the ones
+// above, so they're counted here too
+namespace {
+	void* allocateAligned(std::size_t size, std::align_val_t alignment) {
+		allocations++;
+		std::size_t align = static_cast<std::size_t>(alignment);
+#ifdef _MSC_VER
+		void* memory = _aligned_malloc(size ? size : 1, align);
+#else
+		std::size_t rounded = size == 0 ? align : (size + align - 1) / align * align; // aligned_alloc wants a multiple of the alignment
+		void* memory = std::aligned_alloc(align, rounded);
+#endif
+		if (!memory) throw std::bad_alloc();
+		return memory;
+	}
+
+	void freeAligned(void* memory) {
+#ifdef _MSC_VER
+		_aligned_free(memory);
+#else
+		std::free(memory);
+#endif
+	}
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+	return allocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+	return allocateAligned(size, alignment);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+	freeAligned(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept {
+	freeAligned(memory);
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept {
+	freeAligned(memory);
+}
+
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept {
+	freeAligned(memory);
+}
+
+#endif
+
+#endif
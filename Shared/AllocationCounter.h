@@ -0,0 +1,43 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <cstdint>
+
+// Counts heap allocations made by the calling thread.
+// Building with CORPLIFE_COUNT_ALLOCATIONS replaces the global operator new to do the counting. Without it, count() is always 0.
+namespace AllocationCounter {
+	bool isActive();
+	uint64_t count();
+}
+
+// Checks that a loop iteration makes no heap allocations once it has warmed up.
+// Code we don't own (e.g. SFML's window event queue) can be left out with exclude() / include().
+class FrameAllocationCheck {
+public:
+	explicit FrameAllocationCheck(uint64_t warmupFrames) : warmupFrames(warmupFrames) {}
+
+	void beginFrame() {
+		frameStart = AllocationCounter::count();
+		excluded = 0;
+	}
+
+	void exclude() { excludeStart = AllocationCounter::count(); }
+	void include() { excluded += AllocationCounter::count() - excludeStart; }
+
+	// Allocations made during this frame (not counting excluded sections)
+	uint64_t endFrame() {
+		frameNumber++;
+		return AllocationCounter::count() - frameStart - excluded;
+	}
+
+	bool warmedUp() const { return frameNumber > warmupFrames; }
+
+private:
+	uint64_t warmupFrames;
+	uint64_t frameNumber = 0;
+	uint64_t frameStart = 0;
+	uint64_t excludeStart = 0;
+	uint64_t excluded = 0;
+};
+
+#endif
@@ -0,0 +1,163 @@
+#include "Collision.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CORPLIFE_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit AVX2 in functions marked for it, so the rest of the program still runs on any x86 CPU. MSVC emits
+// whatever intrinsics it's given.
+#if defined(CORPLIFE_X86) && (defined(__GNUC__) || defined(__clang__))
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#else
+#define AVX2_FUNCTION
+#endif
+
+namespace {
+
+	/* ------------------------ Scalar ------------------------ */
+
+	// The same sums as ShapeTest<Circle, Circle>, so both kernels and the one-pair test always agree
+	void findFirstOverlapsScalar(const CircleBatch& players, const CircleBatch& collectibles, int32_t* firstHit, size_t from) {
+		float touchDistance = players.radius + collectibles.radius;
+		float touchSquared = touchDistance * touchDistance;
+
+		for (size_t i = from; i < players.count; ++i) {
+			firstHit[i] = NO_OVERLAP;
+			for (size_t j = 0; j < collectibles.count; ++j) {
+				float dx = players.x[i] - collectibles.x[j];
+				float dy = players.y[i] - collectibles.y[j];
+				if (dx * dx + dy * dy < touchSquared) {
+					firstHit[i] = static_cast<int32_t>(j);
+					break;
+				}
+			}
+		}
+	}
+
+	size_t findFirstOverlapScalar(const CircleBatch& circles, const Circle& circle, size_t from) {
+		float touchDistance = circles.radius + circle.radius;
+		float touchSquared = touchDistance * touchDistance;
+
+		for (size_t i = from; i < circles.count; ++i) {
+			float dx = circles.x[i] - circle.x;
+			float dy = circles.y[i] - circle.y;
+			if (dx * dx + dy * dy < touchSquared) return i;
+		}
+		return NO_CIRCLE;
+	}
+
+	/* ------------------------ AVX2 ------------------------ */
+
+#ifdef CORPLIFE_X86
+	// Eight players at a time against one collectible after another. Players who have found theirs drop out of the mask, and
+	// once all eight have, the rest of the collectibles are skipped. Overlaps are rare, so that part needn't be fast.
+	AVX2_FUNCTION void findFirstOverlapsAvx2(const CircleBatch& players, const CircleBatch& collectibles, int32_t* firstHit) {
+		float touchDistance = players.radius + collectibles.radius;
+		const __m256 touchSquared = _mm256_set1_ps(touchDistance * touchDistance);
+
+		size_t i = 0;
+		for (; i + 8 <= players.count; i += 8) {
+			__m256 x = _mm256_loadu_ps(players.x + i);
+			__m256 y = _mm256_loadu_ps(players.y + i);
+			for (size_t lane = 0; lane < 8; ++lane) firstHit[i + lane] = NO_OVERLAP;
+
+			int searching = 0xFF;
+			for (size_t j = 0; j < collectibles.count && searching; ++j) {
+				__m256 dx = _mm256_sub_ps(x, _mm256_set1_ps(collectibles.x[j]));
+				__m256 dy = _mm256_sub_ps(y, _mm256_set1_ps(collectibles.y[j]));
+				__m256 distanceSquared = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+				int touching = _mm256_movemask_ps(_mm256_cmp_ps(distanceSquared, touchSquared, _CMP_LT_OQ)) & searching;
+				if (touching == 0) continue;
+
+				for (size_t lane = 0; lane < 8; ++lane) {
+					if (touching & (1 << lane)) firstHit[i + lane] = static_cast<int32_t>(j);
+				}
+				searching &= ~touching;
+			}
+		}
+		findFirstOverlapsScalar(players, collectibles, firstHit, i);
+	}
+
+	AVX2_FUNCTION size_t findFirstOverlapAvx2(const CircleBatch& circles, const Circle& circle) {
+		float touchDistance = circles.radius + circle.radius;
+		const __m256 touchSquared = _mm256_set1_ps(touchDistance * touchDistance);
+		const __m256 centreX = _mm256_set1_ps(circle.x);
+		const __m256 centreY = _mm256_set1_ps(circle.y);
+
+		size_t i = 0;
+		for (; i + 8 <= circles.count; i += 8) {
+			__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(circles.x + i), centreX);
+			__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(circles.y + i), centreY);
+			__m256 distanceSquared = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+			int touching = _mm256_movemask_ps(_mm256_cmp_ps(distanceSquared, touchSquared, _CMP_LT_OQ));
+			if (touching == 0) continue;
+
+			for (size_t lane = 0; lane < 8; ++lane) {
+				if (touching & (1 << lane)) return i + lane;
+			}
+		}
+		return findFirstOverlapScalar(circles, circle, i);
+	}
+#endif
+
+	/* ------------------------ Picking one ------------------------ */
+
+	bool cpuHasAvx2() {
+#if defined(CORPLIFE_X86) && (defined(__GNUC__) || defined(__clang__))
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") != 0;
+#elif defined(CORPLIFE_X86) && defined(_MSC_VER)
+		// The CPU has to have it, and the OS has to save the AVX registers on a context switch
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) return false;
+		__cpuid(info, 1);
+		bool osSavesAvx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+		if (!osSavesAvx) return false;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return false;
+#endif
+	}
+
+	CollisionKernel& currentKernel() {
+		static CollisionKernel kernel = cpuHasAvx2() ? CollisionKernel::Avx2 : CollisionKernel::Scalar;
+		return kernel;
+	}
+}
+
+void findFirstOverlaps(const CircleBatch& players, const CircleBatch& collectibles, int32_t* firstHit) {
+#ifdef CORPLIFE_X86
+	if (currentKernel() == CollisionKernel::Avx2) {
+		findFirstOverlapsAvx2(players, collectibles, firstHit);
+		return;
+	}
+#endif
+	findFirstOverlapsScalar(players, collectibles, firstHit, 0);
+}
+
+size_t findFirstOverlap(const CircleBatch& circles, const Circle& circle) {
+#ifdef CORPLIFE_X86
+	if (currentKernel() == CollisionKernel::Avx2) return findFirstOverlapAvx2(circles, circle);
+#endif
+	return findFirstOverlapScalar(circles, circle, 0);
+}
+
+CollisionKernel collisionKernel() {
+	return currentKernel();
+}
+
+bool setCollisionKernel(CollisionKernel kernel) {
+	if (kernel == CollisionKernel::Avx2 && !cpuHasAvx2()) return false;
+	currentKernel() = kernel;
+	return true;
+}
+
+const char* collisionKernelName(CollisionKernel kernel) {
+	return kernel == CollisionKernel::Avx2 ? "avx2" : "scalar";
+}
@@ -0,0 +1,106 @@
+#ifndef COLLISION_H
+#define COLLISION_H
+
+#include <cstddef>
+#include <cstdint>
+#include "GameConfig.h"
+
+// Overlap tests between shapes, all on squared distances (no square roots), plus batch versions that test many players
+// against many collectibles at once with AVX2 where the CPU has it. No SFML, so it can be used and benchmarked anywhere.
+//
+// Shapes touching exactly at their edges don't count as overlapping.
+
+struct Circle {
+	float x, y; // Centre
+	float radius;
+};
+
+struct Box {
+	float left, top, right, bottom;
+};
+
+// The game draws players and the rainbow ball as sf::CircleShapes, positioned by their top-left corner
+inline Circle playerCircle(float left, float top) {
+	return { left + PLAYER_RADIUS, top + PLAYER_RADIUS, PLAYER_RADIUS };
+}
+
+inline Circle rainbowCircle(float left, float top) {
+	return { left + RAINBOW_RADIUS, top + RAINBOW_RADIUS, RAINBOW_RADIUS };
+}
+
+/* ------------------------ One pair ------------------------ */
+
+// Specialised for each pair of shapes in one order. The other order comes from the primary template, which swaps them.
+template <typename A, typename B>
+struct ShapeTest {
+	static bool overlaps(const A& a, const B& b) { return ShapeTest<B, A>::overlaps(b, a); }
+};
+
+template <>
+struct ShapeTest<Circle, Circle> {
+	static bool overlaps(const Circle& a, const Circle& b) {
+		float dx = a.x - b.x;
+		float dy = a.y - b.y;
+		float touchDistance = a.radius + b.radius;
+		return dx * dx + dy * dy < touchDistance * touchDistance;
+	}
+};
+
+template <>
+struct ShapeTest<Circle, Box> {
+	static bool overlaps(const Circle& circle, const Box& box) {
+		// The nearest point of the box to the centre
+		float nearestX = circle.x < box.left ? box.left : (circle.x > box.right ? box.right : circle.x);
+		float nearestY = circle.y < box.top ? box.top : (circle.y > box.bottom ? box.bottom : circle.y);
+		float dx = circle.x - nearestX;
+		float dy = circle.y - nearestY;
+		return dx * dx + dy * dy < circle.radius * circle.radius;
+	}
+};
+
+template <>
+struct ShapeTest<Box, Box> {
+	static bool overlaps(const Box& a, const Box& b) {
+		return a.left < b.right && b.left < a.right && a.top < b.bottom && b.top < a.bottom;
+	}
+};
+
+template <typename A, typename B>
+bool overlaps(const A& a, const B& b) {
+	return ShapeTest<A, B>::overlaps(a, b);
+}
+
+/* ------------------------ Batches ------------------------ */
+
+// Circles of one size, with their centres in two arrays (x and y apart, so eight can be loaded at once)
+struct CircleBatch {
+	const float* x;
+	const float* y;
+	size_t count;
+	float radius;
+};
+
+constexpr int32_t NO_OVERLAP = -1;
+constexpr size_t NO_CIRCLE = static_cast<size_t>(-1);
+
+// For each circle in `players`, the index of the first circle in `collectibles` it overlaps, or NO_OVERLAP.
+// `firstHit` must have room for players.count entries.
+void findFirstOverlaps(const CircleBatch& players, const CircleBatch& collectibles, int32_t* firstHit);
+
+// The index of the first circle in `circles` that overlaps `circle`, or NO_CIRCLE
+size_t findFirstOverlap(const CircleBatch& circles, const Circle& circle);
+
+// Which code the batch tests run. It's picked the first time they're used: AVX2 if this CPU (and build) has it.
+enum class CollisionKernel {
+	Scalar,
+	Avx2
+};
+
+CollisionKernel collisionKernel();
+
+// For the benchmarks, to compare the two on the same machine. False if `kernel` can't run here.
+bool setCollisionKernel(CollisionKernel kernel);
+
+const char* collisionKernelName(CollisionKernel kernel);
+
+#endif
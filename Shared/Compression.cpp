@@ -0,0 +1,161 @@
+#include "Compression.h"
+#include <cstring>
+
+namespace {
+
+	// The preset dictionary. sf::Packet writes a string as a 4 byte big-endian length and the characters, and every number
+	// big-endian, so these are the byte sequences that show up in our large messages: the command strings, small IDs and
+	// scores (mostly zero bytes), name lengths, the spawn position (100.f) and names the headless clients use.
+	// Don't change it without bumping COMPRESSION_DICTIONARY_VERSION.
+	const char DICTIONARY[] =
+		"\0\0\0\x06" "RESYNC"
+		"\0\0\0\x05" "SPAWN"
+		"\0\0\0\x08" "Headless"
+		"\0\0\0\x06" "Player"
+		"\x42\xc8\0\0" "\x42\xc8\0\0"
+		"\0\0\0\0" "\0\0\0\x01" "\0\0\0\x02" "\0\0\0\x03" "\0\0\0\x04" "\0\0\0\x05" "\0\0\0\x06" "\0\0\0\x07"
+		"\0\0\0\x08" "\0\0\0\x09" "\0\0\0\x0a" "\0\0\0\x0b" "\0\0\0\x0c" "\0\0\0\x0d" "\0\0\0\x0e" "\0\0\0\x0f"
+		"\0\0\0\0" "\0\0\0\0" "\0\0\0\0" "\0\0\0\0"
+		"\0\0\0\x06" "ROSTER"
+		"\0\0\0\x0b" "ROSTER_FULL"
+		"\0\0\0\x10" "PLAYER_POSITIONS";
+	constexpr size_t DICTIONARY_SIZE = sizeof(DICTIONARY) - 1;
+
+	constexpr size_t MIN_MATCH = 4;
+	constexpr size_t MAX_OFFSET = 65535;
+	constexpr int HASH_BITS = 12;
+
+	uint32_t read32(const char* p) {
+		uint32_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	uint32_t hash(uint32_t sequence) {
+		return (sequence * 2654435761u) >> (32 - HASH_BITS);
+	}
+
+	// Lengths over 15 continue in extra bytes: 255 means "and more", anything less ends it
+	void writeLength(std::vector<char>& out, size_t length) {
+		while (length >= 255) {
+			out.push_back(static_cast<char>(255));
+			length -= 255;
+		}
+		out.push_back(static_cast<char>(length));
+	}
+
+	bool readLength(const unsigned char*& in, const unsigned char* end, size_t& length) {
+		unsigned char byte;
+		do {
+			if (in == end) return false;
+			byte = *in++;
+			length += byte;
+			if (length > MAX_DECOMPRESSED_SIZE) return false;
+		} while (byte == 255);
+		return true;
+	}
+
+	// One sequence: a token (literal length << 4 | match length - 4), the literals, then the match's offset and length
+	void writeSequence(std::vector<char>& out, const char* literals, size_t literalLength, size_t offset, size_t matchLength) {
+		size_t matchCode = matchLength - MIN_MATCH;
+		unsigned char token = static_cast<unsigned char>(((literalLength < 15 ? literalLength : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+		out.push_back(static_cast<char>(token));
+		if (literalLength >= 15) writeLength(out, literalLength - 15);
+		out.insert(out.end(), literals, literals + literalLength);
+
+		out.push_back(static_cast<char>(offset & 0xff));
+		out.push_back(static_cast<char>(offset >> 8));
+		if (matchCode >= 15) writeLength(out, matchCode - 15);
+	}
+}
+
+Compressor::Compressor(bool useDictionary) : useDictionary(useDictionary), table(size_t(1) << HASH_BITS) {}
+
+void Compressor::compress(const void* data, size_t size, std::vector<char>& out) {
+	out.clear();
+	size_t dictionarySize = useDictionary ? DICTIONARY_SIZE : 0;
+
+	window.assign(DICTIONARY, DICTIONARY + dictionarySize);
+	window.insert(window.end(), static_cast<const char*>(data), static_cast<const char*>(data) + size);
+	const char* base = window.data();
+	size_t end = window.size();
+
+	// Start with every position of the dictionary in the table, so the message's first bytes can already match
+	table.assign(table.size(), -1);
+	for (size_t position = 0; position + MIN_MATCH <= dictionarySize; ++position) {
+		table[hash(read32(base + position))] = static_cast<int32_t>(position);
+	}
+
+	size_t position = dictionarySize;
+	size_t anchor = position; // Start of the literals not written yet
+	while (position + MIN_MATCH <= end) {
+		uint32_t sequence = read32(base + position);
+		uint32_t slot = hash(sequence);
+		int32_t candidate = table[slot];
+		table[slot] = static_cast<int32_t>(position);
+
+		if (candidate < 0 || position - candidate > MAX_OFFSET || read32(base + candidate) != sequence) {
+			position++;
+			continue;
+		}
+
+		size_t length = MIN_MATCH;
+		while (position + length < end && base[candidate + length] == base[position + length]) length++;
+
+		writeSequence(out, base + anchor, position - anchor, position - candidate, length);
+		position += length;
+		anchor = position;
+	}
+
+	// Whatever is left goes out as literals, in a last token without a match (the input ending there is how the other side knows)
+	size_t literalLength = end - anchor;
+	out.push_back(static_cast<char>((literalLength < 15 ? literalLength : 15) << 4));
+	if (literalLength >= 15) writeLength(out, literalLength - 15);
+	out.insert(out.end(), base + anchor, base + end);
+}
+
+bool Compressor::decompress(const void* data, size_t size, size_t rawSize, std::vector<char>& out) {
+	if (rawSize > MAX_DECOMPRESSED_SIZE) return false;
+	size_t dictionarySize = useDictionary ? DICTIONARY_SIZE : 0;
+
+	// Decoded after the dictionary, so copies can reach back into it
+	window.resize(dictionarySize + rawSize);
+	memcpy(window.data(), DICTIONARY, dictionarySize);
+	char* output = window.data();
+	size_t produced = dictionarySize;
+	size_t limit = window.size();
+
+	const unsigned char* in = static_cast<const unsigned char*>(data);
+	const unsigned char* inEnd = in + size;
+
+	while (in < inEnd) {
+		unsigned char token = *in++;
+
+		size_t literalLength = token >> 4;
+		if (literalLength == 15 && !readLength(in, inEnd, literalLength)) return false;
+		if (literalLength > static_cast<size_t>(inEnd - in) || literalLength > limit - produced) return false;
+		memcpy(output + produced, in, literalLength);
+		in += literalLength;
+		produced += literalLength;
+
+		if (in == inEnd) break; // The last sequence has no match
+
+		if (inEnd - in < 2) return false;
+		size_t offset = in[0] | (in[1] << 8);
+		in += 2;
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !readLength(in, inEnd, matchLength)) return false;
+		matchLength += MIN_MATCH;
+
+		if (offset == 0 || offset > produced || matchLength > limit - produced) return false;
+
+		// Byte by byte: the copy may overlap what it's writing (a short pattern repeated)
+		const char* from = output + produced - offset;
+		for (size_t i = 0; i < matchLength; ++i) output[produced + i] = from[i];
+		produced += matchLength;
+	}
+
+	if (produced != limit) return false;
+	out.assign(window.begin() + dictionarySize, window.end());
+	return true;
+}
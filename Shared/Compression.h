@@ -0,0 +1,48 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compression for the bigger server messages (score tables, resyncs, snapshots in big matches).
+//
+// It's LZ77 in LZ4's block format: runs of literal bytes, each followed by a copy of earlier bytes (2 byte offset + length).
+// Our messages are short, so on their own there's little earlier data to copy from. Both sides therefore start with the same
+// preset dictionary (the command strings, field encodings and value patterns our messages are made of), which the first
+// copies can point back into. Changing the dictionary breaks old clients, so bump COMPRESSION_DICTIONARY_VERSION when you do.
+//
+// No heap allocations once the scratch buffers have grown to the largest message, so the client can unpack in the game loop.
+
+// Smaller messages are sent as they are: not worth the CPU, and they barely shrink
+constexpr size_t COMPRESSION_THRESHOLD = 256;
+
+// Largest message a compressed one may expand to, so a bad size field can't make the receiver allocate gigabytes
+constexpr size_t MAX_DECOMPRESSED_SIZE = 1 << 20;
+
+// Largest packet PacketStream accepts off the wire, so a bad length prefix can't either. The biggest thing sent is an
+// uncompressed WATCH frame, about 50 bytes a player, which is 5 MB with the most bots ServerConfig allows.
+constexpr size_t MAX_PACKET_SIZE = 8 << 20;
+
+// Sent with every compressed message, so a client with another dictionary drops the message instead of decoding garbage
+constexpr uint8_t COMPRESSION_DICTIONARY_VERSION = 2;
+
+class Compressor {
+public:
+	// Without the dictionary it's plain LZ77 (for the benchmarks, to see what the dictionary is worth)
+	explicit Compressor(bool useDictionary = true);
+
+	// Replaces `out` with the compressed form of `data`. It can come out bigger than `size` for data that doesn't repeat.
+	void compress(const void* data, size_t size, std::vector<char>& out);
+
+	// Replaces `out` with the `rawSize` bytes `data` decompresses to. False (and `out` undefined) if `data` is malformed or
+	// doesn't decompress to exactly `rawSize` bytes.
+	bool decompress(const void* data, size_t size, size_t rawSize, std::vector<char>& out);
+
+private:
+	bool useDictionary;
+	std::vector<char> window;   // Dictionary followed by the message, so copies can reach back into the dictionary
+	std::vector<int32_t> table; // Last position each 4 byte sequence was seen at (by hash)
+};
+
+#endif
@@ -0,0 +1,198 @@
+#include "Decoders.h"
+#include "Compression.h"
+#include "GameConfig.h"
+#include <cmath>
+#include <limits>
+
+using namespace std;
+using namespace sf;
+
+namespace {
+	// Anything this far out is garbage, not a position (the play area is WINDOW_WIDTH x WINDOW_HEIGHT)
+	constexpr float MAX_COORDINATE = 1000000.f;
+
+	// The smallest each repeated entry can be, so a count can be checked against the bytes left before anything is resized
+	constexpr size_t MIN_ROSTER_EVENT_SIZE = 1 + 4;          // Type, ID (a Leave)
+	constexpr size_t MIN_FULL_ROSTER_ENTRY_SIZE = 4 + 4 + 4; // ID, empty name, score
+	constexpr size_t MIN_WATCH_PLAYER_SIZE = 4 + 4 + 4 + 4 + 4; // ID, x, y, score, empty name
+
+	bool isCoordinate(float value) {
+		return std::isfinite(value) && std::fabs(value) <= MAX_COORDINATE;
+	}
+
+	size_t remaining(const Packet& packet) {
+		return packet.getDataSize() - packet.getReadPosition();
+	}
+
+	bool isValid(const SpawnMessage& spawn) {
+		return isCoordinate(spawn.x) && isCoordinate(spawn.y) && std::isfinite(spawn.spawnTime);
+	}
+
+	// Names from the server. It cuts them to MAX_NAME_LENGTH, so a longer one didn't come from it.
+	bool isName(const string& name) {
+		return name.size() <= MAX_NAME_LENGTH;
+	}
+}
+
+/* ------------------------ Client -> Server ------------------------ */
+
+bool decodePlayerName(Packet& packet, string& name) {
+	if (!(packet >> name)) return false;
+
+	if (name.size() > MAX_NAME_LENGTH) name.resize(MAX_NAME_LENGTH);
+	for (char& c : name) {
+		if (static_cast<unsigned char>(c) < ' ') c = '?'; // Names end up in logs and on everyone's scoreboard
+	}
+	return true;
+}
+
+bool decodeUpdatePosition(Packet& packet, UpdatePositionMessage& update, InputEcho& echo) {
+	Schema::MessageReader reader = Schema::reader(packet);
+	if (!reader.read(update)) return false;
+	if (!isCoordinate(update.x) || !isCoordinate(update.y) || !isCoordinate(update.moveX) || !isCoordinate(update.moveY)) return false;
+
+	// Clients that haven't had a PLAYER_POSITIONS yet don't send one, and very old ones send only the timestamp
+	if (reader.atEnd() || !reader.read(echo)) echo = {};
+	return true;
+}
+
+bool decodeResume(Packet& packet, ResumeMessage& resume) {
+	return Schema::reader(packet).read(resume);
+}
+
+bool decodeRosterRequest(Packet& packet, uint32_t& version) {
+	Uint32 have = 0;
+	if (!(packet >> have)) return false;
+	version = have;
+	return true;
+}
+
+/* ------------------------ Server -> Client ------------------------ */
+
+bool decodePlayerPositions(Packet& packet, vector<PlayerPositionEntry>& entries) {
+	constexpr size_t ENTRY_SIZE = Schema::size<PlayerPositionEntry>();
+	size_t bytes = remaining(packet);
+	if (bytes % ENTRY_SIZE != 0) return false;
+
+	entries.resize(bytes / ENTRY_SIZE);
+	Schema::MessageReader reader = Schema::reader(packet);
+	for (PlayerPositionEntry& entry : entries) {
+		reader.read(entry); // Can't come up short, the size was checked above
+		if (entry.ID < 0 || !isCoordinate(entry.x) || !isCoordinate(entry.y)) return false;
+	}
+	return true;
+}
+
+bool decodePlayerId(Packet& packet, PlayerIdMessage& id) {
+	return Schema::reader(packet).read(id) && id.ID >= 0;
+}
+
+bool decodeSpawn(Packet& packet, SpawnMessage& spawn) {
+	return Schema::reader(packet).read(spawn) && isValid(spawn);
+}
+
+bool decodeResync(Packet& packet, ResyncMessage& resync, SpawnMessage& spawn) {
+	Schema::MessageReader reader = Schema::reader(packet);
+	if (!reader.read(resync)) return false;
+	if (resync.ID < 0 || !isCoordinate(resync.x) || !isCoordinate(resync.y) || resync.rainbowBall > 2) return false;
+	return resync.rainbowBall != 2 || (reader.read(spawn) && isValid(spawn));
+}
+
+bool decodeLobby(Packet& packet, LobbyStatus& status) {
+	Uint8 value = 0;
+	if (!(packet >> value) || value > static_cast<Uint8>(LobbyStatus::Full)) return false;
+	status = static_cast<LobbyStatus>(value);
+	return true;
+}
+
+bool decodeRoster(Packet& packet, uint32_t& firstVersion, vector<RosterEntry>& events) {
+	Uint32 first = 0;
+	Uint16 count = 0;
+	if (!(packet >> first >> count) || count == 0) return false;
+	if (count - 1u > numeric_limits<uint32_t>::max() - first) return false; // The last version would wrap round
+	if (count > remaining(packet) / MIN_ROSTER_EVENT_SIZE) return false;
+
+	events.resize(count);
+	for (RosterEntry& event : events) {
+		Uint8 type = 0;
+		Int32 ID = 0, value = 0;
+		packet >> type >> ID;
+		if (type == static_cast<Uint8>(RosterEvent::Join)) packet >> event.name >> value;
+		else if (type == static_cast<Uint8>(RosterEvent::Score)) packet >> value;
+
+		if (type > static_cast<Uint8>(RosterEvent::Score) || ID < 0) return false;
+		event.type = static_cast<RosterEvent>(type);
+		if (event.type != RosterEvent::Join) event.name.clear(); // Not left over from an earlier message
+		else if (!isName(event.name)) return false;
+		event.ID = ID;
+		event.value = value;
+	}
+
+	// Reads after one has come up short do nothing (and the count was checked), so the packet only needs checking at the end
+	if (!packet) return false;
+	firstVersion = first;
+	return true;
+}
+
+bool decodeFullRoster(Packet& packet, uint32_t& version, vector<RosterEntry>& players) {
+	Uint32 upTo = 0, count = 0;
+	if (!(packet >> upTo >> count)) return false;
+	if (count > remaining(packet) / MIN_FULL_ROSTER_ENTRY_SIZE) return false;
+
+	players.resize(count);
+	for (RosterEntry& player : players) {
+		Int32 ID = 0, score = 0;
+		packet >> ID >> player.name >> score;
+		if (ID < 0 || !isName(player.name)) return false;
+		player.type = RosterEvent::Join;
+		player.ID = ID;
+		player.value = score;
+	}
+	if (!packet) return false; // As in decodeRoster
+
+	version = upTo;
+	return true;
+}
+
+bool decodePackedHeader(Packet& packet, uint8_t& dictionaryVersion, uint32_t& rawSize) {
+	Uint8 version = 0;
+	Uint32 size = 0;
+	if (!(packet >> version >> size) || packet.getReadPosition() != PACKED_HEADER_SIZE) return false;
+	if (size == 0 || size > MAX_DECOMPRESSED_SIZE) return false;
+
+	dictionaryVersion = version;
+	rawSize = size;
+	return true;
+}
+
+/* ------------------------ Server -> Spectator ------------------------ */
+
+bool decodeWatch(Packet& packet, WatchFrame& frame) {
+	Uint32 number = 0;
+	Uint8 flags = 0;
+	if (!(packet >> number >> flags)) return false;
+
+	frame.rainbow = {};
+	if (flags & WATCH_RAINBOW_BALL) {
+		packet >> frame.rainbow.x >> frame.rainbow.y >> frame.rainbow.r >> frame.rainbow.g >> frame.rainbow.b;
+		if (!packet || !isValid(frame.rainbow)) return false;
+	}
+
+	Uint16 count = 0;
+	if (!(packet >> count) || count > remaining(packet) / MIN_WATCH_PLAYER_SIZE) return false;
+
+	frame.players.resize(count);
+	for (RosterEntry& player : frame.players) {
+		Int32 ID = 0, score = 0;
+		packet >> ID >> player.x >> player.y >> score >> player.name;
+		if (ID < 0 || !isCoordinate(player.x) || !isCoordinate(player.y) || !isName(player.name)) return false;
+		player.type = RosterEvent::Join;
+		player.ID = ID;
+		player.value = score;
+	}
+	if (!packet) return false; // As in decodeRoster
+
+	frame.frame = number;
+	frame.flags = flags;
+	return true;
+}
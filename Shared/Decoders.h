@@ -0,0 +1,67 @@
+#ifndef DECODERS_H
+#define DECODERS_H
+
+#include <SFML/Network.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Protocol.h"
+
+// The one place every received message is read and checked. Each decoder takes a packet that has had its command read
+// and fills in the message, or returns false if the message is truncated or holds something no honest peer sends: a
+// position that isn't a finite number, an enum value that doesn't exist, a count bigger than the packet could hold.
+// Nothing is applied from a message that fails, so the caller just drops it.
+//
+// They don't touch sockets, clocks or game state, which is what lets Fuzz/ throw garbage at every one of them and
+// Benchmarks/DecoderBenchmark time them on their own.
+
+// One ROSTER event, one ROSTER_FULL player (type Join) or one WATCH player (value is the score)
+struct RosterEntry {
+	RosterEvent type = RosterEvent::Join;
+	int32_t ID = 0;
+	std::string name;  // Join only
+	int32_t value = 0; // Join: score, Score: change in score
+	float x = 0.f;     // WATCH only
+	float y = 0.f;
+};
+
+struct WatchFrame {
+	uint32_t frame = 0;
+	uint8_t flags = 0;   // WatchFlags
+	SpawnMessage rainbow = {}; // If flags has WATCH_RAINBOW_BALL (spawnTime isn't sent)
+	std::vector<RosterEntry> players;
+};
+
+/* ------------------------ Client -> Server ------------------------ */
+
+// Names longer than MAX_NAME_LENGTH are cut, so an old client with a long one still gets in
+bool decodePlayerName(sf::Packet& packet, std::string& name);
+
+// `echo` is zero if the client didn't send one
+bool decodeUpdatePosition(sf::Packet& packet, UpdatePositionMessage& update, InputEcho& echo);
+bool decodeResume(sf::Packet& packet, ResumeMessage& resume);
+bool decodeRosterRequest(sf::Packet& packet, uint32_t& version);
+
+/* ------------------------ Server -> Client ------------------------ */
+
+// `entries` is reused, so once it has grown to the match size this doesn't allocate
+bool decodePlayerPositions(sf::Packet& packet, std::vector<PlayerPositionEntry>& entries);
+bool decodePlayerId(sf::Packet& packet, PlayerIdMessage& id);
+bool decodeSpawn(sf::Packet& packet, SpawnMessage& spawn);
+
+// `spawn` is only filled in when resync.rainbowBall is 2
+bool decodeResync(sf::Packet& packet, ResyncMessage& resync, SpawnMessage& spawn);
+bool decodeLobby(sf::Packet& packet, LobbyStatus& status);
+
+// `entries` (and the names in them) are reused, like decodePlayerPositions
+bool decodeRoster(sf::Packet& packet, uint32_t& firstVersion, std::vector<RosterEntry>& events);
+bool decodeFullRoster(sf::Packet& packet, uint32_t& version, std::vector<RosterEntry>& players);
+
+// Only the header: the compressed bytes start at PACKED_HEADER_SIZE
+bool decodePackedHeader(sf::Packet& packet, uint8_t& dictionaryVersion, uint32_t& rawSize);
+
+/* ------------------------ Server -> Spectator ------------------------ */
+
+bool decodeWatch(sf::Packet& packet, WatchFrame& frame);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef GAME_CONFIG_H
+#define GAME_CONFIG_H
+
+// Game configuration shared by the client and server. Both sides used to keep their own copies of these
+// (and the rainbow ball radius was 17 on one and 7 on the other), so anything both sides rely on lives here now.
+
+constexpr unsigned short PORT = 5555;
+constexpr unsigned short SPECTATOR_PORT = 5556; // Watching only (see GameServer/Spectators.h)
+
+// Size of the play area. The client window is opened at this size and positions are clamped to it.
+constexpr float WINDOW_WIDTH = 1700.f;
+constexpr float WINDOW_HEIGHT = 900.f;
+
+// Shapes are positioned by their top-left corner (SFML's default origin), so a shape's centre is position + radius
+constexpr float PLAYER_RADIUS = 15.f;
+constexpr float RAINBOW_RADIUS = 7.f;
+
+// Where every new player starts, top-left corner (a resumed player carries on from where they were, bots start anywhere)
+constexpr float PLAYER_SPAWN_X = 100.f;
+constexpr float PLAYER_SPAWN_Y = 100.f;
+
+// Movement (see step() in Simulation.h)
+constexpr float MOVE_SPEED = 400.f;      // Pixels per second
+constexpr float DEAD_ZONE_RADIUS = 5.f;  // Don't move when the mouse is this close, to prevent jittering
+
+// Server-side prediction (see predictPosition() in Simulation.h)
+constexpr float PREDICTION_SMOOTHING = 0.6f; // Weight of the last known position against the extrapolated one (the server's default)
+constexpr float MAX_PREDICTION_DRIFT = 50.f; // Give up on a prediction this far from the last known position
+constexpr unsigned POSITION_HISTORY_SIZE = 4;
+
+// Timing
+constexpr int SNAPSHOT_INTERVAL_MS = 30;       // PLAYER_POSITIONS is sent this often to a client with a good connection...
+constexpr int MAX_SNAPSHOT_INTERVAL_MS = 120;  // ...and backs off as far as this one for a congested one (see GameServer/Snapshots.h)
+constexpr int INPUT_HEARTBEAT_MS = 250;        // A client that isn't moving still sends UPDATE_POSITION this often
+constexpr int INPUT_TICK_MS = SNAPSHOT_INTERVAL_MS / 2; // The client reads input, moves and talks to the server on this fixed tick, whatever its frame rate (see Client1/FramePacer.h)
+constexpr int RAINBOW_LIFETIME_SECONDS = 5;    // A rainbow ball despawns (and a new one spawns) after this long
+
+// Player names are cut to this many bytes by the server, the same as the player store keeps
+constexpr unsigned MAX_NAME_LENGTH = 31;
+
+#endif
@@ -0,0 +1,183 @@
+#include "Logger.h"
+#include <chrono>
+#include <cstdarg>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+	int64_t steadyMicros() {
+		static const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+	}
+
+	const char* levelName(LogLevel level) {
+		switch (level) {
+		case LogLevel::Debug: return "DEBUG";
+		case LogLevel::Info: return "INFO ";
+		case LogLevel::Warning: return "WARN ";
+		case LogLevel::Error: return "ERROR";
+		default: return "     ";
+		}
+	}
+
+	// Bounded multi-producer ring (each slot carries a sequence number, so producers never lock) drained by one background thread
+	class LogRing {
+	public:
+		LogRing() {
+			for (size_t i = 0; i < Logger::RING_SLOTS; ++i) slots[i].sequence.store(i, memory_order_relaxed);
+			worker = thread([this] { drainLoop(); });
+		}
+
+		~LogRing() {
+			stopping = true;
+			worker.join();
+		}
+
+		void push(LogLevel level, const char* function, uint32_t suppressed, const char* format, va_list args) {
+			size_t position = enqueuePosition.load(memory_order_relaxed);
+			Slot* slot;
+			for (;;) {
+				slot = &slots[position % Logger::RING_SLOTS];
+				size_t sequence = slot->sequence.load(memory_order_acquire);
+				intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+				if (difference == 0) {
+					if (enqueuePosition.compare_exchange_weak(position, position + 1, memory_order_relaxed)) break;
+				}
+				else if (difference < 0) {
+					// Full. Never block the caller, just drop the line.
+					dropped.fetch_add(1, memory_order_relaxed);
+					return;
+				}
+				else position = enqueuePosition.load(memory_order_relaxed);
+			}
+
+			slot->level = level;
+			slot->function = function;
+			slot->suppressed = suppressed;
+			slot->micros = steadyMicros();
+			vsnprintf(slot->text, sizeof(slot->text), format, args);
+			slot->sequence.store(position + 1, memory_order_release);
+		}
+
+		void flush() {
+			size_t target = enqueuePosition.load(memory_order_acquire);
+			while (written.load(memory_order_acquire) < target) this_thread::sleep_for(chrono::milliseconds(1));
+		}
+
+		atomic<FILE*> output{ stdout };
+		atomic<FILE*> errorOutput{ stderr };
+		atomic<uint64_t> dropped{ 0 };
+
+	private:
+		struct Slot {
+			atomic<size_t> sequence;
+			LogLevel level;
+			const char* function;
+			uint32_t suppressed;
+			int64_t micros;
+			char text[Logger::LINE_LENGTH];
+		};
+
+		// Writes out everything that's ready. Returns false if there was nothing to write.
+		bool drain() {
+			bool any = false;
+			bool usedOutput = false, usedErrorOutput = false;
+
+			for (;;) {
+				Slot& slot = slots[dequeuePosition % Logger::RING_SLOTS];
+				if (slot.sequence.load(memory_order_acquire) != dequeuePosition + 1) break;
+
+				bool isError = slot.level >= LogLevel::Warning;
+				FILE* file = isError ? errorOutput.load() : output.load();
+				fprintf(file, "[%9.3f] %s %s: %s", slot.micros / 1e6, levelName(slot.level), slot.function, slot.text);
+				if (slot.suppressed) fprintf(file, " (%u similar lines suppressed)", slot.suppressed);
+				fputc('\n', file);
+				(isError ? usedErrorOutput : usedOutput) = true;
+
+				slot.sequence.store(dequeuePosition + Logger::RING_SLOTS, memory_order_release);
+				++dequeuePosition;
+				any = true;
+			}
+
+			// One flush per batch instead of one per line
+			if (usedOutput) fflush(output.load());
+			if (usedErrorOutput) fflush(errorOutput.load());
+			written.store(dequeuePosition, memory_order_release);
+			return any;
+		}
+
+		void drainLoop() {
+			while (!stopping) {
+				if (!drain()) this_thread::sleep_for(chrono::milliseconds(2));
+			}
+			drain();
+		}
+
+		Slot slots[Logger::RING_SLOTS];
+		atomic<size_t> enqueuePosition{ 0 };
+		size_t dequeuePosition = 0; // Only the background thread touches this
+		atomic<size_t> written{ 0 };
+		atomic<bool> stopping{ false };
+		thread worker;
+	};
+
+	LogRing& ring() {
+		static LogRing instance;
+		return instance;
+	}
+}
+
+bool LogRateLimiter::allow(uint32_t& suppressedOut) {
+	int64_t now = steadyMicros();
+	int64_t start = windowStart.load(memory_order_relaxed);
+	if (now - start >= 1000000 && windowStart.compare_exchange_strong(start, now, memory_order_relaxed)) {
+		usedInWindow.store(0, memory_order_relaxed);
+	}
+
+	if (usedInWindow.fetch_add(1, memory_order_relaxed) < perSecond) {
+		suppressedOut = suppressed.exchange(0, memory_order_relaxed);
+		return true;
+	}
+
+	suppressed.fetch_add(1, memory_order_relaxed);
+	return false;
+}
+
+namespace Logger {
+
+	namespace detail {
+		atomic<int> runtimeLevel{ CORPLIFE_LOG_LEVEL };
+	}
+
+	void setLevel(LogLevel level) {
+		detail::runtimeLevel.store(static_cast<int>(level), memory_order_relaxed);
+	}
+
+	LogLevel getLevel() {
+		return static_cast<LogLevel>(detail::runtimeLevel.load(memory_order_relaxed));
+	}
+
+	void setOutput(FILE* output, FILE* errorOutput) {
+		ring().flush();
+		ring().output = output;
+		ring().errorOutput = errorOutput;
+	}
+
+	void flush() {
+		ring().flush();
+	}
+
+	uint64_t droppedCount() {
+		return ring().dropped.load(memory_order_relaxed);
+	}
+
+	void write(LogLevel level, const char* function, uint32_t suppressed, const char* format, ...) {
+		va_list args;
+		va_start(args, format);
+		ring().push(level, function, suppressed, format, args);
+		va_end(args);
+	}
+}
@@ -0,0 +1,119 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+// Asynchronous logger for the hot paths (game loop, tick).
+//
+// LOG_* formats the line straight into a slot of a fixed ring buffer and returns. A background thread writes the
+// slots out and flushes once per batch, so the render/tick thread never waits on the console.
+// If the ring is full the line is dropped (and counted) rather than blocking.
+//
+// Levels below CORPLIFE_LOG_LEVEL are compiled out completely (their arguments aren't even evaluated).
+// Every LOG_* call site is also rate limited on its own, so a message printed every frame can't flood the output.
+
+enum class LogLevel {
+	Debug = 0,
+	Info = 1,
+	Warning = 2,
+	Error = 3,
+	Off = 4
+};
+
+// Lowest level that gets compiled in. Debug builds keep everything, release builds drop LOG_DEBUG.
+#ifndef CORPLIFE_LOG_LEVEL
+#ifdef NDEBUG
+#define CORPLIFE_LOG_LEVEL 1
+#else
+#define CORPLIFE_LOG_LEVEL 0
+#endif
+#endif
+
+// Default number of lines per second each call site may write before the rest are suppressed
+constexpr uint32_t LOG_DEFAULT_RATE = 20;
+
+// Token bucket, one per call site (a static inside the LOG_* macro)
+class LogRateLimiter {
+public:
+	explicit LogRateLimiter(uint32_t perSecond) : perSecond(perSecond) {}
+
+	// True if this line may be written. Lines that weren't are added up and reported with the next one that is.
+	bool allow(uint32_t& suppressedOut);
+
+private:
+	uint32_t perSecond;
+	std::atomic<int64_t> windowStart{ 0 };
+	std::atomic<uint32_t> usedInWindow{ 0 };
+	std::atomic<uint32_t> suppressed{ 0 };
+};
+
+namespace Logger {
+
+	constexpr size_t RING_SLOTS = 1024;
+	constexpr size_t LINE_LENGTH = 240;
+
+	void setLevel(LogLevel level);
+	LogLevel getLevel();
+
+	// Where lines end up. Warnings and errors go to errorOutput. Defaults are stdout / stderr.
+	void setOutput(FILE* output, FILE* errorOutput);
+
+	// Blocks until everything logged so far has been written
+	void flush();
+
+	// Lines dropped because the ring was full
+	uint64_t droppedCount();
+
+	void write(LogLevel level, const char* function, uint32_t suppressed, const char* format, ...)
+#if defined(__GNUC__) || defined(__clang__)
+		__attribute__((format(printf, 4, 5)))
+#endif
+		;
+
+	namespace detail {
+		extern std::atomic<int> runtimeLevel;
+	}
+
+	// Inline so a disabled level costs one relaxed load and a branch
+	inline bool shouldLog(LogLevel level) {
+		return static_cast<int>(level) >= detail::runtimeLevel.load(std::memory_order_relaxed);
+	}
+}
+
+#define LOG_LIMITED(level, perSecond, ...) do { \
+		if (Logger::shouldLog(level)) { \
+			static LogRateLimiter logRateLimiter(perSecond); \
+			uint32_t logSuppressed = 0; \
+			if (logRateLimiter.allow(logSuppressed)) Logger::write(level, __func__, logSuppressed, __VA_ARGS__); \
+		} \
+	} while (0)
+
+#define LOG_AT(level, ...) LOG_LIMITED(level, LOG_DEFAULT_RATE, __VA_ARGS__)
+
+#if CORPLIFE_LOG_LEVEL <= 0
+#define LOG_DEBUG(...) LOG_AT(LogLevel::Debug, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) ((void)0)
+#endif
+
+#if CORPLIFE_LOG_LEVEL <= 1
+#define LOG_INFO(...) LOG_AT(LogLevel::Info, __VA_ARGS__)
+#else
+#define LOG_INFO(...) ((void)0)
+#endif
+
+#if CORPLIFE_LOG_LEVEL <= 2
+#define LOG_WARNING(...) LOG_AT(LogLevel::Warning, __VA_ARGS__)
+#else
+#define LOG_WARNING(...) ((void)0)
+#endif
+
+#if CORPLIFE_LOG_LEVEL <= 3
+#define LOG_ERROR(...) LOG_AT(LogLevel::Error, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,346 @@
+#include "Metrics.h"
+#include <chrono>
+#include <fstream>
+#include <memory>
+
+using namespace std;
+
+namespace Metrics {
+
+	namespace {
+
+		struct TraceEvent {
+			const char* name;
+			uint64_t start;
+			uint64_t duration;
+		};
+
+		// Everything one thread records. Only the owning thread writes, so a relaxed load + store is enough (no locked read-modify-write on the hot path).
+		struct ThreadShard {
+			uint32_t threadIndex = 0;
+			atomic<uint64_t> counters[COUNTER_COUNT] = {};
+			atomic<uint64_t> packetsIn[OPCODE_COUNT] = {};
+			atomic<uint64_t> packetsOut[OPCODE_COUNT] = {};
+			atomic<uint64_t> sendFailures[STATUS_COUNT] = {};
+			atomic<uint64_t> buckets[HISTOGRAM_COUNT][HISTOGRAM_BUCKETS] = {};
+			atomic<uint64_t> histogramMax[HISTOGRAM_COUNT] = {};
+			atomic<uint64_t> histogramSum[HISTOGRAM_COUNT] = {};
+
+			unique_ptr<TraceEvent[]> trace{ new TraceEvent[TRACE_CAPACITY] };
+			atomic<uint64_t> traceWritten{ 0 };
+		};
+
+		atomic<ThreadShard*> shards[MAX_THREADS] = {};
+		atomic<uint32_t> shardCount{ 0 };
+		const chrono::steady_clock::time_point processStart = chrono::steady_clock::now();
+
+		// Registers the calling thread's shard the first time it records anything. Shards live until the process exits so readers never see them freed.
+		ThreadShard* localShard() {
+			thread_local ThreadShard* shard = [] {
+				uint32_t index = shardCount.fetch_add(1, memory_order_relaxed);
+				if (index >= MAX_THREADS) return static_cast<ThreadShard*>(nullptr);
+
+				ThreadShard* created = new ThreadShard();
+				created->threadIndex = index;
+				shards[index].store(created, memory_order_release);
+				return created;
+			}();
+			return shard;
+		}
+
+		inline void bump(atomic<uint64_t>& value, uint64_t amount) {
+			value.store(value.load(memory_order_relaxed) + amount, memory_order_relaxed);
+		}
+
+		size_t bucketFor(uint64_t value) {
+			size_t bucket = 0;
+			while (value != 0 && bucket < HISTOGRAM_BUCKETS - 1) {
+				value >>= 1;
+				++bucket;
+			}
+			return bucket;
+		}
+
+		template <typename Visit>
+		void forEachShard(Visit visit) {
+			uint32_t count = shardCount.load(memory_order_acquire);
+			if (count > MAX_THREADS) count = MAX_THREADS;
+			for (uint32_t i = 0; i < count; ++i) {
+				ThreadShard* shard = shards[i].load(memory_order_acquire);
+				if (shard) visit(*shard);
+			}
+		}
+
+		const char* statusName(size_t status) {
+			switch (status) {
+			case sf::Socket::Done: return "Done";
+			case sf::Socket::NotReady: return "NotReady";
+			case sf::Socket::Partial: return "Partial";
+			case sf::Socket::Disconnected: return "Disconnected";
+			default: return "Error";
+			}
+		}
+
+		const char* histogramName(size_t histogram) {
+			switch (static_cast<Histogram>(histogram)) {
+			case Histogram::TickDurationUs: return "tick_duration_us";
+			case Histogram::QueueDepth: return "queue_depth";
+			case Histogram::PredictionErrorPx: return "prediction_error_px";
+			case Histogram::ClientRttMs: return "client_rtt_ms";
+			case Histogram::FrameTimeUs: return "frame_time_us";
+			case Histogram::OutboundQueueDepth: return "outbound_queue_depth";
+			case Histogram::InputToSendUs: return "input_to_send_us";
+			case Histogram::DrawCalls: return "draw_calls";
+			case Histogram::TimeToFirstFrameMs: return "time_to_first_frame_ms";
+			case Histogram::AcceptBatchSize: return "accept_batch_size";
+			case Histogram::SnapshotIntervalMs: return "snapshot_interval_ms";
+			case Histogram::HandoffPauseUs: return "handoff_pause_us";
+			case Histogram::OwnPredictionErrorPx: return "own_prediction_error_px";
+			case Histogram::EmulatedDelayMs: return "emulated_delay_ms";
+			default: return "unknown";
+			}
+		}
+
+		const char* counterName(size_t counter) {
+			switch (static_cast<Counter>(counter)) {
+			case Counter::PacketsIn: return "packets_in";
+			case Counter::PacketsOut: return "packets_out";
+			case Counter::BytesIn: return "bytes_in";
+			case Counter::BytesOut: return "bytes_out";
+			case Counter::SendFailures: return "send_failures";
+			case Counter::ConnectionsAccepted: return "connections_accepted";
+			case Counter::ConnectionsRejected: return "connections_rejected";
+			case Counter::ConnectionsThrottled: return "connections_throttled";
+			case Counter::CompressionSavedBytes: return "compression_saved_bytes";
+			case Counter::RosterResyncs: return "roster_resyncs";
+			case Counter::PredictionFallbacks: return "prediction_fallbacks";
+			case Counter::EmulatedRetransmits: return "emulated_retransmits";
+			case Counter::MissedFrameDeadlines: return "missed_frame_deadlines";
+			case Counter::SkippedInputTicks: return "skipped_input_ticks";
+			default: return "unknown";
+			}
+		}
+	}
+
+	namespace detail {
+		atomic<bool> enabled{ false };
+	}
+
+	void setEnabled(bool value) {
+		detail::enabled.store(value, memory_order_relaxed);
+	}
+
+	uint64_t nowMicros() {
+		// +1 so a real timestamp is never 0 (ScopedSpan uses 0 for "not recording")
+		return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - processStart).count() + 1;
+	}
+
+	void add(Counter counter, uint64_t amount) {
+		if (ThreadShard* shard = localShard()) bump(shard->counters[static_cast<size_t>(counter)], amount);
+	}
+
+	void record(Histogram histogram, uint64_t value) {
+		ThreadShard* shard = localShard();
+		if (!shard) return;
+
+		size_t index = static_cast<size_t>(histogram);
+		bump(shard->buckets[index][bucketFor(value)], 1);
+		bump(shard->histogramSum[index], value);
+		if (value > shard->histogramMax[index].load(memory_order_relaxed)) shard->histogramMax[index].store(value, memory_order_relaxed);
+	}
+
+	void countPacketIn(Opcode opcode, size_t bytes) {
+		ThreadShard* shard = localShard();
+		if (!shard) return;
+
+		bump(shard->packetsIn[static_cast<size_t>(opcode)], 1);
+		bump(shard->counters[static_cast<size_t>(Counter::PacketsIn)], 1);
+		bump(shard->counters[static_cast<size_t>(Counter::BytesIn)], bytes);
+	}
+
+	void countPacketOut(Opcode opcode, size_t bytes) {
+		ThreadShard* shard = localShard();
+		if (!shard) return;
+
+		bump(shard->packetsOut[static_cast<size_t>(opcode)], 1);
+		bump(shard->counters[static_cast<size_t>(Counter::PacketsOut)], 1);
+		bump(shard->counters[static_cast<size_t>(Counter::BytesOut)], bytes);
+	}
+
+	void countSendFailure(sf::Socket::Status status) {
+		ThreadShard* shard = localShard();
+		if (!shard) return;
+
+		size_t index = static_cast<size_t>(status);
+		if (index >= STATUS_COUNT) index = sf::Socket::Error;
+		bump(shard->sendFailures[index], 1);
+		bump(shard->counters[static_cast<size_t>(Counter::SendFailures)], 1);
+	}
+
+	void recordSpan(const char* name, uint64_t startMicros, uint64_t endMicros) {
+		ThreadShard* shard = localShard();
+		if (!shard) return;
+
+		uint64_t written = shard->traceWritten.load(memory_order_relaxed);
+		shard->trace[written % TRACE_CAPACITY] = { name, startMicros, endMicros - startMicros };
+		shard->traceWritten.store(written + 1, memory_order_release);
+	}
+
+	uint64_t total(Counter counter) {
+		uint64_t sum = 0;
+		forEachShard([&](ThreadShard& shard) { sum += shard.counters[static_cast<size_t>(counter)].load(memory_order_relaxed); });
+		return sum;
+	}
+
+	// Approximate percentile: the upper bound of the power-of-two bucket the percentile falls in
+	uint64_t percentile(Histogram histogram, double fraction) {
+		size_t index = static_cast<size_t>(histogram);
+		uint64_t buckets[HISTOGRAM_BUCKETS] = {};
+		uint64_t count = 0;
+		forEachShard([&](ThreadShard& shard) {
+			for (size_t b = 0; b < HISTOGRAM_BUCKETS; ++b) {
+				uint64_t value = shard.buckets[index][b].load(memory_order_relaxed);
+				buckets[b] += value;
+				count += value;
+			}
+		});
+		if (count == 0) return 0;
+
+		uint64_t target = static_cast<uint64_t>(fraction * count);
+		uint64_t seen = 0;
+		for (size_t b = 0; b < HISTOGRAM_BUCKETS; ++b) {
+			seen += buckets[b];
+			if (seen > target) return b == 0 ? 0 : (uint64_t(1) << b) - 1;
+		}
+		return UINT64_MAX;
+	}
+
+	uint64_t count(Histogram histogram) {
+		size_t index = static_cast<size_t>(histogram);
+		uint64_t sum = 0;
+		forEachShard([&](ThreadShard& shard) {
+			for (size_t b = 0; b < HISTOGRAM_BUCKETS; ++b) sum += shard.buckets[index][b].load(memory_order_relaxed);
+		});
+		return sum;
+	}
+
+	uint64_t maximum(Histogram histogram) {
+		size_t index = static_cast<size_t>(histogram);
+		uint64_t max = 0;
+		forEachShard([&](ThreadShard& shard) { max = std::max(max, shard.histogramMax[index].load(memory_order_relaxed)); });
+		return max;
+	}
+
+	uint64_t sum(Histogram histogram) {
+		size_t index = static_cast<size_t>(histogram);
+		uint64_t total = 0;
+		forEachShard([&](ThreadShard& shard) { total += shard.histogramSum[index].load(memory_order_relaxed); });
+		return total;
+	}
+
+	void writeSummary(ostream& out) {
+		out << "---- Metrics ----\n";
+		out << "packets in: " << total(Counter::PacketsIn) << " (" << total(Counter::BytesIn) << " bytes)\n";
+		out << "packets out: " << total(Counter::PacketsOut) << " (" << total(Counter::BytesOut) << " bytes)\n";
+
+		for (size_t op = 0; op < OPCODE_COUNT; ++op) {
+			uint64_t in = 0, outCount = 0;
+			forEachShard([&](ThreadShard& shard) {
+				in += shard.packetsIn[op].load(memory_order_relaxed);
+				outCount += shard.packetsOut[op].load(memory_order_relaxed);
+			});
+			if (in || outCount) out << "  " << opcodeName(static_cast<Opcode>(op)) << ": in " << in << ", out " << outCount << "\n";
+		}
+
+		out << "send failures: " << total(Counter::SendFailures) << "\n";
+		for (size_t status = 1; status < STATUS_COUNT; ++status) {
+			uint64_t failures = 0;
+			forEachShard([&](ThreadShard& shard) { failures += shard.sendFailures[status].load(memory_order_relaxed); });
+			if (failures) out << "  " << statusName(status) << ": " << failures << "\n";
+		}
+
+		uint64_t accepted = total(Counter::ConnectionsAccepted), rejected = total(Counter::ConnectionsRejected), throttled = total(Counter::ConnectionsThrottled);
+		if (accepted || rejected || throttled) out << "connections: " << accepted << " accepted, " << rejected << " rejected (full), " << throttled << " throttled\n";
+
+		uint64_t saved = total(Counter::CompressionSavedBytes);
+		if (saved) out << "compression saved: " << saved << " bytes\n";
+
+		uint64_t frames = count(Histogram::FrameTimeUs);
+		if (frames) out << "frames: " << frames << ", " << total(Counter::MissedFrameDeadlines) << " missed their deadline, " << total(Counter::SkippedInputTicks) << " input ticks skipped\n";
+
+		for (size_t h = 0; h < HISTOGRAM_COUNT; ++h) {
+			Histogram histogram = static_cast<Histogram>(h);
+			out << histogramName(h) << ": p50 <= " << percentile(histogram, 0.5) << ", p99 <= " << percentile(histogram, 0.99) << ", max " << maximum(histogram) << "\n";
+		}
+	}
+
+	void writeJson(ostream& out) {
+		out << "{\n\"counters\": {";
+		for (size_t c = 0; c < COUNTER_COUNT; ++c) {
+			out << (c ? ", " : "") << "\"" << counterName(c) << "\": " << total(static_cast<Counter>(c));
+		}
+		out << "},\n\"histograms\": {";
+		for (size_t h = 0; h < HISTOGRAM_COUNT; ++h) {
+			Histogram histogram = static_cast<Histogram>(h);
+			out << (h ? "," : "") << "\n  \"" << histogramName(h) << "\": {\"count\": " << count(histogram)
+				<< ", \"p50\": " << percentile(histogram, 0.5) << ", \"p90\": " << percentile(histogram, 0.9)
+				<< ", \"p99\": " << percentile(histogram, 0.99) << ", \"max\": " << maximum(histogram) << "}";
+		}
+		out << "\n}\n}\n";
+	}
+
+	// Counters as Prometheus counters (corplife_<name>_total, and per opcode), histograms as summaries. The quantiles are the
+	// same bucket upper bounds the other writers give.
+	void writePrometheus(ostream& out) {
+		for (size_t c = 0; c < COUNTER_COUNT; ++c) {
+			out << "# TYPE corplife_" << counterName(c) << "_total counter\n";
+			out << "corplife_" << counterName(c) << "_total " << total(static_cast<Counter>(c)) << "\n";
+		}
+
+		out << "# TYPE corplife_messages_in_total counter\n";
+		for (size_t op = 0; op < OPCODE_COUNT; ++op) {
+			uint64_t in = 0;
+			forEachShard([&](ThreadShard& shard) { in += shard.packetsIn[op].load(memory_order_relaxed); });
+			out << "corplife_messages_in_total{opcode=\"" << opcodeName(static_cast<Opcode>(op)) << "\"} " << in << "\n";
+		}
+		out << "# TYPE corplife_messages_out_total counter\n";
+		for (size_t op = 0; op < OPCODE_COUNT; ++op) {
+			uint64_t sent = 0;
+			forEachShard([&](ThreadShard& shard) { sent += shard.packetsOut[op].load(memory_order_relaxed); });
+			out << "corplife_messages_out_total{opcode=\"" << opcodeName(static_cast<Opcode>(op)) << "\"} " << sent << "\n";
+		}
+
+		for (size_t h = 0; h < HISTOGRAM_COUNT; ++h) {
+			Histogram histogram = static_cast<Histogram>(h);
+			const char* name = histogramName(h);
+			out << "# TYPE corplife_" << name << " summary\n";
+			out << "corplife_" << name << "{quantile=\"0.5\"} " << percentile(histogram, 0.5) << "\n";
+			out << "corplife_" << name << "{quantile=\"0.9\"} " << percentile(histogram, 0.9) << "\n";
+			out << "corplife_" << name << "{quantile=\"0.99\"} " << percentile(histogram, 0.99) << "\n";
+			out << "corplife_" << name << "_sum " << sum(histogram) << "\n";
+			out << "corplife_" << name << "_count " << count(histogram) << "\n";
+			out << "# TYPE corplife_" << name << "_max gauge\n";
+			out << "corplife_" << name << "_max " << maximum(histogram) << "\n";
+		}
+	}
+
+	// Chrome trace format (open in chrome://tracing or Perfetto). Spans are written as "X" (complete) events.
+	bool writeChromeTrace(const string& path) {
+		ofstream file(path);
+		if (!file) return false;
+
+		file << "{\"traceEvents\":[";
+		bool first = true;
+		forEachShard([&](ThreadShard& shard) {
+			uint64_t written = shard.traceWritten.load(memory_order_acquire);
+			uint64_t begin = written > TRACE_CAPACITY ? written - TRACE_CAPACITY : 0;
+			for (uint64_t i = begin; i < written; ++i) {
+				const TraceEvent& event = shard.trace[i % TRACE_CAPACITY];
+				file << (first ? "" : ",") << "\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"ts\":" << event.start << ",\"dur\":" << event.duration << ",\"pid\":1,\"tid\":" << shard.threadIndex << "}";
+				first = false;
+			}
+		});
+		file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+		return static_cast<bool>(file);
+	}
+}
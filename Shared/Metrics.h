@@ -0,0 +1,152 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <SFML/Network.hpp>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include "Protocol.h"
+
+// Lightweight counters, histograms and trace spans shared by the server and client.
+//
+// Every thread writes to its own shard, so recording never takes a lock or does an atomic read-modify-write.
+// Readers (writeSummary / writeChromeTrace) add the shards together with relaxed loads.
+// Recording is off until Metrics::setEnabled(true), and building with CORPLIFE_NO_METRICS removes the macros below entirely.
+
+namespace Metrics {
+
+	enum class Counter {
+		PacketsIn,
+		PacketsOut,
+		BytesIn,
+		BytesOut,
+		SendFailures,
+		ConnectionsAccepted,  // Server: handed to a match by the acceptor
+		ConnectionsRejected,  // Server: every match was full (sent LOBBY Full)
+		ConnectionsThrottled, // Server: over the per-IP connection rate, closed without a reply
+		CompressionSavedBytes, // Server: bytes compression took off the messages it was used on
+		RosterResyncs,         // Server: ROSTER_FULLs sent because a client asked (it missed a ROSTER)
+		PredictionFallbacks,   // Client: times the server's prediction of us went stale and we fell back to our own position
+		EmulatedRetransmits,   // Client: messages the network emulator "lost" (held back as if TCP had to resend them)
+		MissedFrameDeadlines,  // Client: frames that came more than half a frame late (see Client1/FramePacer.h)
+		SkippedInputTicks,     // Client: input ticks dropped after a stall too long to catch up on
+		Count
+	};
+
+	enum class Histogram {
+		TickDurationUs,     // Server: one iteration of Server::run
+		QueueDepth,         // Server: sockets with data waiting per selector wakeup
+		PredictionErrorPx,  // Server: distance between the predicted position and the next actual position
+		ClientRttMs,        // Server: time from PLAYER_POSITIONS to the client's UPDATE_POSITION echoing its timestamp
+		FrameTimeUs,        // Client: one iteration of Client::gameLoop, from the start of one frame to the start of the next
+		OutboundQueueDepth, // Server: messages queued for a client when flushing
+		InputToSendUs,      // Client: from reading the input to UPDATE_POSITION being handed to the socket
+		DrawCalls,          // Client: draw calls per frame
+		TimeToFirstFrameMs, // Client: from pressing Play (or starting a headless join) to the first game frame on screen
+		AcceptBatchSize,    // Server: connections the acceptor took off the listen backlog in one wakeup
+		SnapshotIntervalMs, // Server: a client's snapshot interval after each snapshot sent to them (30 ms unless they're falling behind)
+		HandoffPauseUs,     // Server: after a hot restart, from the old server's last tick to the new one's first
+		OwnPredictionErrorPx, // Client: distance between where the server predicts we are and where we actually are
+		EmulatedDelayMs,    // Client: how long the network emulator held each message (both directions)
+		Count
+	};
+
+	constexpr size_t COUNTER_COUNT = static_cast<size_t>(Counter::Count);
+	constexpr size_t HISTOGRAM_COUNT = static_cast<size_t>(Histogram::Count);
+	constexpr size_t STATUS_COUNT = 5; // Socket::Done .. Socket::Error
+	constexpr size_t HISTOGRAM_BUCKETS = 64; // Power-of-two buckets
+	constexpr size_t MAX_THREADS = 64;
+	constexpr size_t TRACE_CAPACITY = 1 << 15; // Spans kept per thread (oldest are overwritten)
+
+	namespace detail {
+		extern std::atomic<bool> enabled;
+	}
+
+	// Inline so a disabled metric costs one relaxed load and a branch
+	inline bool isEnabled() { return detail::enabled.load(std::memory_order_relaxed); }
+	void setEnabled(bool enabled);
+
+	// Microseconds since the process started
+	uint64_t nowMicros();
+
+	void add(Counter counter, uint64_t amount = 1);
+	void record(Histogram histogram, uint64_t value);
+	void countPacketIn(Opcode opcode, size_t bytes);
+	void countPacketOut(Opcode opcode, size_t bytes);
+	void countSendFailure(sf::Socket::Status status);
+	void recordSpan(const char* name, uint64_t startMicros, uint64_t endMicros);
+
+	// Totals across all threads
+	uint64_t total(Counter counter);
+	uint64_t percentile(Histogram histogram, double fraction);
+	uint64_t count(Histogram histogram);
+	uint64_t maximum(Histogram histogram);
+	uint64_t sum(Histogram histogram);
+
+	void writeSummary(std::ostream& out);
+	void writeJson(std::ostream& out); // Counters and histogram percentiles, for comparing automated runs
+	void writePrometheus(std::ostream& out); // The same in Prometheus' text format, for the server's admin endpoint
+	bool writeChromeTrace(const std::string& path);
+
+	// Records the time between construction and destruction as a "complete" trace event
+	class ScopedSpan {
+	public:
+		explicit ScopedSpan(const char* name) : name(name), start(isEnabled() ? nowMicros() : 0) {}
+		~ScopedSpan() { end(); }
+
+		// Ends the span early (for stages that don't line up with a C++ scope)
+		void end() {
+			if (start != 0) recordSpan(name, start, nowMicros());
+			start = 0;
+		}
+
+		ScopedSpan(const ScopedSpan&) = delete;
+		ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+	private:
+		const char* name;
+		uint64_t start;
+	};
+
+	// Records the time between construction and destruction into a histogram
+	class ScopedTimer {
+	public:
+		explicit ScopedTimer(Histogram histogram) : histogram(histogram), start(isEnabled() ? nowMicros() : 0) {}
+		~ScopedTimer() { if (start != 0) record(histogram, nowMicros() - start); }
+
+		ScopedTimer(const ScopedTimer&) = delete;
+		ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+	private:
+		Histogram histogram;
+		uint64_t start;
+	};
+}
+
+#define METRICS_CONCAT_INNER(a, b) a##b
+#define METRICS_CONCAT(a, b) METRICS_CONCAT_INNER(a, b)
+
+#ifdef CORPLIFE_NO_METRICS
+#define METRIC_ADD(counter, amount) ((void)0)
+#define METRIC_RECORD(histogram, value) ((void)0)
+#define METRIC_PACKET_IN(opcode, bytes) ((void)0)
+#define METRIC_PACKET_OUT(opcode, bytes) ((void)0)
+#define METRIC_SEND_FAILURE(status) ((void)0)
+#define METRIC_TIMER(histogram) ((void)0)
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_SPAN_BEGIN(span, name) ((void)0)
+#define TRACE_SPAN_END(span) ((void)0)
+#else
+#define METRIC_ADD(counter, amount) do { if (Metrics::isEnabled()) Metrics::add(counter, amount); } while (0)
+#define METRIC_RECORD(histogram, value) do { if (Metrics::isEnabled()) Metrics::record(histogram, value); } while (0)
+#define METRIC_PACKET_IN(opcode, bytes) do { if (Metrics::isEnabled()) Metrics::countPacketIn(opcode, bytes); } while (0)
+#define METRIC_PACKET_OUT(opcode, bytes) do { if (Metrics::isEnabled()) Metrics::countPacketOut(opcode, bytes); } while (0)
+#define METRIC_SEND_FAILURE(status) do { if (Metrics::isEnabled()) Metrics::countSendFailure(status); } while (0)
+#define METRIC_TIMER(histogram) Metrics::ScopedTimer METRICS_CONCAT(metricTimer_, __LINE__)(histogram)
+#define TRACE_SCOPE(name) Metrics::ScopedSpan METRICS_CONCAT(traceSpan_, __LINE__)(name)
+#define TRACE_SPAN_BEGIN(span, name) Metrics::ScopedSpan span(name)
+#define TRACE_SPAN_END(span) span.end()
+#endif
+
+#endif
@@ -0,0 +1,258 @@
+#include "NetEmulator.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <limits>
+
+using namespace std;
+using namespace sf;
+
+namespace {
+
+	constexpr size_t HEADER_SIZE = 4; // The big-endian size sf::Packet is sent with
+	constexpr size_t RELAY_BUFFER_SIZE = 64 * 1024;
+	constexpr float MAX_WAIT_MS = 50.f; // So stop() doesn't hang around
+
+	double nowMs() {
+		return chrono::duration<double, milli>(chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	string trim(const string& text) {
+		size_t first = text.find_first_not_of(" \t\r");
+		if (first == string::npos) return string();
+		size_t last = text.find_last_not_of(" \t\r");
+		return text.substr(first, last - first + 1);
+	}
+
+	bool setCondition(LinkConditions& link, const string& key, float value) {
+		if (key == "latency_ms") link.latencyMs = value;
+		else if (key == "jitter_ms") link.jitterMs = value;
+		else if (key == "loss_percent") link.lossPercent = value;
+		else if (key == "retransmit_ms") link.retransmitMs = value;
+		else if (key == "reorder_percent") link.reorderPercent = value;
+		else if (key == "bandwidth_kbps") link.bandwidthKbps = value;
+		else return false;
+		return true;
+	}
+
+	// Later messages are due later, so the soonest is at the top of the heap
+	struct LaterDue {
+		template <typename Message>
+		bool operator()(const Message& a, const Message& b) const {
+			return a.dueMs != b.dueMs ? a.dueMs > b.dueMs : a.sequence > b.sequence;
+		}
+	};
+}
+
+/* ------------------------ Profiles ------------------------ */
+
+bool NetProfile::load(const string& path, NetProfile& profile, string& error) {
+	ifstream file(path);
+	if (!file) {
+		error = "Could not open " + path;
+		return false;
+	}
+
+	profile = NetProfile();
+	size_t nameStart = path.find_last_of("/\\");
+	profile.name = path.substr(nameStart == string::npos ? 0 : nameStart + 1);
+	profile.name = profile.name.substr(0, profile.name.find('.'));
+
+	string line;
+	for (int lineNumber = 1; getline(file, line); ++lineNumber) {
+		line = trim(line.substr(0, line.find('#')));
+		if (line.empty()) continue;
+
+		size_t equals = line.find('=');
+		string key = trim(line.substr(0, equals));
+		string text = equals == string::npos ? string() : trim(line.substr(equals + 1));
+		char* end = nullptr;
+		float value = strtof(text.c_str(), &end);
+		if (text.empty() || *end != '\0' || value < 0.f) {
+			error = path + ":" + to_string(lineNumber) + ": expected `key = number`";
+			return false;
+		}
+
+		bool known;
+		if (key == "seed") {
+			profile.seed = static_cast<uint32_t>(value);
+			known = true;
+		}
+		else if (key.compare(0, 3, "up.") == 0) known = setCondition(profile.up, key.substr(3), value);
+		else if (key.compare(0, 5, "down.") == 0) known = setCondition(profile.down, key.substr(5), value);
+		else known = setCondition(profile.up, key, value) && setCondition(profile.down, key, value);
+
+		if (!known) {
+			error = path + ":" + to_string(lineNumber) + ": unknown setting " + key;
+			return false;
+		}
+	}
+	return true;
+}
+
+/* ------------------------ One direction ------------------------ */
+
+DelayLine::DelayLine(const LinkConditions& conditions, uint32_t seed) : conditions(conditions), random(seed) {}
+
+void DelayLine::write(const char* data, size_t size, double nowMs) {
+	partial.insert(partial.end(), data, data + size);
+
+	// Split off every whole message
+	size_t begin = 0;
+	while (partial.size() - begin >= HEADER_SIZE) {
+		const unsigned char* header = reinterpret_cast<const unsigned char*>(&partial[begin]);
+		size_t length = HEADER_SIZE + ((static_cast<size_t>(header[0]) << 24) | (static_cast<size_t>(header[1]) << 16) | (static_cast<size_t>(header[2]) << 8) | header[3]);
+		if (partial.size() - begin < length) break;
+
+		schedule(vector<char>(partial.begin() + begin, partial.begin() + begin + length), nowMs);
+		begin += length;
+	}
+	partial.erase(partial.begin(), partial.begin() + begin);
+}
+
+void DelayLine::schedule(vector<char>&& bytes, double nowMs) {
+	uniform_real_distribution<float> chance(0.f, 100.f);
+	uniform_real_distribution<float> jitter(0.f, conditions.jitterMs);
+
+	// With a bandwidth cap the message can't start until the ones before it are on their way
+	double sentMs = nowMs;
+	if (conditions.bandwidthKbps > 0.f) {
+		linkFreeMs = max(linkFreeMs, nowMs) + bytes.size() * 8.0 / conditions.bandwidthKbps; // kbit/s is bits per ms
+		sentMs = linkFreeMs;
+	}
+
+	double dueMs = sentMs + conditions.latencyMs + (conditions.jitterMs > 0.f ? jitter(random) : 0.f);
+	if (conditions.lossPercent > 0.f && chance(random) < conditions.lossPercent) {
+		dueMs += conditions.retransmitMs;
+		METRIC_ADD(Metrics::Counter::EmulatedRetransmits, 1);
+	}
+
+	// Everything else waits for the messages ahead of it, as it would over TCP
+	bool overtakes = conditions.reorderPercent > 0.f && chance(random) < conditions.reorderPercent;
+	if (!overtakes) {
+		dueMs = max(dueMs, lastInOrderMs);
+		lastInOrderMs = dueMs;
+	}
+
+	queue.push_back(Message{ dueMs, nextSequence++, nowMs, move(bytes) });
+	push_heap(queue.begin(), queue.end(), LaterDue());
+}
+
+void DelayLine::deliver(double nowMs, vector<char>& out) {
+	while (!queue.empty() && queue.front().dueMs <= nowMs) {
+		pop_heap(queue.begin(), queue.end(), LaterDue());
+		Message& message = queue.back();
+		out.insert(out.end(), message.bytes.begin(), message.bytes.end());
+		METRIC_RECORD(Metrics::Histogram::EmulatedDelayMs, static_cast<uint64_t>(nowMs - message.writtenMs));
+		queue.pop_back();
+	}
+}
+
+double DelayLine::nextDueMs() const {
+	return queue.empty() ? numeric_limits<double>::max() : queue.front().dueMs;
+}
+
+/* ------------------------ The relay ------------------------ */
+
+NetEmulator::~NetEmulator() {
+	stop();
+}
+
+bool NetEmulator::start(const NetProfile& newProfile, const IpAddress& address, unsigned short port) {
+	profile = newProfile;
+	server = address;
+	serverPort = port;
+
+	if (listener.listen(Socket::AnyPort, IpAddress::LocalHost) != Socket::Done) {
+		LOG_ERROR("Network emulator could not listen on 127.0.0.1");
+		return false;
+	}
+	selector.add(listener);
+	buffer.resize(RELAY_BUFFER_SIZE);
+
+	LOG_INFO("Emulating %s: up %.0f+%.0f ms, %.1f%% loss, down %.0f+%.0f ms, %.1f%% loss", profile.name.c_str(),
+		profile.up.latencyMs, profile.up.jitterMs, profile.up.lossPercent, profile.down.latencyMs, profile.down.jitterMs, profile.down.lossPercent);
+
+	stopping = false;
+	worker = thread([this] { relay(); });
+	return true;
+}
+
+void NetEmulator::stop() {
+	stopping = true;
+	if (worker.joinable()) worker.join();
+}
+
+void NetEmulator::relay() {
+	while (!stopping.load(memory_order_relaxed)) {
+
+		// Sleep until something arrives or the next message is due
+		double now = nowMs();
+		double nextDue = now + MAX_WAIT_MS;
+		for (const auto& pipe : pipes) nextDue = min(nextDue, min(pipe->up.nextDueMs(), pipe->down.nextDueMs()));
+		float waitMs = static_cast<float>(max(nextDue - now, 0.1)); // wait(Time::Zero) would wait forever
+		bool ready = selector.wait(microseconds(static_cast<Int64>(waitMs * 1000.f)));
+
+		now = nowMs();
+		if (ready && selector.isReady(listener)) acceptClient();
+
+		for (auto& pipe : pipes) {
+			if (ready && selector.isReady(*pipe->client)) forward(*pipe->client, pipe->up, *pipe, now);
+			if (ready && pipe->open && selector.isReady(*pipe->server)) forward(*pipe->server, pipe->down, *pipe, now);
+
+			pipe->up.deliver(now, pipe->toServer);
+			pipe->down.deliver(now, pipe->toClient);
+			if (pipe->open && (!flush(*pipe->server, pipe->toServer) || !flush(*pipe->client, pipe->toClient))) pipe->open = false;
+		}
+
+		// A side hung up: so does the other one (straight away, what was still on the way is dropped)
+		for (auto& pipe : pipes) {
+			if (pipe->open) continue;
+			selector.remove(*pipe->client);
+			selector.remove(*pipe->server);
+			pipe->client->disconnect();
+			pipe->server->disconnect();
+		}
+		pipes.erase(remove_if(pipes.begin(), pipes.end(), [](const unique_ptr<Pipe>& pipe) { return !pipe->open; }), pipes.end());
+	}
+}
+
+void NetEmulator::acceptClient() {
+	unique_ptr<Pipe> pipe(new Pipe(profile));
+	pipe->client.reset(new TcpSocket());
+	pipe->server.reset(new TcpSocket());
+	if (listener.accept(*pipe->client) != Socket::Done) return;
+
+	// The client is waiting on its own connect, so there's no harm blocking for this one
+	if (pipe->server->connect(server, serverPort, seconds(2)) != Socket::Done) {
+		LOG_WARNING("Network emulator could not reach %s:%u", server.toString().c_str(), serverPort);
+		pipe->client->disconnect();
+		return;
+	}
+
+	pipe->client->setBlocking(false);
+	pipe->server->setBlocking(false);
+	selector.add(*pipe->client);
+	selector.add(*pipe->server);
+	pipes.push_back(move(pipe));
+}
+
+void NetEmulator::forward(TcpSocket& from, DelayLine& line, Pipe& pipe, double nowMs) {
+	size_t received = 0;
+	Socket::Status status = from.receive(buffer.data(), buffer.size(), received);
+	if (status == Socket::Done) line.write(buffer.data(), received, nowMs);
+	else if (status != Socket::NotReady) pipe.open = false;
+}
+
+// Sends what the socket will take. False if the connection is gone.
+bool NetEmulator::flush(TcpSocket& to, vector<char>& pending) {
+	if (pending.empty()) return true;
+
+	size_t sent = 0;
+	Socket::Status status = to.send(pending.data(), pending.size(), sent);
+	if (status == Socket::Disconnected || status == Socket::Error) return false;
+	pending.erase(pending.begin(), pending.begin() + sent);
+	return true;
+}
@@ -0,0 +1,129 @@
+#ifndef NET_EMULATOR_H
+#define NET_EMULATOR_H
+
+#include <SFML/Network.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Network condition emulator, for testing prediction and the snapshot rates against something worse than localhost.
+//
+// It's a relay in the client's own process: the client connects to it on 127.0.0.1 and it connects on to the server, so
+// nothing else about the game changes. Every message (one sf::Packet, as framed on the wire) going either way is held back
+// according to the profile before being passed on:
+//
+//   latency   - fixed one-way delay
+//   jitter    - up to this much more, at random
+//   loss      - TCP resends a lost segment, so a "lost" message arrives a retransmit timeout late, and holds up the ones
+//               behind it just like TCP does
+//   reorder   - the chance a message may overtake the ones ahead of it (TCP never does this, but UDP would)
+//   bandwidth - messages queue behind each other on the link
+//
+// The random choices come from the profile's seed, so the same profile makes the same decisions for the same traffic.
+
+// How one direction of the link behaves
+struct LinkConditions {
+	float latencyMs = 0.f;
+	float jitterMs = 0.f;
+	float lossPercent = 0.f;
+	float retransmitMs = 200.f; // How late a lost message arrives (roughly TCP's minimum retransmit timeout)
+	float reorderPercent = 0.f;
+	float bandwidthKbps = 0.f;  // 0 is unlimited
+};
+
+// A profile file has one `key = value` per line, # for comments:
+//
+//   latency_ms, jitter_ms, loss_percent, retransmit_ms, reorder_percent, bandwidth_kbps - for both directions
+//   up.<key>, down.<key>  - for just client to server (up) or server to client (down)
+//   seed                  - for the random choices
+struct NetProfile {
+	std::string name; // The file name, without the folder and extension
+	LinkConditions up;
+	LinkConditions down;
+	uint32_t seed = 1;
+
+	// False, with `error` saying which line was wrong, if the file couldn't be read
+	static bool load(const std::string& path, NetProfile& profile, std::string& error);
+};
+
+// One direction of the link. Takes the bytes as the socket gives them and hands back whole messages once they're due.
+class DelayLine {
+public:
+	DelayLine(const LinkConditions& conditions, uint32_t seed);
+
+	void write(const char* data, size_t size, double nowMs);
+
+	// Appends every message due by `nowMs` to `out`, in the order they arrive
+	void deliver(double nowMs, std::vector<char>& out);
+
+	// When the next message is due (a very large number if there isn't one)
+	double nextDueMs() const;
+
+private:
+	struct Message {
+		double dueMs;
+		uint64_t sequence; // Messages due at the same time keep their order
+		double writtenMs;
+		std::vector<char> bytes;
+	};
+
+	void schedule(std::vector<char>&& bytes, double nowMs);
+
+	LinkConditions conditions;
+	std::mt19937 random;
+	std::vector<char> partial; // The start of a message the socket hasn't given us all of yet
+	std::vector<Message> queue; // Min-heap on dueMs
+	uint64_t nextSequence = 0;
+	double linkFreeMs = 0.0;   // Bandwidth: when the link has finished sending what's already on it
+	double lastInOrderMs = 0.0; // Nothing that keeps its place may arrive before this
+};
+
+class NetEmulator {
+public:
+	NetEmulator() = default;
+	~NetEmulator();
+
+	NetEmulator(const NetEmulator&) = delete;
+	NetEmulator& operator=(const NetEmulator&) = delete;
+
+	// Starts relaying to the server. Connect to 127.0.0.1 on getLocalPort() instead of the server after this.
+	bool start(const NetProfile& profile, const sf::IpAddress& server, unsigned short serverPort);
+	void stop();
+
+	unsigned short getLocalPort() const { return listener.getLocalPort(); }
+
+private:
+	// A client connection and the one we made to the server for it
+	struct Pipe {
+		std::unique_ptr<sf::TcpSocket> client;
+		std::unique_ptr<sf::TcpSocket> server;
+		DelayLine up;
+		DelayLine down;
+		std::vector<char> toServer; // Due, but the socket hasn't taken it yet
+		std::vector<char> toClient;
+		bool open = true;
+
+		Pipe(const NetProfile& profile) : up(profile.up, profile.seed), down(profile.down, profile.seed + 1) {}
+	};
+
+	void relay();
+	void acceptClient();
+	void forward(sf::TcpSocket& from, DelayLine& line, Pipe& pipe, double nowMs);
+	bool flush(sf::TcpSocket& to, std::vector<char>& pending);
+
+	NetProfile profile;
+	sf::IpAddress server;
+	unsigned short serverPort = 0;
+	sf::TcpListener listener;
+	sf::SocketSelector selector;
+	std::vector<std::unique_ptr<Pipe>> pipes;
+	std::vector<char> buffer;
+	std::thread worker;
+	std::atomic<bool> stopping{ false };
+};
+
+#endif
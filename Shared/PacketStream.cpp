@@ -0,0 +1,88 @@
+#include "PacketStream.h"
+#include "Compression.h"
+#include <cstring>
+
+using namespace std;
+using namespace sf;
+
+PacketStream::PacketStream(TcpSocket& socket, size_t initialCapacity) : socket(socket) {
+	outgoing.reserve(initialCapacity);
+	incoming.resize(initialCapacity);
+}
+
+Socket::Status PacketStream::send(const Packet& packet) {
+	Uint32 size = static_cast<Uint32>(packet.getDataSize());
+
+	// resize() only allocates if this packet is bigger than any sent before
+	outgoing.resize(sizeof(size) + size);
+	outgoing[0] = static_cast<char>(size >> 24);
+	outgoing[1] = static_cast<char>(size >> 16);
+	outgoing[2] = static_cast<char>(size >> 8);
+	outgoing[3] = static_cast<char>(size);
+	if (size > 0) memcpy(&outgoing[sizeof(size)], packet.getData(), size);
+
+	size_t total = 0;
+	Socket::Status status;
+	do {
+		size_t sent = 0;
+		status = socket.send(&outgoing[total], outgoing.size() - total, sent);
+		total += sent;
+	} while (status == Socket::Partial || (status == Socket::NotReady && total > 0 && total < outgoing.size()));
+
+	return status;
+}
+
+Socket::Status PacketStream::receive(Packet& packet) {
+	for (;;) {
+		Socket::Status extracted = extract(packet);
+		if (extracted != Socket::NotReady) return extracted;
+
+		// Make room at the end: first by moving the unread bytes to the front, then by growing (only for packets bigger than we've seen)
+		if (incomingEnd == incoming.size()) {
+			if (incomingBegin > 0) {
+				memmove(&incoming[0], &incoming[incomingBegin], incomingEnd - incomingBegin);
+				incomingEnd -= incomingBegin;
+				incomingBegin = 0;
+			}
+			else incoming.resize(incoming.size() * 2);
+		}
+
+		size_t received = 0;
+		Socket::Status status = socket.receive(&incoming[incomingEnd], incoming.size() - incomingEnd, received);
+		if (status != Socket::Done) return status;
+		incomingEnd += received;
+	}
+}
+
+void PacketStream::reset() {
+	incomingBegin = incomingEnd = 0;
+}
+
+// Pull one complete packet out of the buffered bytes: Done if there is one, NotReady if it hasn't all arrived, Error if it's too big
+Socket::Status PacketStream::extract(Packet& packet) {
+	size_t available = incomingEnd - incomingBegin;
+	if (available < sizeof(Uint32)) return Socket::NotReady;
+
+	const unsigned char* header = reinterpret_cast<const unsigned char*>(&incoming[incomingBegin]);
+	size_t size = (static_cast<Uint32>(header[0]) << 24) | (static_cast<Uint32>(header[1]) << 16) | (static_cast<Uint32>(header[2]) << 8) | header[3];
+	if (size > MAX_PACKET_SIZE) return Socket::Error; // Corrupt or hostile, and trusting it would mean allocating up to 4 GB
+
+	if (available < sizeof(Uint32) + size) {
+		// Make sure the whole packet will fit once it arrives
+		if (sizeof(Uint32) + size > incoming.size() - incomingBegin) {
+			memmove(&incoming[0], &incoming[incomingBegin], available);
+			incomingBegin = 0;
+			incomingEnd = available;
+			if (sizeof(Uint32) + size > incoming.size()) incoming.resize(sizeof(Uint32) + size);
+		}
+		return Socket::NotReady;
+	}
+
+	// clear() keeps the packet's capacity, so refilling it doesn't allocate
+	packet.clear();
+	if (size > 0) packet.append(&incoming[incomingBegin + sizeof(Uint32)], size);
+
+	incomingBegin += sizeof(Uint32) + size;
+	if (incomingBegin == incomingEnd) incomingBegin = incomingEnd = 0;
+	return Socket::Done;
+}
@@ -0,0 +1,37 @@
+#ifndef PACKET_STREAM_H
+#define PACKET_STREAM_H
+
+#include <SFML/Network.hpp>
+#include <vector>
+
+// Sends and receives sf::Packets over a TcpSocket using the same wire format as TcpSocket::send(Packet&) / receive(Packet&)
+// (4 byte big-endian size, then the packet data), so the other side can keep using plain SFML.
+//
+// SFML builds a new buffer for every packet it sends and receives. PacketStream keeps its buffers between calls,
+// and receive() refills the caller's packet in place, so after the first few packets nothing here touches the heap.
+class PacketStream {
+public:
+	explicit PacketStream(sf::TcpSocket& socket, size_t initialCapacity = 4096);
+
+	// Blocks in blocking mode. In non-blocking mode, keeps sending until the whole packet is out.
+	sf::Socket::Status send(const sf::Packet& packet);
+
+	// Done when a whole packet was put into `packet`. In non-blocking mode, NotReady means part of one may have been buffered.
+	// Error when the next packet says it's bigger than MAX_PACKET_SIZE (Shared/Compression.h): the stream can't be read past
+	// it, so reconnect (and reset()).
+	sf::Socket::Status receive(sf::Packet& packet);
+
+	// Drop anything buffered (e.g. after reconnecting the socket)
+	void reset();
+
+private:
+	sf::Socket::Status extract(sf::Packet& packet);
+
+	sf::TcpSocket& socket;
+	std::vector<char> outgoing;
+	std::vector<char> incoming;
+	size_t incomingBegin = 0;
+	size_t incomingEnd = 0;
+};
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include "Schema.h"
+
+// Every packet starts with a command string. These are the commands the server and client send to each other.
+enum class Opcode {
+	PlayerName,      // Client -> Server: name entered in the main menu
+	UpdatePosition,  // Client -> Server: actual position + movement vector
+	Resume,          // Client -> Server: session token after a reconnect
+	PlayerPositions, // Server -> Client: predicted positions of every player
+	PlayerId,        // Server -> Client: the player's ID and session token
+	Spawn,           // Server -> Client: new rainbow ball
+	Despawn,         // Server -> Client: rainbow ball removed
+	Resync,          // Server -> Client: state that changed while a player was disconnected
+	ResumeFailed,    // Server -> Client: the session token was unknown or expired
+	Lobby,           // Server -> Client: lobby status as one LobbyStatus byte
+	Roster,          // Server -> Client: players joining, leaving and scoring since the last one (see RosterEvent)
+	RosterFull,      // Server -> Client: the whole roster, when joining the match or after a gap
+	RosterRequest,   // Client -> Server: missed a ROSTER, please send ROSTER_FULL
+	Packed,          // Server -> Client: another message, compressed (see PACKED_HEADER_SIZE)
+	Watch,           // Server -> Spectator: one whole frame of the match (see WatchFlags)
+	Unknown,
+	Count
+};
+
+constexpr size_t OPCODE_COUNT = static_cast<size_t>(Opcode::Count);
+
+// Sent after LOBBY. The client used to match the English text, which broke whenever the wording changed.
+enum class LobbyStatus : unsigned char {
+	Waiting,  // Connected, waiting for another player
+	Starting, // Both players are here, the game starts now
+	Full      // No room, the server disconnects after this
+};
+
+// The scoreboard is kept in sync with versioned events instead of resending every name and score whenever someone scores.
+// Every event bumps the server's roster version by one.
+//   ROSTER:         Uint32 version of the first event, Uint16 event count, then the events
+//   ROSTER_FULL:    Uint32 version it's up to date with, Uint32 player count, then (ID, name, score) per player
+//   ROSTER_REQUEST: Uint32 version the client has
+// A client applies a ROSTER only if it starts right after the version it has, ignores one it has already seen, and on a gap
+// (e.g. the server dropped a message because the client fell behind) asks for ROSTER_FULL.
+enum class RosterEvent : unsigned char {
+	Join,  // ID, name, score. Also sent when a player changes their name.
+	Leave, // ID
+	Score  // ID, Int32 change in score
+};
+
+// Spectators get WATCH, a whole frame each time, so they (and relays) can start watching at any frame:
+//   Uint32 frame number, Uint8 WatchFlags, the rainbow ball if there is one (float x, y, Uint8 r, g, b),
+//   Uint16 player count, then (Int32 ID, float x, float y, Int32 score, string name) per player
+enum WatchFlags : unsigned char {
+	WATCH_MATCH_IN_PROGRESS = 1,
+	WATCH_RAINBOW_BALL = 2
+};
+
+/* ------------------------ Fixed-size messages ------------------------ */
+
+// What follows the command in each message that has no strings in it, declared once for both sides (see Schema.h). Write one
+// with Schema::append(packet, ...) after the command and read it with Schema::reader(packet).read(...).
+
+// PLAYER_POSITIONS is one of these per player, in the server's order. A client's spawn position is the entry with the ID from
+// the PLAYER_ID that comes just before its first PLAYER_POSITIONS.
+struct PlayerPositionEntry {
+	int64_t timestamp; // Epoch milliseconds when the server sent it, echoed back in InputEcho
+	int32_t ID;
+	float x;
+	float y;
+
+	static constexpr auto fields() {
+		return std::make_tuple(Schema::field(&PlayerPositionEntry::timestamp), Schema::field(&PlayerPositionEntry::ID),
+			Schema::field(&PlayerPositionEntry::x), Schema::field(&PlayerPositionEntry::y));
+	}
+};
+
+// PLAYER_ID
+struct PlayerIdMessage {
+	int32_t ID;
+	uint64_t sessionToken; // For RESUME after a reconnect
+
+	static constexpr auto fields() {
+		return std::make_tuple(Schema::field(&PlayerIdMessage::ID), Schema::field(&PlayerIdMessage::sessionToken));
+	}
+};
+
+// UPDATE_POSITION: where the player is and how far they moved this frame, followed by an InputEcho once they've had a
+// PLAYER_POSITIONS
+struct UpdatePositionMessage {
+	float x;
+	float y;
+	float moveX;
+	float moveY;
+
+	static constexpr auto fields() {
+		return std::make_tuple(Schema::field(&UpdatePositionMessage::x), Schema::field(&UpdatePositionMessage::y),
+			Schema::field(&UpdatePositionMessage::moveX), Schema::field(&UpdatePositionMessage::moveY));
+	}
+};
+
+// The timestamp of the last PLAYER_POSITIONS the client got, and how long it had it before sending this, for the RTT
+struct InputEcho {
+	int64_t timestamp;
+	uint16_t heldMs;
+
+	static constexpr auto fields() {
+		return std::make_tuple(Schema::field(&InputEcho::timestamp), Schema::field(&InputEcho::heldMs));
+	}
+};
+
+// SPAWN, and the new rainbow ball in a RESYNC
+struct SpawnMessage {
+	float x;
+	float y;
+	uint8_t r;
+	uint8_t g;
+	uint8_t b;
+	float spawnTime; // Seconds, on the server's clock
+
+	static constexpr auto fields() {
+		return std::make_tuple(Schema::field(&SpawnMessage::x), Schema::field(&SpawnMessage::y), Schema::field(&SpawnMessage::r),
+			Schema::field(&SpawnMessage::g), Schema::field(&SpawnMessage::b), Schema::field(&SpawnMessage::spawnTime));
+	}
+};
+
+// RESUME
+struct ResumeMessage {
+	uint64_t sessionToken;
+
+	static constexpr auto fields() {
+		return std::make_tuple(Schema::field(&ResumeMessage::sessionToken));
+	}
+};
+
+// RESYNC: the resumed player's own state, then a SpawnMessage if rainbowBall is 2
+struct ResyncMessage {
+	int32_t ID;
+	float x;
+	float y;
+	int32_t score;
+	uint8_t rainbowBall; // 0 = unchanged, 1 = gone, 2 = a new one
+
+	static constexpr auto fields() {
+		return std::make_tuple(Schema::field(&ResyncMessage::ID), Schema::field(&ResyncMessage::x), Schema::field(&ResyncMessage::y),
+			Schema::field(&ResyncMessage::score), Schema::field(&ResyncMessage::rainbowBall));
+	}
+};
+
+// PACKED is followed by the dictionary version (one byte), the Uint32 size of the original message and then the compressed bytes
+// (Shared/Compression.h). The client decompresses it and handles the original message as if it had arrived on its own.
+constexpr size_t PACKED_HEADER_SIZE = 4 + 6 + 1 + 4; // "PACKED" as an sf::Packet string (length + characters), version, size
+
+inline const char* opcodeName(Opcode opcode) {
+	switch (opcode) {
+	case Opcode::PlayerName: return "PLAYER_NAME";
+	case Opcode::UpdatePosition: return "UPDATE_POSITION";
+	case Opcode::Resume: return "RESUME";
+	case Opcode::PlayerPositions: return "PLAYER_POSITIONS";
+	case Opcode::PlayerId: return "PLAYER_ID";
+	case Opcode::Spawn: return "SPAWN";
+	case Opcode::Despawn: return "DESPAWN";
+	case Opcode::Resync: return "RESYNC";
+	case Opcode::ResumeFailed: return "RESUME_FAILED";
+	case Opcode::Lobby: return "LOBBY";
+	case Opcode::Roster: return "ROSTER";
+	case Opcode::RosterFull: return "ROSTER_FULL";
+	case Opcode::RosterRequest: return "ROSTER_REQUEST";
+	case Opcode::Packed: return "PACKED";
+	case Opcode::Watch: return "WATCH";
+	default: return "UNKNOWN";
+	}
+}
+
+// Map a received command string back to its opcode (used for per-opcode stats)
+inline Opcode opcodeFromCommand(const std::string& command) {
+	for (size_t i = 0; i < static_cast<size_t>(Opcode::Unknown); ++i) {
+		if (command == opcodeName(static_cast<Opcode>(i))) return static_cast<Opcode>(i);
+	}
+	return Opcode::Unknown;
+}
+
+#endif
@@ -0,0 +1,207 @@
+#ifndef SCHEMA_H
+#define SCHEMA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// Fixed-size messages declared once, as plain structs, with their encoders and decoders generated from the declaration.
+//
+// A message lists its fields in wire order in a constexpr fields() (the messages themselves are in Protocol.h):
+//
+//   struct PlayerIdMessage {
+//       int32_t ID;
+//       uint64_t sessionToken;
+//       static constexpr auto fields() { return std::make_tuple(Schema::field(&PlayerIdMessage::ID), Schema::field(&PlayerIdMessage::sessionToken)); }
+//   };
+//
+// From that list the message's size and every field's offset are worked out at compile time. encode() writes each field
+// straight to its offset; MessageReader::read() checks once that the whole message is in the buffer, then decodes it from
+// where it lies. There are no virtual calls and no per-field bounds checks, and nothing is copied on the way.
+//
+// The bytes are exactly what sf::Packet's << writes (integers big-endian, floats as they are in memory, bools as one byte),
+// so the two can be mixed in one packet, and a message can move over to the schema on one side before the other.
+// Strings aren't fixed-size, so a message with one in it won't compile: those are still written with sf::Packet.
+namespace Schema {
+
+	/* ------------------------ Field types ------------------------ */
+
+	// How one field goes on the wire. Only fixed-size types have one.
+	template <typename T, typename Enable = void>
+	struct Wire;
+
+	template <typename T>
+	struct Wire<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type> {
+		static constexpr size_t SIZE = sizeof(T);
+		using Bits = typename std::make_unsigned<T>::type;
+
+		static void write(char* out, T value) {
+			Bits bits = static_cast<Bits>(value);
+			for (size_t i = 0; i < SIZE; ++i) out[i] = static_cast<char>(bits >> (8 * (SIZE - 1 - i)));
+		}
+
+		static T read(const char* in) {
+			Bits bits = 0;
+			for (size_t i = 0; i < SIZE; ++i) bits = static_cast<Bits>((bits << 8) | static_cast<unsigned char>(in[i]));
+			return static_cast<T>(bits);
+		}
+	};
+
+	template <>
+	struct Wire<bool> {
+		static constexpr size_t SIZE = 1;
+		static void write(char* out, bool value) { out[0] = value ? 1 : 0; }
+		static bool read(const char* in) { return in[0] != 0; }
+	};
+
+	template <typename T>
+	struct Wire<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+		static constexpr size_t SIZE = sizeof(T);
+		static void write(char* out, T value) { std::memcpy(out, &value, SIZE); }
+		static T read(const char* in) {
+			T value;
+			std::memcpy(&value, in, SIZE);
+			return value;
+		}
+	};
+
+	// Enums go as their underlying type (e.g. LobbyStatus as one byte)
+	template <typename T>
+	struct Wire<T, typename std::enable_if<std::is_enum<T>::value>::type> {
+		using Underlying = typename std::underlying_type<T>::type;
+		static constexpr size_t SIZE = Wire<Underlying>::SIZE;
+		static void write(char* out, T value) { Wire<Underlying>::write(out, static_cast<Underlying>(value)); }
+		static T read(const char* in) { return static_cast<T>(Wire<Underlying>::read(in)); }
+	};
+
+	/* ------------------------ Declaring a message ------------------------ */
+
+	template <typename Message, typename T>
+	struct Field {
+		using Type = T;
+		T Message::* member;
+	};
+
+	template <typename Message, typename T>
+	constexpr Field<Message, T> field(T Message::* member) {
+		return { member };
+	}
+
+	namespace Detail {
+		constexpr size_t sum() { return 0; }
+
+		template <typename... Sizes>
+		constexpr size_t sum(size_t first, Sizes... rest) { return first + sum(rest...); }
+
+		template <typename Message>
+		using Fields = decltype(Message::fields());
+
+		template <typename Message>
+		using Indices = std::make_index_sequence<std::tuple_size<Fields<Message>>::value>;
+
+		template <typename Message, size_t I>
+		using FieldType = typename std::tuple_element<I, Fields<Message>>::type::Type;
+
+		// The size of fields 0..N-1, i.e. where field N starts (or, for all of them, the whole message)
+		template <typename Message, size_t... I>
+		constexpr size_t sizeOf(std::index_sequence<I...>) { return sum(Wire<FieldType<Message, I>>::SIZE...); }
+	}
+
+	// Bytes the message takes on the wire
+	template <typename Message>
+	constexpr size_t size() { return Detail::sizeOf<Message>(Detail::Indices<Message>()); }
+
+	// Where field I starts
+	template <typename Message, size_t I>
+	constexpr size_t offset() { return Detail::sizeOf<Message>(std::make_index_sequence<I>()); }
+
+	/* ------------------------ Encoding and decoding ------------------------ */
+
+	namespace Detail {
+		template <typename Message, size_t I>
+		void writeField(char* out, const Message& message) {
+			constexpr auto member = std::get<I>(Message::fields()).member;
+			Wire<FieldType<Message, I>>::write(out + offset<Message, I>(), message.*member);
+		}
+
+		template <typename Message, size_t I>
+		void readField(const char* in, Message& message) {
+			constexpr auto member = std::get<I>(Message::fields()).member;
+			message.*member = Wire<FieldType<Message, I>>::read(in + offset<Message, I>());
+		}
+
+		template <typename Message, size_t... I>
+		void encode(char* out, const Message& message, std::index_sequence<I...>) {
+			using Expand = int[];
+			(void)Expand{ 0, (writeField<Message, I>(out, message), 0)... };
+		}
+
+		template <typename Message, size_t... I>
+		void decode(const char* in, Message& message, std::index_sequence<I...>) {
+			using Expand = int[];
+			(void)Expand{ 0, (readField<Message, I>(in, message), 0)... };
+		}
+	}
+
+	// Writes size<Message>() bytes to `out`
+	template <typename Message>
+	void encode(const Message& message, char* out) {
+		Detail::encode(out, message, Detail::Indices<Message>());
+	}
+
+	// Reads size<Message>() bytes from `in`. They have to be there (MessageReader checks).
+	template <typename Message>
+	void decode(const char* in, Message& message) {
+		Detail::decode(in, message, Detail::Indices<Message>());
+	}
+
+	// Adds the message to anything with append(const void*, size_t), e.g. an sf::Packet, in one go
+	template <typename Message, typename Buffer>
+	void append(Buffer& buffer, const Message& message) {
+		static_assert(size<Message>() > 0, "A message needs at least one field");
+		char bytes[size<Message>()];
+		encode(message, bytes);
+		buffer.append(bytes, sizeof(bytes));
+	}
+
+	// Reads messages out of a received buffer, where they lie. Each read() checks once that the whole message is there, then
+	// decodes it. Once a read comes up short the reader stays failed, like sf::Packet.
+	class MessageReader {
+	public:
+		MessageReader(const void* data, size_t size, size_t position = 0)
+			: data(static_cast<const char*>(data)), end(size), position(position), valid(position <= size) {}
+
+		template <typename Message>
+		bool read(Message& message) {
+			if (!valid || end - position < size<Message>()) {
+				valid = false;
+				return false;
+			}
+			decode(data + position, message);
+			position += size<Message>();
+			return true;
+		}
+
+		bool atEnd() const { return position >= end; }
+		size_t remaining() const { return valid ? end - position : 0; }
+		size_t getPosition() const { return position; }
+		explicit operator bool() const { return valid; }
+
+	private:
+		const char* data;
+		size_t end;
+		size_t position;
+		bool valid;
+	};
+
+	// A reader for the rest of an sf::Packet (or anything like one), from wherever it has read up to, e.g. just after the command
+	template <typename Packet>
+	MessageReader reader(const Packet& packet) {
+		return MessageReader(packet.getData(), packet.getDataSize(), packet.getReadPosition());
+	}
+}
+
+#endif
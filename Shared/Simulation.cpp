@@ -0,0 +1,69 @@
+#include "Simulation.h"
+#include "Collision.h"
+#include <algorithm>
+#include <cmath>
+
+MoveStep step(Vector2f position, Vector2f target, float deltaTime) {
+	MoveStep result = { position, { 0.f, 0.f } };
+
+	// Compute direction vector and normalize it
+	Vector2f direction = target - position;
+	float distance = sqrt(direction.x * direction.x + direction.y * direction.y);
+
+	// Only move if outside the dead zone
+	if (distance > DEAD_ZONE_RADIUS) {
+		Vector2f normalizedDirection = direction / distance;
+		result.movement = normalizedDirection * MOVE_SPEED * deltaTime;
+		result.position += result.movement;
+	}
+
+	result.position = clampToWorld(result.position);
+	return result;
+}
+
+Vector2f clampToWorld(Vector2f position) {
+	position.x = max(0.f, min(position.x, WINDOW_WIDTH - 2 * PLAYER_RADIUS));
+	position.y = max(0.f, min(position.y, WINDOW_HEIGHT - 2 * PLAYER_RADIUS));
+	return position;
+}
+
+Vector2f predictPosition(const deque<PositionSnapshot>& history, Vector2f position, float predictionTime, float smoothing) {
+	Vector2f predictedPosition = position; // Default to last known position
+
+	// Predict the next position if enough data is available
+	if (history.size() >= 2) {
+		const PositionSnapshot& lastPosition = history.back();
+		const PositionSnapshot& secondLastPosition = history[history.size() - 2];
+
+		// Calculate velocity (last two positions)
+		float timeDelta = (lastPosition.timestamp - secondLastPosition.timestamp) / 1000.0f; // Convert ms to seconds
+
+		if (timeDelta > 0.0f) {
+			Vector2f velocity = (lastPosition.position - secondLastPosition.position) / timeDelta;
+
+			// Predict based on velocity and elapsed time
+			predictedPosition = lastPosition.position + (velocity * 2.5f) * predictionTime;
+		}
+	}
+
+	// Apply smoothing to avoid sudden jumps
+	predictedPosition = smoothing * position + (1.0f - smoothing) * predictedPosition;
+
+	// Limit drift
+	if (abs(predictedPosition.x - position.x) > MAX_PREDICTION_DRIFT ||
+		abs(predictedPosition.y - position.y) > MAX_PREDICTION_DRIFT) {
+		predictedPosition = position; // Revert to last known position
+	}
+
+	return predictedPosition;
+}
+
+bool shouldSendInput(Vector2f position, Vector2f movement, Vector2f lastSentPosition, Vector2f lastSentMovement, float msSinceLastSend) {
+	if (position != lastSentPosition || movement != lastSentMovement) return true;
+	return msSinceLastSend >= INPUT_HEARTBEAT_MS;
+}
+
+bool isTouchingRainbowBall(Vector2f player, Vector2f rainbowBall) {
+	// Compares the centres' squared distance with the squared sum of the radii (see Shared/Collision.h)
+	return overlaps(playerCircle(player.x, player.y), rainbowCircle(rainbowBall.x, rainbowBall.y));
+}
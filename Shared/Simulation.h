@@ -0,0 +1,46 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <SFML/System/Vector2.hpp>
+#include <deque>
+#include "GameConfig.h"
+
+using namespace std;
+using namespace sf;
+
+// The game rules, shared by the client and server. Nothing in here draws anything or touches a socket, and every
+// function gives the same result for the same inputs (plain float maths, no clocks or randomness), so the client's
+// local movement and the server's checks agree exactly and the rules can be benchmarked and fuzzed on their own.
+
+struct PositionSnapshot {
+	Vector2f position;
+	float timestamp; // Milliseconds since the server started
+};
+
+// Result of moving a player for one frame
+struct MoveStep {
+	Vector2f position; // Where the player ends up (clamped to the play area)
+	Vector2f movement; // How far they tried to move this frame (sent to the server in UPDATE_POSITION)
+};
+
+// One frame of movement: head towards `target` (the mouse) at MOVE_SPEED, unless it's within the dead zone,
+// then stay inside the play area.
+MoveStep step(Vector2f position, Vector2f target, float deltaTime);
+
+// Keep a player's top-left corner inside the play area
+Vector2f clampToWorld(Vector2f position);
+
+// Where the player should be by the time the next PLAYER_POSITIONS reaches the clients.
+// Uses the velocity between the last two snapshots, smooths it against the last known position (`smoothing` is the
+// weight of the last known position, PREDICTION_SMOOTHING or the server's prediction-smoothing setting) and
+// gives up (returns `position`) if the guess drifts too far.
+Vector2f predictPosition(const deque<PositionSnapshot>& history, Vector2f position, float predictionTime, float smoothing);
+
+// True when the player's circle overlaps the rainbow ball (both given as top-left positions)
+bool isTouchingRainbowBall(Vector2f player, Vector2f rainbowBall);
+
+// Whether this frame's UPDATE_POSITION is worth sending: when the player moved, when they stopped (so the server sees the
+// velocity drop to zero) and otherwise only as a heartbeat every INPUT_HEARTBEAT_MS.
+bool shouldSendInput(Vector2f position, Vector2f movement, Vector2f lastSentPosition, Vector2f lastSentMovement, float msSinceLastSend);
+
+#endif